@@ -1,4 +1,6 @@
+using System.IO;
 using System.Runtime.InteropServices;
+using System.Text;
 using UnityEngine;
 using UnityEngine.Assertions;
 
@@ -7,28 +9,313 @@ public static class DWM_AudioManager
 {
     private static class NativePlugin
     {
+        [DllImport("Unity_DWM_Spatializer")]
+        public static extern int GetMaxWorkerCount();
+
+        [DllImport("Unity_DWM_Spatializer")]
+        public static extern void SetWorkerCount(int count);
+
+        [DllImport("Unity_DWM_Spatializer")]
+        public static extern int GetLookaheadBlocks();
+
+        [DllImport("Unity_DWM_Spatializer")]
+        public static extern void SetLookaheadBlocks(int blocks);
+
+        [DllImport("Unity_DWM_Spatializer")]
+        public static extern uint GetDeadlineMisses();
+
+        [DllImport("Unity_DWM_Spatializer")]
+        public static extern float GetSleepThreshold();
+
+        [DllImport("Unity_DWM_Spatializer")]
+        public static extern void SetSleepThreshold(float threshold);
+
+        [DllImport("Unity_DWM_Spatializer")]
+        public static extern int GetQualityTierCount();
+
+        [DllImport("Unity_DWM_Spatializer")]
+        public static extern int GetQualityTierRate(int tier);
+
+        [DllImport("Unity_DWM_Spatializer")]
+        public static extern void GetQualityTierSize(int tier, [Out] float[] size);
+
+        [DllImport("Unity_DWM_Spatializer")]
+        public static extern int GetQualityTier();
+
+        [DllImport("Unity_DWM_Spatializer")]
+        public static extern int SetQualityTier(int tier);
+
+        [DllImport("Unity_DWM_Spatializer")]
+        public static extern int LoadOccupancy(string path);
+
+        [DllImport("Unity_DWM_Spatializer")]
+        public static extern void ClearOccupancy();
+
+        [DllImport("Unity_DWM_Spatializer")]
+        public static extern int GetRoomCount();
+
+        [DllImport("Unity_DWM_Spatializer")]
+        public static extern void GetRoomBounds(int index, [Out] float[] bounds);
+
+        [DllImport("Unity_DWM_Spatializer")]
+        public static extern int GetAmbisonicOrder();
+
+        [DllImport("Unity_DWM_Spatializer")]
+        public static extern int GetStatistics([Out] float[] values, int count);
+
+        [DllImport("Unity_DWM_Spatializer")]
+        public static extern int GetBudgetHistogram([Out] float[] counts, int count);
+
+        [DllImport("Unity_DWM_Spatializer")]
+        public static extern void ResetStatistics();
+
+        [DllImport("Unity_DWM_Spatializer")]
+        public static extern int SetTraceFile(string path);
+
         [DllImport("Unity_DWM_Spatializer")]
         public static extern int GetSampleRate();
 
         [DllImport("Unity_DWM_Spatializer")]
-        public static extern int GetBufferSize();
+        public static extern int BakeImpulseResponses(string path, float listenerSpacing, float sourceSpacing,
+            int yawCount, int length);
+
+        [DllImport("Unity_DWM_Spatializer")]
+        public static extern float GetBakeProgress();
+
+        [DllImport("Unity_DWM_Spatializer")]
+        public static extern int GetBakeError(StringBuilder message, int capacity);
+
+        [DllImport("Unity_DWM_Spatializer")]
+        public static extern void CancelBake();
+
+        [DllImport("Unity_DWM_Spatializer")]
+        public static extern int LoadImpulseResponses(string path);
+
+        [DllImport("Unity_DWM_Spatializer")]
+        public static extern void ClearImpulseResponses();
     }
 
+    /// Rendering statistics of the simulation shared by the spatializer's instances
+    public struct Statistics
+    {
+        /// Blocks rendered
+        public ulong Blocks;
+
+        /// Blocks which took longer to render than their duration
+        public ulong Overruns;
+
+        /// Rendering time of the last block, in milliseconds
+        public float LastBlockMs;
+
+        /// Mean rendering time of the blocks, in milliseconds
+        public float MeanBlockMs;
+
+        /// Longest rendering time of a block, in milliseconds
+        public float PeakBlockMs;
+
+        /// Rendering time of the last block, in percent of its duration
+        public float LastBudget;
+
+        /// Highest rendering time of a block, in percent of its duration
+        public float PeakBudget;
+
+        /// Sources injected in the mesh by the last block
+        public int ActiveSources;
+
+        /// Percentage of the mesh's tiles asleep at the end of the last block
+        public float SleepingTiles;
+
+        /// Junction updates computed per second spent rendering
+        public float JunctionUpdatesPerSecond;
+    }
+
+    // Must match dwm::render_statistics::value
+    private const int StatisticsValueCount = 10;
+
+    /// Width in percent of the blocks' duration of the bins of BudgetHistogram
+    public const float BudgetHistogramBinWidth = 5;
+
+    /// Maximum number of threads the mesh simulation can be split across (one per hardware thread)
+    public static int MaxWorkerCount => NativePlugin.GetMaxWorkerCount();
+
+    /// Sets the number of threads the mesh simulation is split across, takes effect at the next audio block
+    public static void SetWorkerCount(int count) => NativePlugin.SetWorkerCount(count);
+
+    /// Number of DSP buffers the mesh is rendered ahead on its own thread, 0 when rendered in the audio callback
+    public static int LookaheadBlocks => NativePlugin.GetLookaheadBlocks();
+
+    /// Sets the number of DSP buffers the mesh is rendered ahead, takes effect when the spatializer is next created
+    /// (e.g. after AudioSettings.Reset)
+    public static void SetLookaheadBlocks(int blocks) => NativePlugin.SetLookaheadBlocks(blocks);
+
+    /// Number of DSP buffers the look-ahead thread did not render in time, which were faded out instead
+    public static uint DeadlineMisses => NativePlugin.GetDeadlineMisses();
+
+    /// Peak value below which silent regions of the mesh stop being updated until a sound reaches them again
+    public static float SleepThreshold => NativePlugin.GetSleepThreshold();
+
+    /// Sets the peak value below which silent regions of the mesh stop being updated, 0 to update the whole mesh at
+    /// every step. Takes effect at the next audio block
+    public static void SetSleepThreshold(float threshold) => NativePlugin.SetSleepThreshold(threshold);
+
+    /// Number of quality tiers the plugin was built with (see DWM_QUALITY_RATES), ordered by rate
+    public static int QualityTierCount => NativePlugin.GetQualityTierCount();
+
+    /// Sample rate in Hz of the mesh simulated at a quality tier, 0 for an invalid tier
+    public static int GetQualityTierRate(int tier) => NativePlugin.GetQualityTierRate(tier);
+
+    /// Gets the size in meters of the mesh simulated at a quality tier, the rooms' bounding box for all the tiers when
+    /// the space is made of rooms
+    public static Vector3 GetQualityTierSize(int tier)
+    {
+        Assert.IsTrue(tier >= 0 && tier < QualityTierCount);
+        var s = new float[3];
+        NativePlugin.GetQualityTierSize(tier, s);
+        return new Vector3(s[0], s[1], s[2]);
+    }
+
+    /// Quality tier the spatializer simulates the space at, the one at DWM_SAMPLE_RATE by default. A switch only
+    /// changes it once the audio thread swapped the tier's mesh in
+    public static int QualityTier => NativePlugin.GetQualityTier();
+
+    /// Switches the spatializer to a quality tier, blocking while its mesh is built and until the audio thread swaps it
+    /// in. The current mesh fades out and the new one starts from silence, so the reverberation in progress is lost
+    /// <returns>Whether the tier is valid and playing, false if the audio thread did not swap it in within a second
+    /// (e.g. while the audio is paused), the current tier going on</returns>
+    public static bool SetQualityTier(int tier) => NativePlugin.SetQualityTier(tier) != 0;
+
+    /// Occupancy grid loaded at startup when present, as baked by DWM_OccupancyBaker
+    public static string OccupancyPath => Path.Combine(Application.streamingAssetsPath, "DWM_Occupancy.bin");
+
+    /// Loads an occupancy grid marking the solid voxels left out of the mesh, takes effect when the spatializer is
+    /// next created (e.g. after AudioSettings.Reset)
+    public static bool LoadOccupancy(string path) => NativePlugin.LoadOccupancy(path) != 0;
+
+    /// Marks the whole mesh as air again, takes effect when the spatializer is next created
+    public static void ClearOccupancy() => NativePlugin.ClearOccupancy();
+
+    /// Number of rooms the simulated space is made of, 1 when it is a single box
+    public static int RoomCount => NativePlugin.GetRoomCount();
+
+    /// Gets the bounds of one of the rooms, in the mesh's coordinates. A single box is the mesh of the current quality
+    /// tier
+    public static Bounds GetRoomBounds(int index)
+    {
+        Assert.IsTrue(index >= 0 && index < RoomCount);
+        var b = new float[6];
+        NativePlugin.GetRoomBounds(index, b);
+        var min = new Vector3(b[0], b[1], b[2]);
+        var size = new Vector3(b[3], b[4], b[5]);
+        return new Bounds(min + size / 2, size);
+    }
+
+    /// Order of the ambisonic channels (ACN/SN3D) the spatializer outputs instead of the two ears, 0 when it outputs
+    /// the ears
+    public static int AmbisonicOrder => NativePlugin.GetAmbisonicOrder();
+
+    /// Reads the rendering statistics without blocking the audio thread, the values of a block being rendered may be
+    /// partially included
+    public static Statistics GetStatistics()
+    {
+        var v = new float[StatisticsValueCount];
+        NativePlugin.GetStatistics(v, v.Length);
+        return new Statistics
+        {
+            Blocks = (ulong)v[0],
+            Overruns = (ulong)v[1],
+            LastBlockMs = v[2],
+            MeanBlockMs = v[3],
+            PeakBlockMs = v[4],
+            LastBudget = v[5],
+            PeakBudget = v[6],
+            ActiveSources = (int)v[7],
+            SleepingTiles = v[8],
+            JunctionUpdatesPerSecond = v[9]
+        };
+    }
+
+    /// Histogram of the blocks' rendering time in percent of their duration, BudgetHistogramBinWidth percent per bin
+    /// from 0, the last bin also counting the blocks beyond it
+    public static float[] GetBudgetHistogram()
+    {
+        var counts = new float[40];
+        var n = NativePlugin.GetBudgetHistogram(counts, counts.Length);
+        System.Array.Resize(ref counts, n);
+        return counts;
+    }
+
+    /// Clears the rendering statistics and their histogram
+    public static void ResetStatistics() => NativePlugin.ResetStatistics();
+
+    /// Starts appending the rendering statistics to a CSV file every 100 ms, from a thread of the plugin, replacing
+    /// any previous trace
+    public static bool StartTrace(string path) => !string.IsNullOrEmpty(path) && NativePlugin.SetTraceFile(path) != 0;
+
+    /// Stops the trace started by StartTrace and closes its file
+    public static void StopTrace() => NativePlugin.SetTraceFile(null);
+
+    /// Impulse responses loaded at startup when present, as baked by BakeImpulseResponses
+    public static string ImpulseResponsesPath =>
+        Path.Combine(Application.streamingAssetsPath, "DWM_ImpulseResponses.bin");
+
+    /// Starts baking in the background the impulse responses between points of the mesh spread over a grid, with the
+    /// loaded occupancy grid and the boundary parameters of the spatializer, replacing any bake in progress
+    /// <param name="path">File the responses are written to once baked, replaced even while loaded</param>
+    /// <param name="listenerSpacing">Distance in meters between the listener positions</param>
+    /// <param name="sourceSpacing">Distance in meters between the source positions</param>
+    /// <param name="yawCount">Number of listener orientations around the vertical axis</param>
+    /// <param name="seconds">Length of the responses</param>
+    /// <returns>Whether the bake started, it is not supported when the spatializer outputs ambisonics</returns>
+    public static bool BakeImpulseResponses(string path, float listenerSpacing = 0.5f, float sourceSpacing = 0.5f,
+        int yawCount = 8, float seconds = 0.25f)
+    {
+        var length = Mathf.CeilToInt(seconds * NativePlugin.GetSampleRate());
+        return !string.IsNullOrEmpty(path) &&
+               NativePlugin.BakeImpulseResponses(path, listenerSpacing, sourceSpacing, yawCount, length) != 0;
+    }
+
+    /// Progress of the bake between 0 and 1, 1 once its file is written, -1 when it failed or none was started
+    public static float BakeProgress => NativePlugin.GetBakeProgress();
+
+    /// Why the bake failed, empty while it runs, once its file is written or when none was started
+    public static string BakeError
+    {
+        get
+        {
+            var message = new StringBuilder(NativePlugin.GetBakeError(null, 0) + 1);
+            NativePlugin.GetBakeError(message, message.Capacity);
+            return message.ToString();
+        }
+    }
+
+    /// Stops the bake in progress without writing its file
+    public static void CancelBake() => NativePlugin.CancelBake();
+
+    /// Loads the impulse responses rendering the sources using them (see DWM_AudioSource.UseBakedResponses), takes
+    /// effect when the spatializer is next created (e.g. after AudioSettings.Reset)
+    public static bool LoadImpulseResponses(string path) => NativePlugin.LoadImpulseResponses(path) != 0;
+
+    /// Unloads the impulse responses, all the sources being simulated again when the spatializer is next created
+    public static void ClearImpulseResponses() => NativePlugin.ClearImpulseResponses();
+
     // Important: must be called as soon as possible in order not to interfere audio sources in scenes
     [RuntimeInitializeOnLoadMethod(RuntimeInitializeLoadType.BeforeSplashScreen)]
     private static void OnBeforeSplashScreen()
     {
-        // Set up the audio configuration
+        // The occupancy grid and impulse responses must be loaded before the reset creates the spatializer
+        if (File.Exists(OccupancyPath) && !LoadOccupancy(OccupancyPath))
+            Debug.LogWarning($"Invalid DWM occupancy grid {OccupancyPath}, the whole mesh is simulated");
+        if (File.Exists(ImpulseResponsesPath) && !LoadImpulseResponses(ImpulseResponsesPath))
+            Debug.LogWarning($"Invalid DWM impulse responses {ImpulseResponsesPath}, all the sources are simulated");
+
+        // Set up the audio configuration, the output sample rate and buffer size are left to the platform since the
+        // mesh is resampled to the former and sources are buffered independently of the latter
         var c = AudioSettings.GetConfiguration();
-        c.speakerMode = AudioSpeakerMode.Stereo;
-        c.dspBufferSize = NativePlugin.GetBufferSize();
-        c.sampleRate = NativePlugin.GetSampleRate();
+        c.speakerMode = AmbisonicOrder > 0 ? AudioSpeakerMode.Quad : AudioSpeakerMode.Stereo;
         AudioSettings.Reset(c);
 
         // Check that the mandatory parts have been applied as expected
         var c1 = AudioSettings.GetConfiguration();
         Assert.AreEqual(c.speakerMode, c1.speakerMode);
-        Assert.AreEqual(c.dspBufferSize, c1.dspBufferSize);
-        Assert.AreEqual(c.sampleRate, c1.sampleRate);
     }
 }
\ No newline at end of file
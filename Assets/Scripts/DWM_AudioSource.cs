@@ -1,4 +1,5 @@
 using System.Runtime.InteropServices;
+using System.Threading;
 using UnityEngine;
 
 // ReSharper disable once InconsistentNaming
@@ -6,32 +7,92 @@ public class DWM_AudioSource : MonoBehaviour
 {
     private static class NativePlugin
     {
+        [DllImport("Unity_DWM_Spatializer")]
+        public static extern long AcquireSource();
+
+        [DllImport("Unity_DWM_Spatializer")]
+        public static extern void ReleaseSource(long handle);
+
         [DllImport("Unity_DWM_Spatializer")]
         // ReSharper disable InconsistentNaming
-        public static extern int WriteSource(int index, float p_x, float p_y, float p_z,
-            [In, Out] float[] buffer, int num_channels);
+        public static extern void WriteSource(long handle, [In] float[] buffer, int num_channels, int num_samples);
+
+        [DllImport("Unity_DWM_Spatializer")]
+        public static extern void WriteSourcePosition(long handle, float p_x, float p_y, float p_z);
         // ReSharper restore InconsistentNaming
+
+        [DllImport("Unity_DWM_Spatializer")]
+        public static extern uint GetSourceUnderruns(long handle);
+
+        [DllImport("Unity_DWM_Spatializer")]
+        public static extern uint GetSourceOverruns(long handle);
+
+        [DllImport("Unity_DWM_Spatializer")]
+        public static extern void SetSourceBaked(long handle, int baked);
     }
 
-    private Vector3 _cachedPosition;
+    // Convolve the source with the impulse responses loaded by DWM_AudioManager instead of simulating it, for static
+    // sources far from the listener
+    [SerializeField] private bool useBakedResponses;
+
+    // Handle of the slot handed out by the native plugin while enabled, -1 when disabled or when all the slots are in
+    // use. The audio thread may still write with the handle after it was released, the plugin then drops the samples
+    private long _handle = -1;
+
+    private long Handle => Volatile.Read(ref _handle);
 
-    private void Start()
+    private void OnEnable()
     {
-        _cachedPosition = transform.position;
+        Volatile.Write(ref _handle, NativePlugin.AcquireSource());
+        if (Handle < 0) Debug.LogWarning("No DWM source slot available, the source will not be spatialized", this);
+        NativePlugin.SetSourceBaked(Handle, useBakedResponses ? 1 : 0);
+        WritePosition();
+    }
+
+    private void OnValidate()
+    {
+        if (Handle >= 0) NativePlugin.SetSourceBaked(Handle, useBakedResponses ? 1 : 0);
+    }
+
+    private void OnDisable()
+    {
+        var handle = Handle;
+        Volatile.Write(ref _handle, -1);
+        NativePlugin.ReleaseSource(handle);
     }
 
     private void LateUpdate()
     {
-        _cachedPosition = transform.position;
+        WritePosition();
     }
 
-    [SerializeField] private int index;
+    /// Number of audio blocks the spatializer could not entirely fill with this source's samples
+    public uint Underruns => NativePlugin.GetSourceUnderruns(Handle);
+
+    /// Number of writes to the spatializer dropped because it was not consuming this source's samples fast enough
+    public uint Overruns => NativePlugin.GetSourceOverruns(Handle);
+
+    /// Whether the source is rendered with the loaded impulse responses, when they were baked with the spatializer's
+    /// current boundary parameters, rather than simulated in the mesh
+    public bool UseBakedResponses
+    {
+        get => useBakedResponses;
+        set
+        {
+            useBakedResponses = value;
+            NativePlugin.SetSourceBaked(Handle, value ? 1 : 0);
+        }
+    }
+
+    // The position is timestamped by the native plugin against the samples written so far
+    private void WritePosition()
+    {
+        var position = transform.position;
+        NativePlugin.WriteSourcePosition(Handle, position.x, position.y, position.z);
+    }
 
-    public void SetIndex(int i) => this.index = i;
-    
     private void OnAudioFilterRead(float[] data, int channels)
     {
-        // TODO: _cachedPosition is not atomic, can it be modified by LateUpdate at the same time as OnAudioFilterRead runs?
-        NativePlugin.WriteSource(index, _cachedPosition.x, _cachedPosition.y, _cachedPosition.z, data, channels);
+        NativePlugin.WriteSource(Handle, data, channels, data.Length / channels);
     }
-}
\ No newline at end of file
+}
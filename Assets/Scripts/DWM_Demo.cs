@@ -7,9 +7,6 @@ public class DWM_Demo : MonoBehaviour
 {
     private static class NativePlugin
     {
-        [DllImport("Unity_DWM_Spatializer")]
-        public static extern int GetMaxSourceCount();
-
         [DllImport("Unity_DWM_Spatializer")]
         public static extern float GetMeshWidth();
 
@@ -23,6 +20,7 @@ public class DWM_Demo : MonoBehaviour
     [SerializeField] private GameObject[] tests;
     [SerializeField] private GameObject test3SourcePrefab;
     [SerializeField] private GameObject test4SourcePrefab;
+    [SerializeField] private int testSourceCount = 16;
 
     private int _selectedTest;
 
@@ -40,33 +38,35 @@ public class DWM_Demo : MonoBehaviour
         tests[_selectedTest].SetActive(true);
     }
 
-    private void Start()
+    // Scales the demo to the mesh, whose size follows the quality tier playing
+    private void FitMesh()
     {
         var meshSize = new Vector3(NativePlugin.GetMeshWidth(), NativePlugin.GetMeshHeight(),
             NativePlugin.GetMeshDepth());
         transform.localScale = meshSize;
+    }
+
+    private void Start()
+    {
+        FitMesh();
 
         foreach (var test in tests) test.SetActive(false);
         tests[0].SetActive(true);
 
-        for (var i = 0; i < NativePlugin.GetMaxSourceCount(); i++)
+        for (var i = 0; i < testSourceCount; i++)
         {
             var newSource = Instantiate(test3SourcePrefab, tests[3].transform, true);
             newSource.transform.localPosition = new Vector3(Random.value, Random.value, Random.value);
-            newSource.GetComponent<DWM_AudioSource>().SetIndex(i);
             var s = newSource.GetComponent<AudioSource>();
             s.pitch = Mathf.Pow(2, (Random.Range(1, 36)) / 12.0f);
         }
 
-        for (var i = 0; i < NativePlugin.GetMaxSourceCount(); i++)
-        {
-            var newSource = Instantiate(test4SourcePrefab, tests[4].transform, true);
-            newSource.GetComponent<DWM_AudioSource>().SetIndex(i);
-        }
+        for (var i = 0; i < testSourceCount; i++) Instantiate(test4SourcePrefab, tests[4].transform, true);
     }
 
     private void Update()
     {
+        FitMesh();
         if (Keyboard.current.backspaceKey.wasPressedThisFrame) PreviousTest();
         else if (Keyboard.current.enterKey.wasPressedThisFrame) NextTest();
     }
@@ -0,0 +1,69 @@
+using System.IO;
+using UnityEngine;
+
+// ReSharper disable once InconsistentNaming
+/// Voxelizes the colliders inside a box into the occupancy grid loaded by DWM_AudioManager at startup, so that walls,
+/// furniture and the space outside the level are left out of the mesh and reflect sound like its boundaries
+public class DWM_OccupancyBaker : MonoBehaviour
+{
+    // Box voxelized, from the object's position
+    [SerializeField] private Vector3 size = Vector3.one;
+
+    // Edge of the voxels, at most the mesh's junction spacing to resolve thin walls
+    [SerializeField] private float voxelSize = 0.05f;
+
+    // Layers of the colliders considered solid
+    [SerializeField] private LayerMask solidLayers = ~0;
+
+    [ContextMenu("Bake")]
+    private void Bake()
+    {
+        var origin = transform.position;
+        var count = Vector3Int.CeilToInt(size / voxelSize);
+        var halfExtents = Vector3.one * (voxelSize * 0.5f);
+
+        // Runs of alternating air and solid voxels in x->y->z order, see dwm::occupancy_grid
+        Directory.CreateDirectory(Path.GetDirectoryName(DWM_AudioManager.OccupancyPath));
+        using var writer = new BinaryWriter(File.Open(DWM_AudioManager.OccupancyPath, FileMode.Create));
+        writer.Write(new[] { (byte)'D', (byte)'W', (byte)'M', (byte)'O' });
+        writer.Write(1u);
+        writer.Write(count.x);
+        writer.Write(count.y);
+        writer.Write(count.z);
+        writer.Write(voxelSize);
+        writer.Write(origin.x);
+        writer.Write(origin.y);
+        writer.Write(origin.z);
+
+        var solid = false;
+        var run = 0u;
+        var solidCount = 0;
+        for (var z = 0; z < count.z; z++)
+        for (var y = 0; y < count.y; y++)
+        for (var x = 0; x < count.x; x++)
+        {
+            var center = origin + (new Vector3(x, y, z) + Vector3.one * 0.5f) * voxelSize;
+            var voxelSolid = Physics.CheckBox(center, halfExtents, Quaternion.identity, solidLayers,
+                QueryTriggerInteraction.Ignore);
+            if (voxelSolid != solid)
+            {
+                writer.Write(run);
+                run = 0;
+                solid = voxelSolid;
+            }
+
+            run++;
+            if (voxelSolid) solidCount++;
+        }
+
+        writer.Write(run);
+        Debug.Log($"Baked {solidCount} solid voxels out of {count.x * count.y * count.z} into " +
+                  DWM_AudioManager.OccupancyPath, this);
+    }
+
+    private void OnDrawGizmosSelected()
+    {
+        Gizmos.color = Color.cyan;
+        Gizmos.DrawWireCube(transform.position + size * 0.5f, size);
+    }
+}
@@ -0,0 +1,1128 @@
+// Headless benchmark of the DWM mesh simulation, runs the same block rendering used by the plugin's ProcessCallback
+// without requiring Unity
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <numbers>
+#include <numeric>
+#include <random>
+#include <type_traits>
+#include <vector>
+#include "dwm_convolution.h"
+#include "dwm_ir_cache.h"
+#include "dwm_kernels.h"
+#include "dwm_nested.h"
+#include "plugin_config.h"
+#include "simulation.h"
+
+namespace {
+
+    /// Benchmark options, parsed from the command line
+    struct options {
+        double seconds_per_run = 0.5; // Wall clock time budget of each configuration
+        int min_blocks = 8; // Minimum number of blocks rendered for each configuration
+        bool csv = false; // Print comma separated values instead of a table
+        double min_headroom = 0.0; // Exit with failure if the plugin's configuration has less headroom than this
+        int threads = 1; // Workers each mesh update is split across, outside the scaling sweep
+        int max_threads = 0; // Workers spawned for the scaling sweep, 0 for one per hardware thread
+        int blocking_depth = 0; // Temporal blocking depth outside the blocking sweep, 0 to let the mesh choose
+        int output_rate = 0; // Output sample rate outside the resampling sweep, 0 to run at the mesh's rate
+        float solid_fraction = 0.0f; // Fraction of the mesh marked solid, leaving an L-shaped room
+        float sleep_threshold = 0.0f; // Peak below which the mesh's tiles fall asleep, 0 to update the whole mesh
+        int burst_period = 0; // Sources play one block every burst_period blocks and are silent otherwise, 0 always
+        dwm::page_mode pages = dwm::page_mode::DWM_PAGE_MODE; // Pages requested for the junctions outside the sweep
+    };
+
+    /// Measured results of a single configuration
+    struct result {
+        const char *kernel;
+        const char *storage;
+        const char *pages; // Pages actually backing the junctions
+        int threads, blocking_depth;
+        float width, height, depth;
+        int sample_rate, output_rate, buffer_size, source_count, junctions;
+        float sleep_threshold;
+        double awake_fraction; // Mean fraction of the mesh's tiles updated at the end of each block
+        long long blocks;
+        double junction_updates_per_second;
+        double ns_per_sample;
+        double mean_block_us, worst_block_us, budget_block_us;
+        double headroom; // Simulated time over wall clock time, must be > 1 to run in real time
+        double worst_headroom; // Block budget over worst case block time
+    };
+
+    void print_header(const options &opt) {
+        if (opt.csv) {
+            std::printf("kernel,storage,pages,threads,blocking_depth,width,height,depth,sample_rate,output_rate,"
+                        "buffer_size,source_count,junctions,sleep_threshold,awake_fraction,blocks,"
+                        "junction_updates_per_second,ns_per_sample,mean_block_us,worst_block_us,budget_block_us,"
+                        "headroom,worst_headroom\n");
+        } else {
+            std::printf("%-7s %-5s %-5s %3s %3s %-17s %6s %6s %6s %4s %9s %7s %5s %11s %10s %11s %11s %11s %8s "
+                        "%8s\n",
+                        "kernel", "store", "pages", "thr", "tb", "mesh (m)", "rate", "out", "buffer", "src",
+                        "junctions", "sleep", "awake", "Mupdates/s", "ns/sample", "mean (us)", "worst (us)",
+                        "budget (us)", "headroom", "worst");
+        }
+    }
+
+    void print_result(const options &opt, const result &r) {
+        if (opt.csv) {
+            std::printf("%s,%s,%s,%d,%d,%g,%g,%g,%d,%d,%d,%d,%d,%g,%.3f,%lld,%.0f,%.1f,%.2f,%.2f,%.2f,%.3f,%.3f\n",
+                        r.kernel, r.storage, r.pages, r.threads, r.blocking_depth, r.width, r.height, r.depth,
+                        r.sample_rate, r.output_rate, r.buffer_size, r.source_count, r.junctions, r.sleep_threshold,
+                        r.awake_fraction, r.blocks, r.junction_updates_per_second, r.ns_per_sample, r.mean_block_us,
+                        r.worst_block_us, r.budget_block_us, r.headroom, r.worst_headroom);
+        } else {
+            char mesh[48];
+            std::snprintf(mesh, sizeof(mesh), "%gx%gx%g", r.width, r.height, r.depth);
+            std::printf("%-7s %-5s %-5s %3d %3d %-17s %6d %6d %6d %4d %9d %7.0e %5.2f %11.1f %10.1f %11.2f %11.2f "
+                        "%11.2f %7.2fx %7.2fx\n",
+                        r.kernel, r.storage, r.pages, r.threads, r.blocking_depth, mesh, r.sample_rate, r.output_rate,
+                        r.buffer_size, r.source_count, r.junctions, r.sleep_threshold, r.awake_fraction,
+                        r.junction_updates_per_second * 1e-6, r.ns_per_sample, r.mean_block_us, r.worst_block_us,
+                        r.budget_block_us, r.headroom, r.worst_headroom);
+        }
+        std::fflush(stdout);
+    }
+
+    /// @return name of a mesh storage format
+    template<typename storage>
+    const char *storage_name() {
+        return std::is_same_v<storage, dwm::float16> ? "fp16" : "fp32";
+    }
+
+    /// @return short name of the pages backing an arena
+    const char *pages_name(const dwm::page_mode pages) {
+        switch (pages) {
+            case dwm::page_mode::transparent_huge:
+                return "thp";
+            case dwm::page_mode::huge:
+                return "huge";
+            default:
+                return "std";
+        }
+    }
+
+    /// Renders blocks with the plugin's block rendering until the time budget is exhausted, blocks are at the output
+    /// rate and resampled to and from the mesh's rate when they differ
+    /// @param mesh_t mesh rendered, a single mesh by default, sampled at sample_rate and spanning the given dimensions
+    template<const float width, const float height, const float depth, const int sample_rate,
+             typename storage = float, dwm::topologies::mesh_topology topology = dwm::topologies::rectilinear,
+             typename mesh_t =
+                     dwm::simulation::mesh_admittance_lowpass<width, height, depth, sample_rate, storage, topology>>
+    result run(const options &opt, dwm::worker_pool &workers, const int buffer_size, const int source_count) {
+        const auto mesh = std::make_unique<mesh_t>(workers.max_workers(), opt.pages);
+        constexpr bool blocking = requires { mesh->set_temporal_blocking_depth(0); }; // Nested meshes step in lockstep
+        if constexpr (blocking)
+            mesh->set_temporal_blocking_depth(opt.blocking_depth);
+        if (opt.solid_fraction > 0.0f) {
+            // A single voxel covering the x+ y+ corner of the mesh over its whole depth, leaving an L-shaped room
+            const float side = std::sqrt(std::min(opt.solid_fraction, 1.0f));
+            dwm::occupancy_grid grid(1, 1, 1, std::max({width, height, depth}),
+                                     {width * (1.0f - side), height * (1.0f - side), 0.0f});
+            grid.set_solid(0, 0, 0, true);
+            mesh->set_occupancy(grid);
+        }
+        mesh->set_sleep_threshold(opt.sleep_threshold);
+        const int output_rate = opt.output_rate > 0 ? opt.output_rate : sample_rate;
+        dwm::simulation::rate_converter converter(sample_rate, output_rate, buffer_size);
+
+        // Sources are scattered in the mesh and fed with white noise, refilled outside the timed region
+        std::mt19937 rng(1234);
+        std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        std::vector<float> source_buffers(static_cast<size_t>(buffer_size) * source_count);
+        std::vector<dwm::block_source> sources(source_count);
+        std::vector<dwm::simulation::source_resampler> resamplers;
+        resamplers.reserve(source_count);
+        for (int s = 0; s < source_count; s++) {
+            sources[s].x = unit(rng) * width;
+            sources[s].y = unit(rng) * height;
+            sources[s].z = unit(rng) * depth;
+            resamplers.push_back(converter.make_source_resampler());
+        }
+        mesh->reserve_block(source_count, 2);
+
+        // Listener at the mesh's center, facing z+
+        constexpr float identity[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+        float listener_matrix[16];
+        std::memcpy(listener_matrix, identity, sizeof(identity));
+        listener_matrix[12] = -width * 0.5f;
+        listener_matrix[13] = -height * 0.5f;
+        listener_matrix[14] = -depth * 0.5f;
+        const auto ears = dwm::simulation::ears::from_listener_matrix(listener_matrix, DWM_EARS_DISTANCE);
+
+        // Typical boundary settings, the filters' cost does not depend on their parameters
+        const auto params = dwm::simulation::boundary_parameters(0.5f, 0.5f);
+
+        constexpr int out_channels = 2;
+        std::vector<float> out_buffer(static_cast<size_t>(buffer_size) * out_channels);
+
+        typedef std::chrono::steady_clock clock;
+        double total_s = 0.0, worst_s = 0.0, awake = 0.0;
+        long long blocks = 0;
+        while (blocks < opt.min_blocks || total_s < opt.seconds_per_run) {
+            // Between bursts the sources are skipped, as the plugin does once they are silent
+            const bool playing = opt.burst_period == 0 || blocks % opt.burst_period == 0;
+            for (float &v: source_buffers)
+                v = noise(rng);
+
+            const auto start = clock::now();
+            const int steps = converter.mesh_steps(buffer_size);
+            for (int s = 0; s < source_count; s++) {
+                const float *samples = source_buffers.data() + static_cast<size_t>(s) * buffer_size;
+                sources[s].samples = resamplers[s].resample(samples, buffer_size, steps);
+            }
+            converter.render_block(*mesh, params, params, params, params, params, params, sources.data(),
+                                   playing ? source_count : 0, ears, out_buffer.data(), buffer_size, out_channels,
+                                   &workers);
+            const double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+
+            total_s += elapsed;
+            worst_s = std::max(worst_s, elapsed);
+            awake += mesh->awake_fraction();
+            blocks++;
+        }
+
+        const double samples = static_cast<double>(blocks) * buffer_size;
+        const double budget_s = static_cast<double>(buffer_size) / output_rate;
+        result r{};
+        r.kernel = dwm::kernels::active().name;
+        r.storage = storage_name<storage>();
+        r.pages = pages_name(mesh->pages());
+        r.threads = workers.worker_count();
+        if constexpr (blocking)
+            r.blocking_depth = mesh->temporal_blocking_depth();
+        r.width = width;
+        r.height = height;
+        r.depth = depth;
+        r.sample_rate = sample_rate;
+        r.output_rate = output_rate;
+        r.buffer_size = buffer_size;
+        r.source_count = source_count;
+        r.junctions = mesh->air_junction_count();
+        r.sleep_threshold = opt.sleep_threshold;
+        r.awake_fraction = awake / static_cast<double>(blocks);
+        r.blocks = blocks;
+        r.junction_updates_per_second = samples * sample_rate / output_rate * r.junctions / total_s;
+        if constexpr (!blocking) // The meshes of a nested mesh run at different rates, their updates are counted
+            r.junction_updates_per_second = static_cast<double>(mesh->junction_updates()) / total_s;
+        r.ns_per_sample = total_s * 1e9 / samples;
+        r.mean_block_us = total_s * 1e6 / static_cast<double>(blocks);
+        r.worst_block_us = worst_s * 1e6;
+        r.budget_block_us = budget_s * 1e6;
+        r.headroom = samples / output_rate / total_s;
+        r.worst_headroom = budget_s / worst_s;
+        return r;
+    }
+
+    /// Sources playing at once in a typical scene, used outside the source count sweep
+    constexpr int typical_source_count = 16;
+
+#if DWM_INTERPOLATED_MESH
+    typedef dwm::topologies::interpolated plugin_topology;
+#else
+    typedef dwm::topologies::rectilinear plugin_topology;
+#endif
+
+    /// Sweeps cubic meshes of the given sides at a fixed sample rate
+    template<const int sample_rate, const float... sides>
+    void sweep_mesh_sizes(const options &opt, dwm::worker_pool &workers) {
+        (print_result(opt,
+                      run<sides, sides, sides, sample_rate>(opt, workers, DWM_BUFFER_SIZE, typical_source_count)),
+         ...);
+    }
+
+    /// Accuracy of the half precision storage against the single precision one, on the same input
+    struct storage_error {
+        float width, height, depth;
+        int sample_rate;
+        long long samples;
+        double max_error; // Largest absolute output difference, relative to the largest single precision output
+        double snr_db; // Single precision output power over output difference power
+    };
+
+    /// Renders the same noise bursts through a single and a half precision mesh and compares their outputs, the bursts
+    /// are followed by silence so that the reverberation tails, where the rounding errors accumulate, are compared too
+    template<const float width, const float height, const float depth, const int sample_rate>
+    storage_error measure_storage_error(const double seconds) {
+        typedef dwm::simulation::mesh_admittance_lowpass<width, height, depth, sample_rate, float> reference_t;
+        typedef dwm::simulation::mesh_admittance_lowpass<width, height, depth, sample_rate, dwm::float16> mesh_t;
+        const auto reference = std::make_unique<reference_t>();
+        const auto mesh = std::make_unique<mesh_t>();
+
+        std::mt19937 rng(1234);
+        std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        std::vector<float> source_buffers(static_cast<size_t>(DWM_BUFFER_SIZE) * typical_source_count);
+        std::vector<dwm::block_source> sources(typical_source_count);
+        for (int s = 0; s < typical_source_count; s++) {
+            sources[s].x = unit(rng) * width;
+            sources[s].y = unit(rng) * height;
+            sources[s].z = unit(rng) * depth;
+            sources[s].samples = source_buffers.data() + static_cast<size_t>(s) * DWM_BUFFER_SIZE;
+        }
+        reference->reserve_block(typical_source_count, 2);
+        mesh->reserve_block(typical_source_count, 2);
+
+        float listener_matrix[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+        listener_matrix[12] = -width * 0.5f;
+        listener_matrix[13] = -height * 0.5f;
+        listener_matrix[14] = -depth * 0.5f;
+        const auto ears = dwm::simulation::ears::from_listener_matrix(listener_matrix, DWM_EARS_DISTANCE);
+        const auto params = dwm::simulation::boundary_parameters(0.5f, 0.5f);
+
+        constexpr int out_channels = 2;
+        std::vector<float> reference_out(static_cast<size_t>(DWM_BUFFER_SIZE) * out_channels);
+        std::vector<float> out(reference_out.size());
+        const long long blocks = std::max(1LL, static_cast<long long>(seconds * sample_rate / DWM_BUFFER_SIZE));
+        double max_reference = 0.0, max_error = 0.0, reference_power = 0.0, error_power = 0.0;
+        for (long long block = 0; block < blocks; block++) {
+            // Bursts of 4 blocks every 32 blocks
+            for (float &v: source_buffers)
+                v = block % 32 < 4 ? noise(rng) : 0.0f;
+            dwm::simulation::render_block(*reference, params, params, params, params, params, params, sources.data(),
+                                          typical_source_count, ears, reference_out.data(), DWM_BUFFER_SIZE,
+                                          out_channels);
+            dwm::simulation::render_block(*mesh, params, params, params, params, params, params, sources.data(),
+                                          typical_source_count, ears, out.data(), DWM_BUFFER_SIZE, out_channels);
+            for (size_t n = 0; n < out.size(); n++) {
+                const double error = static_cast<double>(out[n]) - reference_out[n];
+                max_reference = std::max(max_reference, std::abs(static_cast<double>(reference_out[n])));
+                max_error = std::max(max_error, std::abs(error));
+                reference_power += static_cast<double>(reference_out[n]) * reference_out[n];
+                error_power += error * error;
+            }
+        }
+
+        storage_error e{};
+        e.width = width;
+        e.height = height;
+        e.depth = depth;
+        e.sample_rate = sample_rate;
+        e.samples = blocks * DWM_BUFFER_SIZE;
+        e.max_error = max_reference > 0.0 ? max_error / max_reference : 0.0;
+        e.snr_db = error_power > 0.0 ? 10.0 * std::log10(reference_power / error_power) : INFINITY;
+        return e;
+    }
+
+    void print_storage_error_header(const options &opt) {
+        if (opt.csv)
+            std::printf("\nwidth,height,depth,sample_rate,samples,max_error,snr_db\n");
+        else
+            std::printf("\n%-17s %6s %9s %12s %9s\n", "fp16 error", "rate", "samples", "max error", "SNR (dB)");
+    }
+
+    void print_storage_error(const options &opt, const storage_error &e) {
+        if (opt.csv) {
+            std::printf("%g,%g,%g,%d,%lld,%.3g,%.1f\n", e.width, e.height, e.depth, e.sample_rate, e.samples,
+                        e.max_error, e.snr_db);
+        } else {
+            char mesh[48];
+            std::snprintf(mesh, sizeof(mesh), "%gx%gx%g", e.width, e.height, e.depth);
+            std::printf("%-17s %6d %9lld %12.3g %9.1f\n", mesh, e.sample_rate, e.samples, e.max_error, e.snr_db);
+        }
+        std::fflush(stdout);
+    }
+
+    /// Largest output difference, relative to the reference's peak, tolerated between rendering paths which only differ
+    /// by the order and the merging of their floating point operations
+    constexpr double equivalence_tolerance = 1e-4;
+
+    /// Difference between an optimized rendering path and the one it must match
+    struct equivalence_error {
+        const char *topology;
+        const char *path; // Optimized path
+        const char *reference; // Path it is compared to
+        float width, height, depth;
+        int sample_rate;
+        long long samples;
+        double max_error; // Largest absolute output difference, relative to the largest reference output
+    };
+
+    /// How the equivalence check renders a mesh
+    struct equivalence_path {
+        const char *name;
+        bool per_sample; // Sample by sample with write_value, update and read_value instead of render_block
+        int blocking_depth; // Temporal blocking depth of render_block
+        dwm::worker_pool *workers; // Pool each update is split across, nullptr for none
+        dwm::kernels::isa instruction_set; // Kernels the mesh is updated with
+    };
+
+    /// Renders noise bursts from static sources at the ears of a static listener along the given path, the mesh's sleep
+    /// threshold being 0 so that every junction is updated
+    /// @return the ears' interleaved samples
+    template<const float width, const float height, const float depth, const int sample_rate,
+             dwm::topologies::mesh_topology topology>
+    std::vector<float> render_equivalence(const equivalence_path &path, const long long blocks) {
+        typedef dwm::simulation::mesh_admittance_lowpass<width, height, depth, sample_rate, float, topology> mesh_t;
+        const auto mesh = std::make_unique<mesh_t>(path.workers != nullptr ? path.workers->max_workers() : 1);
+        mesh->set_temporal_blocking_depth(path.blocking_depth);
+        mesh->set_sleep_threshold(0.0f);
+        const dwm::kernels::isa default_isa = dwm::kernels::active().instruction_set;
+        dwm::kernels::set_active(path.instruction_set);
+
+        std::mt19937 rng(1234);
+        std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        std::vector<float> source_buffers(static_cast<size_t>(DWM_BUFFER_SIZE) * typical_source_count);
+        std::vector<dwm::block_source> sources(typical_source_count);
+        for (int s = 0; s < typical_source_count; s++) {
+            sources[s].x = unit(rng) * width;
+            sources[s].y = unit(rng) * height;
+            sources[s].z = unit(rng) * depth;
+            sources[s].samples = source_buffers.data() + static_cast<size_t>(s) * DWM_BUFFER_SIZE;
+        }
+        mesh->reserve_block(typical_source_count, 2);
+
+        float listener_matrix[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+        listener_matrix[12] = -width * 0.5f;
+        listener_matrix[13] = -height * 0.5f;
+        listener_matrix[14] = -depth * 0.5f;
+        const auto ears = dwm::simulation::ears::from_listener_matrix(listener_matrix, DWM_EARS_DISTANCE);
+        const auto params = dwm::simulation::boundary_parameters(0.5f, 0.5f);
+
+        constexpr int out_channels = 2;
+        std::vector<float> out(static_cast<size_t>(blocks) * DWM_BUFFER_SIZE * out_channels);
+        for (long long block = 0; block < blocks; block++) {
+            // Bursts of 4 blocks every 32 blocks, so that the reverberation tails are compared too
+            for (float &v: source_buffers)
+                v = block % 32 < 4 ? noise(rng) : 0.0f;
+            float *block_out = out.data() + static_cast<size_t>(block) * DWM_BUFFER_SIZE * out_channels;
+            if (!path.per_sample) {
+                dwm::simulation::render_block(*mesh, params, params, params, params, params, params, sources.data(),
+                                              typical_source_count, ears, block_out, DWM_BUFFER_SIZE, out_channels,
+                                              path.workers);
+                continue;
+            }
+            for (int n = 0; n < DWM_BUFFER_SIZE; n++) {
+                for (const dwm::block_source &source: sources)
+                    mesh->write_value(source.x, source.y, source.z, source.samples[n]);
+                mesh->update(params, params, params, params, params, params, path.workers);
+                block_out[n * out_channels] = mesh->read_value(ears.l_x, ears.l_y, ears.l_z);
+                block_out[n * out_channels + 1] = mesh->read_value(ears.r_x, ears.r_y, ears.r_z);
+            }
+        }
+        dwm::kernels::set_active(default_isa);
+        return out;
+    }
+
+    /// Renders the same input along an optimized path and along the one it must match, and compares their outputs
+    template<const float width, const float height, const float depth, const int sample_rate,
+             dwm::topologies::mesh_topology topology>
+    equivalence_error measure_equivalence(const equivalence_path &path, const equivalence_path &reference) {
+        constexpr long long blocks = 64;
+        const std::vector<float> out = render_equivalence<width, height, depth, sample_rate, topology>(path, blocks);
+        const std::vector<float> reference_out =
+                render_equivalence<width, height, depth, sample_rate, topology>(reference, blocks);
+        double max_reference = 0.0, max_error = 0.0;
+        for (size_t n = 0; n < out.size(); n++) {
+            max_reference = std::max(max_reference, std::abs(static_cast<double>(reference_out[n])));
+            max_error = std::max(max_error, std::abs(static_cast<double>(out[n]) - reference_out[n]));
+        }
+
+        equivalence_error e{};
+        e.topology = topology::name;
+        e.path = path.name;
+        e.reference = reference.name;
+        e.width = width;
+        e.height = height;
+        e.depth = depth;
+        e.sample_rate = sample_rate;
+        e.samples = blocks * DWM_BUFFER_SIZE;
+        // NaNs and silent outputs never match
+        e.max_error = max_reference > 0.0 && std::isfinite(max_error) ? max_error / max_reference : INFINITY;
+        return e;
+    }
+
+    void print_equivalence_header(const options &opt) {
+        if (opt.csv)
+            std::printf("\ntopology,path,reference,width,height,depth,sample_rate,samples,max_error,passed\n");
+        else
+            std::printf("\n%-13s %-13s %-11s %-17s %6s %9s %12s %6s\n", "equivalence", "path", "reference",
+                        "mesh (m)", "rate", "samples", "max error", "check");
+    }
+
+    /// Prints an equivalence error and checks it against the tolerance
+    /// @return whether the optimized path matches its reference
+    bool print_equivalence(const options &opt, const equivalence_error &e) {
+        const bool passed = e.max_error <= equivalence_tolerance;
+        if (opt.csv) {
+            std::printf("%s,%s,%s,%g,%g,%g,%d,%lld,%.3g,%d\n", e.topology, e.path, e.reference, e.width, e.height,
+                        e.depth, e.sample_rate, e.samples, e.max_error, passed ? 1 : 0);
+        } else {
+            char mesh[48];
+            std::snprintf(mesh, sizeof(mesh), "%gx%gx%g", e.width, e.height, e.depth);
+            std::printf("%-13s %-13s %-11s %-17s %6d %9lld %12.3g %6s\n", e.topology, e.path, e.reference, mesh,
+                        e.sample_rate, e.samples, e.max_error, passed ? "ok" : "FAILED");
+        }
+        std::fflush(stdout);
+        return passed;
+    }
+
+    /// Checks the block rendering of a mesh against the sample by sample one, with temporal blocking and with workers,
+    /// then the kernels supported by the running CPU against the scalar ones
+    /// @return whether every path matches its reference
+    template<const float width, const float height, const float depth, const int sample_rate,
+             dwm::topologies::mesh_topology topology>
+    bool check_equivalence(const options &opt) {
+        // Two workers even on a single core, each slab being updated the same whichever thread runs it
+        dwm::worker_pool workers(2);
+        workers.set_worker_count(2);
+        const dwm::kernels::isa default_isa = dwm::kernels::active().instruction_set;
+        const equivalence_path per_sample = {"per sample", true, 1, nullptr, default_isa};
+        const equivalence_path blocking = {"blocking (4)", false, 4, nullptr, default_isa};
+        const equivalence_path parallel = {"workers (2)", false, 1, &workers, default_isa};
+        bool passed = print_equivalence(opt, measure_equivalence<width, height, depth, sample_rate, topology>(
+                                                     blocking, per_sample));
+        passed = print_equivalence(opt, measure_equivalence<width, height, depth, sample_rate, topology>(
+                                                parallel, per_sample)) &&
+                 passed;
+
+        const equivalence_path scalar = {"scalar", false, 4, nullptr, dwm::kernels::isa::scalar};
+        for (int i = 0; i < static_cast<int>(dwm::kernels::isa::count); i++) {
+            const auto instruction_set = static_cast<dwm::kernels::isa>(i);
+            if (instruction_set == dwm::kernels::isa::scalar || !dwm::kernels::set_active(instruction_set))
+                continue;
+            const equivalence_path kernel = {dwm::kernels::active().name, false, 4, nullptr, instruction_set};
+            passed = print_equivalence(opt, measure_equivalence<width, height, depth, sample_rate, topology>(
+                                                    kernel, scalar)) &&
+                     passed;
+        }
+        dwm::kernels::set_active(default_isa);
+        return passed;
+    }
+
+    /// Cost of the usable bandwidth of a mesh topology
+    struct topology_cost {
+        const char *topology;
+        float width, height, depth;
+        int sample_rate, junctions;
+        double junction_updates_per_second;
+        double bandwidth; // Highest frequency (Hz) whose phase velocity error stays within 2% in every direction
+        double load; // Wall clock time over simulated time
+    };
+
+    /// @return the highest frequency, as a fraction of the sample rate, up to which the phase velocity error of a
+    /// topology stays within the tolerance in every direction
+    template<dwm::topologies::mesh_topology topology>
+    double useful_bandwidth(const double tolerance) {
+        constexpr double pi = 3.14159265358979323846;
+        constexpr int directions = 16; // Per right angle, the dispersion being symmetric across the axes
+        const double courant = 1.0 / topology::spacing;
+        double bandwidth = 0.5;
+        for (int a = 0; a <= directions; a++) {
+            for (int b = 0; b <= directions; b++) {
+                const double theta = pi / 2 * a / directions, phi = pi / 2 * b / directions;
+                const double d[3] = {std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi),
+                                     std::cos(theta)};
+                // Walks up the wavenumber until the error exceeds the tolerance or the wave no longer propagates
+                double omega = 0.0;
+                for (double k = 1e-3; k < pi * std::sqrt(3.0); k += 1e-3) {
+                    const double c = topology::dispersion(k * d[0], k * d[1], k * d[2]);
+                    if (c <= -1.0 || std::abs(std::acos(c) / (courant * k) - 1.0) > tolerance)
+                        break;
+                    omega = std::acos(c);
+                }
+                bandwidth = std::min(bandwidth, omega / (2 * pi));
+            }
+        }
+        return bandwidth;
+    }
+
+    /// Measures a mesh of the given topology with the plugin's block rendering and relates its cost to its usable
+    /// bandwidth
+    template<const float width, const float height, const float depth, const int sample_rate,
+             dwm::topologies::mesh_topology topology>
+    topology_cost measure_topology(const options &opt, dwm::worker_pool &workers) {
+        const result r = run<width, height, depth, sample_rate, float, topology>(opt, workers, DWM_BUFFER_SIZE,
+                                                                                 typical_source_count);
+        topology_cost c{};
+        c.topology = topology::name;
+        c.width = width;
+        c.height = height;
+        c.depth = depth;
+        c.sample_rate = sample_rate;
+        c.junctions = r.junctions;
+        c.junction_updates_per_second = r.junction_updates_per_second;
+        c.bandwidth = useful_bandwidth<topology>(0.02) * sample_rate;
+        c.load = 1.0 / r.headroom;
+        return c;
+    }
+
+    void print_topology_cost_header(const options &opt) {
+        if (opt.csv)
+            std::printf("\ntopology,width,height,depth,sample_rate,junctions,junction_updates_per_second,bandwidth,"
+                        "load,bandwidth_per_cpu_second,real_time_bandwidth\n");
+        else
+            std::printf("\n%-13s %-17s %6s %9s %11s %10s %8s %12s %12s\n", "topology", "mesh (m)", "rate", "junctions",
+                        "Mupdates/s", "band (Hz)", "load", "Hz/CPU-s", "rt band (Hz)");
+    }
+
+    void print_topology_cost(const options &opt, const topology_cost &c) {
+        // The cost grows with the fourth power of the bandwidth (sample rate times junctions), the bandwidth at full
+        // load is thus the one the topology would reach in real time on this machine
+        const double real_time_bandwidth = c.bandwidth * std::pow(1.0 / c.load, 0.25);
+        if (opt.csv) {
+            std::printf("%s,%g,%g,%g,%d,%d,%.0f,%.1f,%.4f,%.1f,%.1f\n", c.topology, c.width, c.height, c.depth,
+                        c.sample_rate, c.junctions, c.junction_updates_per_second, c.bandwidth, c.load,
+                        c.bandwidth / c.load, real_time_bandwidth);
+        } else {
+            char mesh[48];
+            std::snprintf(mesh, sizeof(mesh), "%gx%gx%g", c.width, c.height, c.depth);
+            std::printf("%-13s %-17s %6d %9d %11.1f %10.0f %8.3f %12.0f %12.0f\n", c.topology, mesh, c.sample_rate,
+                        c.junctions, c.junction_updates_per_second * 1e-6, c.bandwidth, c.load, c.bandwidth / c.load,
+                        real_time_bandwidth);
+        }
+        std::fflush(stdout);
+    }
+
+    /// Cost of a mesh refined around the listener, against a single mesh at the fine rate
+    struct nested_cost {
+        float width, height, depth, fine_size; // Fine size 0 for a single mesh
+        int sample_rate, coarse_rate, junctions;
+        double junction_updates_per_second;
+        double load; // Wall clock time over simulated time
+        double worst_headroom;
+    };
+
+    /// Measures the space covered at a ratio times lower rate than the given one, with a cube of fine_size meters at
+    /// the given rate around the listener (at the center of the space), a ratio of 1 measuring a single mesh instead
+    template<const float width, const float height, const float depth, const int sample_rate, const float fine_size,
+             const int ratio>
+    nested_cost measure_nested(const options &opt, dwm::worker_pool &workers) {
+        typedef dwm::nested_mesh<
+                dwm::simulation::mesh_admittance_lowpass<width, height, depth, sample_rate / ratio>,
+                dwm::simulation::mesh_admittance_lowpass<fine_size, fine_size, fine_size, sample_rate>>
+                nested_t;
+        result r{};
+        if constexpr (ratio == 1)
+            r = run<width, height, depth, sample_rate>(opt, workers, DWM_BUFFER_SIZE, typical_source_count);
+        else
+            r = run<width, height, depth, sample_rate, float, dwm::topologies::rectilinear, nested_t>(
+                    opt, workers, DWM_BUFFER_SIZE, typical_source_count);
+        nested_cost c{};
+        c.width = width;
+        c.height = height;
+        c.depth = depth;
+        c.fine_size = ratio == 1 ? 0.0f : fine_size;
+        c.sample_rate = sample_rate;
+        c.coarse_rate = sample_rate / ratio;
+        c.junctions = r.junctions;
+        c.junction_updates_per_second = r.junction_updates_per_second;
+        c.load = 1.0 / r.headroom;
+        c.worst_headroom = r.worst_headroom;
+        return c;
+    }
+
+    void print_nested_cost_header(const options &opt) {
+        if (opt.csv)
+            std::printf("\nwidth,height,depth,coarse_rate,fine_size,sample_rate,junctions,junction_updates_per_second,"
+                        "load,worst_headroom\n");
+        else
+            std::printf("\n%-13s %-17s %6s %8s %6s %9s %11s %8s %8s\n", "nested", "mesh (m)", "rate", "fine (m)",
+                        "rate", "junctions", "Mupdates/s", "load", "worst");
+    }
+
+    void print_nested_cost(const options &opt, const nested_cost &c) {
+        if (opt.csv) {
+            std::printf("%g,%g,%g,%d,%g,%d,%d,%.0f,%.4f,%.3f\n", c.width, c.height, c.depth, c.coarse_rate,
+                        c.fine_size, c.sample_rate, c.junctions, c.junction_updates_per_second, c.load,
+                        c.worst_headroom);
+        } else {
+            char mesh[48];
+            std::snprintf(mesh, sizeof(mesh), "%gx%gx%g", c.width, c.height, c.depth);
+            std::printf("%-13s %-17s %6d %8g %6d %9d %11.1f %8.3f %7.2fx\n", "", mesh, c.coarse_rate, c.fine_size,
+                        c.sample_rate, c.junctions, c.junction_updates_per_second * 1e-6, c.load, c.worst_headroom);
+        }
+        std::fflush(stdout);
+    }
+
+    /// Direct sound level of a mesh refined around the listener, against a single mesh at the fine rate, in the band
+    /// both simulate
+    struct nested_level {
+        float width, height, depth, fine_size;
+        int sample_rate, coarse_rate;
+        const char *source; // Mesh the source lies in, the fine or the coarse one
+        const char *listener; // Mesh the listener lies in
+        double level_db; // Peak output of the nested mesh over that of the single mesh
+    };
+
+    /// Renders a 4ms Hann pulse, whose energy lies below 500Hz, from a static source at the ears of a static listener
+    /// @param gain peak of the pulse
+    /// @return the ears' interleaved samples
+    template<typename mesh_t, const int sample_rate>
+    std::vector<float> render_pulse(const std::array<float, 3> &source_position,
+                                    const std::array<float, 3> &listener_position, const int steps,
+                                    const float gain = 1.0f) {
+        const auto mesh = std::make_unique<mesh_t>();
+        std::vector<float> samples(steps, 0.0f);
+        constexpr int length = sample_rate / 250;
+        for (int n = 0; n < std::min(length, steps); n++) {
+            const float phase = 2.0f * std::numbers::pi_v<float> * static_cast<float>(n) / length;
+            samples[n] = gain * (0.5f - 0.5f * std::cos(phase));
+        }
+        dwm::block_source source{};
+        source.x = source_position[0];
+        source.y = source_position[1];
+        source.z = source_position[2];
+        source.samples = samples.data();
+        mesh->reserve_block(1, 2);
+
+        float listener_matrix[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+        listener_matrix[12] = -listener_position[0];
+        listener_matrix[13] = -listener_position[1];
+        listener_matrix[14] = -listener_position[2];
+        const auto ears = dwm::simulation::ears::from_listener_matrix(listener_matrix, DWM_EARS_DISTANCE);
+        const auto params = dwm::simulation::boundary_parameters(0.5f, 0.5f);
+
+        constexpr int out_channels = 2;
+        std::vector<float> out(static_cast<size_t>(steps) * out_channels);
+        dwm::simulation::render_block(*mesh, params, params, params, params, params, params, &source, 1, ears,
+                                      out.data(), steps, out_channels);
+        return out;
+    }
+
+    /// Renders the same pulse through a nested mesh, with a cube of fine_size meters at the given rate at the center of
+    /// the space, and through a single mesh at that rate, and compares the peaks of their direct sound
+    /// @param duration seconds rendered, ending before the first reflection reaches the listener
+    template<const float width, const float height, const float depth, const int sample_rate, const float fine_size,
+             const int ratio>
+    nested_level measure_nested_level(const char *source, const std::array<float, 3> &source_position,
+                                      const char *listener, const std::array<float, 3> &listener_position,
+                                      const double duration) {
+        typedef dwm::simulation::mesh_admittance_lowpass<width, height, depth, sample_rate> reference_t;
+        typedef dwm::nested_mesh<
+                dwm::simulation::mesh_admittance_lowpass<width, height, depth, sample_rate / ratio>,
+                dwm::simulation::mesh_admittance_lowpass<fine_size, fine_size, fine_size, sample_rate>>
+                nested_t;
+        const int steps = static_cast<int>(duration * sample_rate);
+        const std::vector<float> reference_out =
+                render_pulse<reference_t, sample_rate>(source_position, listener_position, steps);
+        const std::vector<float> out = render_pulse<nested_t, sample_rate>(source_position, listener_position, steps);
+        double reference_peak = 0.0, peak = 0.0;
+        for (size_t n = 0; n < out.size(); n++) {
+            reference_peak = std::max(reference_peak, std::abs(static_cast<double>(reference_out[n])));
+            peak = std::max(peak, std::abs(static_cast<double>(out[n])));
+        }
+
+        nested_level l{};
+        l.width = width;
+        l.height = height;
+        l.depth = depth;
+        l.fine_size = fine_size;
+        l.sample_rate = sample_rate;
+        l.coarse_rate = sample_rate / ratio;
+        l.source = source;
+        l.listener = listener;
+        l.level_db = 20.0 * std::log10(peak / reference_peak);
+        return l;
+    }
+
+    void print_nested_level_header(const options &opt) {
+        if (opt.csv)
+            std::printf("\nwidth,height,depth,coarse_rate,fine_size,sample_rate,source,listener,level_db\n");
+        else
+            std::printf("\n%-13s %-17s %6s %8s %6s %8s %8s %10s\n", "nested level", "mesh (m)", "rate", "fine (m)",
+                        "rate", "source", "listener", "level (dB)");
+    }
+
+    void print_nested_level(const options &opt, const nested_level &l) {
+        if (opt.csv) {
+            std::printf("%g,%g,%g,%d,%g,%d,%s,%s,%.2f\n", l.width, l.height, l.depth, l.coarse_rate, l.fine_size,
+                        l.sample_rate, l.source, l.listener, l.level_db);
+        } else {
+            char mesh[48];
+            std::snprintf(mesh, sizeof(mesh), "%gx%gx%g", l.width, l.height, l.depth);
+            std::printf("%-13s %-17s %6d %8g %6d %8s %8s %+10.2f\n", "", mesh, l.coarse_rate, l.fine_size,
+                        l.sample_rate, l.source, l.listener, l.level_db);
+        }
+        std::fflush(stdout);
+    }
+
+    /// Largest difference, in dB, tolerated between the direct sound levels of two quality tiers
+    constexpr double tier_level_tolerance = 0.5;
+
+    /// Direct sound level of a quality tier against the plugin's default one, both rendering the same source
+    struct tier_level {
+        const char *topology;
+        int sample_rate, reference_rate;
+        double level_db; // Peak output of the tier over that of the default tier
+    };
+
+    /// Renders the same pulse through a mesh at a tier's rate and through one at DWM_SAMPLE_RATE, each scaling its
+    /// source by its junction density relative to the latter's as the plugin does, and compares the peaks of their
+    /// direct sound. The source and the listener lie on junctions of both meshes, a source blended between junctions
+    /// being weaker than one on a junction
+    template<const int sample_rate, dwm::topologies::mesh_topology topology>
+    tier_level measure_tier_level() {
+        typedef dwm::simulation::mesh_admittance_lowpass<4.0f, 4.0f, 4.0f, DWM_SAMPLE_RATE, float, topology>
+                reference_t;
+        typedef dwm::simulation::mesh_admittance_lowpass<4.0f, 4.0f, 4.0f, sample_rate, float, topology> mesh_t;
+        // Junction density of the mesh whose junctions both meshes share, the junction spacing following the rate
+        constexpr float shared_density = reference_t::junction_density() *
+                                         static_cast<float>(std::gcd(sample_rate, DWM_SAMPLE_RATE)) / DWM_SAMPLE_RATE;
+        const auto shared_junction = [](const float position) {
+            return std::round(position * shared_density) / shared_density;
+        };
+        // The first reflection reaches the listener, at the center, 9ms after the source is emitted
+        const float center = shared_junction(2.0f);
+        const std::array<float, 3> source = {shared_junction(2.8f), center, center};
+        const std::array<float, 3> listener = {center, center, center};
+        constexpr double duration = 0.008;
+        const std::vector<float> reference_out = render_pulse<reference_t, DWM_SAMPLE_RATE>(
+                source, listener, static_cast<int>(duration * DWM_SAMPLE_RATE));
+        const std::vector<float> out =
+                render_pulse<mesh_t, sample_rate>(source, listener, static_cast<int>(duration * sample_rate),
+                                                  mesh_t::junction_density() / reference_t::junction_density());
+        double reference_peak = 0.0, peak = 0.0;
+        for (const float v: reference_out)
+            reference_peak = std::max(reference_peak, std::abs(static_cast<double>(v)));
+        for (const float v: out)
+            peak = std::max(peak, std::abs(static_cast<double>(v)));
+
+        tier_level l{};
+        l.topology = topology::name;
+        l.sample_rate = sample_rate;
+        l.reference_rate = DWM_SAMPLE_RATE;
+        l.level_db = 20.0 * std::log10(peak / reference_peak);
+        return l;
+    }
+
+    void print_tier_level_header(const options &opt) {
+        if (opt.csv)
+            std::printf("\ntopology,sample_rate,reference_rate,level_db,passed\n");
+        else
+            std::printf("\n%-13s %6s %9s %10s %6s\n", "tier level", "rate", "reference", "level (dB)", "check");
+    }
+
+    /// Prints a tier's level and checks it against the tolerance
+    /// @return whether the tier's level matches the default tier's
+    bool print_tier_level(const options &opt, const tier_level &l) {
+        const bool passed = std::abs(l.level_db) <= tier_level_tolerance;
+        if (opt.csv)
+            std::printf("%s,%d,%d,%.2f,%d\n", l.topology, l.sample_rate, l.reference_rate, l.level_db, passed ? 1 : 0);
+        else
+            std::printf("%-13s %6d %9d %+10.2f %6s\n", l.topology, l.sample_rate, l.reference_rate, l.level_db,
+                        passed ? "ok" : "FAILED");
+        std::fflush(stdout);
+        return passed;
+    }
+
+    /// Checks the level of each of the given tier rates against the plugin's default tier, with the plugin's topology
+    /// @return whether every tier's level matches
+    template<const int... rates>
+    bool check_tier_levels(const options &opt) {
+        return (print_tier_level(opt, measure_tier_level<rates, plugin_topology>()) & ...);
+    }
+
+    /// Cost of rendering sources by convolving them with baked impulse responses instead of simulating them
+    struct convolution_cost {
+        int sample_rate, source_count, length, partition_size;
+        long long blocks;
+        double ns_per_sample; // Per source
+        double load; // Wall clock time over simulated time
+    };
+
+    /// Convolves noise with random stereo responses as the plugin does for baked sources, at the mesh's rate and in
+    /// blocks of the plugin's buffer size, the responses being cross-faded to new ones every 16 blocks
+    convolution_cost measure_convolution(const options &opt, const int source_count, const int length) {
+        std::mt19937 rng(1234);
+        std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+        std::vector<float> responses(2 * static_cast<size_t>(length));
+        std::vector<dwm::partitioned_convolver> convolvers;
+        for (int s = 0; s < source_count; s++) {
+            convolvers.emplace_back(2, length, dwm::ir::convolution_partition);
+            for (float &v: responses)
+                v = noise(rng) * 0.01f;
+            convolvers.back().set_responses(responses.data(), false);
+        }
+        std::vector<float> input(DWM_BUFFER_SIZE), out(2 * static_cast<size_t>(DWM_BUFFER_SIZE));
+
+        long long blocks = 0;
+        double elapsed = 0.0;
+        while (blocks < opt.min_blocks || elapsed < opt.seconds_per_run) {
+            for (float &v: input)
+                v = noise(rng);
+            const auto start = std::chrono::steady_clock::now();
+            std::fill(out.begin(), out.end(), 0.0f);
+            for (auto &convolver: convolvers) {
+                if (blocks % 16 == 0 && convolver.ready())
+                    convolver.set_responses(responses.data());
+                convolver.process(input.data(), out.data(), DWM_BUFFER_SIZE, 2);
+            }
+            elapsed += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            blocks++;
+        }
+
+        convolution_cost c{};
+        c.sample_rate = DWM_SAMPLE_RATE;
+        c.source_count = source_count;
+        c.length = length;
+        c.partition_size = dwm::ir::convolution_partition;
+        c.blocks = blocks;
+        const double samples = static_cast<double>(blocks) * DWM_BUFFER_SIZE;
+        c.ns_per_sample = elapsed * 1e9 / (samples * source_count);
+        c.load = elapsed / (samples / DWM_SAMPLE_RATE);
+        return c;
+    }
+
+    void print_convolution_cost_header(const options &opt) {
+        if (opt.csv)
+            std::printf("\nsample_rate,source_count,length,partition_size,blocks,ns_per_sample,load\n");
+        else
+            std::printf("\n%-13s %6s %4s %7s %9s %9s %12s %8s\n", "baked sources", "rate", "src", "length", "partition",
+                        "blocks", "ns/sample", "load");
+    }
+
+    void print_convolution_cost(const options &opt, const convolution_cost &c) {
+        if (opt.csv) {
+            std::printf("%d,%d,%d,%d,%lld,%.1f,%.4f\n", c.sample_rate, c.source_count, c.length, c.partition_size,
+                        c.blocks, c.ns_per_sample, c.load);
+        } else {
+            std::printf("%-13s %6d %4d %7d %9d %9lld %12.1f %8.4f\n", "", c.sample_rate, c.source_count, c.length,
+                        c.partition_size, c.blocks, c.ns_per_sample, c.load);
+        }
+        std::fflush(stdout);
+    }
+
+    void print_usage(const char *name) {
+        std::fprintf(stderr,
+                     "Usage: %s [--seconds <s>] [--min-blocks <n>] [--csv] [--min-headroom <x>] [--threads <n>]\n"
+                     "          [--max-threads <n>] [--blocking-depth <n>] [--output-rate <hz>]\n"
+                     "          [--sleep-threshold <x>] [--pages <mode>]\n"
+                     "  --seconds <s>       wall clock time spent on each configuration (default 0.5)\n"
+                     "  --min-blocks <n>    minimum number of blocks rendered per configuration (default 8)\n"
+                     "  --csv               print comma separated values\n"
+                     "  --min-headroom <x>  fail if the plugin's configuration runs less than x times real time\n"
+                     "  --threads <n>       workers each mesh update is split across (default 1)\n"
+                     "  --max-threads <n>   upper bound of the thread scaling sweep (default one per hardware thread)\n"
+                     "  --blocking-depth <n> time steps per pass over the mesh (default 0, chosen from the mesh size)\n"
+                     "  --output-rate <hz>  output sample rate the mesh is resampled to (default the mesh's rate)\n"
+                     "  --sleep-threshold <x> peak below which silent tiles of the mesh are skipped (default 0, off)\n"
+                     "  --pages <mode>      pages backing the junctions: standard, transparent_huge or huge (default\n"
+                     "                      the plugin's)\n",
+                     name);
+    }
+
+} // namespace
+
+int main(const int argc, char **argv) {
+    options opt;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            opt.seconds_per_run = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--min-blocks") == 0 && i + 1 < argc) {
+            opt.min_blocks = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--csv") == 0) {
+            opt.csv = true;
+        } else if (std::strcmp(argv[i], "--min-headroom") == 0 && i + 1 < argc) {
+            opt.min_headroom = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            opt.threads = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--max-threads") == 0 && i + 1 < argc) {
+            opt.max_threads = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--blocking-depth") == 0 && i + 1 < argc) {
+            opt.blocking_depth = std::max(0, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--output-rate") == 0 && i + 1 < argc) {
+            opt.output_rate = std::max(0, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--sleep-threshold") == 0 && i + 1 < argc) {
+            opt.sleep_threshold = std::max(0.0f, static_cast<float>(std::atof(argv[++i])));
+        } else if (std::strcmp(argv[i], "--pages") == 0 && i + 1 < argc) {
+            const char *mode = argv[++i];
+            if (std::strcmp(mode, "standard") == 0) {
+                opt.pages = dwm::page_mode::standard;
+            } else if (std::strcmp(mode, "transparent_huge") == 0) {
+                opt.pages = dwm::page_mode::transparent_huge;
+            } else if (std::strcmp(mode, "huge") == 0) {
+                opt.pages = dwm::page_mode::huge;
+            } else {
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    dwm::worker_pool workers(opt.max_threads > 0 ? std::max(opt.max_threads, opt.threads) : 0);
+    workers.set_worker_count(opt.threads);
+
+    print_header(opt);
+
+    // Configuration compiled into the plugin, used as the regression reference
+    const result reference = run<DWM_MESH_WIDTH, DWM_MESH_HEIGHT, DWM_MESH_DEPTH, DWM_SAMPLE_RATE, float,
+                                 plugin_topology>(opt, workers, DWM_BUFFER_SIZE, typical_source_count);
+    print_result(opt, reference);
+
+    // Same configuration with every kernel supported by the running CPU, then back to the default one
+    const dwm::kernels::isa default_isa = dwm::kernels::active().instruction_set;
+    for (int i = 0; i < static_cast<int>(dwm::kernels::isa::count); i++) {
+        const auto instruction_set = static_cast<dwm::kernels::isa>(i);
+        if (instruction_set == default_isa || !dwm::kernels::set_active(instruction_set))
+            continue;
+        print_result(opt, run<DWM_MESH_WIDTH, DWM_MESH_HEIGHT, DWM_MESH_DEPTH, DWM_SAMPLE_RATE, float,
+                              plugin_topology>(opt, workers, DWM_BUFFER_SIZE, typical_source_count));
+    }
+    dwm::kernels::set_active(default_isa);
+
+    // Half precision storage, which pays off once the mesh no longer fits in the caches
+    print_result(opt, run<DWM_MESH_WIDTH, DWM_MESH_HEIGHT, DWM_MESH_DEPTH, DWM_SAMPLE_RATE, dwm::float16>(
+                              opt, workers, DWM_BUFFER_SIZE, typical_source_count));
+    print_result(opt, run<2.0f, 2.0f, 2.0f, 16000>(opt, workers, DWM_BUFFER_SIZE, typical_source_count));
+    print_result(opt, run<2.0f, 2.0f, 2.0f, 16000, dwm::float16>(opt, workers, DWM_BUFFER_SIZE, typical_source_count));
+    print_result(opt, run<4.0f, 4.0f, 4.0f, 8000>(opt, workers, DWM_BUFFER_SIZE, typical_source_count));
+    print_result(opt, run<4.0f, 4.0f, 4.0f, 8000, dwm::float16>(opt, workers, DWM_BUFFER_SIZE, typical_source_count));
+
+    // Mesh size and sample rate sweep, mesh cost grows with the cube of both
+    sweep_mesh_sizes<8000, 0.5f, 1.0f, 2.0f, 4.0f>(opt, workers);
+    sweep_mesh_sizes<16000, 0.5f, 1.0f, 2.0f>(opt, workers);
+    sweep_mesh_sizes<24000, 0.5f, 1.0f, 2.0f>(opt, workers);
+    sweep_mesh_sizes<32000, 0.5f, 1.0f>(opt, workers);
+
+    // Buffer size and source count sweep on the plugin's mesh
+    for (const int buffer_size: {64, 128, 256, 512, 1024}) {
+        for (const int source_count: {1, 4, 16, 64}) {
+            print_result(opt, run<DWM_MESH_WIDTH, DWM_MESH_HEIGHT, DWM_MESH_DEPTH, DWM_SAMPLE_RATE>(
+                                      opt, workers, buffer_size, source_count));
+        }
+    }
+
+    // Temporal blocking sweep, the deeper the blocking the less each plane is streamed from memory
+    for (const int blocking_depth: {1, 2, 4, 8, 16}) {
+        options blocking_opt = opt;
+        blocking_opt.blocking_depth = blocking_depth;
+        print_result(opt, run<2.0f, 2.0f, 2.0f, 16000>(blocking_opt, workers, DWM_BUFFER_SIZE, 1));
+        print_result(opt, run<4.0f, 4.0f, 4.0f, 8000>(blocking_opt, workers, DWM_BUFFER_SIZE, 1));
+    }
+
+    // Output rate sweep, the resampling cost is paid per source and per ear at the output rate
+    for (const int output_rate: {DWM_SAMPLE_RATE, 44100, 48000}) {
+        options resampling_opt = opt;
+        resampling_opt.output_rate = output_rate;
+        for (const int source_count: {1, typical_source_count}) {
+            print_result(opt, run<DWM_MESH_WIDTH, DWM_MESH_HEIGHT, DWM_MESH_DEPTH, DWM_SAMPLE_RATE>(
+                                      resampling_opt, workers, DWM_BUFFER_SIZE, source_count));
+        }
+    }
+
+    // Occupancy sweep, only the air junctions are updated
+    for (const float solid_fraction: {0.3f, 0.6f}) {
+        options occupancy_opt = opt;
+        occupancy_opt.solid_fraction = solid_fraction;
+        print_result(opt, run<4.0f, 4.0f, 4.0f, 8000>(occupancy_opt, workers, DWM_BUFFER_SIZE, typical_source_count));
+    }
+
+    // Activity tracking sweep: continuous noise pays for the tracking alone, bursts let the mesh fall asleep between
+    // them and a silent scene only costs the sources' and ears' bookkeeping
+    for (const int burst_period: {0, 64}) {
+        for (const float sleep_threshold: {0.0f, 1e-5f}) {
+            options sleep_opt = opt;
+            sleep_opt.burst_period = burst_period;
+            sleep_opt.sleep_threshold = sleep_threshold;
+            print_result(opt, run<2.0f, 2.0f, 2.0f, 16000>(sleep_opt, workers, DWM_BUFFER_SIZE, typical_source_count));
+        }
+    }
+    for (const float sleep_threshold: {0.0f, 1e-5f}) {
+        options sleep_opt = opt;
+        sleep_opt.sleep_threshold = sleep_threshold;
+        print_result(opt, run<2.0f, 2.0f, 2.0f, 16000>(sleep_opt, workers, DWM_BUFFER_SIZE, 0));
+    }
+
+    // Page sweep on a mesh much larger than the caches, whose planes span many pages: huge pages cut the TLB misses of
+    // the stencil's seven streams (the pages column shows the pages actually obtained)
+    for (const dwm::page_mode pages:
+         {dwm::page_mode::standard, dwm::page_mode::transparent_huge, dwm::page_mode::huge}) {
+        options pages_opt = opt;
+        pages_opt.pages = pages;
+        print_result(opt, run<4.0f, 4.0f, 4.0f, 16000>(pages_opt, workers, DWM_BUFFER_SIZE, typical_source_count));
+    }
+
+    // Thread scaling sweep on a mesh large enough to amortize the per sample synchronization
+    for (int threads = 1; threads <= workers.max_workers(); threads++) {
+        workers.set_worker_count(threads);
+        print_result(opt, run<2.0f, 2.0f, 2.0f, 16000>(opt, workers, DWM_BUFFER_SIZE, typical_source_count));
+    }
+    workers.set_worker_count(opt.threads);
+
+    // Half precision error report, over a few seconds of simulated time
+    print_storage_error_header(opt);
+    print_storage_error(opt, measure_storage_error<DWM_MESH_WIDTH, DWM_MESH_HEIGHT, DWM_MESH_DEPTH, DWM_SAMPLE_RATE>(
+                                     4.0));
+    print_storage_error(opt, measure_storage_error<2.0f, 2.0f, 2.0f, 16000>(4.0));
+    print_storage_error(opt, measure_storage_error<4.0f, 4.0f, 4.0f, 8000>(4.0));
+
+    // Equivalence of the block rendering and of the kernels to the plain paths, which they only differ from by
+    // rounding
+    print_equivalence_header(opt);
+    bool equivalent = check_equivalence<2.0f, 1.0f, 1.0f, 16000, dwm::topologies::rectilinear>(opt);
+    equivalent = check_equivalence<2.0f, 1.0f, 1.0f, 8000, dwm::topologies::interpolated>(opt) && equivalent;
+
+    // Topology comparison, the interpolated mesh costs more per junction update but reaches the same usable bandwidth
+    // at about half the sample rate
+    print_topology_cost_header(opt);
+    using dwm::topologies::interpolated;
+    using dwm::topologies::rectilinear;
+    print_topology_cost(opt, measure_topology<2.0f, 2.0f, 2.0f, 16000, rectilinear>(opt, workers));
+    print_topology_cost(opt, measure_topology<2.0f, 2.0f, 2.0f, 24000, rectilinear>(opt, workers));
+    print_topology_cost(opt, measure_topology<2.0f, 2.0f, 2.0f, 32000, rectilinear>(opt, workers));
+    print_topology_cost(opt, measure_topology<2.0f, 2.0f, 2.0f, 8000, interpolated>(opt, workers));
+    print_topology_cost(opt, measure_topology<2.0f, 2.0f, 2.0f, 12000, interpolated>(opt, workers));
+    print_topology_cost(opt, measure_topology<2.0f, 2.0f, 2.0f, 16000, interpolated>(opt, workers));
+
+    // Refinement around the listener, the rest of the space running at a lower rate
+    print_nested_cost_header(opt);
+    print_nested_cost(opt, measure_nested<4.0f, 4.0f, 4.0f, 16000, 1.0f, 1>(opt, workers));
+    print_nested_cost(opt, measure_nested<4.0f, 4.0f, 4.0f, 16000, 1.0f, 2>(opt, workers));
+    print_nested_cost(opt, measure_nested<4.0f, 4.0f, 4.0f, 16000, 1.0f, 4>(opt, workers));
+
+    // Direct sound level of the refined space against a single mesh at the full rate, whichever mesh the source and
+    // the listener lie in, the fine mesh spanning 1.5m to 2.5m along each axis
+    print_nested_level_header(opt);
+    constexpr std::array<float, 3> fine_source = {2.3f, 2.0f, 2.0f}, coarse_source = {3.2f, 2.0f, 2.0f};
+    constexpr std::array<float, 3> fine_listener = {2.0f, 2.0f, 2.0f}, coarse_listener = {0.8f, 2.0f, 2.0f};
+    print_nested_level(opt, measure_nested_level<4.0f, 4.0f, 4.0f, 16000, 1.0f, 2>("fine", fine_source, "fine",
+                                                                                   fine_listener, 0.012));
+    print_nested_level(opt, measure_nested_level<4.0f, 4.0f, 4.0f, 16000, 1.0f, 2>("coarse", coarse_source, "fine",
+                                                                                   fine_listener, 0.012));
+    print_nested_level(opt, measure_nested_level<4.0f, 4.0f, 4.0f, 16000, 1.0f, 2>("coarse", coarse_source, "coarse",
+                                                                                   coarse_listener, 0.012));
+    print_nested_level(opt, measure_nested_level<4.0f, 4.0f, 4.0f, 16000, 1.0f, 4>("coarse", coarse_source, "fine",
+                                                                                   fine_listener, 0.012));
+    print_nested_level(opt, measure_nested_level<4.0f, 4.0f, 4.0f, 16000, 1.0f, 4>("coarse", coarse_source, "coarse",
+                                                                                   coarse_listener, 0.012));
+
+    // Level of the quality tiers compiled into the plugin, and of a cheaper and a more accurate one, against the
+    // default tier
+#define DWM_TIER_RATE(rate, width, height, depth) rate
+    print_tier_level_header(opt);
+    const bool tiers_matched = check_tier_levels<DWM_QUALITY_TIERS(DWM_TIER_RATE), 8000, 32000>(opt);
+
+    // Baked sources, whose cost grows with their count and the length of their responses but not with the mesh's size
+    print_convolution_cost_header(opt);
+    for (const int source_count: {1, 16, 64})
+        print_convolution_cost(opt, measure_convolution(opt, source_count, DWM_SAMPLE_RATE / 4));
+
+    if (!equivalent) {
+        std::fprintf(stderr, "Optimized rendering paths differ from their reference by more than %g\n",
+                     equivalence_tolerance);
+        return EXIT_FAILURE;
+    }
+    if (!tiers_matched) {
+        std::fprintf(stderr, "Quality tiers play more than %gdB away from the default tier\n", tier_level_tolerance);
+        return EXIT_FAILURE;
+    }
+    if (reference.headroom < opt.min_headroom) {
+        std::fprintf(stderr, "Plugin configuration runs at %.2fx real time, required at least %.2fx\n",
+                     reference.headroom, opt.min_headroom);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
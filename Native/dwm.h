@@ -2,9 +2,19 @@
 #define DWM_H
 
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <new>
+#include <numeric>
+#include <type_traits>
 #include <vector>
+#include "dwm_arena.h"
+#include "dwm_kernels.h"
+#include "dwm_occupancy.h"
+#include "dwm_workers.h"
 
 /// Rectilinear Digital Waveguide Mesh implementation,
 /// based on the K-DWM implementation described in
@@ -19,27 +29,27 @@ namespace dwm {
         /// Struct shared by non-parametric filters
         struct no_parameters {};
 
-        /// K-DWM boundary filter interface
-        template<typename parameters>
-        class filter {
-        public:
-            virtual ~filter() = default;
+        /// K-DWM boundary filter: a stateless description of the filtering of one incoming sample, whose history
+        /// (history_size values per boundary junction) is owned and laid out by the boundary, so that process is
+        /// inlined into the boundary's loops instead of being called through a vtable
+        template<typename f>
+        concept boundary_filter = requires(const typename f::parameters &params, const float input,
+                                           std::array<float, f::history_size> &history) {
+            { f::process(params, input, history) } -> std::same_as<float>;
+        };
+
+        /// K-DWM boundary Anechoic filter
+        struct anechoic final {
+            typedef no_parameters parameters;
+            static constexpr int history_size = 1; // Previous input
 
             /// Performs filtering on an incoming sample
             /// @return the new output sample resulting from the filter's computation
             /// @param input the incoming sample
-            virtual float process(const parameters &, float input) = 0;
-        };
-
-        /// K-DWM boundary Anechoic filter
-        class anechoic final : public filter<no_parameters> {
-            float prev_input = 0.0f;
-
-        public:
-            /// @copydoc filter::process
-            float process(const no_parameters &, const float input) override {
-                const float result = prev_input;
-                prev_input = input;
+            /// @param history the junction's filter history, updated in place
+            static float process(const parameters &, const float input, std::array<float, history_size> &history) {
+                const float result = history[0];
+                history[0] = input;
                 return result;
             }
         };
@@ -49,6 +59,9 @@ namespace dwm {
             float admittance;
             float cutoff;
 
+            /// Builds parameters with null admittance and cutoff, the defaults of the plugin's parameters
+            admittance_lowpass_parameters() : admittance_lowpass_parameters(0.0f, 0.0f) {}
+
             /// Constructor to safely build parameters which do not amplify the signal
             /// @param normalized_admittance must be in the [0,1] range
             /// @param normalized_cutoff must be in the [0,1] range
@@ -58,17 +71,17 @@ namespace dwm {
         };
 
         /// Admittance + Single pole low pass filter
-        class admittance_lowpass final : public filter<admittance_lowpass_parameters> {
-            float prev_input_1 = 0.0f;
-            float prev_input_2 = 0.0f;
+        struct admittance_lowpass final {
+            typedef admittance_lowpass_parameters parameters;
+            static constexpr int history_size = 2; // Previous input and the one before
 
-        public:
-            /// @copydoc filter::process
-            float process(const admittance_lowpass_parameters &params, const float input) override {
-                const float result = params.cutoff * (input + prev_input_2) + (1.0f + params.admittance) * prev_input_1;
+            /// @copydoc anechoic::process
+            static float process(const parameters &params, const float input,
+                                 std::array<float, history_size> &history) {
+                const float result = params.cutoff * (input + history[1]) + (1.0f + params.admittance) * history[0];
 
-                prev_input_2 = prev_input_1;
-                prev_input_1 = input;
+                history[1] = history[0];
+                history[0] = input;
 
                 return result;
             }
@@ -76,58 +89,191 @@ namespace dwm {
 
     } // namespace filters
 
-    /// 1-dimensional K-DWM boundary parameterized by a filter
-    template<typename filter, typename filter_parameters>
-        requires(std::is_base_of_v<filters::filter<filter_parameters>, filter>)
-    class mesh_boundary final {
+    /// Face of 1-dimensional K-DWM boundaries parameterized by a filter\n
+    /// The state of the face's junctions is stored as a structure of arrays (p+ and p- of the previous step, then each
+    /// filter history value in its own array), so that rows of junctions are updated by vectorizable loops
+    template<filters::boundary_filter filter>
+    class mesh_face final {
     public:
-        /// Updates the boundary state and filters an incoming sample
-        /// @return the filtered input K value
+        /// Builds a new instance, in the initial state
+        /// @param size number of boundary junctions of the face
+        explicit mesh_face(const int size) : p_plus_1(size), p_minus_1(size) {
+            for (std::vector<float> &h : history)
+                h.resize(size);
+        }
+
+        /// Resets all the junctions to the initial state
+        void reset() {
+            std::fill(p_plus_1.begin(), p_plus_1.end(), 0.0f);
+            std::fill(p_minus_1.begin(), p_minus_1.end(), 0.0f);
+            for (std::vector<float> &h : history)
+                std::fill(h.begin(), h.end(), 0.0f);
+        }
+
+        /// Resets consecutive junctions to the initial state
+        /// @param first index of the first junction
+        /// @param n number of junctions
+        void reset(const int first, const int n) {
+            std::fill_n(p_plus_1.begin() + first, n, 0.0f);
+            std::fill_n(p_minus_1.begin() + first, n, 0.0f);
+            for (std::vector<float> &h : history)
+                std::fill_n(h.begin() + first, n, 0.0f);
+        }
+
+        /// Updates the boundary state of consecutive junctions and filters their incoming samples
         /// @param filter_params the filter's parameters
-        /// @param incoming_value the incoming K value
-        [[nodiscard]] float update(const filter_parameters &filter_params, const float incoming_value) {
-            const float p_plus = incoming_value - p_minus_1;
-            const float p_out = f.process(filter_params, p_plus);
+        /// @param first index of the first junction
+        /// @param incoming incoming K values
+        /// @param stride distance between consecutive incoming K values
+        /// @param outgoing filtered input K values, one per junction
+        /// @param n number of junctions
+        void update(const typename filter::parameters &filter_params, const int first,
+                    const float *__restrict incoming, const int stride, float *__restrict outgoing, const int n) {
+            float *__restrict pp = p_plus_1.data() + first;
+            float *__restrict pm = p_minus_1.data() + first;
+            std::array<float *, filter::history_size> hs;
+            for (int k = 0; k < filter::history_size; k++)
+                hs[k] = history[k].data() + first;
 
-            p_minus_1 = p_out - p_plus_1;
-            p_plus_1 = p_plus;
+            for (int j = 0; j < n; j++) {
+                std::array<float, filter::history_size> h;
+                for (int k = 0; k < filter::history_size; k++)
+                    h[k] = hs[k][j];
 
-            return p_out;
+                const float p_plus = incoming[j * stride] - pm[j];
+                const float p_out = filter::process(filter_params, p_plus, h);
+
+                for (int k = 0; k < filter::history_size; k++)
+                    hs[k][j] = h[k];
+                pm[j] = p_out - pp[j];
+                pp[j] = p_plus;
+                outgoing[j] = p_out;
+            }
         }
 
     private:
-        float p_plus_1 = 0.0f, p_minus_1 = 0.0f;
-        filter f = filter();
+        std::vector<float> p_plus_1, p_minus_1;
+        std::array<std::vector<float>, filter::history_size> history;
     };
 
-    /// 3-dimensional Rectilinear K-DWM implementation
+    /// Source injected in a mesh during a block of samples
+    struct block_source {
+        float x, y, z; // World coordinates, reached at the end of the block
+        const float *samples; // Value written at each sample step of the block
+        bool moving = false; // Whether to move linearly from the start coordinates during the block
+        float start_x = 0.0f, start_y = 0.0f, start_z = 0.0f; // World coordinates at the start of the block
+    };
+
+    /// Point sampled from a mesh during a block of samples
+    struct block_receiver {
+        float x, y, z; // World coordinates, reached at the end of the block
+        float *samples; // Value read at each sample step of the block
+        int stride; // Distance between consecutive samples, to write directly into interleaved buffers
+        bool moving = false; // Whether to move linearly from the start coordinates during the block
+        float start_x = 0.0f, start_y = 0.0f, start_z = 0.0f; // World coordinates at the start of the block
+    };
+
+    /// Face of a mesh, named after the axis it is orthogonal to and the direction it faces\n
+    /// Junctions of a face are addressed with (u, v) coordinates: (y, z) on the x faces, (x, z) on the y faces and
+    /// (x, y) on the z faces
+    enum class mesh_side { xp, xn, yp, yn, zp, zn };
+
+    /// Mesh topologies, i.e. the neighbourhood each junction is updated from
+    namespace topologies {
+
+        /// Topology of a mesh, which sets the spacing of its junctions, its dispersion and how it radiates the values
+        /// written by sources
+        template<typename t>
+        concept mesh_topology = requires(const double k) {
+            { t::name } -> std::convertible_to<const char *>;
+            { t::spacing } -> std::convertible_to<float>;
+            { t::source_gain } -> std::convertible_to<float>;
+            { t::source_lead } -> std::convertible_to<float>;
+            { t::dispersion(k, k, k) } -> std::convertible_to<double>;
+        };
+
+        /// Rectilinear K-DWM, each junction is updated from its 6 axial neighbours\n
+        /// The cheapest update per junction, but waves along the axes are slowed down the most: the phase velocity
+        /// error stays within 2% only up to 0.076 times the sample rate
+        struct rectilinear {
+            static constexpr const char *name = "rectilinear";
+            /// Junction spacing, in distances travelled by sound in one sample step
+            static constexpr float spacing = std::sqrt(3.0f);
+            /// Value of the direct path at one junction spacing from a source, relative to the value written by the
+            /// source and decaying as 1 / distance, measured at low frequencies in free field and averaged over the
+            /// source's position between junctions (which changes it by about 1dB)
+            static constexpr float source_gain = 0.224f;
+            /// Sample steps by which the direct path leads the propagation delay, measured along with source_gain
+            static constexpr float source_lead = 2.0f;
+
+            /// @return cos(w * T) of the plane wave of wavenumbers (k_x, k_y, k_z), in radians per junction
+            static double dispersion(const double k_x, const double k_y, const double k_z) {
+                return (std::cos(k_x) + std::cos(k_y) + std::cos(k_z)) / 3.0;
+            }
+        };
+
+        /// Interpolated wideband scheme (Kowalczyk and van Walstijn, "Room acoustics simulation using 3-D compact
+        /// explicit FDTD schemes", 2011), each junction is updated from its 26 neighbours weighted by the product of
+        /// (2 - |d|) along each axis\n
+        /// The update costs about twice as much, but the nearly isotropic dispersion keeps the phase velocity error
+        /// within 2% up to 0.154 times the sample rate: the same bandwidth needs a mesh run at half the sample rate
+        /// with junctions 24% further apart, i.e. about 4 times fewer junction updates
+        struct interpolated {
+            static constexpr const char *name = "interpolated";
+            /// Square of the Courant number, whose limit is 1: the bandwidth barely grows above 0.9, while the highest
+            /// frequency modes become marginally stable
+            static constexpr float courant_squared = 0.9f;
+            /// Junction spacing, in distances travelled by sound in one sample step
+            static constexpr float spacing = 1.0f / std::sqrt(courant_squared);
+            /// See rectilinear::source_gain, the wider update makes it up to twice larger for a source halfway
+            /// between junctions along every axis
+            static constexpr float source_gain = 0.107f;
+            /// See rectilinear::source_lead
+            static constexpr float source_lead = 1.9f;
+
+            /// @return cos(w * T) of the plane wave of wavenumbers (k_x, k_y, k_z), in radians per junction
+            static double dispersion(const double k_x, const double k_y, const double k_z) {
+                const double c = courant_squared;
+                return 1.0 - 2.0 * c + c * (1.0 + std::cos(k_x)) * (1.0 + std::cos(k_y)) * (1.0 + std::cos(k_z)) / 4.0;
+            }
+        };
+
+    } // namespace topologies
+
+    /// 3-dimensional K-DWM implementation
     /// @param width width in meters of the mesh
     /// @param height height in meters of the mesh
     /// @param depth depth in meters of the mesh
     /// @param sample_rate sample rate of the input signal
     /// @param xp_filter filter for the x+ boundary
-    /// @param xp_filter_params x+ boundary filter parameters type
-    /// @param xn_filter filter implementation for the x- boundary
-    /// @param xn_filter_params x- boundary filter parameters type
-    /// @param yp_filter filter implementation for the y+ boundary
-    /// @param yp_filter_params y+ boundary filter parameters type
-    /// @param yn_filter filter implementation for the y- boundary
-    /// @param yn_filter_params y- boundary filter parameters type
-    /// @param zp_filter filter implementation for the z+ boundary
-    /// @param zp_filter_params z+ boundary filter parameters type
-    /// @param zn_filter filter implementation for the z- boundary
-    /// @param zn_filter_params z- boundary filter parameters type
+    /// @param xn_filter filter for the x- boundary
+    /// @param yp_filter filter for the y+ boundary
+    /// @param yn_filter filter for the y- boundary
+    /// @param zp_filter filter for the z+ boundary
+    /// @param zn_filter filter for the z- boundary
+    /// @param storage storage format of the junction values, float or float16: half precision halves the memory
+    /// traffic of large meshes, the computations are still carried out in single precision
+    /// @param topology neighbourhood each junction is updated from (see topologies), which sets the junctions spacing:
+    /// interpolated meshes only support single precision storage
     template<const float width, const float height, const float depth, const int sample_rate, //
-             typename xp_filter, typename xp_filter_params, typename xn_filter, typename xn_filter_params,
-             typename yp_filter, typename yp_filter_params, typename yn_filter, typename yn_filter_params,
-             typename zp_filter, typename zp_filter_params, typename zn_filter, typename zn_filter_params>
-        requires(std::is_base_of_v<filters::filter<xp_filter_params>, xp_filter>,
-                 std::is_base_of_v<filters::filter<xn_filter_params>, xn_filter>,
-                 std::is_base_of_v<filters::filter<yp_filter_params>, yp_filter>,
-                 std::is_base_of_v<filters::filter<yn_filter_params>, yn_filter>,
-                 std::is_base_of_v<filters::filter<zp_filter_params>, zp_filter>,
-                 std::is_base_of_v<filters::filter<zn_filter_params>, zn_filter>)
+             filters::boundary_filter xp_filter, filters::boundary_filter xn_filter, //
+             filters::boundary_filter yp_filter, filters::boundary_filter yn_filter, //
+             filters::boundary_filter zp_filter, filters::boundary_filter zn_filter, typename storage = float,
+             topologies::mesh_topology topology = topologies::rectilinear>
+        requires((std::is_same_v<storage, float> || std::is_same_v<storage, float16>) &&
+                 (std::is_same_v<topology, topologies::rectilinear> ||
+                  (std::is_same_v<topology, topologies::interpolated> && std::is_same_v<storage, float>)))
     class mesh_3d final {
+    public:
+        /// Parameters type of each boundary's filter
+        typedef typename xp_filter::parameters xp_filter_params;
+        typedef typename xn_filter::parameters xn_filter_params;
+        typedef typename yp_filter::parameters yp_filter_params;
+        typedef typename yn_filter::parameters yn_filter_params;
+        typedef typename zp_filter::parameters zp_filter_params;
+        typedef typename zn_filter::parameters zn_filter_params;
+
+    private:
         // * World coordinates <x, y, z> refer to the continuous coordinate system
         // external to the mesh, which is used
         //   in public facing methods
@@ -138,36 +284,318 @@ namespace dwm {
         // store the junctions' data
         //   (indices are linearized in x->y->z order, like
         //   [<0,0,0>, <1,0,0>, ... , <s_x,0,0>, <0,1,0>, ..., <s_x,s_y,0>, <0,0,1>,
-        //   ..., <s_x,s_y,s_z>])
+        //   ..., <s_x,s_y,s_z>], x-rows being row_stride apart and z planes plane_stride apart)
 
-        // Junctions density, dependent on the mesh's required sample rate
-        static constexpr float density = static_cast<float>(sample_rate) / (std::sqrt(3.0f) * 343.0f);
+        // Junctions density, dependent on the mesh's required sample rate and topology
+        static constexpr float density = static_cast<float>(sample_rate) / (topology::spacing * 343.0f);
         // Junctions dimensionality, dependent on the mesh's density and "world size"
         static constexpr int size_x = std::max(1, static_cast<int>(std::ceil(width * density)));
         static constexpr int size_y = std::max(1, static_cast<int>(std::ceil(height * density)));
         static constexpr int size_z = std::max(1, static_cast<int>(std::ceil(depth * density)));
+        // Junctions stored per x-row and per z plane: rows are padded to whole cache lines, so that each one starts
+        // aligned for the kernels' vector loads, and planes to an odd number of cache lines, so that the rows of a
+        // junction's z neighbours start in different cache sets however the mesh is sized. The padding stays zero
+        static constexpr int line_junctions = static_cast<int>(arena::alignment / sizeof(storage));
+        static constexpr int row_stride = (size_x + line_junctions - 1) / line_junctions * line_junctions;
+        static constexpr int plane_stride =
+                row_stride * size_y + (row_stride * size_y / line_junctions % 2 == 0 ? line_junctions : 0);
+        static constexpr int stored_junctions = plane_stride * size_z;
 
-        float *p; // Linearized storage of "z timestep" K values for each junction
-        float *p_aux; // Linearized storage of "z-1 timestep" K value for each junction
+        // Backs p, p_aux and the scratch buffers, zeroed when mapped and only written by the updates afterwards
+        arena memory;
+        storage *p; // Linearized storage of "z timestep" K values for each junction
+        storage *p_aux; // Linearized storage of "z-1 timestep" K value for each junction
 
-        // Each buffer stores a specific side's boundary
+        // Each face stores a specific side's boundary
 
         // x+, size of size_y * size_z, stored in y-major layout
-        mesh_boundary<xp_filter, xp_filter_params> *b_xp;
+        mesh_face<xp_filter> b_xp{size_y * size_z};
         // x-, size of size_y * size_z, stored in y-major layout
-        mesh_boundary<xn_filter, xn_filter_params> *b_xn;
+        mesh_face<xn_filter> b_xn{size_y * size_z};
         // y+, size of size_x * size_z, stored in x-major layout
-        mesh_boundary<yp_filter, yp_filter_params> *b_yp;
+        mesh_face<yp_filter> b_yp{size_x * size_z};
         // y-, size of size_x * size_z, stored in x-major layout
-        mesh_boundary<yn_filter, yn_filter_params> *b_yn;
+        mesh_face<yn_filter> b_yn{size_x * size_z};
         // z+, size of size_x * size_y, stored in x-major layout
-        mesh_boundary<zp_filter, yp_filter_params> *b_zp;
+        mesh_face<zp_filter> b_zp{size_x * size_y};
         // z-, size of size_x * size_y, stored in x-major layout
-        mesh_boundary<zn_filter, yn_filter_params> *b_zn;
+        mesh_face<zn_filter> b_zn{size_x * size_y};
+
+        int max_slabs; // Maximum number of z slabs updated in parallel
+        // Per slab scratch holding the y+, y-, z+ and z- boundary outputs of the x-row being updated, then the x+ and
+        // x- boundary outputs of the z plane being updated
+        // Rounded up to whole cache lines, so that the workers never write the same line
+        static constexpr int scratch_size = (4 * size_x + 2 * size_y + line_junctions - 1) / line_junctions *
+                                            line_junctions;
+        storage *rows;
+
+        // Per slab scratch holding the single precision incoming and outgoing values of the face row being updated,
+        // only used by half precision meshes
+        static constexpr int face_scratch_size =
+                std::is_same_v<storage, float> ? 0 : (2 * std::max(size_x, size_y) + 15) / 16 * 16;
+        float *face_rows;
+
+        // Trilinear interpolation stencil of a world coordinate, in the same order used by read_value and write_value
+        struct stencil {
+            int i[8];
+            float w[8];
+        };
+
+        // Junction touched by a source or receiver during a block, with its interpolation weight at the start and at
+        // the end of the block: the stencils of moving sources and receivers are cross-faded along the block
+        struct tap {
+            int i; // Linearized junction coordinate
+            int owner; // Index of the source or receiver
+            float w_start, w_end;
+        };
+
+        // Number of time steps whose injection coefficients and receiver weights are computed at once, without
+        // temporal blocking
+        static constexpr int chunk_steps = 16;
+
+        // Per block state of update_block, see prepare_block
+        std::vector<tap> source_taps; // Sorted by junction, then by source
+        std::vector<int> injection_index; // Junctions touched by at least one source, in increasing order
+        std::vector<int> injection_taps; // First source tap of each injected junction, plus the end
+        std::vector<int> injection_planes; // First injected junction of each z plane, plus the end
+        std::vector<float> injection_a, injection_b; // Affine injection coefficients of the current steps, step-major
+        std::vector<tap> receiver_taps; // Taps of all the receivers, sorted by junction, then by receiver
+        std::vector<int> receiver_index; // Junctions of receiver_taps
+        std::vector<int> receiver_planes; // First receiver tap of each z plane, plus the end
+        std::vector<float> receiver_weights; // Tap weights of the current steps, step-major
+        std::vector<float> receiver_values; // Weighted junction value of each tap, for the step being read
+
+        // Number of time steps advanced per pass over the mesh by update_block, 0 to choose from the plane size
+        int blocking_depth = 0;
+
+        // Block being advanced by step_block, see begin_block
+        const block_source *block_sources = nullptr;
+        const block_receiver *block_receivers = nullptr;
+        int block_steps = 0, block_step = 0;
+
+        // Rectangle of a face whose outer neighbours are read from another mesh instead of the face's filters
+        struct portal {
+            mesh_side side;
+            int u, v, u_size, v_size;
+            const float *incoming; // u_size * v_size values, u-major
+        };
+        std::vector<portal> portals;
+
+        // Junctions left out of the update, see set_occupancy
+        std::vector<uint8_t> solid; // Whether each junction is solid, empty when all of them are air
+        std::vector<int> row_spans; // First span of each x-row, plus the end, rows in linearized order
+        std::vector<int> span_begin, span_end; // Runs of consecutive air junctions of the x-rows
+        // Range of rows of each z plane whose last and first junctions are air, where the x+ and x- faces are updated
+        std::vector<std::array<int, 4>> face_x_rows;
+        // Air junctions whose neighbour on each side (indexed by mesh_side) is solid, in increasing order, each
+        // terminated by a boundary filtered like the mesh's face on the same side
+        std::array<std::vector<int>, 6> wall_index;
+        std::array<std::vector<int>, 6> wall_planes; // First wall junction of each z plane, plus the end, per side
+        mesh_face<xp_filter> w_xp{0};
+        mesh_face<xn_filter> w_xn{0};
+        mesh_face<yp_filter> w_yp{0};
+        mesh_face<yn_filter> w_yn{0};
+        mesh_face<zp_filter> w_zp{0};
+        mesh_face<zn_filter> w_zn{0};
+        // Per slab scratch holding the incoming values of one side's wall junctions of the z plane being updated,
+        // then the boundary outputs of each side
+        int wall_scratch_size = 0;
+        std::vector<float> wall_rows;
+
+        // Whether junctions are updated from their 26 neighbours, see topologies::interpolated
+        static constexpr bool interpolated = std::is_same_v<topology, topologies::interpolated>;
+        // Offset of each face (indexed by mesh_side) among the ghosts of a time step, plus their total size
+        static constexpr int ghost_offsets[7] = {0,
+                                                 size_y * size_z,
+                                                 2 * size_y * size_z,
+                                                 2 * size_y * size_z + size_x * size_z,
+                                                 2 * (size_y * size_z + size_x * size_z),
+                                                 2 * (size_y * size_z + size_x * size_z) + size_x * size_y,
+                                                 2 * (size_y * size_z + size_x * size_z + size_x * size_y)};
+        // Boundary outputs of all the faces' junctions at the time step of p (first half) and of p_aux (second half),
+        // laid out like the faces, only used by interpolated meshes: their junctions also read the boundary outputs of
+        // their neighbours on the face, so the outputs of a plane are kept until its neighbouring planes are updated
+        std::vector<float> ghosts = std::vector<float>(interpolated ? 2 * ghost_offsets[6] : 0, 0.0f);
+        // Air junctions of interpolated meshes next to solid ones, which reflect rigidly: the row kernels read the
+        // solid neighbours as zero instead of the junction's own value, rigid_weight being the missing share
+        std::vector<int> rigid_index;
+        std::vector<float> rigid_weight;
+        std::vector<int> rigid_planes; // First rigid junction of each z plane, plus the end
+
+        // Activity tracking, see set_sleep_threshold: the x-rows are grouped in tiles of tile_size x tile_size rows
+        // (along y and z), checked every tile_size steps at most. Waves cross at most one junction per step, so a wave
+        // leaving an active tile cannot cross its neighbours before the next check
+        static constexpr int tile_size = 16;
+        static constexpr int tiles_y = (size_y + tile_size - 1) / tile_size;
+        static constexpr int tiles_z = (size_z + tile_size - 1) / tile_size;
+        float sleep_threshold = 0.0f; // Peak below which tiles fall asleep, 0 when disabled
+        int sleep_hold_checks = 1; // Consecutive checks a tile must stay below the threshold for before sleeping
+        std::vector<uint8_t> tile_awake = std::vector<uint8_t>(tiles_y * tiles_z, 1); // Updated tiles, z-major
+        std::vector<uint8_t> tile_active = std::vector<uint8_t>(tiles_y * tiles_z, 0); // Not yet quiet for long
+        std::vector<uint8_t> tile_pinned = std::vector<uint8_t>(tiles_y * tiles_z, 0); // Touched by a loud source
+        std::vector<int> tile_quiet = std::vector<int>(tiles_y * tiles_z, 0); // Consecutive checks below the threshold
+        int awake_tiles = tiles_y * tiles_z;
+        int activity_steps = 0; // Steps since the last check
+        std::vector<int> tile_junctions = std::vector<int>(tiles_y * tiles_z, 0); // Air junctions of each tile
+        int air_junctions = 0; // Air junctions of the whole mesh
+
+        // Junctions computed by the updates since construction, solid and sleeping ones excluded
+        uint64_t junction_updates_count = 0;
 
         // Converts from junction coordinates to a linearized coordinates
         [[nodiscard]] static int junction_to_linearized(const int x, const int y, const int z) {
-            return (z * size_y + y) * size_x + x;
+            return z * plane_stride + y * row_stride + x;
+        }
+
+        // Converts from the (u, v) coordinates of a face's junction to linearized coordinates
+        [[nodiscard]] static int face_to_linearized(const mesh_side side, const int u, const int v) {
+            switch (side) {
+                case mesh_side::xp:
+                    return junction_to_linearized(size_x - 1, u, v);
+                case mesh_side::xn:
+                    return junction_to_linearized(0, u, v);
+                case mesh_side::yp:
+                    return junction_to_linearized(u, size_y - 1, v);
+                case mesh_side::yn:
+                    return junction_to_linearized(u, 0, v);
+                case mesh_side::zp:
+                    return junction_to_linearized(u, v, size_z - 1);
+                default:
+                    return junction_to_linearized(u, v, 0);
+            }
+        }
+
+        // Boundary outputs of a face at the time step of p (slot 0) or p_aux (slot 1), see ghosts
+        [[nodiscard]] float *ghost_face(const mesh_side side, const int slot) {
+            return ghosts.data() + slot * ghost_offsets[6] + ghost_offsets[static_cast<int>(side)];
+        }
+        [[nodiscard]] const float *ghost_face(const mesh_side side, const int slot) const {
+            return ghosts.data() + slot * ghost_offsets[6] + ghost_offsets[static_cast<int>(side)];
+        }
+
+        // Zeroes the boundary outputs of n junctions of a face in both time steps, see ghosts
+        void clear_ghosts(const mesh_side side, const int first, const int n) {
+            if constexpr (interpolated) {
+                for (int slot = 0; slot < 2; slot++)
+                    std::fill_n(ghost_face(side, slot) + first, n, 0.0f);
+            }
+        }
+
+        // Rebuilds the spans of air junctions and the walls around the solid ones, zeroing the latter so that they do
+        // not contribute to the update of their air neighbours
+        void build_occupancy() {
+            constexpr int offsets[6] = {1, -1, row_stride, -row_stride, plane_stride, -plane_stride};
+            const auto air = [this](const int i) { return solid.empty() || solid[i] == 0; };
+
+            row_spans.clear();
+            span_begin.clear();
+            span_end.clear();
+            for (std::vector<int> &walls: wall_index)
+                walls.clear();
+            rigid_index.clear();
+            rigid_weight.clear();
+            face_x_rows.assign(size_z, {size_y, 0, size_y, 0});
+            for (int z = 0; z < size_z; z++) {
+                for (int y = 0; y < size_y; y++) {
+                    if (air(junction_to_linearized(size_x - 1, y, z))) {
+                        face_x_rows[z][0] = std::min(face_x_rows[z][0], y);
+                        face_x_rows[z][1] = y + 1;
+                    }
+                    if (air(junction_to_linearized(0, y, z))) {
+                        face_x_rows[z][2] = std::min(face_x_rows[z][2], y);
+                        face_x_rows[z][3] = y + 1;
+                    }
+                    row_spans.push_back(static_cast<int>(span_begin.size()));
+                    for (int x = 0; x < size_x; x++) {
+                        const int i = junction_to_linearized(x, y, z);
+                        if (!air(i))
+                            continue;
+                        if (x == 0 || !air(i - 1))
+                            span_begin.push_back(x);
+                        if (x == size_x - 1 || !air(i + 1))
+                            span_end.push_back(x + 1);
+                        if (solid.empty())
+                            continue;
+                        if constexpr (interpolated) {
+                            int weight = 0; // Of the solid neighbours, in sixteenths of the neighbours' sum
+                            for (int dz = -1; dz <= 1; dz++) {
+                                for (int dy = -1; dy <= 1; dy++) {
+                                    for (int dx = -1; dx <= 1; dx++) {
+                                        const int n_x = x + dx, n_y = y + dy, n_z = z + dz;
+                                        if (n_x >= 0 && n_x < size_x && n_y >= 0 && n_y < size_y && n_z >= 0 &&
+                                            n_z < size_z && !air(junction_to_linearized(n_x, n_y, n_z)))
+                                            weight += (2 - std::abs(dx)) * (2 - std::abs(dy)) * (2 - std::abs(dz));
+                                    }
+                                }
+                            }
+                            if (weight > 0) {
+                                rigid_index.push_back(i);
+                                rigid_weight.push_back(topology::courant_squared * static_cast<float>(weight) / 16.0f);
+                            }
+                            continue;
+                        }
+                        const bool inside[6] = {x < size_x - 1, x > 0, y < size_y - 1, y > 0, z < size_z - 1, z > 0};
+                        for (int side = 0; side < 6; side++) {
+                            if (inside[side] && !air(i + offsets[side]))
+                                wall_index[side].push_back(i);
+                        }
+                    }
+                }
+            }
+            row_spans.push_back(static_cast<int>(span_begin.size()));
+
+            std::fill(tile_junctions.begin(), tile_junctions.end(), 0);
+            for (int z = 0; z < size_z; z++) {
+                for (int y = 0; y < size_y; y++) {
+                    const int row = z * size_y + y;
+                    for (int s = row_spans[row]; s < row_spans[row + 1]; s++)
+                        tile_junctions[z / tile_size * tiles_y + y / tile_size] += span_end[s] - span_begin[s];
+                }
+            }
+            air_junctions = std::accumulate(tile_junctions.begin(), tile_junctions.end(), 0);
+
+            int max_plane_walls = 0;
+            for (int side = 0; side < 6; side++) {
+                wall_planes[side].resize(size_z + 1);
+                for (int z = 0; z <= size_z; z++)
+                    wall_planes[side][z] = static_cast<int>(
+                            std::lower_bound(wall_index[side].begin(), wall_index[side].end(), z * plane_stride) -
+                            wall_index[side].begin());
+                for (int z = 0; z < size_z; z++)
+                    max_plane_walls = std::max(max_plane_walls, wall_planes[side][z + 1] - wall_planes[side][z]);
+            }
+            w_xp = mesh_face<xp_filter>(static_cast<int>(wall_index[0].size()));
+            w_xn = mesh_face<xn_filter>(static_cast<int>(wall_index[1].size()));
+            w_yp = mesh_face<yp_filter>(static_cast<int>(wall_index[2].size()));
+            w_yn = mesh_face<yn_filter>(static_cast<int>(wall_index[3].size()));
+            w_zp = mesh_face<zp_filter>(static_cast<int>(wall_index[4].size()));
+            w_zn = mesh_face<zn_filter>(static_cast<int>(wall_index[5].size()));
+            wall_scratch_size = 7 * max_plane_walls;
+            wall_rows.assign(static_cast<size_t>(wall_scratch_size) * max_slabs, 0.0f);
+            if constexpr (interpolated) {
+                rigid_planes.resize(size_z + 1);
+                for (int z = 0; z <= size_z; z++)
+                    rigid_planes[z] = static_cast<int>(
+                            std::lower_bound(rigid_index.begin(), rigid_index.end(), z * plane_stride) -
+                            rigid_index.begin());
+                // The boundary outputs of junctions which became solid are no longer updated
+                std::fill(ghosts.begin(), ghosts.end(), 0.0f);
+            }
+
+            for (size_t i = 0; i < solid.size(); i++) {
+                if (solid[i] != 0)
+                    p[i] = p_aux[i] = from_float<storage>(0.0f);
+            }
+        }
+
+        // Trilinear interpolation of a buffer's junctions at a world coordinate
+        [[nodiscard]] static float interpolate(const storage *buffer, const float x, const float y, const float z) {
+            float px, py, pz;
+            int i000, i100, i010, i110, i001, i101, i011, i111;
+            compute_interpolation_parameters(x, y, z, px, py, pz, i000, i100, i010, i110, i001, i101, i011, i111);
+            const auto v = [buffer](const int i) { return to_float(buffer[i]); };
+            return std::lerp(std::lerp(std::lerp(v(i000), v(i100), px), std::lerp(v(i010), v(i110), px), py),
+                             std::lerp(std::lerp(v(i001), v(i101), px), std::lerp(v(i011), v(i111), px), py), pz);
         }
 
         // Compute interpolation parameters for a world coordinate
@@ -203,49 +631,445 @@ namespace dwm {
             pz = modff(zs, &_);
         }
 
+        // Compute the interpolation stencil of a world coordinate
+        static stencil compute_stencil(const float x, const float y, const float z) {
+            stencil s;
+            float px, py, pz;
+            compute_interpolation_parameters(x, y, z, px, py, pz, s.i[0], s.i[1], s.i[2], s.i[3], s.i[4], s.i[5],
+                                             s.i[6], s.i[7]);
+            s.w[0] = (1 - px) * (1 - py) * (1 - pz);
+            s.w[1] = px * (1 - py) * (1 - pz);
+            s.w[2] = (1 - px) * py * (1 - pz);
+            s.w[3] = px * py * (1 - pz);
+            s.w[4] = (1 - px) * (1 - py) * pz;
+            s.w[5] = px * (1 - py) * pz;
+            s.w[6] = (1 - px) * py * pz;
+            s.w[7] = px * py * pz;
+            return s;
+        }
+
+        // Appends the taps of a source or receiver moving between two world coordinates during a block, merging the
+        // junctions shared by the start and end stencils
+        static void append_taps(std::vector<tap> &taps, const int owner, const bool moving, const float start_x,
+                                const float start_y, const float start_z, const float x, const float y,
+                                const float z) {
+            const stencil end = compute_stencil(x, y, z);
+            const size_t first = taps.size();
+            for (int k = 0; k < 8; k++)
+                taps.push_back({end.i[k], owner, moving ? 0.0f : end.w[k], end.w[k]});
+            if (!moving)
+                return;
+            const stencil start = compute_stencil(start_x, start_y, start_z);
+            for (int k = 0; k < 8; k++) {
+                const auto shared = std::find_if(taps.begin() + static_cast<std::ptrdiff_t>(first), taps.end(),
+                                                 [&](const tap &t) { return t.i == start.i[k]; });
+                if (shared != taps.end())
+                    shared->w_start += start.w[k];
+                else
+                    taps.push_back({start.i[k], owner, start.w[k], 0.0f});
+            }
+        }
+
+        // Weight of a tap at a step of a block, sources and receivers reach their end coordinates at the last step
+        [[nodiscard]] static float tap_weight(const tap &t, const int n, const int steps) {
+            return t.w_start + (t.w_end - t.w_start) * (static_cast<float>(n + 1) / static_cast<float>(steps));
+        }
+
+        // Computes the taps of the block's sources and receivers, merging the sources touching the same junctions
+        void prepare_block(const int steps, const block_source *sources, const int source_count,
+                           const block_receiver *receivers, const int receiver_count) {
+            const bool sleeping = sleep_threshold > 0.0f;
+            if (sleeping)
+                std::fill(tile_pinned.begin(), tile_pinned.end(), 0);
+            source_taps.clear();
+            for (int s = 0; s < source_count; s++) {
+                const block_source &src = sources[s];
+                const size_t first = source_taps.size();
+                append_taps(source_taps, s, src.moving, src.start_x, src.start_y, src.start_z, src.x, src.y, src.z);
+                // Sources above the threshold wake their tiles, which then stay awake until the end of the block
+                if (sleeping && kernels::active().peak_abs(src.samples, steps) > sleep_threshold) {
+                    for (size_t t = first; t < source_taps.size(); t++) {
+                        wake_junction(source_taps[t].i);
+                        tile_pinned[junction_tile(source_taps[t].i)] = 1;
+                    }
+                }
+            }
+            // Solid junctions are never written, so that they do not leak into their air neighbours, nor are the
+            // sleeping ones, which the sources left below the threshold only need to stay silent
+            if (!solid.empty() || sleeping)
+                std::erase_if(source_taps, [this](const tap &t) {
+                    return (!solid.empty() && solid[t.i] != 0) || tile_awake[junction_tile(t.i)] == 0;
+                });
+            // Sources are injected in their order, which is kept among the taps of the same junction
+            std::sort(source_taps.begin(), source_taps.end(),
+                      [](const tap &a, const tap &b) { return a.i != b.i ? a.i < b.i : a.owner < b.owner; });
+            injection_index.clear();
+            injection_taps.clear();
+            for (int t = 0; t < static_cast<int>(source_taps.size()); t++) {
+                if (t == 0 || source_taps[t].i != source_taps[t - 1].i) {
+                    injection_index.push_back(source_taps[t].i);
+                    injection_taps.push_back(t);
+                }
+            }
+            injection_taps.push_back(static_cast<int>(source_taps.size()));
+            injection_planes.resize(size_z + 1);
+            for (int z = 0; z <= size_z; z++)
+                injection_planes[z] = static_cast<int>(
+                        std::lower_bound(injection_index.begin(), injection_index.end(), z * plane_stride) -
+                        injection_index.begin());
+
+            // The taps of all the receivers are merged, so that each step reads them with a single gather however
+            // many points are sampled (receiver arrays share most of their junctions, which stay in cache)
+            receiver_taps.clear();
+            for (int r = 0; r < receiver_count; r++) {
+                const block_receiver &rec = receivers[r];
+                append_taps(receiver_taps, r, rec.moving, rec.start_x, rec.start_y, rec.start_z, rec.x, rec.y, rec.z);
+            }
+            if (!solid.empty())
+                std::erase_if(receiver_taps, [this](const tap &t) { return solid[t.i] != 0; });
+            std::sort(receiver_taps.begin(), receiver_taps.end(),
+                      [](const tap &a, const tap &b) { return a.i != b.i ? a.i < b.i : a.owner < b.owner; });
+            receiver_index.resize(receiver_taps.size());
+            for (size_t t = 0; t < receiver_taps.size(); t++)
+                receiver_index[t] = receiver_taps[t].i;
+            receiver_values.resize(receiver_taps.size());
+            receiver_planes.resize(size_z + 1);
+            for (int z = 0; z <= size_z; z++)
+                receiver_planes[z] = static_cast<int>(
+                        std::lower_bound(receiver_index.begin(), receiver_index.end(), z * plane_stride) -
+                        receiver_index.begin());
+        }
+
+        // Composes the injections of each junction's sources into a single affine update per step, for count steps
+        // starting from step first: injecting v with weight w maps p to (1 - w) * p + w * v, and applying such maps
+        // in the sources' order gives a * p + b
+        void prepare_injection(const block_source *sources, const int steps, const int first, const int count) {
+            const int junctions = static_cast<int>(injection_index.size());
+            injection_a.resize(static_cast<size_t>(count) * junctions);
+            injection_b.resize(static_cast<size_t>(count) * junctions);
+            std::fill(injection_a.begin(), injection_a.end(), 1.0f);
+            std::fill(injection_b.begin(), injection_b.end(), 0.0f);
+            for (int j = 0; j < junctions; j++) {
+                for (int t = injection_taps[j]; t < injection_taps[j + 1]; t++) {
+                    const tap &st = source_taps[t];
+                    const float *values = sources[st.owner].samples + first;
+                    for (int k = 0; k < count; k++) {
+                        const float w = tap_weight(st, first + k, steps);
+                        float &a = injection_a[k * junctions + j];
+                        float &b = injection_b[k * junctions + j];
+                        a *= 1.0f - w;
+                        b = b * (1.0f - w) + w * values[k];
+                    }
+                }
+            }
+        }
+
+        // Computes the receivers' tap weights for count steps starting from step first
+        void prepare_receivers(const int steps, const int first, const int count) {
+            const int taps = static_cast<int>(receiver_taps.size());
+            receiver_weights.resize(static_cast<size_t>(count) * taps);
+            for (int k = 0; k < count; k++) {
+                for (int t = 0; t < taps; t++)
+                    receiver_weights[k * taps + t] = tap_weight(receiver_taps[t], first + k, steps);
+            }
+        }
+
+        // Applies the injection of the k-th prepared step to the junctions of the z planes in [z_begin, z_end)
+        void apply_injection(const kernels::kernel_set &kernels, storage *buffer, const int k, const int z_begin,
+                             const int z_end) {
+            const int begin = injection_planes[z_begin], end = injection_planes[z_end];
+            if (end == begin)
+                return;
+            const size_t offset = static_cast<size_t>(k) * injection_index.size() + begin;
+            const int *index = injection_index.data() + begin;
+            const float *a = injection_a.data() + offset, *b = injection_b.data() + offset;
+            if constexpr (std::is_same_v<storage, float>) {
+                kernels.scatter_affine(buffer, index, a, b, end - begin);
+            } else {
+                // A handful of junctions per source, not worth a kernel
+                for (int j = 0; j < end - begin; j++)
+                    buffer[index[j]] = from_float<storage>(a[j] * to_float(buffer[index[j]]) + b[j]);
+            }
+        }
+
+        // Accumulates into the receivers' n-th sample the junctions of the z planes in [z_begin, z_end), with the
+        // weights of the k-th prepared step: the taps of all the receivers are read with one gather
+        void apply_receivers(const kernels::kernel_set &kernels, const storage *buffer,
+                             const block_receiver *receivers, const int n, const int k, const int z_begin,
+                             const int z_end) {
+            const int begin = receiver_planes[z_begin], end = receiver_planes[z_end];
+            if (end == begin)
+                return;
+            const int *index = receiver_index.data() + begin;
+            const float *w = receiver_weights.data() + static_cast<size_t>(k) * receiver_taps.size() + begin;
+            float *values = receiver_values.data() + begin;
+            if constexpr (std::is_same_v<storage, float>) {
+                kernels.gather_scaled(buffer, index, w, values, end - begin);
+            } else {
+                for (int j = 0; j < end - begin; j++)
+                    values[j] = w[j] * to_float(buffer[index[j]]);
+            }
+            for (int t = begin; t < end; t++) {
+                const block_receiver &r = receivers[receiver_taps[t].owner];
+                r.samples[n * r.stride] += receiver_values[t];
+            }
+        }
+
+        // Overwrites the boundary outputs of the v-th row of a face's junctions with the values of its portals
+        void apply_portals(const mesh_side side, const int v, storage *row) const {
+            for (const portal &pt: portals) {
+                if (pt.side != side || v < pt.v || v >= pt.v + pt.v_size)
+                    continue;
+                const float *incoming = pt.incoming + static_cast<size_t>(v - pt.v) * pt.u_size;
+                for (int u = 0; u < pt.u_size; u++)
+                    row[pt.u + u] = from_float<storage>(incoming[u]);
+            }
+        }
+
+        // Wakes a tile and its neighbours, which energy is about to be pushed into: the energy can reach the
+        // neighbouring tiles before the next check
+        void wake_tile(const int t_y, const int t_z) {
+            for (int n_z = std::max(0, t_z - 1); n_z <= std::min(tiles_z - 1, t_z + 1); n_z++) {
+                for (int n_y = std::max(0, t_y - 1); n_y <= std::min(tiles_y - 1, t_y + 1); n_y++) {
+                    uint8_t &awake = tile_awake[n_z * tiles_y + n_y];
+                    awake_tiles += awake == 0;
+                    awake = 1;
+                }
+            }
+        }
+
+        // Air junctions computed by an update in the current state, those of the awake tiles
+        [[nodiscard]] int updated_junctions() const {
+            if (sleep_threshold <= 0.0f || awake_tiles == tiles_y * tiles_z)
+                return air_junctions;
+            int junctions = 0;
+            for (int t = 0; t < tiles_y * tiles_z; t++)
+                junctions += tile_awake[t] != 0 ? tile_junctions[t] : 0;
+            return junctions;
+        }
+
+        // Index of the tile of a junction
+        [[nodiscard]] static int junction_tile(const int i) {
+            return i / plane_stride / tile_size * tiles_y + i % plane_stride / row_stride / tile_size;
+        }
+
+        // Wakes the tile of a junction and its neighbours, see wake_tile
+        void wake_junction(const int i) {
+            wake_tile(i % plane_stride / row_stride / tile_size, i / plane_stride / tile_size);
+        }
+
+        // Wakes the tiles behind the portals whose incoming values exceed the threshold
+        void wake_portals(const kernels::kernel_set &kernels) {
+            for (const portal &pt: portals) {
+                if (!(kernels.peak_abs(pt.incoming, pt.u_size * pt.v_size) > sleep_threshold))
+                    continue;
+                // Rows of junctions behind the portal, as [y_begin, y_end) x [z_begin, z_end)
+                int y_begin = pt.u, y_end = pt.u + pt.u_size, z_begin = pt.v, z_end = pt.v + pt.v_size;
+                if (pt.side == mesh_side::yp || pt.side == mesh_side::yn) {
+                    y_begin = pt.side == mesh_side::yp ? size_y - 1 : 0;
+                    y_end = y_begin + 1;
+                } else if (pt.side == mesh_side::zp || pt.side == mesh_side::zn) {
+                    y_begin = pt.v;
+                    y_end = pt.v + pt.v_size;
+                    z_begin = pt.side == mesh_side::zp ? size_z - 1 : 0;
+                    z_end = z_begin + 1;
+                }
+                for (int t_z = z_begin / tile_size; t_z <= (z_end - 1) / tile_size; t_z++) {
+                    for (int t_y = y_begin / tile_size; t_y <= (y_end - 1) / tile_size; t_y++)
+                        wake_tile(t_y, t_z);
+                }
+            }
+        }
+
+        // Whether the peak of a tile's junctions exceeds the threshold in either time step, stopping at the first
+        // plane that does
+        [[nodiscard]] bool tile_exceeds(const kernels::kernel_set &kernels, const int t_y, const int t_z) const {
+            const int y_begin = t_y * tile_size, y_end = std::min(size_y, y_begin + tile_size);
+            for (int z = t_z * tile_size; z < std::min(size_z, (t_z + 1) * tile_size); z++) {
+                for (const storage *buffer: {p, p_aux}) {
+                    const storage *rows = buffer + junction_to_linearized(0, y_begin, z);
+                    if constexpr (std::is_same_v<storage, float>) {
+                        // The rows' padding is zero
+                        if (kernels.peak_abs(rows, (y_end - y_begin - 1) * row_stride + size_x) > sleep_threshold)
+                            return true;
+                    } else {
+                        for (int y = y_begin; y < y_end; y++) {
+                            kernels.load_float16(face_rows, rows + (y - y_begin) * row_stride, 1, size_x);
+                            if (kernels.peak_abs(face_rows, size_x) > sleep_threshold)
+                                return true;
+                        }
+                    }
+                }
+            }
+            return false;
+        }
+
+        // Resets the wall junctions of one side between two linearized coordinates
+        template<filters::boundary_filter filter>
+        void reset_walls(mesh_face<filter> &walls, const mesh_side side, const int begin, const int end) {
+            const std::vector<int> &index = wall_index[static_cast<int>(side)];
+            const auto first = std::lower_bound(index.begin(), index.end(), begin);
+            walls.reset(static_cast<int>(first - index.begin()),
+                        static_cast<int>(std::lower_bound(first, index.end(), end) - first));
+        }
+
+        // Zeroes a tile falling asleep, along with the boundaries of its rows, so that it is silent when it wakes up
+        void sleep_tile(const int t_y, const int t_z) {
+            const int y_begin = t_y * tile_size, y_end = std::min(size_y, y_begin + tile_size);
+            const int z_begin = t_z * tile_size, z_end = std::min(size_z, z_begin + tile_size);
+            const int rows = y_end - y_begin;
+            for (int z = z_begin; z < z_end; z++) {
+                const int begin = junction_to_linearized(0, y_begin, z), end = junction_to_linearized(0, y_end, z);
+                std::fill(p + begin, p + end, from_float<storage>(0.0f));
+                std::fill(p_aux + begin, p_aux + end, from_float<storage>(0.0f));
+                b_xp.reset(z * size_y + y_begin, rows);
+                b_xn.reset(z * size_y + y_begin, rows);
+                clear_ghosts(mesh_side::xp, z * size_y + y_begin, rows);
+                clear_ghosts(mesh_side::xn, z * size_y + y_begin, rows);
+                if (y_end == size_y) {
+                    b_yp.reset(z * size_x, size_x);
+                    clear_ghosts(mesh_side::yp, z * size_x, size_x);
+                }
+                if (y_begin == 0) {
+                    b_yn.reset(z * size_x, size_x);
+                    clear_ghosts(mesh_side::yn, z * size_x, size_x);
+                }
+                if (!solid.empty()) {
+                    reset_walls(w_xp, mesh_side::xp, begin, end);
+                    reset_walls(w_xn, mesh_side::xn, begin, end);
+                    reset_walls(w_yp, mesh_side::yp, begin, end);
+                    reset_walls(w_yn, mesh_side::yn, begin, end);
+                    reset_walls(w_zp, mesh_side::zp, begin, end);
+                    reset_walls(w_zn, mesh_side::zn, begin, end);
+                }
+            }
+            if (z_end == size_z) {
+                b_zp.reset(y_begin * size_x, rows * size_x);
+                clear_ghosts(mesh_side::zp, y_begin * size_x, rows * size_x);
+            }
+            if (z_begin == 0) {
+                b_zn.reset(y_begin * size_x, rows * size_x);
+                clear_ghosts(mesh_side::zn, y_begin * size_x, rows * size_x);
+            }
+        }
+
+        // Puts to sleep the tiles which are neither active (above the threshold during the hold time, or pinned by a
+        // loud source) nor next to an active one
+        void track_activity() {
+            activity_steps = 0;
+            const kernels::kernel_set &kernels = kernels::active();
+            for (int t_z = 0; t_z < tiles_z; t_z++) {
+                for (int t_y = 0; t_y < tiles_y; t_y++) {
+                    const int t = t_z * tiles_y + t_y;
+                    if (tile_awake[t] != 0 && tile_exceeds(kernels, t_y, t_z))
+                        tile_quiet[t] = 0;
+                    else
+                        tile_quiet[t] = std::min(tile_quiet[t] + 1, sleep_hold_checks);
+                    tile_active[t] = tile_pinned[t] != 0 || tile_quiet[t] < sleep_hold_checks;
+                }
+            }
+            awake_tiles = 0;
+            for (int t_z = 0; t_z < tiles_z; t_z++) {
+                for (int t_y = 0; t_y < tiles_y; t_y++) {
+                    bool awake = false;
+                    for (int n_z = std::max(0, t_z - 1); n_z <= std::min(tiles_z - 1, t_z + 1); n_z++) {
+                        for (int n_y = std::max(0, t_y - 1); n_y <= std::min(tiles_y - 1, t_y + 1); n_y++)
+                            awake = awake || tile_active[n_z * tiles_y + n_y] != 0;
+                    }
+                    uint8_t &tile = tile_awake[t_z * tiles_y + t_y];
+                    if (tile != 0 && !awake)
+                        sleep_tile(t_y, t_z);
+                    tile = awake;
+                    awake_tiles += awake;
+                }
+            }
+        }
+
+        // Position of a junction among the walls of one side of its z plane
+        [[nodiscard]] int walls_before(const mesh_side side, const int z, const int i) const {
+            const std::vector<int> &index = wall_index[static_cast<int>(side)];
+            const std::vector<int> &planes = wall_planes[static_cast<int>(side)];
+            const auto first = index.begin() + planes[z];
+            return static_cast<int>(std::lower_bound(first, index.begin() + planes[z + 1], i) - first);
+        }
+
     public:
         /// Builds a new instance\n
         /// The mesh's valid coordinates range from (0,0) to (width, height, depth)
-        explicit mesh_3d() {
+        /// @param max_workers maximum number of workers the update can be split into (see worker_pool)
+        /// @param pages pages backing the junctions, see arena
+        explicit mesh_3d(const int max_workers = 1, const page_mode pages = page_mode::transparent_huge) :
+            max_slabs(std::clamp(max_workers, 1, size_z)) {
             static_assert(width > 0 && "width must be greater than zero");
             static_assert(height > 0 && "height must be be greater than zero");
             static_assert(depth > 0 && "depth must be greater than zero");
             static_assert(sample_rate > 0 && "sample rate must be greater than zero");
 
-            // Allocate all buffers
-            p = new float[size_x * size_y * size_z];
-            p_aux = new float[size_x * size_y * size_z];
-            b_xp = new mesh_boundary<xp_filter, xp_filter_params>[size_y * size_z];
-            b_xn = new mesh_boundary<xn_filter, xn_filter_params>[size_y * size_z];
-            b_yp = new mesh_boundary<yp_filter, yp_filter_params>[size_x * size_z];
-            b_yn = new mesh_boundary<yn_filter, yn_filter_params>[size_x * size_z];
-            b_zp = new mesh_boundary<zp_filter, zp_filter_params>[size_x * size_y];
-            b_zn = new mesh_boundary<zn_filter, zn_filter_params>[size_x * size_y];
-            reset();
+            // Allocate all buffers from a single arena, p_aux starting half the set span after p so that the two
+            // streams of each junction do not compete for the same cache sets. The arena is already zeroed and left
+            // untouched until the first update, so that each worker's first write places its slab on its own node
+            constexpr size_t junction_bytes = sizeof(storage) * stored_junctions;
+            memory = arena(2 * arena::footprint(junction_bytes) +
+                           arena::footprint(sizeof(storage) * scratch_size * max_slabs) +
+                           arena::footprint(sizeof(float) * face_scratch_size * max_slabs), pages);
+            p = memory.carve<storage>(stored_junctions);
+            p_aux = memory.carve<storage>(stored_junctions, arena::set_span / 2);
+            rows = memory.carve<storage>(static_cast<size_t>(scratch_size) * max_slabs);
+            face_rows = memory.carve<float>(static_cast<size_t>(face_scratch_size) * max_slabs);
+            if (p == nullptr || p_aux == nullptr || rows == nullptr || face_rows == nullptr)
+                throw std::bad_alloc();
+            build_occupancy();
         }
 
+        /// @return the number of junctions of the mesh, solid ones included
+        [[nodiscard]] static constexpr int junction_count() { return size_x * size_y * size_z; }
+
+        /// @return the number of junctions along the x, y and z axes
+        [[nodiscard]] static constexpr std::array<int, 3> junction_dimensions() { return {size_x, size_y, size_z}; }
+
+        /// @return the pages actually backing the junctions, which may differ from the requested ones (see arena)
+        [[nodiscard]] page_mode pages() const { return memory.pages(); }
+
+        /// @return the number of air junctions updated at each sample step, which excludes the solid ones (see
+        /// set_occupancy)
+        [[nodiscard]] int air_junction_count() const { return air_junctions; }
+
+        /// @return the number of junction updates computed since the mesh was built, the solid and sleeping junctions
+        /// being skipped
+        [[nodiscard]] uint64_t junction_updates() const { return junction_updates_count; }
+
+        /// @return the number of junctions per meter, junction (x, y, z) lying at world coordinates
+        /// (x, y, z) / junction_density()
+        [[nodiscard]] static constexpr float junction_density() { return density; }
+
+        /// @return the number of sample steps the mesh is updated at per second
+        [[nodiscard]] static constexpr int step_rate() { return sample_rate; }
+
         /// Resets the mesh to the initial state
         void reset() {
-            std::fill_n(p, size_x * size_y * size_z, 0.0f);
-            std::fill_n(p_aux, size_x * size_y * size_z, 0.0f);
-            std::fill_n(b_xp, size_y * size_z, mesh_boundary<xp_filter, xp_filter_params>());
-            std::fill_n(b_xn, size_y * size_z, mesh_boundary<xn_filter, xn_filter_params>());
-            std::fill_n(b_yp, size_x * size_z, mesh_boundary<yp_filter, yp_filter_params>());
-            std::fill_n(b_yn, size_x * size_z, mesh_boundary<yn_filter, yn_filter_params>());
-            std::fill_n(b_zp, size_x * size_y, mesh_boundary<zp_filter, zp_filter_params>());
-            std::fill_n(b_zn, size_x * size_y, mesh_boundary<zn_filter, zn_filter_params>());
-        }
-
-        ~mesh_3d() {
-            delete[] p;
-            delete[] p_aux;
-            delete[] b_xp;
-            delete[] b_xn;
-            delete[] b_yp;
-            delete[] b_yn;
-            delete[] b_zp;
-            delete[] b_zn;
+            std::fill_n(p, stored_junctions, from_float<storage>(0.0f));
+            std::fill_n(p_aux, stored_junctions, from_float<storage>(0.0f));
+            b_xp.reset();
+            b_xn.reset();
+            b_yp.reset();
+            b_yn.reset();
+            b_zp.reset();
+            b_zn.reset();
+            w_xp.reset();
+            w_xn.reset();
+            w_yp.reset();
+            w_yn.reset();
+            w_zp.reset();
+            w_zn.reset();
+            std::fill(ghosts.begin(), ghosts.end(), 0.0f);
+            std::fill(tile_awake.begin(), tile_awake.end(), 1);
+            std::fill(tile_pinned.begin(), tile_pinned.end(), 0);
+            std::fill(tile_quiet.begin(), tile_quiet.end(), 0);
+            awake_tiles = tiles_y * tiles_z;
+            activity_steps = 0;
         }
+
+        ~mesh_3d() = default;
         // No copy constructor
         mesh_3d(const mesh_3d &other) = delete;
         // No copy assignment operator
@@ -263,11 +1087,59 @@ namespace dwm {
         /// @attention coordinates outside the ((0, width), (0, height), (0, depth))
         /// range are clamped at the edges
         [[nodiscard]] float read_value(const float x, const float y, const float z) const {
-            float px, py, pz;
-            int i000, i100, i010, i110, i001, i101, i011, i111;
-            compute_interpolation_parameters(x, y, z, px, py, pz, i000, i100, i010, i110, i001, i101, i011, i111);
-            return std::lerp(std::lerp(std::lerp(p[i000], p[i100], px), std::lerp(p[i010], p[i110], px), py),
-                             std::lerp(std::lerp(p[i001], p[i101], px), std::lerp(p[i011], p[i111], px), py), pz);
+            return interpolate(p, x, y, z);
+        }
+
+        /// Same as read_value, at the previous time step
+        [[nodiscard]] float read_previous_value(const float x, const float y, const float z) const {
+            return interpolate(p_aux, x, y, z);
+        }
+
+        /// @return the current value of a junction
+        /// @param x junction coordinate along x, from 0 to junction_dimensions()[0] - 1
+        /// @param y junction coordinate along y, from 0 to junction_dimensions()[1] - 1
+        /// @param z junction coordinate along z, from 0 to junction_dimensions()[2] - 1
+        [[nodiscard]] float junction_value(const int x, const int y, const int z) const {
+            return to_float(p[junction_to_linearized(x, y, z)]);
+        }
+
+        /// Overwrites the current value of a junction, waking its tile when the value exceeds the sleep threshold.
+        /// Solid junctions are left untouched
+        void set_junction_value(const int x, const int y, const int z, const float value) {
+            const int i = junction_to_linearized(x, y, z);
+            if (!solid.empty() && solid[i] != 0)
+                return;
+            if (sleep_threshold > 0.0f && std::abs(value) > sleep_threshold)
+                wake_junction(i);
+            p[i] = from_float<storage>(value);
+        }
+
+        /// Moves the junctions' values by whole junctions, as seen from a mesh moved by the same offset in the world:
+        /// junction (x, y, z) takes the values of junction (x + dx, y + dy, z + dz) in both time steps, and the
+        /// junctions left uncovered take fill(x, y, z, previous), previous telling the time step. The boundary
+        /// filters keep their state and all the tiles are woken up. Must not be called during an update
+        /// @param fill callable returning the value of an uncovered junction
+        template<typename function>
+        void shift(const int dx, const int dy, const int dz, function &&fill) {
+            const int offset = dz * plane_stride + dy * row_stride + dx;
+            for (storage *buffer: {p, p_aux}) {
+                const bool previous = buffer == p_aux;
+                // Junctions are moved in the order which reads each one before overwriting it
+                const int first = offset >= 0 ? 0 : junction_count() - 1, last = offset >= 0 ? junction_count() : -1;
+                for (int j = first; j != last; j += offset >= 0 ? 1 : -1) {
+                    const int x = j % size_x, y = j / size_x % size_y, z = j / (size_x * size_y);
+                    const int s_x = x + dx, s_y = y + dy, s_z = z + dz;
+                    const int i = junction_to_linearized(x, y, z);
+                    if (s_x >= 0 && s_x < size_x && s_y >= 0 && s_y < size_y && s_z >= 0 && s_z < size_z)
+                        buffer[i] = buffer[i + offset];
+                    else
+                        buffer[i] = from_float<storage>(fill(x, y, z, previous));
+                }
+            }
+            std::fill(ghosts.begin(), ghosts.end(), 0.0f);
+            std::fill(tile_awake.begin(), tile_awake.end(), 1);
+            std::fill(tile_quiet.begin(), tile_quiet.end(), 0);
+            awake_tiles = tiles_y * tiles_z;
         }
 
         /// Writes a value at the specified coordinates inside the mesh
@@ -282,14 +1154,91 @@ namespace dwm {
             float px, py, pz;
             int i000, i100, i010, i110, i001, i101, i011, i111;
             compute_interpolation_parameters(x, y, z, px, py, pz, i000, i100, i010, i110, i001, i101, i011, i111);
-            p[i000] = std::lerp(p[i000], value, (1 - px) * (1 - py) * (1 - pz));
-            p[i100] = std::lerp(p[i100], value, px * (1 - py) * (1 - pz));
-            p[i010] = std::lerp(p[i010], value, (1 - px) * py * (1 - pz));
-            p[i110] = std::lerp(p[i110], value, px * py * (1 - pz));
-            p[i001] = std::lerp(p[i001], value, (1 - px) * (1 - py) * pz);
-            p[i101] = std::lerp(p[i101], value, px * (1 - py) * pz);
-            p[i011] = std::lerp(p[i011], value, (1 - px) * py * pz);
-            p[i111] = std::lerp(p[i111], value, px * py * pz);
+            const auto blend = [this, value](const int i, const float weight) {
+                if (!solid.empty() && solid[i] != 0)
+                    return;
+                if (sleep_threshold > 0.0f && weight > 0.0f)
+                    wake_junction(i);
+                p[i] = from_float<storage>(std::lerp(to_float(p[i]), value, weight));
+            };
+            blend(i000, (1 - px) * (1 - py) * (1 - pz));
+            blend(i100, px * (1 - py) * (1 - pz));
+            blend(i010, (1 - px) * py * (1 - pz));
+            blend(i110, px * py * (1 - pz));
+            blend(i001, (1 - px) * (1 - py) * pz);
+            blend(i101, px * (1 - py) * pz);
+            blend(i011, (1 - px) * py * pz);
+            blend(i111, px * py * pz);
+        }
+
+        /// Couples a rectangle of a face to another mesh: the outer neighbours of its junctions take the given
+        /// values instead of the face's filter outputs, so that waves cross the face as if both meshes were one\n
+        /// The values are read at each update and must be refreshed before it (see read_face), temporal blocking
+        /// must thus be disabled or the mesh advanced with step_block. Junctions of interpolated meshes along the edges
+        /// of the face read their diagonal neighbours beyond both faces from their own mesh, so the coupling is only
+        /// approximate there
+        /// @param side face of the portal
+        /// @param u first junction along the face's u axis
+        /// @param v first junction along the face's v axis
+        /// @param u_size number of junctions along the face's u axis
+        /// @param v_size number of junctions along the face's v axis
+        /// @param incoming u_size * v_size values in u-major order, must outlive the portal
+        void add_portal(const mesh_side side, const int u, const int v, const int u_size, const int v_size,
+                        const float *incoming) {
+            portals.push_back({side, u, v, u_size, v_size, incoming});
+        }
+
+        /// Removes all the portals, the faces are entirely filtered again
+        void clear_portals() { portals.clear(); }
+
+        /// Marks the junctions lying in the solid voxels of an occupancy grid, which are then left out of the update:
+        /// each span of consecutive air junctions along x is updated at once, and the air junctions next to a solid
+        /// one are terminated by a boundary filtered like the mesh's face on the same side (e.g. by xp_filter with
+        /// the x+ parameters for a solid junction on their x+ side). In interpolated meshes solid junctions instead
+        /// reflect rigidly, reading as the value of their air neighbour\n
+        /// Sources and receivers are neither injected into nor read from solid junctions. Allocates and resets the
+        /// solid junctions, must not be called during an update
+        /// @param grid occupancy grid, sampled at the junctions' world coordinates
+        /// @param origin world coordinates of the mesh's (0, 0, 0) corner in the grid's space
+        void set_occupancy(const occupancy_grid &grid, const std::array<float, 3> &origin = {}) {
+            solid.assign(stored_junctions, 0);
+            bool any = false;
+            for (int z = 0; z < size_z; z++) {
+                for (int y = 0; y < size_y; y++) {
+                    for (int x = 0; x < size_x; x++) {
+                        const bool s = grid.solid_at(origin[0] + static_cast<float>(x) / density,
+                                                     origin[1] + static_cast<float>(y) / density,
+                                                     origin[2] + static_cast<float>(z) / density);
+                        solid[junction_to_linearized(x, y, z)] = s;
+                        any = any || s;
+                    }
+                }
+            }
+            if (!any)
+                solid.clear();
+            build_occupancy();
+        }
+
+        /// Marks all the junctions as air again
+        void clear_occupancy() {
+            solid.clear();
+            build_occupancy();
+        }
+
+        /// Copies the current values of a rectangle of a face's junctions, as expected by the portals of a mesh
+        /// placed against this face
+        /// @param side face to read
+        /// @param u first junction along the face's u axis
+        /// @param v first junction along the face's v axis
+        /// @param u_size number of junctions along the face's u axis
+        /// @param v_size number of junctions along the face's v axis
+        /// @param out u_size * v_size values in u-major order
+        void read_face(const mesh_side side, const int u, const int v, const int u_size, const int v_size,
+                       float *out) const {
+            for (int j = 0; j < v_size; j++) {
+                for (int k = 0; k < u_size; k++)
+                    out[j * u_size + k] = to_float(p[face_to_linearized(side, u + k, v + j)]);
+            }
         }
 
         /// Updates the mesh's simulation by one sample step
@@ -299,71 +1248,592 @@ namespace dwm {
         /// @param yn_params y- boundary filters parameters
         /// @param zp_params z+ boundary filters parameters
         /// @param zn_params z- boundary filters parameters
+        /// @param workers optional pool the update is split across, by slabs of z planes
         void update(const xp_filter_params &xp_params, const xn_filter_params &xn_params,
                     const yp_filter_params &yp_params, const yn_filter_params &yn_params,
-                    const zp_filter_params &zp_params, const zn_filter_params &zn_params) {
+                    const zp_filter_params &zp_params, const zn_filter_params &zn_params,
+                    worker_pool *workers = nullptr) {
             // At the start of an update, p_aux contains the (z - 1) timestep values
             // During the update loop, each (z - 1) timestep value is read and
             // overwritten with the (z + 1) value
 
-            // The junctions and boundaries are scanned linearly as they are laid out in
-            // memory, and the various edge cases are unrolled
-
-            int i = 0, i_xp = 0, i_xn = 0, i_yp = 0, i_yn = 0, i_zp = 0, i_zn = 0;
-
-#define UPDATE(XP, XN, YP, YN, ZP, ZN)                                                                                 \
-    p_aux[i] = (XP + XN + YP + YN + ZP + ZN) / 3.0f - p_aux[i];                                                        \
-    i++;
-
-#define XP_INTERNAL p[i + 1]
-#define XN_INTERNAL p[i - 1]
-#define XP_BOUNDARY b_xp[i_xp++].update(xp_params, p[i])
-#define XN_BOUNDARY b_xn[i_xn++].update(xn_params, p[i])
-#define EDGE_MACRO_X(YP, YN, ZP, ZN)                                                                                   \
-    UPDATE(XP_INTERNAL, XN_BOUNDARY, YP, YN, ZP, ZN)                                                                   \
-    for (int x = 1; x < size_x - 1; x++) {                                                                             \
-        UPDATE(XP_INTERNAL, XN_INTERNAL, YP, YN, ZP, ZN)                                                               \
-    }                                                                                                                  \
-    UPDATE(XP_BOUNDARY, XN_INTERNAL, YP, YN, ZP, ZN)
-
-#define YP_INTERNAL p[i + size_x]
-#define YN_INTERNAL p[i - size_x]
-#define YP_BOUNDARY b_yp[i_yp++].update(yp_params, p[i])
-#define YN_BOUNDARY b_yn[i_yn++].update(yn_params, p[i])
-#define EDGE_MACRO_Y(ZP, ZN)                                                                                           \
-    EDGE_MACRO_X(YP_INTERNAL, YN_BOUNDARY, ZP, ZN)                                                                     \
-    for (int y = 1; y < size_y - 1; y++) {                                                                             \
-        EDGE_MACRO_X(YP_INTERNAL, YN_INTERNAL, ZP, ZN)                                                                 \
-    }                                                                                                                  \
-    EDGE_MACRO_X(YP_BOUNDARY, YN_INTERNAL, ZP, ZN)
-
-#define ZP_INTERNAL p[i + size_x * size_y]
-#define ZN_INTERNAL p[i - size_x * size_y]
-#define ZP_BOUNDARY b_zp[i_zp++].update(zp_params, p[i])
-#define ZN_BOUNDARY b_zn[i_zn++].update(zn_params, p[i])
-            EDGE_MACRO_Y(ZP_INTERNAL, ZN_BOUNDARY)
-            for (int z = 1; z < size_z - 1; z++) {
-                EDGE_MACRO_Y(ZP_INTERNAL, ZN_INTERNAL)
-            }
-            EDGE_MACRO_Y(ZP_BOUNDARY, ZN_INTERNAL)
-
-#undef UPDATE
-#undef XP_INTERNAL
-#undef XN_INTERNAL
-#undef XP_BOUNDARY
-#undef XN_BOUNDARY
-#undef EDGE_MACRO_X
-#undef YP_INTERNAL
-#undef YN_INTERNAL
-#undef YP_BOUNDARY
-#undef YN_BOUNDARY
-#undef EDGE_MACRO_Y
-#undef ZP_INTERNAL
-#undef ZN_INTERNAL
-#undef ZP_BOUNDARY
-#undef ZN_BOUNDARY
+            const kernels::kernel_set &kernels = kernels::active();
+            const bool sleeping = sleep_threshold > 0.0f;
+            if (sleeping) {
+                wake_portals(kernels);
+                if (awake_tiles == 0)
+                    return; // The whole mesh is silent, both buffers are zero
+            }
+            junction_updates_count += updated_junctions();
+
+            // Each slab only reads p (including the halo planes of the neighbouring slabs, which are not modified
+            // during the update) and only writes its own planes of p_aux and its own boundaries, so slabs are
+            // independent until the buffer swap, which happens after all the workers are done
+            update_job job{this, &kernels, &xp_params, &xn_params, &yp_params, &yn_params, &zp_params, &zn_params};
+            const bool parallel = workers != nullptr && max_slabs > 1;
+            if constexpr (interpolated) {
+                // Planes read the boundary outputs of their neighbouring planes, which are all filtered beforehand
+                if (parallel)
+                    workers->run(update_ghost_slab, &job, max_slabs);
+                else
+                    update_ghost_slab(&job, 0, 1);
+            }
+            if (parallel)
+                workers->run(update_slab, &job, max_slabs);
+            else
+                update_slab(&job, 0, 1);
 
             std::swap(p, p_aux); // Current <-> previous buffer swap
+            if (sleeping && ++activity_steps >= tile_size)
+                track_activity();
+        }
+
+        /// Sets the peak value below which regions of the mesh fall asleep: the mesh is split in tiles of x-rows,
+        /// whose peak is checked every few steps, and tiles which stayed below the threshold for the hold time, and
+        /// whose neighbours did too, are zeroed and left out of the update until a source, a portal or an awake
+        /// neighbour pushes energy into them. Once all the tiles sleep, updates return immediately\n
+        /// The hold time must span the period of the lowest modes of the mesh, whose pressure peak vanishes at each
+        /// zero crossing. Sources whose block stays below the threshold are not injected into sleeping tiles
+        /// @param threshold peak value, 0 to update the whole mesh at every step
+        /// @param hold_steps number of steps a tile must stay below the threshold for, 100ms by default
+        void set_sleep_threshold(const float threshold, const int hold_steps = sample_rate / 10) {
+            const int hold_checks = std::max(1, (hold_steps + tile_size - 1) / tile_size);
+            if (std::max(0.0f, threshold) == sleep_threshold && hold_checks == sleep_hold_checks)
+                return;
+            sleep_threshold = std::max(0.0f, threshold);
+            sleep_hold_checks = hold_checks;
+            std::fill(tile_awake.begin(), tile_awake.end(), 1);
+            std::fill(tile_pinned.begin(), tile_pinned.end(), 0);
+            std::fill(tile_quiet.begin(), tile_quiet.end(), 0);
+            awake_tiles = tiles_y * tiles_z;
+            activity_steps = 0;
+        }
+
+        /// @return the peak value below which regions of the mesh fall asleep, 0 when disabled
+        [[nodiscard]] float get_sleep_threshold() const { return sleep_threshold; }
+
+        /// @return whether all the tiles of the mesh sleep, updates then return immediately
+        [[nodiscard]] bool asleep() const { return sleep_threshold > 0.0f && awake_tiles == 0; }
+
+        /// @return the fraction of the mesh's tiles currently updated, 1 when sleeping is disabled
+        [[nodiscard]] float awake_fraction() const {
+            return sleep_threshold > 0.0f ? static_cast<float>(awake_tiles) / static_cast<float>(tiles_y * tiles_z)
+                                          : 1.0f;
+        }
+
+        /// Sets how many time steps update_block advances per pass over the mesh (temporal blocking)
+        /// @param steps number of time steps, 1 to disable temporal blocking, 0 to choose it from the mesh size
+        void set_temporal_blocking_depth(const int steps) { blocking_depth = std::max(0, steps); }
+
+        /// @return the number of time steps update_block advances per pass over the mesh
+        [[nodiscard]] int temporal_blocking_depth() const {
+            if (blocking_depth > 0)
+                return blocking_depth;
+            // Meshes whose buffers already fit in a typical 1MiB L2 cache gain nothing from temporal blocking,
+            // otherwise each pass keeps (depth + 2) planes of both buffers hot
+            constexpr long long cache_bytes = 1 << 20;
+            constexpr long long plane_bytes = static_cast<long long>(sizeof(float)) * plane_stride;
+            if (2 * plane_bytes * size_z <= cache_bytes)
+                return 1;
+            return static_cast<int>(std::clamp(cache_bytes / (2 * plane_bytes) - 2, 1LL, 16LL));
+        }
+
+        /// Preallocates the per block state, so that update_block does not allocate with up to the given number of
+        /// sources and receivers (and up to the current temporal blocking depth)
+        void reserve_block(const int sources, const int receivers) {
+            // Moving sources and receivers touch up to 16 junctions
+            const size_t steps = std::max(chunk_steps, temporal_blocking_depth());
+            source_taps.reserve(16 * static_cast<size_t>(sources));
+            injection_index.reserve(16 * static_cast<size_t>(sources));
+            injection_taps.reserve(16 * static_cast<size_t>(sources) + 1);
+            injection_planes.reserve(size_z + 1);
+            injection_a.reserve(16 * static_cast<size_t>(sources) * steps);
+            injection_b.reserve(16 * static_cast<size_t>(sources) * steps);
+            receiver_taps.reserve(16 * static_cast<size_t>(receivers));
+            receiver_index.reserve(16 * static_cast<size_t>(receivers));
+            receiver_planes.reserve(size_z + 1);
+            receiver_weights.reserve(16 * static_cast<size_t>(receivers) * steps);
+            receiver_values.reserve(16 * static_cast<size_t>(receivers));
+        }
+
+        /// Starts a block of sample steps, each advanced by a call to step_block: same as update_block without
+        /// temporal blocking, for meshes which must be advanced in lockstep with others (see add_portal)
+        /// @param steps number of sample steps of the block
+        /// @param sources sources injected at each step, in order, must outlive the block
+        /// @param source_count number of sources
+        /// @param receivers points sampled at each step, must outlive the block
+        /// @param receiver_count number of receivers
+        void begin_block(const int steps, const block_source *sources, const int source_count,
+                         const block_receiver *receivers, const int receiver_count) {
+            block_sources = sources;
+            block_receivers = receivers;
+            block_steps = std::max(0, steps);
+            block_step = 0;
+            if (block_steps == 0)
+                return;
+
+            prepare_block(block_steps, sources, source_count, receivers, receiver_count);
+
+            // Receivers are accumulated plane by plane
+            for (int r = 0; r < receiver_count; r++) {
+                for (int n = 0; n < steps; n++)
+                    receivers[r].samples[n * receivers[r].stride] = 0.0f;
+            }
+
+            // The first step's sources are injected before any plane is updated
+            prepare_injection(sources, steps, 0, 1);
+            apply_injection(kernels::active(), p, 0, 0, size_z);
+        }
+
+        /// Advances the block started by begin_block by one sample step, does nothing once all of them are done
+        /// @param workers optional pool the update is split across
+        void step_block(const xp_filter_params &xp_params, const xn_filter_params &xn_params,
+                        const yp_filter_params &yp_params, const yn_filter_params &yn_params,
+                        const zp_filter_params &zp_params, const zn_filter_params &zn_params,
+                        worker_pool *workers = nullptr) {
+            if (block_step >= block_steps)
+                return;
+            const kernels::kernel_set &kernels = kernels::active();
+            const int n = block_step++;
+            const int t = n % chunk_steps;
+            if (t == 0) {
+                const int pass_steps = std::min(chunk_steps, block_steps - n);
+                prepare_receivers(block_steps, n, pass_steps);
+                prepare_injection(block_sources, block_steps, n + 1, std::min(pass_steps, block_steps - n - 1));
+            }
+            update(xp_params, xn_params, yp_params, yn_params, zp_params, zn_params, workers);
+            apply_receivers(kernels, p, block_receivers, n, t, 0, size_z);
+            if (n + 1 < block_steps)
+                apply_injection(kernels, p, t, 0, size_z);
+        }
+
+        /// Updates the mesh's simulation by a block of sample steps, equivalent to calling write_value for each
+        /// source, update and read_value for each receiver at every sample step, but the sources and receivers
+        /// interpolation stencils are only computed once per block (and linearly cross-faded for moving ones), while
+        /// the sources touching the same junctions are merged into a single update per junction\n
+        /// Without workers the mesh is advanced several time steps per pass (temporal blocking): planes are updated
+        /// along a wavefront skewed by one plane per time step, so that each plane is updated multiple times while
+        /// it is still in cache, with the sources injected and the receivers sampled as soon as the planes they
+        /// touch reach the right time step
+        /// @param steps number of sample steps of the block
+        /// @param sources sources injected at each step, in order
+        /// @param source_count number of sources
+        /// @param receivers points sampled at each step
+        /// @param receiver_count number of receivers
+        /// @param workers optional pool each update is split across, disables temporal blocking (as do portals)
+        void update_block(const xp_filter_params &xp_params, const xn_filter_params &xn_params,
+                          const yp_filter_params &yp_params, const yn_filter_params &yn_params,
+                          const zp_filter_params &zp_params, const zn_filter_params &zn_params, const int steps,
+                          const block_source *sources, const int source_count, const block_receiver *receivers,
+                          const int receiver_count, worker_pool *workers = nullptr) {
+            begin_block(steps, sources, source_count, receivers, receiver_count);
+            if (steps <= 0)
+                return;
+            const bool sleeping = sleep_threshold > 0.0f;
+            if (sleeping && awake_tiles == 0 && portals.empty()) {
+                block_step = steps; // Nothing to update nor to inject, the receivers are already zeroed
+                return;
+            }
+
+            // Activity is checked after each pass, which must not be longer than a tile
+            const int pass_depth = sleeping ? std::min(temporal_blocking_depth(), tile_size)
+                                            : temporal_blocking_depth();
+            const bool blocked = (workers == nullptr || workers->worker_count() == 1 || max_slabs == 1) &&
+                                 pass_depth > 1 && portals.empty();
+            if (!blocked) {
+                for (int n = 0; n < steps; n++)
+                    step_block(xp_params, xn_params, yp_params, yn_params, zp_params, zn_params, workers);
+                return;
+            }
+
+            const kernels::kernel_set &kernels = kernels::active();
+            for (int first = 0; first < steps; first += pass_depth) {
+                const int pass_steps = std::min(pass_depth, steps - first);
+                junction_updates_count += static_cast<uint64_t>(pass_steps) * updated_junctions();
+                prepare_receivers(steps, first, pass_steps);
+                prepare_injection(sources, steps, first + 1, std::min(pass_steps, steps - first - 1));
+
+                // Wavefront k updates plane (k - t) at time step t, planes of the previous time step are always
+                // updated before the ones of the next time step that depend on them
+                for (int k = 0; k < size_z + pass_steps - 1; k++) {
+                    for (int t = std::max(0, k - size_z + 1); t < pass_steps && t <= k; t++) {
+                        const int z = k - t;
+                        const int n = first + t;
+                        // Even steps read p and write p_aux, odd steps the opposite
+                        const storage *current = t % 2 == 0 ? p : p_aux;
+                        storage *next = t % 2 == 0 ? p_aux : p;
+                        if constexpr (interpolated) {
+                            // The boundary outputs of a plane are filtered once it reaches time step t, before the
+                            // first plane reading them (its z- neighbour) is updated
+                            if (z == 0)
+                                update_ghosts(z, current, xp_params, xn_params, yp_params, yn_params, zp_params,
+                                              zn_params);
+                            if (z + 1 < size_z)
+                                update_ghosts(z + 1, current, xp_params, xn_params, yp_params, yn_params, zp_params,
+                                              zn_params);
+                        }
+                        update_plane(kernels, rows, face_rows, wall_rows.data(), z, current, next, xp_params,
+                                     xn_params, yp_params, yn_params, zp_params, zn_params);
+
+                        // The receivers read this plane before the next step's sources are written into it
+                        apply_receivers(kernels, next, receivers, n, t, z, z + 1);
+                        if (n + 1 < steps)
+                            apply_injection(kernels, next, t, z, z + 1);
+                    }
+                }
+
+                if (pass_steps % 2 == 1)
+                    std::swap(p, p_aux); // Current <-> previous buffer swap
+                if (sleeping) {
+                    track_activity();
+                    if (awake_tiles == 0)
+                        break; // Fell silent, the remaining sources are below the threshold
+                }
+            }
+            block_step = steps;
+        }
+
+    private:
+        // Arguments of an update shared by all the workers
+        struct update_job {
+            mesh_3d *mesh;
+            const kernels::kernel_set *kernels;
+            const xp_filter_params *xp_params;
+            const xn_filter_params *xn_params;
+            const yp_filter_params *yp_params;
+            const yn_filter_params *yn_params;
+            const zp_filter_params *zp_params;
+            const zn_filter_params *zn_params;
+        };
+
+        // Updates the slab of z planes assigned to a worker
+        static void update_slab(void *context, const int worker, const int worker_count) {
+            const auto *job = static_cast<const update_job *>(context);
+            mesh_3d *mesh = job->mesh;
+            storage *scratch = mesh->rows + scratch_size * worker;
+            float *face_scratch = mesh->face_rows + face_scratch_size * worker;
+            float *wall_scratch = mesh->wall_rows.data() + static_cast<size_t>(mesh->wall_scratch_size) * worker;
+            const int z_begin = size_z * worker / worker_count;
+            const int z_end = size_z * (worker + 1) / worker_count;
+            for (int z = z_begin; z < z_end; z++)
+                mesh->update_plane(*job->kernels, scratch, face_scratch, wall_scratch, z, mesh->p, mesh->p_aux,
+                                   *job->xp_params, *job->xn_params, *job->yp_params, *job->yn_params,
+                                   *job->zp_params, *job->zn_params);
+        }
+
+        // Filters the boundary outputs of the slab of z planes assigned to a worker, see update_ghosts
+        static void update_ghost_slab(void *context, const int worker, const int worker_count) {
+            const auto *job = static_cast<const update_job *>(context);
+            mesh_3d *mesh = job->mesh;
+            const int z_begin = size_z * worker / worker_count;
+            const int z_end = size_z * (worker + 1) / worker_count;
+            for (int z = z_begin; z < z_end; z++)
+                mesh->update_ghosts(z, mesh->p, *job->xp_params, *job->xn_params, *job->yp_params, *job->yn_params,
+                                    *job->zp_params, *job->zn_params);
+        }
+
+        // Updates n junctions of a face, reading their incoming values every stride values
+        // Half precision values are converted by the kernels to and from single precision copies, so that the face
+        // update itself is the same vectorized loop for both storage formats
+        template<filters::boundary_filter filter>
+        static void update_face(const kernels::kernel_set &kernels, float *face_scratch, mesh_face<filter> &face,
+                                const typename filter::parameters &params, const int first, const storage *incoming,
+                                const int stride, storage *outgoing, const int n) {
+            if constexpr (std::is_same_v<storage, float>) {
+                face.update(params, first, incoming, stride, outgoing, n);
+            } else {
+                float *incoming_copy = face_scratch, *outgoing_copy = face_scratch + face_scratch_size / 2;
+                kernels.load_float16(incoming_copy, incoming, stride, n);
+                face.update(params, first, incoming_copy, 1, outgoing_copy, n);
+                kernels.store_float16(outgoing, outgoing_copy, n);
+            }
+        }
+
+        // Filters the wall junctions of a z plane on one side into outgoing, gathering their values from current
+        template<filters::boundary_filter filter>
+        void update_walls(mesh_face<filter> &walls, const typename filter::parameters &params, const mesh_side side,
+                          const int z, const storage *current, float *incoming, float *outgoing) {
+            const std::vector<int> &planes = wall_planes[static_cast<int>(side)];
+            const int first = planes[z], n = planes[z + 1] - first;
+            const int *index = wall_index[static_cast<int>(side)].data() + first;
+            for (int j = 0; j < n; j++)
+                incoming[j] = to_float(current[index[j]]);
+            walls.update(params, first, incoming, 1, outgoing, n);
+        }
+
+        // Adds to the wall junctions of a z plane on one side the contribution of their boundary, which the row
+        // kernels read as zero from the solid neighbour
+        void apply_walls(const mesh_side side, const int z, const float *outgoing, storage *next) const {
+            const std::vector<int> &planes = wall_planes[static_cast<int>(side)];
+            const int *index = wall_index[static_cast<int>(side)].data() + planes[z];
+            for (int j = 0; j < planes[z + 1] - planes[z]; j++)
+                next[index[j]] = from_float<storage>(to_float(next[index[j]]) + outgoing[j] / 3.0f);
+        }
+
+        // Filters the face junctions of a z plane of an interpolated mesh into the ghosts of current's time step, the
+        // faces being skipped for solid and sleeping rows like in update_plane
+        void update_ghosts(const int z, const storage *current, const xp_filter_params &xp_params,
+                           const xn_filter_params &xn_params, const yp_filter_params &yp_params,
+                           const yn_filter_params &yn_params, const zp_filter_params &zp_params,
+                           const zn_filter_params &zn_params) {
+            if (row_spans[z * size_y] == row_spans[(z + 1) * size_y])
+                return; // Entirely solid, the ghosts stay zero
+            const uint8_t *awake = nullptr;
+            if (sleep_threshold > 0.0f) {
+                awake = tile_awake.data() + z / tile_size * tiles_y;
+                if (std::find(awake, awake + tiles_y, 1) == awake + tiles_y)
+                    return; // Entirely asleep, the ghosts were zeroed with the tiles
+            }
+            const int slot = current == p ? 0 : 1;
+            const bool coupled = !portals.empty();
+
+            const float *plane = current + junction_to_linearized(0, 0, z);
+            float *col_xp = ghost_face(mesh_side::xp, slot) + z * size_y;
+            float *col_xn = ghost_face(mesh_side::xn, slot) + z * size_y;
+            const auto [xp_first, xp_end, xn_first, xn_end] = face_x_rows[z];
+            if (xp_first < xp_end)
+                b_xp.update(xp_params, z * size_y + xp_first, plane + xp_first * row_stride + size_x - 1, row_stride,
+                            col_xp + xp_first, xp_end - xp_first);
+            if (xn_first < xn_end)
+                b_xn.update(xn_params, z * size_y + xn_first, plane + xn_first * row_stride, row_stride,
+                            col_xn + xn_first, xn_end - xn_first);
+            if (coupled) {
+                apply_portals(mesh_side::xp, z, col_xp);
+                apply_portals(mesh_side::xn, z, col_xn);
+            }
+
+            for (int y = 0; y < size_y; y++) {
+                if (y > 0 && y < size_y - 1 && z > 0 && z < size_z - 1)
+                    y = size_y - 1; // Only the first and last rows lie on the y faces
+                if (row_spans[z * size_y + y] == row_spans[z * size_y + y + 1] ||
+                    (awake != nullptr && awake[y / tile_size] == 0))
+                    continue;
+                const float *c = plane + y * row_stride;
+                if (y == size_y - 1) {
+                    float *row = ghost_face(mesh_side::yp, slot) + z * size_x;
+                    b_yp.update(yp_params, z * size_x, c, 1, row, size_x);
+                    if (coupled)
+                        apply_portals(mesh_side::yp, z, row);
+                }
+                if (y == 0) {
+                    float *row = ghost_face(mesh_side::yn, slot) + z * size_x;
+                    b_yn.update(yn_params, z * size_x, c, 1, row, size_x);
+                    if (coupled)
+                        apply_portals(mesh_side::yn, z, row);
+                }
+                if (z == size_z - 1) {
+                    float *row = ghost_face(mesh_side::zp, slot) + y * size_x;
+                    b_zp.update(zp_params, y * size_x, c, 1, row, size_x);
+                    if (coupled)
+                        apply_portals(mesh_side::zp, y, row);
+                }
+                if (z == 0) {
+                    float *row = ghost_face(mesh_side::zn, slot) + y * size_x;
+                    b_zn.update(zn_params, y * size_x, c, 1, row, size_x);
+                    if (coupled)
+                        apply_portals(mesh_side::zn, y, row);
+                }
+            }
+        }
+
+        // Updates all the air junctions of a z plane of an interpolated mesh, reading from current and the ghosts of
+        // its time step (see update_ghosts) and overwriting next
+        // Each span of air junctions of each x-row is updated by the vectorized kernel from the 3x3 rows around it:
+        // rows beyond one face are its ghosts, rows beyond two faces (along the mesh's edges) read as the row itself,
+        // and the x neighbours of the span ends are summed beforehand, beyond the x faces from their ghosts
+        void update_interpolated_plane(const kernels::kernel_set &kernels, float *scratch, const int z,
+                                       const float *current, float *next) const {
+            const uint8_t *awake = sleep_threshold > 0.0f ? tile_awake.data() + z / tile_size * tiles_y : nullptr;
+            const int slot = current == p ? 0 : 1;
+            const float *ghost_xp = ghost_face(mesh_side::xp, slot), *ghost_xn = ghost_face(mesh_side::xn, slot);
+            const float *ghost_yp = ghost_face(mesh_side::yp, slot), *ghost_yn = ghost_face(mesh_side::yn, slot);
+            const float *ghost_zp = ghost_face(mesh_side::zp, slot), *ghost_zn = ghost_face(mesh_side::zn, slot);
+            // Weights of the 3x3 rows, (2 - |dy|) * (2 - |dz|) / 16, in the kernel's order
+            constexpr float row_weights[9] = {1.0f / 16, 2.0f / 16, 1.0f / 16, 2.0f / 16, 4.0f / 16,
+                                              2.0f / 16, 1.0f / 16, 2.0f / 16, 1.0f / 16};
+            constexpr float weight = topology::courant_squared / 16.0f;
+            constexpr float center = 2.0f - 4.0f * topology::courant_squared;
+
+            for (int y = 0; y < size_y; y++) {
+                const int i = junction_to_linearized(0, y, z);
+                const int spans_begin = row_spans[z * size_y + y], spans_end = row_spans[z * size_y + y + 1];
+                if (spans_begin == spans_end || (awake != nullptr && awake[y / tile_size] == 0))
+                    continue; // Entirely solid or asleep
+
+                const float *rows[9];
+                float face_xn = 0.0f, face_xp = 0.0f;
+                for (int dz = -1; dz <= 1; dz++) {
+                    for (int dy = -1; dy <= 1; dy++) {
+                        const int k = (dz + 1) * 3 + dy + 1, n_y = y + dy, n_z = z + dz;
+                        const bool inside_y = n_y >= 0 && n_y < size_y, inside_z = n_z >= 0 && n_z < size_z;
+                        if (inside_y && inside_z) {
+                            rows[k] = current + junction_to_linearized(0, n_y, n_z);
+                            face_xn += row_weights[k] * ghost_xn[n_z * size_y + n_y];
+                            face_xp += row_weights[k] * ghost_xp[n_z * size_y + n_y];
+                            continue;
+                        }
+                        if (inside_z)
+                            rows[k] = (dy > 0 ? ghost_yp : ghost_yn) + n_z * size_x;
+                        else if (inside_y)
+                            rows[k] = (dz > 0 ? ghost_zp : ghost_zn) + n_y * size_x;
+                        else
+                            rows[k] = current + i;
+                        // Beyond an x face as well, read as the nearest junction
+                        const float *edge = current + junction_to_linearized(0, std::clamp(n_y, 0, size_y - 1),
+                                                                             std::clamp(n_z, 0, size_z - 1));
+                        face_xn += row_weights[k] * edge[0];
+                        face_xp += row_weights[k] * edge[size_x - 1];
+                    }
+                }
+
+                for (int s = spans_begin; s < spans_end; s++) {
+                    const int a = span_begin[s], b = span_end[s];
+                    // Spans which do not reach the faces start and end at solid junctions, whose neighbouring rows
+                    // may be air
+                    float xn = a == 0 ? face_xn : 0.0f, xp = b == size_x ? face_xp : 0.0f;
+                    const float *span_rows[9];
+                    for (int k = 0; k < 9; k++) {
+                        span_rows[k] = rows[k] + a;
+                        if (a > 0)
+                            xn += row_weights[k] * rows[k][a - 1];
+                        if (b < size_x)
+                            xp += row_weights[k] * rows[k][b];
+                    }
+                    kernels.update_row_interpolated(next + i + a, span_rows, scratch, b - a, xn, xp, weight, center);
+                }
+            }
+
+            if (!solid.empty()) {
+                for (int j = rigid_planes[z]; j < rigid_planes[z + 1]; j++)
+                    next[rigid_index[j]] += rigid_weight[j] * current[rigid_index[j]];
+            }
+        }
+
+        // Updates all the air junctions of a z plane, reading from current and overwriting next
+        // The boundary outputs of the plane are computed first in the scratch rows, then each span of air junctions
+        // of each x-row is updated by the vectorized kernel, so that only the x boundaries are handled one junction
+        // at a time
+        void update_plane(const kernels::kernel_set &kernels, storage *scratch, float *face_scratch,
+                          float *wall_scratch, const int z, const storage *current, storage *next,
+                          const xp_filter_params &xp_params, const xn_filter_params &xn_params,
+                          const yp_filter_params &yp_params, const yn_filter_params &yn_params,
+                          const zp_filter_params &zp_params, const zn_filter_params &zn_params) {
+            if (row_spans[z * size_y] == row_spans[(z + 1) * size_y])
+                return; // Entirely solid, and thus without walls either
+            const uint8_t *awake = nullptr;
+            if (sleep_threshold > 0.0f) {
+                awake = tile_awake.data() + z / tile_size * tiles_y;
+                if (std::find(awake, awake + tiles_y, 1) == awake + tiles_y)
+                    return; // Entirely asleep, boundaries included
+            }
+            if constexpr (interpolated) {
+                update_interpolated_plane(kernels, scratch, z, current, next);
+                return;
+            }
+            storage *row_yp = scratch, *row_yn = scratch + size_x;
+            storage *row_zp = scratch + 2 * size_x, *row_zn = scratch + 3 * size_x;
+            storage *col_xp = scratch + 4 * size_x, *col_xn = col_xp + size_y;
+
+            // The walls around solid junctions, whose x boundaries are read as the ends of the spans
+            const bool occupied = !solid.empty();
+            const int wall_size = wall_scratch_size / 7;
+            float *wall_out[6] = {};
+            if (occupied) {
+                for (int side = 0; side < 6; side++)
+                    wall_out[side] = wall_scratch + (side + 1) * wall_size;
+                update_walls(w_xp, xp_params, mesh_side::xp, z, current, wall_scratch, wall_out[0]);
+                update_walls(w_xn, xn_params, mesh_side::xn, z, current, wall_scratch, wall_out[1]);
+                update_walls(w_yp, yp_params, mesh_side::yp, z, current, wall_scratch, wall_out[2]);
+                update_walls(w_yn, yn_params, mesh_side::yn, z, current, wall_scratch, wall_out[3]);
+                update_walls(w_zp, zp_params, mesh_side::zp, z, current, wall_scratch, wall_out[4]);
+                update_walls(w_zn, zn_params, mesh_side::zn, z, current, wall_scratch, wall_out[5]);
+            }
+            const float *wall_xp = wall_out[0], *wall_xn = wall_out[1];
+
+            // The x boundaries of the whole plane at once, reading the first and last junction of each x-row (between
+            // the first and last rows where they are air)
+            const storage *plane = current + junction_to_linearized(0, 0, z);
+            const auto [xp_first, xp_end, xn_first, xn_end] = face_x_rows[z];
+            if (xp_first < xp_end)
+                update_face(kernels, face_scratch, b_xp, xp_params, z * size_y + xp_first,
+                            plane + xp_first * row_stride + size_x - 1, row_stride, col_xp + xp_first,
+                            xp_end - xp_first);
+            if (xn_first < xn_end)
+                update_face(kernels, face_scratch, b_xn, xn_params, z * size_y + xn_first,
+                            plane + xn_first * row_stride, row_stride, col_xn + xn_first, xn_end - xn_first);
+            const bool coupled = !portals.empty();
+            if (coupled) {
+                apply_portals(mesh_side::xp, z, col_xp);
+                apply_portals(mesh_side::xn, z, col_xn);
+            }
+
+            bool skipped = false; // Whether the walls of sleeping rows were skipped since the last awake row
+            for (int y = 0; y < size_y; y++) {
+                const int i = junction_to_linearized(0, y, z);
+                const int spans_begin = row_spans[z * size_y + y], spans_end = row_spans[z * size_y + y + 1];
+                if (spans_begin == spans_end)
+                    continue; // Entirely solid
+                if (awake != nullptr && awake[y / tile_size] == 0) {
+                    // Asleep, the walls and boundaries of sleeping rows are zero and stay so
+                    skipped = occupied;
+                    continue;
+                }
+                if (skipped) {
+                    wall_xp = wall_out[0] + walls_before(mesh_side::xp, z, i);
+                    wall_xn = wall_out[1] + walls_before(mesh_side::xn, z, i);
+                    skipped = false;
+                }
+                const storage *c = current + i;
+
+                const storage *yp = c + row_stride;
+                if (y == size_y - 1) {
+                    update_face(kernels, face_scratch, b_yp, yp_params, z * size_x, c, 1, row_yp, size_x);
+                    if (coupled)
+                        apply_portals(mesh_side::yp, z, row_yp);
+                    yp = row_yp;
+                }
+                const storage *yn = c - row_stride;
+                if (y == 0) {
+                    update_face(kernels, face_scratch, b_yn, yn_params, z * size_x, c, 1, row_yn, size_x);
+                    if (coupled)
+                        apply_portals(mesh_side::yn, z, row_yn);
+                    yn = row_yn;
+                }
+                const storage *zp = c + plane_stride;
+                if (z == size_z - 1) {
+                    update_face(kernels, face_scratch, b_zp, zp_params, y * size_x, c, 1, row_zp, size_x);
+                    if (coupled)
+                        apply_portals(mesh_side::zp, y, row_zp);
+                    zp = row_zp;
+                }
+                const storage *zn = c - plane_stride;
+                if (z == 0) {
+                    update_face(kernels, face_scratch, b_zn, zn_params, y * size_x, c, 1, row_zn, size_x);
+                    if (coupled)
+                        apply_portals(mesh_side::zn, y, row_zn);
+                    zn = row_zn;
+                }
+
+                const float face_xn = to_float(col_xn[y]), face_xp = to_float(col_xp[y]);
+                for (int s = spans_begin; s < spans_end; s++) {
+                    const int a = span_begin[s], b = span_end[s];
+                    // Spans which do not reach the faces start and end at walls, in the same order
+                    const float xn = a == 0 ? face_xn : *wall_xn++;
+                    const float xp = b == size_x ? face_xp : *wall_xp++;
+                    if constexpr (std::is_same_v<storage, float>)
+                        kernels.update_row(next + i + a, c + a, yp + a, yn + a, zp + a, zn + a, b - a, xn, xp);
+                    else
+                        kernels.update_row_float16(next + i + a, c + a, yp + a, yn + a, zp + a, zn + a, b - a, xn,
+                                                   xp);
+                }
+            }
+
+            if (occupied) {
+                apply_walls(mesh_side::yp, z, wall_out[2], next);
+                apply_walls(mesh_side::yn, z, wall_out[3], next);
+                apply_walls(mesh_side::zp, z, wall_out[4], next);
+                apply_walls(mesh_side::zn, z, wall_out[5], next);
+            }
         }
     };
 } // namespace dwm
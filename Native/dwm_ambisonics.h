@@ -0,0 +1,200 @@
+#ifndef DWM_AMBISONICS_H
+#define DWM_AMBISONICS_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numbers>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "dwm.h"
+
+/// Ambisonic encoding of a mesh's sound field around a listener, in the ACN channel order with SN3D normalization
+/// (AmbiX), with the x axis forward, y on the left and z up\n
+/// Instead of a microphone array, the field is sampled at the listener's position and at neighbouring points one
+/// spacing apart along the listener's axes: the pressure gives the 0th order, its gradient the 1st and its second
+/// derivatives the 2nd. For a plane wave coming from direction d, each derivative along an axis scales the pressure
+/// by that axis' component of d over the speed of sound and differentiates it in time, which integrating over time
+/// as many times reverts
+namespace dwm::ambisonics {
+
+    /// Highest supported order, higher ones need derivatives the finite differences are too inaccurate for
+    constexpr int max_order = 2;
+
+    /// @return number of channels of an ambisonic order
+    [[nodiscard]] constexpr int channel_count(const int order) { return (order + 1) * (order + 1); }
+
+    /// Listener's position and axes in world coordinates, the axes being the ambisonic ones
+    struct listener_frame final {
+        float position[3];
+        float forward[3], left[3], up[3];
+
+        /// Computes the frame from a listener matrix (as provided by Unity's spatializer data)
+        /// @param m 4x4 world to listener matrix
+        [[nodiscard]] static listener_frame from_listener_matrix(const float *m) {
+            // Unity's listener space has x on the right, y up and z forward
+            return {{-(m[0] * m[12] + m[1] * m[13] + m[2] * m[14]), -(m[4] * m[12] + m[5] * m[13] + m[6] * m[14]),
+                     -(m[8] * m[12] + m[9] * m[13] + m[10] * m[14])},
+                    {m[2], m[6], m[10]}, {-m[0], -m[4], -m[8]}, {m[1], m[5], m[9]}};
+        }
+
+        /// @return frame linearly interpolated between a (t = 0) and b (t = 1)
+        [[nodiscard]] static listener_frame lerp(const listener_frame &a, const listener_frame &b, const float t) {
+            listener_frame f{};
+            for (int i = 0; i < 3; i++) {
+                f.position[i] = std::lerp(a.position[i], b.position[i], t);
+                f.forward[i] = std::lerp(a.forward[i], b.forward[i], t);
+                f.left[i] = std::lerp(a.left[i], b.left[i], t);
+                f.up[i] = std::lerp(a.up[i], b.up[i], t);
+            }
+            return f;
+        }
+    };
+
+    /// Encodes the field around a listener into ambisonic channels, from the points it samples in the mesh\n
+    /// The encoding is exact for wavelengths much longer than the spacing, the time integrals are leaky so that the
+    /// derived channels roll off below about 20 Hz instead of drifting
+    class encoder final {
+    public:
+        /// Builds a new instance
+        /// @param order ambisonic order, from 1 to max_order
+        /// @param spacing distance between the sampled points, in meters, usually the mesh's junction spacing
+        /// @param sample_rate sample rate of the mesh
+        /// @param max_steps maximum number of steps per block
+        encoder(const int order, const float spacing, const int sample_rate, const int max_steps) :
+            encoder_order(std::clamp(order, 1, max_order)), spacing(spacing), sample_rate(sample_rate),
+            leak(std::exp(-2.0f * std::numbers::pi_v<float> * 20.0f / static_cast<float>(sample_rate))) {
+            // Center, then the axes (for the 1st and 2nd derivatives along them), then the edges of the cube (for the
+            // mixed 2nd derivatives), in units of spacing along forward, left and up
+            offsets = {{0, 0, 0}, {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+            if (encoder_order >= 2) {
+                for (const auto &[a, b]: {std::pair{0, 1}, std::pair{0, 2}, std::pair{1, 2}}) {
+                    for (const int sign_a: {1, -1}) {
+                        for (const int sign_b: {1, -1}) {
+                            offset o = {0, 0, 0};
+                            o[a] = sign_a;
+                            o[b] = sign_b;
+                            offsets.push_back(o);
+                        }
+                    }
+                }
+            }
+            points.resize(offsets.size());
+            samples.resize(offsets.size() * static_cast<size_t>(std::max(1, max_steps)));
+        }
+
+        // No copy constructor
+        encoder(const encoder &other) = delete;
+
+        // No copy assignment
+        encoder &operator=(const encoder &other) = delete;
+
+        /// @return ambisonic order of the encoded channels
+        [[nodiscard]] int order() const { return encoder_order; }
+
+        /// @return number of encoded channels
+        [[nodiscard]] int channels() const { return channel_count(encoder_order); }
+
+        /// @return number of points sampled in the mesh
+        [[nodiscard]] int receiver_count() const { return static_cast<int>(points.size()); }
+
+        /// Places the sampled points around the listener for the next block
+        /// @param end listener's frame reached at the end of the block
+        /// @param start optional listener's frame at the start of the block, the points then move linearly to end
+        /// @return receiver_count() receivers to pass to the mesh's update_block, valid until the next call
+        const block_receiver *receivers(const listener_frame &end, const listener_frame *start = nullptr) {
+            const int count = receiver_count();
+            for (int i = 0; i < count; i++) {
+                block_receiver &r = points[i];
+                const auto [x, y, z] = place(end, offsets[i]);
+                r = {x, y, z, samples.data() + i, count, start != nullptr};
+                if (start != nullptr)
+                    std::tie(r.start_x, r.start_y, r.start_z) = place(*start, offsets[i]);
+            }
+            return points.data();
+        }
+
+        /// Encodes the samples read by the receivers during a block
+        /// @param steps number of steps of the block
+        /// @param out interleaved output buffer, the first channels() channels are written (as many as out_channels
+        /// allows) and the others zeroed
+        /// @param out_channels number of interleaved output channels
+        void encode(const int steps, float *out, const int out_channels) {
+            constexpr float sqrt3 = std::numbers::sqrt3_v<float>;
+            const int count = receiver_count();
+            const float first = 343.0f / (2.0f * spacing), second = 343.0f * 343.0f / (spacing * spacing);
+            for (int n = 0; n < steps; n++) {
+                const float *p = samples.data() + static_cast<size_t>(n) * count;
+                float encoded[channel_count(max_order)];
+                // W, Y, Z and X
+                encoded[0] = p[0];
+                encoded[1] = integrate(0, first * (p[3] - p[4]));
+                encoded[2] = integrate(1, first * (p[5] - p[6]));
+                encoded[3] = integrate(2, first * (p[1] - p[2]));
+                if (encoder_order >= 2) {
+                    // Second derivatives along the axes and mixed ones, the edges of each pair of axes being stored
+                    // as (+, +), (+, -), (-, +) and (-, -)
+                    const float xx = p[1] - 2.0f * p[0] + p[2];
+                    const float yy = p[3] - 2.0f * p[0] + p[4];
+                    const float zz = p[5] - 2.0f * p[0] + p[6];
+                    const float xy = (p[7] - p[8] - p[9] + p[10]) / 4.0f;
+                    const float xz = (p[11] - p[12] - p[13] + p[14]) / 4.0f;
+                    const float yz = (p[15] - p[16] - p[17] + p[18]) / 4.0f;
+                    // V, T, R, S and U, where R uses the pressure for the -1 term instead of the Laplacian's integral
+                    encoded[4] = sqrt3 * integrate_twice(3, second * xy);
+                    encoded[5] = sqrt3 * integrate_twice(4, second * yz);
+                    encoded[6] = 1.5f * integrate_twice(5, second * zz) - 0.5f * p[0];
+                    encoded[7] = sqrt3 * integrate_twice(6, second * xz);
+                    encoded[8] = 0.5f * sqrt3 * integrate_twice(7, second * (xx - yy));
+                }
+                const int written = std::min(channels(), out_channels);
+                std::copy_n(encoded, written, out + n * out_channels);
+                std::fill(out + n * out_channels + written, out + (n + 1) * out_channels, 0.0f);
+            }
+        }
+
+        /// Forgets the previous blocks
+        void reset() {
+            std::fill(&integrals[0][0], &integrals[0][0] + sizeof(integrals) / sizeof(float), 0.0f);
+        }
+
+    private:
+        typedef std::array<int, 3> offset;
+
+        int encoder_order;
+        float spacing;
+        int sample_rate;
+        float leak; // Pole of the leaky integrators
+        std::vector<offset> offsets; // Sampled points around the listener, in units of spacing along its axes
+        std::vector<block_receiver> points;
+        std::vector<float> samples; // Interleaved samples of the points, step-major
+        float integrals[8][4] = {}; // Integrators' previous input and output, then the second integrator's ones
+
+        // World coordinates of a point around the listener
+        [[nodiscard]] std::tuple<float, float, float> place(const listener_frame &f, const offset &o) const {
+            float world[3];
+            for (int i = 0; i < 3; i++)
+                world[i] = f.position[i] +
+                           spacing * (static_cast<float>(o[0]) * f.forward[i] + static_cast<float>(o[1]) * f.left[i] +
+                                      static_cast<float>(o[2]) * f.up[i]);
+            return {world[0], world[1], world[2]};
+        }
+
+        // Leaky trapezoidal integration of a channel's next sample
+        float integrate(const int channel, const float x, const int stage = 0) {
+            float *s = integrals[channel] + 2 * stage;
+            const float y = leak * s[1] + (x + s[0]) / (2.0f * static_cast<float>(sample_rate));
+            s[0] = x;
+            s[1] = y;
+            return y;
+        }
+
+        float integrate_twice(const int channel, const float x) {
+            return integrate(channel, integrate(channel, x, 0), 1);
+        }
+    };
+
+} // namespace dwm::ambisonics
+
+#endif
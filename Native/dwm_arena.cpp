@@ -0,0 +1,130 @@
+#include <cstdint>
+#include <utility>
+#include "dwm_arena.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace dwm {
+
+    namespace {
+
+        [[nodiscard]] size_t round_up(const size_t size, const size_t multiple) {
+            return (size + multiple - 1) / multiple * multiple;
+        }
+
+#ifdef _WIN32
+        // Large pages can only be allocated by processes holding the "Lock pages in memory" privilege, which must be
+        // granted to the user and then enabled in the process' token
+        bool enable_lock_memory_privilege() {
+            HANDLE token;
+            if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+                return false;
+            TOKEN_PRIVILEGES privileges{};
+            privileges.PrivilegeCount = 1;
+            privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+            const bool enabled = LookupPrivilegeValueA(nullptr, "SeLockMemoryPrivilege",
+                                                       &privileges.Privileges[0].Luid) &&
+                                 AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr) &&
+                                 GetLastError() == ERROR_SUCCESS;
+            CloseHandle(token);
+            return enabled;
+        }
+#else
+        [[nodiscard]] void *map_anonymous(const size_t size, const int flags) {
+            void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+            return memory != MAP_FAILED ? memory : nullptr;
+        }
+#endif
+
+    } // namespace
+
+    arena::arena(const size_t size, const page_mode mode) {
+        if (size == 0)
+            return;
+#ifdef _WIN32
+        // Windows has no transparent huge pages, and large pages are committed when allocated
+        if (mode == page_mode::huge && GetLargePageMinimum() > 0 && enable_lock_memory_privilege()) {
+            const size_t rounded = round_up(size, GetLargePageMinimum());
+            base = VirtualAlloc(nullptr, rounded, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+            if (base != nullptr) {
+                capacity = rounded;
+                this->mode = page_mode::huge;
+                return;
+            }
+        }
+        base = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        capacity = base != nullptr ? size : 0;
+#elif defined(__linux__)
+        constexpr size_t huge_page = 2 << 20;
+        const size_t rounded = round_up(size, huge_page);
+        if (mode == page_mode::huge) {
+            base = map_anonymous(rounded, MAP_HUGETLB);
+            if (base != nullptr) {
+                capacity = rounded;
+                this->mode = page_mode::huge;
+                return;
+            }
+        }
+        if (mode != page_mode::standard && size >= huge_page) {
+            // The kernel only merges huge page aligned ranges, the mapping is thus aligned by trimming a larger one
+            auto *mapping = static_cast<unsigned char *>(map_anonymous(rounded + huge_page, 0));
+            if (mapping != nullptr) {
+                const size_t head = (huge_page - reinterpret_cast<uintptr_t>(mapping) % huge_page) % huge_page;
+                if (head > 0)
+                    munmap(mapping, head);
+                munmap(mapping + head + rounded, huge_page - head);
+                base = mapping + head;
+                capacity = rounded;
+                if (madvise(base, capacity, MADV_HUGEPAGE) == 0)
+                    this->mode = page_mode::transparent_huge;
+                return;
+            }
+        }
+        base = map_anonymous(size, 0);
+        capacity = base != nullptr ? size : 0;
+#else
+        (void) mode;
+        base = map_anonymous(size, 0);
+        capacity = base != nullptr ? size : 0;
+#endif
+    }
+
+    arena::~arena() { release(); }
+
+    arena::arena(arena &&other) noexcept :
+        base(std::exchange(other.base, nullptr)), capacity(std::exchange(other.capacity, 0)),
+        used(std::exchange(other.used, 0)), mode(other.mode) {}
+
+    arena &arena::operator=(arena &&other) noexcept {
+        if (this != &other) {
+            release();
+            base = std::exchange(other.base, nullptr);
+            capacity = std::exchange(other.capacity, 0);
+            used = std::exchange(other.used, 0);
+            mode = other.mode;
+        }
+        return *this;
+    }
+
+    void arena::release() {
+        if (base != nullptr) {
+#ifdef _WIN32
+            VirtualFree(base, 0, MEM_RELEASE);
+#else
+            munmap(base, capacity);
+#endif
+        }
+        base = nullptr;
+        capacity = 0;
+        used = 0;
+        mode = page_mode::standard;
+    }
+
+} // namespace dwm
@@ -0,0 +1,79 @@
+#ifndef DWM_ARENA_H
+#define DWM_ARENA_H
+
+#include <cstddef>
+
+namespace dwm {
+
+    /// Pages backing an arena
+    enum class page_mode {
+        standard, ///< The platform's regular pages
+        transparent_huge, ///< Regular pages, which the kernel is advised to merge into huge pages (Linux only)
+        huge ///< Huge pages reserved by the system (hugetlbfs on Linux, large pages on Windows)
+    };
+
+    /// Block of zeroed memory mapped from the operating system, from which buffers are carved consecutively with
+    /// cache line alignment\n
+    /// Pages are only committed when first written, on the memory node of the thread writing them: buffers which are
+    /// not written until they are updated by their workers are thus spread over the nodes those workers run on
+    class arena final {
+    public:
+        /// Alignment of the carved buffers, a cache line and the widest vector register (AVX-512)
+        static constexpr size_t alignment = 64;
+        /// Span of addresses after which cache sets repeat in a typical L1 data cache (64 sets of 64 byte lines)
+        static constexpr size_t set_span = 4096;
+
+        /// @return the bytes to reserve for a buffer, enough for its alignment and any phase (see carve)
+        [[nodiscard]] static constexpr size_t footprint(const size_t bytes) {
+            return (bytes + alignment - 1) / alignment * alignment + set_span;
+        }
+
+        /// Builds an empty arena
+        arena() = default;
+
+        /// Maps a zeroed block, falling back to the next mode down (huge, transparent huge, then standard pages) when
+        /// the requested pages are not available
+        /// @param size number of bytes, see footprint
+        /// @param mode pages backing the block
+        arena(size_t size, page_mode mode);
+        ~arena();
+        // No copy constructor
+        arena(const arena &other) = delete;
+        // No copy assignment operator
+        arena &operator=(const arena &other) = delete;
+        arena(arena &&other) noexcept;
+        arena &operator=(arena &&other) noexcept;
+
+        /// @return the number of bytes mapped, 0 if the mapping failed
+        [[nodiscard]] size_t size() const { return capacity; }
+
+        /// @return the pages actually backing the block
+        [[nodiscard]] page_mode pages() const { return mode; }
+
+        /// Carves a zeroed buffer after the previous ones
+        /// @param count number of elements
+        /// @param phase offset in bytes of the buffer's start within set_span, a multiple of alignment, so that
+        /// buffers streamed together start in different cache sets
+        /// @return the buffer, nullptr if the arena is too small
+        template<typename T>
+        T *carve(const size_t count, const size_t phase = 0) {
+            size_t offset = (used + alignment - 1) / alignment * alignment;
+            offset += (phase % set_span + set_span - offset % set_span) % set_span;
+            if (base == nullptr || offset + count * sizeof(T) > capacity)
+                return nullptr;
+            used = offset + count * sizeof(T);
+            return reinterpret_cast<T *>(static_cast<unsigned char *>(base) + offset);
+        }
+
+    private:
+        void *base = nullptr;
+        size_t capacity = 0;
+        size_t used = 0;
+        page_mode mode = page_mode::standard;
+
+        void release();
+    };
+
+} // namespace dwm
+
+#endif
@@ -0,0 +1,318 @@
+#ifndef DWM_CONVOLUTION_H
+#define DWM_CONVOLUTION_H
+
+#include <algorithm>
+#include <complex>
+#include <numbers>
+#include <vector>
+
+namespace dwm {
+
+    /// Radix-2 FFT of real signals, computed as a complex FFT of half the size with the twiddle factors and the bit
+    /// reversal permutation tabulated at construction\n
+    /// Spectra hold size() / 2 + 1 bins, stored split (real and imaginary parts in separate arrays) so that the loops
+    /// multiplying them vectorize. Instances keep a work buffer and must not be shared between threads
+    class real_fft final {
+    public:
+        /// Builds a new instance
+        /// @param size number of samples transformed, a power of two of at least 4
+        explicit real_fft(const int size) : n(size), half(size / 2), work(size / 2), twiddles(size / 4),
+                                            unpack(size / 2 + 1), reversed(size / 2) {
+            constexpr double pi = std::numbers::pi;
+            for (int k = 0; k < half / 2; k++)
+                twiddles[k] = std::polar(1.0f, static_cast<float>(-2.0 * pi * k / half));
+            for (int k = 0; k <= half; k++)
+                unpack[k] = std::polar(1.0f, static_cast<float>(-2.0 * pi * k / n));
+            int bits = 0;
+            while ((1 << bits) < half)
+                bits++;
+            for (int i = 0; i < half; i++) {
+                int r = 0;
+                for (int b = 0; b < bits; b++)
+                    r |= ((i >> b) & 1) << (bits - 1 - b);
+                reversed[i] = r;
+            }
+        }
+
+        /// @return number of samples transformed
+        [[nodiscard]] int size() const { return n; }
+
+        /// Computes the spectrum of a signal
+        /// @param in size() samples
+        /// @param re real parts of the size() / 2 + 1 bins
+        /// @param im imaginary parts of the bins
+        void forward(const float *in, float *re, float *im) {
+            // Even samples in the real parts, odd samples in the imaginary ones
+            for (int m = 0; m < half; m++)
+                work[m] = {in[2 * m], in[2 * m + 1]};
+            transform(false);
+            for (int k = 0; k <= half; k++) {
+                const std::complex<float> z = work[k % half], zc = std::conj(work[(half - k) % half]);
+                const std::complex<float> even = 0.5f * (z + zc), odd = std::complex<float>(0.0f, -0.5f) * (z - zc);
+                const std::complex<float> x = even + unpack[k] * odd;
+                re[k] = x.real();
+                im[k] = x.imag();
+            }
+        }
+
+        /// Computes a signal from its spectrum, the exact inverse of forward
+        /// @param re real parts of the size() / 2 + 1 bins
+        /// @param im imaginary parts of the bins
+        /// @param out size() samples
+        void inverse(const float *re, const float *im, float *out) {
+            for (int k = 0; k < half; k++) {
+                const std::complex<float> x = {re[k], im[k]}, xc = {re[half - k], -im[half - k]};
+                const std::complex<float> even = 0.5f * (x + xc), odd = 0.5f * (x - xc) * std::conj(unpack[k]);
+                work[k] = even + std::complex<float>(0.0f, 1.0f) * odd;
+            }
+            transform(true);
+            const float scale = 1.0f / static_cast<float>(half);
+            for (int m = 0; m < half; m++) {
+                out[2 * m] = work[m].real() * scale;
+                out[2 * m + 1] = work[m].imag() * scale;
+            }
+        }
+
+    private:
+        int n, half;
+        std::vector<std::complex<float>> work; // Half size complex signal, transformed in place
+        std::vector<std::complex<float>> twiddles; // Of the half size transform
+        std::vector<std::complex<float>> unpack; // Separate the even and odd samples' spectra
+        std::vector<int> reversed; // Bit reversal permutation of the half size transform
+
+        // Iterative decimation in time of the work buffer, unscaled
+        void transform(const bool inverse) {
+            for (int i = 0; i < half; i++) {
+                if (i < reversed[i])
+                    std::swap(work[i], work[reversed[i]]);
+            }
+            for (int length = 2; length <= half; length *= 2) {
+                const int stride = half / length;
+                for (int i = 0; i < half; i += length) {
+                    for (int j = 0; j < length / 2; j++) {
+                        const std::complex<float> w =
+                                inverse ? std::conj(twiddles[j * stride]) : twiddles[j * stride];
+                        const std::complex<float> u = work[i + j], v = work[i + j + length / 2] * w;
+                        work[i + j] = u + v;
+                        work[i + j + length / 2] = u - v;
+                    }
+                }
+            }
+        }
+    };
+
+    /// Zero latency convolution of a mono signal with the impulse responses of several channels (e.g. the two ears),
+    /// which can be replaced while running\n
+    /// The responses are split in partitions of partition_size() samples: the first one is convolved directly, sample
+    /// by sample, and the others with a uniformly partitioned overlap-save scheme, their spectra being multiplied by
+    /// those of the past input blocks (the frequency domain delay line) once per block. Since the later partitions
+    /// only depend on past blocks, the output is not delayed at all. New responses are cross-faded in over a whole
+    /// block, all the state is allocated at construction
+    class partitioned_convolver final {
+    public:
+        /// Builds a new instance, with silent responses
+        /// @param channels number of output channels, each with its own response
+        /// @param length number of samples of each response
+        /// @param partition_size samples per partition, a power of two of at least 2
+        partitioned_convolver(const int channels, const int length, const int partition_size) :
+            channel_count(channels), response_length(length), partition(partition_size),
+            partitions(std::max(1, (length + partition_size - 1) / partition_size)), bins(partition_size + 1),
+            fft(2 * partition_size) {
+            const size_t spectra = static_cast<size_t>(channels) * (partitions - 1) * bins;
+            for (auto &r: responses) {
+                r.head.assign(static_cast<size_t>(channels) * partition, 0.0f);
+                r.re.assign(spectra, 0.0f);
+                r.im.assign(spectra, 0.0f);
+            }
+            history.assign(2 * static_cast<size_t>(partition), 0.0f);
+            delay_re.assign(static_cast<size_t>(partitions - 1) * bins, 0.0f);
+            delay_im.assign(static_cast<size_t>(partitions - 1) * bins, 0.0f);
+            tails.assign(2 * static_cast<size_t>(channels) * partition, 0.0f);
+            frame.assign(2 * static_cast<size_t>(partition), 0.0f);
+            sum_re.assign(bins, 0.0f);
+            sum_im.assign(bins, 0.0f);
+        }
+
+        // No copy constructor
+        partitioned_convolver(const partitioned_convolver &other) = delete;
+
+        // No copy assignment
+        partitioned_convolver &operator=(const partitioned_convolver &other) = delete;
+
+        partitioned_convolver(partitioned_convolver &&other) noexcept = default;
+
+        partitioned_convolver &operator=(partitioned_convolver &&other) noexcept = default;
+
+        /// @return number of output channels
+        [[nodiscard]] int channels() const { return channel_count; }
+
+        /// @return number of samples of each response
+        [[nodiscard]] int length() const { return response_length; }
+
+        /// @return samples per partition, new responses are faded in over as many samples
+        [[nodiscard]] int partition_size() const { return partition; }
+
+        /// @return whether set_responses accepts new responses, i.e. the previous ones are entirely faded in
+        [[nodiscard]] bool ready() const { return !pending && !fading; }
+
+        /// Replaces the responses, starting at the next block
+        /// @param samples channels() responses of length() samples, one after the other
+        /// @param fade whether to cross-fade from the previous responses over a block, otherwise they are replaced
+        /// right away (e.g. after reset)
+        /// @return whether the responses were taken, faded responses are ignored until ready()
+        bool set_responses(const float *samples, const bool fade = true) {
+            if (fade && !ready())
+                return false;
+            if (!fade && !ready()) {
+                // The incoming responses are dropped
+                pending = false;
+                fading = false;
+            }
+            response &r = responses[fade ? 1 - current : current];
+            for (int c = 0; c < channel_count; c++) {
+                const float *h = samples + static_cast<size_t>(c) * response_length;
+                // The first partition is stored reversed, to be applied to the history in chronological order
+                float *head = r.head.data() + static_cast<size_t>(c) * partition;
+                for (int j = 0; j < partition; j++)
+                    head[partition - 1 - j] = j < response_length ? h[j] : 0.0f;
+                // The later ones zero padded to the transform size
+                for (int k = 1; k < partitions; k++) {
+                    const int first = k * partition, count = std::clamp(response_length - first, 0, partition);
+                    std::copy_n(h + first, count, frame.begin());
+                    std::fill(frame.begin() + count, frame.end(), 0.0f);
+                    const size_t offset = (static_cast<size_t>(c) * (partitions - 1) + (k - 1)) * bins;
+                    fft.forward(frame.data(), r.re.data() + offset, r.im.data() + offset);
+                }
+            }
+            if (fade)
+                pending = true;
+            else
+                compute_tails(current, tails.data());
+            return true;
+        }
+
+        /// Convolves a block of input samples
+        /// @param in input samples
+        /// @param out interleaved output buffer, whose first channels() channels the output is added to
+        /// @param n number of samples
+        /// @param out_channels number of interleaved output channels
+        void process(const float *in, float *out, const int n, const int out_channels) {
+            for (int i = 0; i < n;) {
+                const int count = std::min(n - i, partition - position);
+                std::copy_n(in + i, count, history.begin() + partition + position);
+                const float step = 1.0f / static_cast<float>(partition);
+                for (int c = 0; c < channel_count; c++) {
+                    const float *head = responses[current].head.data() + static_cast<size_t>(c) * partition;
+                    const float *tail = tails.data() + static_cast<size_t>(c) * partition;
+                    const float *next_head = responses[1 - current].head.data() + static_cast<size_t>(c) * partition;
+                    const float *next_tail = tails.data() + static_cast<size_t>(channel_count + c) * partition;
+                    for (int s = 0; s < count; s++) {
+                        const int t = position + s;
+                        const float *x = history.data() + t + 1;
+                        float y = tail[t];
+                        for (int j = 0; j < partition; j++)
+                            y += head[j] * x[j];
+                        if (fading) {
+                            float next = next_tail[t];
+                            for (int j = 0; j < partition; j++)
+                                next += next_head[j] * x[j];
+                            y += (next - y) * static_cast<float>(t + 1) * step;
+                        }
+                        out[(i + s) * out_channels + c] += y;
+                    }
+                }
+                i += count;
+                position += count;
+                if (position == partition)
+                    next_block();
+            }
+        }
+
+        /// Forgets the past input, the responses being kept (the incoming ones if they were being faded in)
+        void reset() {
+            if (!ready())
+                current = 1 - current;
+            pending = false;
+            fading = false;
+            position = 0;
+            newest = 0;
+            std::fill(history.begin(), history.end(), 0.0f);
+            std::fill(delay_re.begin(), delay_re.end(), 0.0f);
+            std::fill(delay_im.begin(), delay_im.end(), 0.0f);
+            std::fill(tails.begin(), tails.end(), 0.0f);
+        }
+
+    private:
+        // Responses of all the channels
+        struct response {
+            std::vector<float> head; // First partition of each channel, reversed
+            std::vector<float> re, im; // Spectra of the later partitions of each channel, channel-major
+        };
+
+        int channel_count, response_length;
+        int partition, partitions, bins;
+        real_fft fft;
+        response responses[2]; // Current responses, and the incoming ones while fading
+        int current = 0;
+        bool pending = false; // Whether incoming responses are waiting for the next block
+        bool fading = false; // Whether the current block fades the incoming responses in
+        int position = 0; // Samples of the current block received so far
+        std::vector<float> history; // Previous block then current one
+        std::vector<float> delay_re, delay_im; // Spectra of the last partitions - 1 blocks with their predecessor
+        int newest = 0; // Delay line entry of the last completed block
+        std::vector<float> tails; // Later partitions' output for the current block, then the incoming responses' one
+        std::vector<float> frame, sum_re, sum_im; // Transform scratch
+
+        // Called once the current block is complete: moves it to the delay line and computes the next block's tails
+        void next_block() {
+            if (fading) {
+                current = 1 - current;
+                fading = false;
+            }
+            if (partitions > 1) {
+                newest = (newest + 1) % (partitions - 1);
+                const size_t offset = static_cast<size_t>(newest) * bins;
+                fft.forward(history.data(), delay_re.data() + offset, delay_im.data() + offset);
+            }
+            std::copy_n(history.begin() + partition, partition, history.begin());
+            position = 0;
+            if (pending) {
+                pending = false;
+                fading = true;
+                compute_tails(1 - current, tails.data() + static_cast<size_t>(channel_count) * partition);
+            }
+            compute_tails(current, tails.data());
+        }
+
+        // Output of the later partitions of a response set over the next block, from the delay line
+        void compute_tails(const int set, float *out) {
+            if (partitions == 1) {
+                std::fill_n(out, static_cast<size_t>(channel_count) * partition, 0.0f);
+                return;
+            }
+            const response &r = responses[set];
+            for (int c = 0; c < channel_count; c++) {
+                std::fill(sum_re.begin(), sum_re.end(), 0.0f);
+                std::fill(sum_im.begin(), sum_im.end(), 0.0f);
+                for (int k = 1; k < partitions; k++) {
+                    // Block completed k - 1 blocks before the newest one
+                    const int entry = (newest - (k - 1) + (partitions - 1)) % (partitions - 1);
+                    const float *x_re = delay_re.data() + static_cast<size_t>(entry) * bins;
+                    const float *x_im = delay_im.data() + static_cast<size_t>(entry) * bins;
+                    const size_t offset = (static_cast<size_t>(c) * (partitions - 1) + (k - 1)) * bins;
+                    const float *h_re = r.re.data() + offset, *h_im = r.im.data() + offset;
+                    for (int b = 0; b < bins; b++) {
+                        sum_re[b] += x_re[b] * h_re[b] - x_im[b] * h_im[b];
+                        sum_im[b] += x_re[b] * h_im[b] + x_im[b] * h_re[b];
+                    }
+                }
+                // Overlap-save, only the second half of the frame is free of circular aliasing
+                fft.inverse(sum_re.data(), sum_im.data(), frame.data());
+                std::copy_n(frame.begin() + partition, partition, out + static_cast<size_t>(c) * partition);
+            }
+        }
+    };
+
+} // namespace dwm
+
+#endif
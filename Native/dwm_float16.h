@@ -0,0 +1,71 @@
+#ifndef DWM_FLOAT16_H
+#define DWM_FLOAT16_H
+
+#include <bit>
+#include <cstdint>
+
+namespace dwm {
+
+    /// IEEE 754 half precision value, only used as a storage format: values are converted to float before any
+    /// arithmetic\n
+    /// The portable conversions below are used by the scalar code paths, the vectorized kernels rely on the hardware
+    /// conversions (F16C, AVX-512) which round the same way
+    struct float16 {
+        uint16_t bits;
+    };
+    static_assert(sizeof(float16) == 2, "float16 arrays must be packed for the vectorized conversions");
+
+    // The conversions compute every case and select the right one without branching, so that the loops converting
+    // arrays of values can be vectorized
+
+    /// @return the float exactly representing a half precision value
+    [[nodiscard]] inline float to_float(const float16 value) {
+        constexpr uint32_t shifted_exponent = 0x7c00u << 13;
+        const uint32_t magnitude = (value.bits & 0x7fffu) << 13;
+        const uint32_t exponent = magnitude & shifted_exponent;
+        const uint32_t normal = magnitude + ((127u - 15u) << 23);
+        const uint32_t special = normal + ((128u - 16u) << 23); // Infinity or NaN
+        // Zero or subnormal, renormalized by the float subtraction
+        const uint32_t subnormal =
+                std::bit_cast<uint32_t>(std::bit_cast<float>(normal + (1u << 23)) - std::bit_cast<float>(113u << 23));
+        const uint32_t bits = exponent == shifted_exponent ? special : exponent == 0 ? subnormal : normal;
+        return std::bit_cast<float>(bits | (value.bits & 0x8000u) << 16);
+    }
+
+    /// @return value itself, so that code templated on the storage format can call to_float on both formats
+    [[nodiscard]] inline float to_float(const float value) { return value; }
+
+    /// @return the half precision value nearest to a float, ties to even
+    [[nodiscard]] inline float16 to_float16(const float value) {
+        const uint32_t sign = std::bit_cast<uint32_t>(value) & 0x80000000u;
+        const uint32_t bits = std::bit_cast<uint32_t>(value) ^ sign;
+
+        const uint32_t special = bits > 0x7f800000u ? 0x7e00u : 0x7c00u; // NaN, or infinity for overflows
+        // Subnormal or zero, the float addition aligns and rounds the mantissa
+        constexpr uint32_t magic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+        const uint32_t subnormal = std::bit_cast<uint32_t>(std::bit_cast<float>(bits) + std::bit_cast<float>(magic)) -
+                                   magic;
+        // Normal, rebias the exponent and round the mantissa to nearest even
+        const uint32_t normal = (bits + ((15u - 127u) << 23) + 0xfffu + ((bits >> 13) & 1u)) >> 13;
+
+        const uint32_t result = bits >= (127u + 16u) << 23 ? special : bits < 113u << 23 ? subnormal : normal;
+        return {static_cast<uint16_t>(result | sign >> 16)};
+    }
+
+    /// Converts a float to a storage format
+    template<typename storage>
+    [[nodiscard]] storage from_float(float value);
+
+    template<>
+    [[nodiscard]] inline float from_float<float>(const float value) {
+        return value;
+    }
+
+    template<>
+    [[nodiscard]] inline float16 from_float<float16>(const float value) {
+        return to_float16(value);
+    }
+
+} // namespace dwm
+
+#endif
@@ -0,0 +1,225 @@
+#ifndef DWM_HYBRID_H
+#define DWM_HYBRID_H
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <numbers>
+#include <vector>
+
+/// Hybrid rendering, where the mesh only carries the low band and the direct path of each source is rendered above
+/// a crossover frequency by a binaural renderer: the mesh can then run at a fraction of the output's sample rate\n
+/// The crossover is a 4th order Linkwitz-Riley one, whose low and high bands are in phase and sum to a flat
+/// magnitude, as long as both paths are delayed by the same amount: the direct path's high band is delayed and
+/// attenuated as the mesh's direct path would be, and the mesh's low band by the binaural renderer's latency
+namespace dwm::hybrid {
+
+    /// Band of a crossover
+    enum class band { low, high };
+
+    /// 4th order Linkwitz-Riley filter, i.e. two cascaded 2nd order Butterworth sections
+    class linkwitz_riley final {
+    public:
+        /// Builds a new instance
+        /// @param b band kept by the filter
+        /// @param frequency crossover frequency, in Hz
+        /// @param sample_rate sample rate of the filtered samples
+        linkwitz_riley(const band b, const float frequency, const int sample_rate) {
+            const double w = 2.0 * std::numbers::pi * std::clamp(frequency / sample_rate, 1e-5f, 0.49f);
+            const double cos_w = std::cos(w), alpha = std::sin(w) / std::numbers::sqrt2; // Q = 1 / sqrt(2)
+            const double a0 = 1.0 + alpha;
+            const double b_side = (b == band::low ? 1.0 - cos_w : 1.0 + cos_w) / 2.0;
+            b0 = b2 = static_cast<float>(b_side / a0);
+            b1 = static_cast<float>((b == band::low ? 2.0 : -2.0) * b_side / a0);
+            a1 = static_cast<float>(-2.0 * cos_w / a0);
+            a2 = static_cast<float>((1.0 - alpha) / a0);
+        }
+
+        /// Clears the filter's state
+        void reset() { std::fill(&state[0][0], &state[0][0] + 4, 0.0f); }
+
+        /// Filters samples in place
+        /// @param samples samples to filter
+        /// @param count number of samples
+        /// @param stride distance between consecutive samples
+        void process(float *samples, const int count, const int stride = 1) {
+            for (int n = 0; n < count; n++)
+                samples[n * stride] = process(samples[n * stride]);
+        }
+
+        /// @return next filtered sample
+        float process(float x) {
+            // Transposed direct form II, which keeps the state well conditioned at low frequencies
+            for (auto &s: state) {
+                const float y = b0 * x + s[0];
+                s[0] = b1 * x - a1 * y + s[1];
+                s[1] = b2 * x - a2 * y;
+                x = y;
+            }
+            return x;
+        }
+
+    private:
+        float b0, b1, b2, a1, a2; // Coefficients shared by both sections, normalized by a0
+        float state[2][2] = {}; // Each section's state
+    };
+
+    /// Direction of a point as seen by the listener
+    struct source_direction final {
+        float azimuth; // Degrees, 0 in front of the listener and increasing counterclockwise seen from above
+        float elevation; // Degrees, 0 on the horizontal plane and 90 above the listener
+        float distance; // Meters
+
+        /// Computes the direction of a point from a listener matrix (as provided by Unity's spatializer data)
+        /// @param m 4x4 world to listener matrix
+        /// @param x x world coordinate of the point
+        /// @param y y world coordinate of the point
+        /// @param z z world coordinate of the point
+        [[nodiscard]] static source_direction from_listener_matrix(const float *m, const float x, const float y,
+                                                                   const float z) {
+            // Unity's listener space has x on the right, y up and z forward
+            const float right = m[0] * x + m[4] * y + m[8] * z + m[12];
+            const float up = m[1] * x + m[5] * y + m[9] * z + m[13];
+            const float forward = m[2] * x + m[6] * y + m[10] * z + m[14];
+            constexpr float degrees = 180.0f / std::numbers::pi_v<float>;
+            return {std::atan2(-right, forward) * degrees, std::atan2(up, std::hypot(right, forward)) * degrees,
+                    std::sqrt(right * right + up * up + forward * forward)};
+        }
+    };
+
+    /// Delay and attenuation of the direct path carried by a mesh, from a source to a receiver
+    struct mesh_propagation final {
+        float samples_per_meter; // Propagation delay, in output samples per meter
+        float latency; // Output samples the mesh's output is delayed by on top of the propagation delay
+        float unity_distance; // Distance up to which the direct path keeps the source's value
+
+        /// Builds the propagation model of a mesh
+        /// @param topology topology of the mesh
+        /// @param junction_density junctions per meter of the mesh
+        /// @param mesh_rate sample rate the mesh is simulated at
+        /// @param output_rate sample rate of the mesh's output
+        /// @param resampling_latency delay added by resampling to and from the mesh rate, in output samples
+        template<typename topology>
+        [[nodiscard]] static mesh_propagation of(const float junction_density, const int mesh_rate,
+                                                 const int output_rate, const double resampling_latency) {
+            const float rate_ratio = static_cast<float>(output_rate) / static_cast<float>(mesh_rate);
+            return {static_cast<float>(output_rate) / 343.0f,
+                    static_cast<float>(resampling_latency) - topology::source_lead * rate_ratio,
+                    topology::source_gain / junction_density};
+        }
+
+        /// @return delay of the direct path over a distance, in output samples
+        [[nodiscard]] float delay(const float distance) const { return latency + distance * samples_per_meter; }
+
+        /// @return gain of the direct path over a distance
+        [[nodiscard]] float gain(const float distance) const {
+            return unity_distance / std::max(distance, unity_distance);
+        }
+    };
+
+    /// High band of a source's direct path, delayed and attenuated along the path as the mesh would, ready to be
+    /// rendered by the binaural renderer\n
+    /// The delay and gain glide across each block, a moving source is therefore Doppler shifted like in the mesh
+    class direct_path final {
+    public:
+        /// Builds a new instance
+        /// @param frequency crossover frequency, in Hz
+        /// @param sample_rate sample rate of the source
+        /// @param max_delay longest delay the path can be rendered with, in samples
+        direct_path(const float frequency, const int sample_rate, const float max_delay) :
+            highpass(band::high, frequency, sample_rate),
+            line(std::bit_ceil(static_cast<size_t>(std::max(0.0f, max_delay)) + 4)),
+            max_delay(static_cast<float>(line.size() - 3)) {}
+
+        /// Forgets the previous blocks, the next one starts at its own delay and gain
+        void reset() {
+            highpass.reset();
+            std::fill(line.begin(), line.end(), 0.0f);
+            last_delay = -1.0f;
+        }
+
+        /// Renders a block of the path
+        /// @param input source samples
+        /// @param output high band of the source at the end of the path
+        /// @param count number of samples
+        /// @param delay delay reached at the end of the block, in samples
+        /// @param gain gain reached at the end of the block
+        void render(const float *input, float *output, const int count, float delay, const float gain) {
+            // The interpolation reads one sample past the delay on each side
+            delay = std::clamp(delay, 1.0f, max_delay);
+            if (last_delay < 0.0f) {
+                last_delay = delay;
+                last_gain = gain;
+            }
+            const size_t mask = line.size() - 1;
+            for (int n = 0; n < count; n++) {
+                line[position] = highpass.process(input[n]);
+                const float t = static_cast<float>(n + 1) / static_cast<float>(count);
+                const float d = std::lerp(last_delay, delay, t);
+                const int i = static_cast<int>(d);
+                const float f = d - static_cast<float>(i);
+
+                // 3rd order Lagrange interpolation between the samples i - 1 to i + 2 samples old
+                const float y0 = line[(position - i + 1) & mask], y1 = line[(position - i) & mask];
+                const float y2 = line[(position - i - 1) & mask], y3 = line[(position - i - 2) & mask];
+                const float value = -f * (f - 1.0f) * (f - 2.0f) / 6.0f * y0 +
+                                    (f + 1.0f) * (f - 1.0f) * (f - 2.0f) / 2.0f * y1 -
+                                    (f + 1.0f) * f * (f - 2.0f) / 2.0f * y2 + (f + 1.0f) * f * (f - 1.0f) / 6.0f * y3;
+                output[n] = std::lerp(last_gain, gain, t) * value;
+                position = (position + 1) & mask;
+            }
+            last_delay = delay;
+            last_gain = gain;
+        }
+
+    private:
+        linkwitz_riley highpass;
+        std::vector<float> line; // Delay line of the high band, a power of 2 long
+        float max_delay;
+        size_t position = 0; // Next sample written to the delay line
+        float last_delay = -1.0f, last_gain = 0.0f; // Reached at the end of the previous block, negative before any
+    };
+
+    /// Low band of the mesh's output, delayed to line up with the binaural renderer's output
+    class mesh_low_band final {
+    public:
+        /// Builds a new instance
+        /// @param frequency crossover frequency, in Hz
+        /// @param sample_rate sample rate of the mesh's output
+        /// @param delay binaural renderer's latency, in samples
+        mesh_low_band(const float frequency, const int sample_rate, const int delay) :
+            lowpass{{band::low, frequency, sample_rate}, {band::low, frequency, sample_rate}},
+            line(2 * static_cast<size_t>(std::max(0, delay))) {}
+
+        /// Filters and delays the first two channels of a block in place
+        /// @param buffer interleaved samples
+        /// @param count number of samples per channel
+        /// @param stride number of interleaved channels, at least 2
+        void process(float *buffer, const int count, const int stride) {
+            const size_t length = line.size() / 2;
+            for (int n = 0; n < count; n++) {
+                for (int c = 0; c < 2; c++) {
+                    float &sample = buffer[n * stride + c];
+                    const float filtered = lowpass[c].process(sample);
+                    if (length == 0) {
+                        sample = filtered;
+                        continue;
+                    }
+                    sample = line[2 * position + c];
+                    line[2 * position + c] = filtered;
+                }
+                if (length == 0)
+                    continue;
+                position = position + 1 == length ? 0 : position + 1;
+            }
+        }
+
+    private:
+        linkwitz_riley lowpass[2]; // One per channel
+        std::vector<float> line; // Interleaved delay line of both channels
+        size_t position = 0;
+    };
+
+} // namespace dwm::hybrid
+
+#endif
@@ -0,0 +1,142 @@
+#include <cerrno>
+#include <cstring>
+#include "dwm_ir_cache.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace dwm::ir {
+
+    namespace {
+
+        // Bytes before the responses: magic, version, key and settings
+        constexpr size_t header_size = 4 + sizeof(uint32_t) + sizeof(uint64_t) + sizeof(bake_settings);
+
+    } // namespace
+
+    cache::~cache() { unmap(); }
+
+    bool cache::load(const char *path) {
+        unmap();
+        if (path == nullptr)
+            return false;
+#ifdef _WIN32
+        // Shared for deletion so that a new bake can replace the file, see replace_file
+        file_handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                                  FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file_handle == INVALID_HANDLE_VALUE) {
+            file_handle = nullptr;
+            return false;
+        }
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file_handle, &size) || size.QuadPart == 0) {
+            unmap();
+            return false;
+        }
+        view_size = static_cast<size_t>(size.QuadPart);
+        mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        view = mapping_handle != nullptr ? MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0) : nullptr;
+#else
+        const int fd = open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat status{};
+        if (fstat(fd, &status) == 0 && status.st_size > 0) {
+            view_size = static_cast<size_t>(status.st_size);
+            view = mmap(nullptr, view_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (view == MAP_FAILED)
+                view = nullptr;
+        }
+        // The mapping keeps the file alive
+        close(fd);
+#endif
+        if (view == nullptr || view_size < header_size) {
+            unmap();
+            return false;
+        }
+
+        const auto *bytes = static_cast<const unsigned char *>(view);
+        uint32_t file_version;
+        std::memcpy(&file_version, bytes + 4, sizeof(file_version));
+        std::memcpy(&mesh_key, bytes + 4 + sizeof(uint32_t), sizeof(mesh_key));
+        std::memcpy(&layout, bytes + 4 + sizeof(uint32_t) + sizeof(uint64_t), sizeof(layout));
+        const bool valid_layout = std::memcmp(bytes, magic, sizeof(magic)) == 0 && file_version == version &&
+                                  layout.listeners.spacing > 0.0f && layout.sources.spacing > 0.0f &&
+                                  layout.yaw_count > 0 && layout.length > 0 && layout.sample_rate > 0;
+        source_count = valid_layout ? layout.sources.point_count() : 0;
+        const size_t samples = static_cast<size_t>(layout.listeners.point_count()) * layout.yaw_count * 2 *
+                               source_count * layout.length;
+        if (!valid_layout || view_size != header_size + samples * sizeof(float16)) {
+            unmap();
+            return false;
+        }
+        responses = reinterpret_cast<const float16 *>(bytes + header_size);
+        return true;
+    }
+
+    void cache::unmap() {
+#ifdef _WIN32
+        if (view != nullptr)
+            UnmapViewOfFile(view);
+        if (mapping_handle != nullptr)
+            CloseHandle(mapping_handle);
+        if (file_handle != nullptr)
+            CloseHandle(file_handle);
+#else
+        if (view != nullptr)
+            munmap(view, view_size);
+#endif
+        view = nullptr;
+        view_size = 0;
+        file_handle = nullptr;
+        mapping_handle = nullptr;
+        responses = nullptr;
+        source_count = 0;
+        mesh_key = 0;
+        layout = {};
+    }
+
+    bool write_header(FILE *file, const uint64_t key, const bake_settings &settings) {
+        return std::fwrite(cache::magic, sizeof(cache::magic), 1, file) == 1 &&
+               std::fwrite(&cache::version, sizeof(cache::version), 1, file) == 1 &&
+               std::fwrite(&key, sizeof(key), 1, file) == 1 &&
+               std::fwrite(&settings, sizeof(settings), 1, file) == 1;
+    }
+
+    bool replace_file(const char *from, const char *to, std::string &error) {
+#ifdef _WIN32
+        if (MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING))
+            return true;
+        // The file replaced is still mapped: it is renamed aside and marked for deletion, which completes once the
+        // caches mapping it are destroyed
+        const std::string aside = std::string(to) + "." + std::to_string(GetTickCount64()) + ".old";
+        if (MoveFileExA(to, aside.c_str(), 0)) {
+            if (MoveFileExA(from, to, 0)) {
+                DeleteFileA(aside.c_str());
+                return true;
+            }
+            const DWORD code = GetLastError();
+            MoveFileExA(aside.c_str(), to, 0);
+            SetLastError(code);
+        }
+        error = "cannot replace " + std::string(to) + " (error " + std::to_string(GetLastError()) + ")";
+        return false;
+#else
+        // Caches keep mapping the replaced file until they are destroyed
+        if (std::rename(from, to) == 0)
+            return true;
+        error = "cannot replace " + std::string(to) + " (" + std::strerror(errno) + ")";
+        return false;
+#endif
+    }
+
+} // namespace dwm::ir
@@ -0,0 +1,412 @@
+#ifndef DWM_IR_CACHE_H
+#define DWM_IR_CACHE_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <numbers>
+#include <string>
+#include <thread>
+#include <vector>
+#include "dwm.h"
+#include "dwm_float16.h"
+
+/// Binaural impulse responses of a mesh baked on grids of listener and source positions, so that static or slowly
+/// moving sources can be rendered by convolution (see partitioned_convolver) instead of being simulated
+namespace dwm::ir {
+
+    /// Samples per partition the responses are convolved with, a new response takes two partitions to be faded in
+    constexpr int convolution_partition = 64;
+
+    /// Evenly spaced points covering a box from the world origin, from 0 to the box's extent along each axis
+    struct grid final {
+        float extent[3]; // Size of the box along x, y and z
+        float spacing; // Distance between neighbouring points
+
+        /// @return number of points along the x, y and z axes
+        [[nodiscard]] std::array<int, 3> counts() const {
+            std::array<int, 3> c{};
+            for (int a = 0; a < 3; a++)
+                c[a] = spacing > 0.0f ? static_cast<int>(std::floor(extent[a] / spacing + 1e-3f)) + 1 : 1;
+            return c;
+        }
+
+        /// @return number of points
+        [[nodiscard]] int point_count() const {
+            const auto c = counts();
+            return c[0] * c[1] * c[2];
+        }
+
+        /// @return world coordinates of a point, points being indexed in x->y->z order
+        [[nodiscard]] std::array<float, 3> point(const int index) const {
+            const auto c = counts();
+            return {static_cast<float>(index % c[0]) * spacing, static_cast<float>(index / c[0] % c[1]) * spacing,
+                    static_cast<float>(index / (c[0] * c[1])) * spacing};
+        }
+
+        /// @return index of the point nearest to a position, clamped to the grid
+        [[nodiscard]] int nearest(const float *position) const {
+            const auto c = counts();
+            int i[3];
+            for (int a = 0; a < 3; a++)
+                i[a] = std::clamp(static_cast<int>(std::lround(position[a] / spacing)), 0, c[a] - 1);
+            return (i[2] * c[1] + i[1]) * c[0] + i[0];
+        }
+
+        /// Computes the trilinear interpolation of a position from the 8 points around it, clamped to the grid
+        /// @param position world coordinates
+        /// @param indices indices of the 8 points
+        /// @param weights weights of the 8 points, summing to 1
+        void interpolate(const float *position, int *indices, float *weights) const {
+            const auto c = counts();
+            int i[3];
+            float t[3];
+            for (int a = 0; a < 3; a++) {
+                const float u = position[a] / spacing;
+                i[a] = std::clamp(static_cast<int>(std::floor(u)), 0, std::max(0, c[a] - 2));
+                t[a] = c[a] > 1 ? std::clamp(u - static_cast<float>(i[a]), 0.0f, 1.0f) : 0.0f;
+            }
+            for (int corner = 0; corner < 8; corner++) {
+                int j[3];
+                float w = 1.0f;
+                for (int a = 0; a < 3; a++) {
+                    const int side = (corner >> a) & 1;
+                    j[a] = std::min(i[a] + side, c[a] - 1);
+                    w *= side != 0 ? t[a] : 1.0f - t[a];
+                }
+                indices[corner] = (j[2] * c[1] + j[1]) * c[0] + j[0];
+                weights[corner] = w;
+            }
+        }
+    };
+
+    /// Layout of a cache, chosen when baking it
+    struct bake_settings final {
+        grid listeners; // Listener positions
+        grid sources; // Source positions
+        int32_t yaw_count; // Listener orientations around the vertical axis, evenly spaced from facing z+
+        int32_t length; // Samples of each response, at the mesh's rate
+        int32_t sample_rate; // Mesh's sample rate
+        float ears_distance; // Distance between the listener's position and each ear
+    };
+    static_assert(sizeof(bake_settings) == 48, "bake_settings is stored as is in the cache files");
+
+    /// @return world coordinates of an ear of the listener at a grid point, facing one of the baked orientations
+    /// @param ear 0 for the left ear, 1 for the right one
+    [[nodiscard]] inline std::array<float, 3> ear_position(const bake_settings &settings, const int listener,
+                                                           const int yaw, const int ear) {
+        // Unity's yaw, turning clockwise seen from above: facing z+ the right ear is towards x+
+        const float angle = 2.0f * std::numbers::pi_v<float> * static_cast<float>(yaw) /
+                            static_cast<float>(settings.yaw_count);
+        const float side = ear == 0 ? -settings.ears_distance : settings.ears_distance;
+        const auto p = settings.listeners.point(listener);
+        return {p[0] + side * std::cos(angle), p[1], p[2] - side * std::sin(angle)};
+    }
+
+    /// Builds the key of what a cache was baked from (mesh configuration, occupancy, boundary parameters), as a 64-bit
+    /// FNV-1a hash: caches are only used by meshes built and parameterized the same way
+    class key_builder final {
+    public:
+        /// Adds the bytes of a value to the key
+        template<typename T>
+        key_builder &add(const T &value) {
+            return add_bytes(&value, sizeof(T));
+        }
+
+        /// Adds bytes to the key
+        key_builder &add_bytes(const void *data, const size_t size) {
+            const auto *bytes = static_cast<const unsigned char *>(data);
+            for (size_t i = 0; i < size; i++)
+                hash = (hash ^ bytes[i]) * 1099511628211ull;
+            return *this;
+        }
+
+        /// @return the key of everything added so far
+        [[nodiscard]] uint64_t key() const { return hash; }
+
+    private:
+        uint64_t hash = 14695981039346656037ull;
+    };
+
+    /// Responses blended for a placement of a source and the listener, see cache::select
+    struct selection final {
+        int listener = -1; // Listener point nearest to the listener
+        int yaws[2] = {}; // Orientations around the listener's
+        float yaw_weights[2] = {};
+        int sources[8] = {}; // Source points around the source
+        float source_weights[8] = {};
+
+        /// @return whether both select the same responses, with weights within a tolerance
+        [[nodiscard]] bool near(const selection &other, const float tolerance) const {
+            if (listener != other.listener)
+                return false;
+            for (int y = 0; y < 2; y++) {
+                if (yaws[y] != other.yaws[y] || std::fabs(yaw_weights[y] - other.yaw_weights[y]) > tolerance)
+                    return false;
+            }
+            for (int s = 0; s < 8; s++) {
+                if (sources[s] != other.sources[s] ||
+                    std::fabs(source_weights[s] - other.source_weights[s]) > tolerance)
+                    return false;
+            }
+            return true;
+        }
+    };
+
+    /// Impulse responses from each source point to both ears of the listener, at each listener point and
+    /// orientation, memory-mapped from a cache file so that only the responses in use are paged in\n
+    /// The file starts with the "DWMI" magic, a 32-bit version, the 64-bit key of the baked mesh (see key_builder)
+    /// and the bake_settings, followed by the responses in half precision, ordered by listener point, orientation,
+    /// ear (left first) and source point. All values are in the host's byte order, little endian on all the
+    /// supported platforms
+    class cache final {
+    public:
+        cache() = default;
+        ~cache();
+        // No copy constructor
+        cache(const cache &other) = delete;
+        // No copy assignment operator
+        cache &operator=(const cache &other) = delete;
+
+        /// Maps a cache file, replacing the one mapped so far
+        /// @param path path of the file
+        /// @return whether the file was mapped, the cache is left empty when it is missing or malformed
+        bool load(const char *path);
+
+        /// @return whether no file is mapped
+        [[nodiscard]] bool empty() const { return responses == nullptr; }
+
+        /// @return key of the mesh the responses were baked from
+        [[nodiscard]] uint64_t key() const { return mesh_key; }
+
+        /// @return layout of the responses
+        [[nodiscard]] const bake_settings &settings() const { return layout; }
+
+        /// @return samples of one response at a grid point
+        /// @param ear 0 for the left ear, 1 for the right one
+        [[nodiscard]] const float16 *response(const int listener, const int yaw, const int ear,
+                                              const int source) const {
+            const size_t index =
+                    ((static_cast<size_t>(listener) * layout.yaw_count + yaw) * 2 + ear) * source_count + source;
+            return responses + index * layout.length;
+        }
+
+        /// Selects the responses heard by a listener from a source
+        /// @param source world coordinates of the source
+        /// @param listener world coordinates of the listener, between its ears
+        /// @param yaw listener's rotation around the vertical axis in radians, clockwise seen from above and 0 when
+        /// facing z+
+        [[nodiscard]] selection select(const float *source, const float *listener, const float yaw) const {
+            selection s;
+            s.listener = layout.listeners.nearest(listener);
+            const float turns = yaw / (2.0f * std::numbers::pi_v<float>);
+            const float orientation = (turns - std::floor(turns)) * static_cast<float>(layout.yaw_count);
+            const int first = std::min(static_cast<int>(orientation), layout.yaw_count - 1);
+            s.yaws[0] = first;
+            s.yaws[1] = (first + 1) % layout.yaw_count;
+            s.yaw_weights[1] = orientation - static_cast<float>(first);
+            s.yaw_weights[0] = 1.0f - s.yaw_weights[1];
+            layout.sources.interpolate(source, s.sources, s.source_weights);
+            return s;
+        }
+
+        /// Blends the selected responses
+        /// @param s selected responses
+        /// @param out responses of both ears, left first, settings().length samples each
+        void blend(const selection &s, float *out) const {
+            const int length = layout.length;
+            std::fill_n(out, 2 * static_cast<size_t>(length), 0.0f);
+            for (int ear = 0; ear < 2; ear++) {
+                float *o = out + static_cast<size_t>(ear) * length;
+                for (int y = 0; y < 2; y++) {
+                    for (int p = 0; p < 8; p++) {
+                        const float w = s.yaw_weights[y] * s.source_weights[p];
+                        if (w == 0.0f)
+                            continue;
+                        const float16 *h = response(s.listener, s.yaws[y], ear, s.sources[p]);
+                        for (int n = 0; n < length; n++)
+                            o[n] += w * to_float(h[n]);
+                    }
+                }
+            }
+        }
+
+    private:
+        static constexpr char magic[4] = {'D', 'W', 'M', 'I'};
+        static constexpr uint32_t version = 1;
+
+        uint64_t mesh_key = 0;
+        bake_settings layout{};
+        int source_count = 0;
+        const float16 *responses = nullptr; // Within the mapped view
+        void *view = nullptr;
+        size_t view_size = 0;
+        void *file_handle = nullptr, *mapping_handle = nullptr; // Windows only
+
+        void unmap();
+
+        friend bool write_header(FILE *file, uint64_t key, const bake_settings &settings);
+    };
+
+    /// Writes the header of a cache file, see cache
+    /// @return whether the header was entirely written
+    bool write_header(FILE *file, uint64_t key, const bake_settings &settings);
+
+    /// Moves a file over another one, which a cache may still map: on Windows a mapped file cannot be replaced, it is
+    /// renamed aside instead (caches map their file with FILE_SHARE_DELETE for that purpose) and deleted once unmapped
+    /// @param from path of the file to move
+    /// @param to path of the file replaced
+    /// @param error set to the reason of the failure
+    /// @return whether the file was replaced
+    bool replace_file(const char *from, const char *to, std::string &error);
+
+    /// Bakes the responses of a mesh into a cache file\n
+    /// By reciprocity the response from a source to an ear is the one from the ear to the source, so each run of the
+    /// mesh injects an impulse at one ear of one listener orientation and samples all the source points at once: the
+    /// mesh is run 2 x yaw_count times per listener point, for length steps each. The last eighth of each response
+    /// is faded out, so that truncated tails end smoothly
+    /// @param mesh mesh to bake, with the occupancy it is rendered with, reset before each run
+    /// @param settings layout of the responses, whose sample rate and ears distance must be the mesh's
+    /// @param key key of the mesh and its boundary parameters, see key_builder
+    /// @param path path of the file, replaced once the whole cache is written even if a cache maps it (see
+    /// replace_file)
+    /// @param progress optional fraction of the bake done, updated after each run and set to 1 once written
+    /// @param cancel optional flag polled between runs, stopping the bake when raised
+    /// @param error optional reason of the failure
+    /// @return whether the whole cache was written
+    template<typename mesh_t, typename params_t>
+    bool bake(mesh_t &mesh, const params_t &p_xp, const params_t &p_xn, const params_t &p_yp, const params_t &p_yn,
+              const params_t &p_zp, const params_t &p_zn, const bake_settings &settings, const uint64_t key,
+              const char *path, std::atomic<float> *progress = nullptr, const std::atomic<bool> *cancel = nullptr,
+              std::string *error = nullptr) {
+        constexpr int block = 256;
+        const int source_count = settings.sources.point_count();
+        const int runs = settings.listeners.point_count() * settings.yaw_count * 2;
+        const int length = settings.length;
+        const float impulse = 1.0f;
+        std::vector<float> samples(static_cast<size_t>(block) * source_count);
+        std::vector<float> responses(static_cast<size_t>(source_count) * length);
+        std::vector<float16> stored(responses.size());
+        std::vector<block_receiver> receivers(source_count);
+        for (int s = 0; s < source_count; s++) {
+            const auto p = settings.sources.point(s);
+            receivers[s] = {p[0], p[1], p[2], samples.data() + s, source_count};
+        }
+        const int fade = std::max(1, length / 8);
+        mesh.set_sleep_threshold(0.0f);
+        mesh.reserve_block(1, source_count);
+
+        std::string failure;
+        const std::string temporary = std::string(path) + ".tmp";
+        FILE *file = std::fopen(temporary.c_str(), "wb");
+        if (file == nullptr) {
+            if (error != nullptr)
+                *error = "cannot create " + temporary + " (" + std::strerror(errno) + ")";
+            return false;
+        }
+        bool valid = write_header(file, key, settings);
+        for (int run = 0; run < runs && valid; run++) {
+            if (cancel != nullptr && cancel->load(std::memory_order_relaxed)) {
+                failure = "cancelled";
+                valid = false;
+                break;
+            }
+            const int listener = run / (2 * settings.yaw_count), yaw = run / 2 % settings.yaw_count, ear = run % 2;
+            const auto position = ear_position(settings, listener, yaw, ear);
+            const block_source source = {position[0], position[1], position[2], &impulse};
+            // Meshes refined around a point (see nested_mesh) are refined around the ear
+            if constexpr (requires { mesh.follow(0.0f, 0.0f, 0.0f); })
+                mesh.follow(position[0], position[1], position[2]);
+            mesh.reset();
+            // The impulse is only injected at the first step: the mesh's sources overwrite a share of their junctions
+            // at each step, the ear would otherwise absorb the sound coming back to it for the whole run
+            for (int n = 0; n < length;) {
+                const int steps = n == 0 ? 1 : std::min(block, length - n);
+                mesh.update_block(p_xp, p_xn, p_yp, p_yn, p_zp, p_zn, steps, &source, n == 0 ? 1 : 0, receivers.data(),
+                                  source_count);
+                for (int s = 0; s < source_count; s++) {
+                    for (int t = 0; t < steps; t++)
+                        responses[static_cast<size_t>(s) * length + n + t] = samples[t * source_count + s];
+                }
+                n += steps;
+            }
+            for (int s = 0; s < source_count; s++) {
+                for (int n = 0; n < length; n++) {
+                    const int left = length - n;
+                    const float window =
+                            left >= fade ? 1.0f
+                                         : 0.5f - 0.5f * std::cos(std::numbers::pi_v<float> * static_cast<float>(left) /
+                                                                  static_cast<float>(fade));
+                    stored[static_cast<size_t>(s) * length + n] =
+                            to_float16(window * responses[static_cast<size_t>(s) * length + n]);
+                }
+            }
+            valid = std::fwrite(stored.data(), sizeof(float16), stored.size(), file) == stored.size();
+            if (progress != nullptr)
+                progress->store(static_cast<float>(run + 1) / static_cast<float>(runs + 1), std::memory_order_relaxed);
+        }
+        valid = std::fclose(file) == 0 && valid;
+        if (!valid && failure.empty())
+            failure = "cannot write " + temporary;
+        valid = valid && replace_file(temporary.c_str(), path, failure);
+        if (!valid) {
+            std::remove(temporary.c_str());
+            if (error != nullptr)
+                *error = failure;
+            return false;
+        }
+        if (progress != nullptr)
+            progress->store(1.0f, std::memory_order_relaxed);
+        return true;
+    }
+
+    /// Runs a bake on a thread of its own, cancelled and joined when destroyed
+    class background_bake final {
+    public:
+        /// Function baking a cache, given the progress to update, the cancellation flag to poll and the reason of the
+        /// failure to set (see bake)
+        typedef std::function<bool(std::atomic<float> &progress, const std::atomic<bool> &cancel, std::string &error)>
+                job;
+
+        /// Starts baking
+        explicit background_bake(job bake) :
+            thread([this, bake = std::move(bake)] {
+                status.store(bake(fraction, cancelled, failure) ? 1 : -1, std::memory_order_release);
+            }) {}
+
+        ~background_bake() {
+            cancelled.store(true, std::memory_order_relaxed);
+            thread.join();
+        }
+        // No copy constructor
+        background_bake(const background_bake &other) = delete;
+        // No copy assignment operator
+        background_bake &operator=(const background_bake &other) = delete;
+
+        /// @return fraction of the bake done, 1 once the cache is written and -1 if it failed
+        [[nodiscard]] float progress() const {
+            return status.load(std::memory_order_acquire) < 0 ? -1.0f : fraction.load(std::memory_order_relaxed);
+        }
+
+        /// @return reason of the failure, empty while running or once the cache is written
+        [[nodiscard]] std::string error() const {
+            return status.load(std::memory_order_acquire) < 0 ? failure : std::string();
+        }
+
+    private:
+        std::atomic<float> fraction{0.0f};
+        std::atomic<bool> cancelled{false};
+        std::string failure; // Set by the thread before the status
+        std::atomic<int> status{0}; // 0 while running, then 1 if the cache was written and -1 otherwise
+        std::thread thread; // Last, started once the state above is initialized
+    };
+
+} // namespace dwm::ir
+
+#endif
@@ -0,0 +1,206 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include "dwm_kernels.h"
+
+#ifdef DWM_KERNELS_X86_64
+#ifdef _MSC_VER
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+#endif
+
+namespace dwm::kernels {
+
+    void update_row_scalar(float *__restrict out, const float *__restrict c, const float *__restrict yp,
+                           const float *__restrict yn, const float *__restrict zp, const float *__restrict zn,
+                           const int n, const float xn, const float xp) {
+        if (n == 1) {
+            out[0] = (xp + xn + yp[0] + yn[0] + zp[0] + zn[0]) / 3.0f - out[0];
+            return;
+        }
+        out[0] = (c[1] + xn + yp[0] + yn[0] + zp[0] + zn[0]) / 3.0f - out[0];
+        for (int x = 1; x < n - 1; x++)
+            out[x] = (c[x + 1] + c[x - 1] + yp[x] + yn[x] + zp[x] + zn[x]) / 3.0f - out[x];
+        out[n - 1] = (xp + c[n - 2] + yp[n - 1] + yn[n - 1] + zp[n - 1] + zn[n - 1]) / 3.0f - out[n - 1];
+    }
+
+    void update_row_float16_scalar(float16 *__restrict out, const float16 *__restrict c,
+                                   const float16 *__restrict yp, const float16 *__restrict yn,
+                                   const float16 *__restrict zp, const float16 *__restrict zn, const int n,
+                                   const float xn, const float xp) {
+        // Multiplying last, see float16_row_kernel
+        const auto update = [&](const int x, const float x_neighbours) {
+            const float sum = x_neighbours + to_float(yp[x]) + to_float(yn[x]) + to_float(zp[x]) + to_float(zn[x]);
+            out[x] = to_float16((sum - 3.0f * to_float(out[x])) / 3.0f);
+        };
+        if (n == 1) {
+            update(0, xp + xn);
+            return;
+        }
+        update(0, to_float(c[1]) + xn);
+        for (int x = 1; x < n - 1; x++)
+            update(x, to_float(c[x + 1]) + to_float(c[x - 1]));
+        update(n - 1, xp + to_float(c[n - 2]));
+    }
+
+    void update_row_interpolated_scalar(float *__restrict out, const float *const *rows, float *__restrict scratch,
+                                        const int n, const float xn, const float xp, const float weight,
+                                        const float center) {
+        const float *__restrict r0 = rows[0], *__restrict r1 = rows[1], *__restrict r2 = rows[2];
+        const float *__restrict r3 = rows[3], *__restrict c = rows[4], *__restrict r5 = rows[5];
+        const float *__restrict r6 = rows[6], *__restrict r7 = rows[7], *__restrict r8 = rows[8];
+        float *__restrict t = scratch + 1;
+        scratch[0] = 16.0f * xn;
+        for (int x = 0; x < n; x++)
+            t[x] = (r0[x] + r2[x] + r6[x] + r8[x]) + 2.0f * (r1[x] + r3[x] + r5[x] + r7[x]) + 4.0f * c[x];
+        t[n] = 16.0f * xp;
+        for (int x = 0; x < n; x++)
+            out[x] = weight * (t[x - 1] + t[x + 1] + 2.0f * t[x]) + center * c[x] - out[x];
+    }
+
+    void load_float16_scalar(float *__restrict out, const float16 *__restrict in, const int stride, const int n) {
+        for (int j = 0; j < n; j++)
+            out[j] = to_float(in[j * stride]);
+    }
+
+    void store_float16_scalar(float16 *__restrict out, const float *__restrict in, const int n) {
+        for (int j = 0; j < n; j++)
+            out[j] = to_float16(in[j]);
+    }
+
+    void scatter_affine_scalar(float *__restrict buffer, const int *__restrict index, const float *__restrict a,
+                               const float *__restrict b, const int n) {
+        for (int j = 0; j < n; j++)
+            buffer[index[j]] = a[j] * buffer[index[j]] + b[j];
+    }
+
+    void gather_scaled_scalar(const float *__restrict buffer, const int *__restrict index, const float *__restrict w,
+                              float *__restrict out, const int n) {
+        for (int j = 0; j < n; j++)
+            out[j] = w[j] * buffer[index[j]];
+    }
+
+    float peak_abs_scalar(const float *__restrict values, const int n) {
+        float peak = 0.0f;
+        for (int j = 0; j < n; j++)
+            peak = std::max(peak, std::fabs(values[j]));
+        return peak;
+    }
+
+    namespace {
+
+        constexpr kernel_set kernel_sets[] = {
+                {isa::scalar, "scalar", update_row_scalar, update_row_float16_scalar, update_row_interpolated_scalar,
+                 load_float16_scalar, store_float16_scalar, scatter_affine_scalar, gather_scaled_scalar,
+                 peak_abs_scalar},
+#ifdef DWM_KERNELS_X86_64
+                // SSE has neither gather nor half precision conversion instructions, those are left to the scalar
+                // kernels
+                {isa::sse, "sse", update_row_sse, update_row_float16_scalar, update_row_interpolated_sse,
+                 load_float16_scalar, store_float16_scalar, scatter_affine_scalar, gather_scaled_scalar,
+                 peak_abs_scalar},
+                {isa::avx2, "avx2", update_row_avx2, update_row_float16_avx2, update_row_interpolated_avx2,
+                 load_float16_avx2, store_float16_avx2, scatter_affine_avx2, gather_scaled_avx2, peak_abs_avx2},
+                {isa::avx512, "avx512", update_row_avx512, update_row_float16_avx512, update_row_interpolated_avx512,
+                 load_float16_avx512, store_float16_avx512, scatter_affine_avx512, gather_scaled_avx512,
+                 peak_abs_avx512},
+#else
+                {isa::sse, "sse", nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr},
+                {isa::avx2, "avx2", nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr},
+                {isa::avx512, "avx512", nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr},
+#endif
+        };
+
+        // Queries the CPU (and the OS, for the extended register state) for instruction sets support
+        bool cpu_supports(const isa instruction_set) {
+#ifdef DWM_KERNELS_X86_64
+#if defined(__GNUC__)
+            __builtin_cpu_init();
+            switch (instruction_set) {
+                case isa::scalar:
+                case isa::sse:
+                    return true; // SSE2 is part of the x86-64 baseline
+                case isa::avx2:
+                    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") &&
+                           __builtin_cpu_supports("f16c");
+                case isa::avx512:
+                    return __builtin_cpu_supports("avx512f");
+                default:
+                    return false;
+            }
+#elif defined(_MSC_VER)
+            int regs[4];
+            __cpuid(regs, 0);
+            const int max_leaf = regs[0];
+            __cpuid(regs, 1);
+            const bool fma = (regs[2] & (1 << 12)) != 0;
+            const bool f16c = (regs[2] & (1 << 29)) != 0;
+            const bool os_xsave = (regs[2] & (1 << 27)) != 0;
+            const unsigned long long xcr0 = os_xsave ? _xgetbv(0) : 0;
+            const bool os_avx = (xcr0 & 0x6) == 0x6;
+            const bool os_avx512 = (xcr0 & 0xe6) == 0xe6;
+            int ebx7 = 0;
+            if (max_leaf >= 7) {
+                __cpuidex(regs, 7, 0);
+                ebx7 = regs[1];
+            }
+            switch (instruction_set) {
+                case isa::scalar:
+                case isa::sse:
+                    return true;
+                case isa::avx2:
+                    return os_avx && fma && f16c && (ebx7 & (1 << 5)) != 0;
+                case isa::avx512:
+                    return os_avx512 && (ebx7 & (1 << 16)) != 0;
+                default:
+                    return false;
+            }
+#else
+            return instruction_set == isa::scalar;
+#endif
+#else
+            return instruction_set == isa::scalar;
+#endif
+        }
+
+        // Picks the widest supported instruction set, unless overridden by the DWM_KERNEL environment variable
+        const kernel_set *default_kernel_set() {
+            if (const char *name = std::getenv("DWM_KERNEL")) {
+                for (const auto &set: kernel_sets) {
+                    if (std::strcmp(set.name, name) == 0 && is_supported(set.instruction_set))
+                        return &set;
+                }
+            }
+            for (int i = static_cast<int>(isa::count) - 1; i > 0; i--) {
+                if (is_supported(static_cast<isa>(i)))
+                    return &kernel_sets[i];
+            }
+            return &kernel_sets[static_cast<int>(isa::scalar)];
+        }
+
+        std::atomic<const kernel_set *> &active_kernel_set() {
+            static std::atomic<const kernel_set *> set{default_kernel_set()};
+            return set;
+        }
+
+    } // namespace
+
+    bool is_supported(const isa instruction_set) {
+        if (instruction_set < isa::scalar || instruction_set >= isa::count)
+            return false;
+        return kernel_sets[static_cast<int>(instruction_set)].update_row != nullptr && cpu_supports(instruction_set);
+    }
+
+    const kernel_set &active() { return *active_kernel_set().load(std::memory_order_relaxed); }
+
+    bool set_active(const isa instruction_set) {
+        if (!is_supported(instruction_set))
+            return false;
+        active_kernel_set().store(&kernel_sets[static_cast<int>(instruction_set)], std::memory_order_relaxed);
+        return true;
+    }
+
+} // namespace dwm::kernels
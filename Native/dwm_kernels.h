@@ -0,0 +1,167 @@
+#ifndef DWM_KERNELS_H
+#define DWM_KERNELS_H
+
+#include "dwm_float16.h"
+
+/// Vectorized K-DWM junction update kernels, compiled for several instruction sets and selected at runtime
+namespace dwm::kernels {
+
+    /// Instruction sets the kernels are compiled for
+    enum class isa { scalar, sse, avx2, avx512, count };
+
+    /// Updates a row of n junctions, scanning x in increasing order:\n
+    /// out[x] = (c[x + 1] + c[x - 1] + yp[x] + yn[x] + zp[x] + zn[x]) / 3 - out[x]\n
+    /// where c[-1] is replaced by xn and c[n] by xp (the x- and x+ boundary outputs)
+    /// @param out (z - 1) timestep values of the row, overwritten with the (z + 1) timestep values
+    /// @param c z timestep values of the row
+    /// @param yp z timestep values of the y+ neighbours (either the next row or the y+ boundary outputs)
+    /// @param yn z timestep values of the y- neighbours (either the previous row or the y- boundary outputs)
+    /// @param zp z timestep values of the z+ neighbours (either the next plane's row or the z+ boundary outputs)
+    /// @param zn z timestep values of the z- neighbours (either the previous plane's row or the z- boundary outputs)
+    /// @param n number of junctions in the row, must be at least 1
+    /// @param xn x- boundary output
+    /// @param xp x+ boundary output
+    typedef void (*row_kernel)(float *out, const float *c, const float *yp, const float *yn, const float *zp,
+                               const float *zn, int n, float xn, float xp);
+
+    /// Same as row_kernel with the junction values stored in half precision, converted to single precision for the
+    /// computation and rounded back when stored\n
+    /// The update is computed as (sum - 3 * out[x]) * (1 / 3), multiplying last: results exactly halfway between two
+    /// half precision values then stay exact until the final rounding, which breaks the ties to even. A fused
+    /// multiply-subtract by the float nearest to 1/3 would round all of them the same way, steadily drifting the mesh
+    typedef void (*float16_row_kernel)(float16 *out, const float16 *c, const float16 *yp, const float16 *yn,
+                                       const float16 *zp, const float16 *zn, int n, float xn, float xp);
+
+    /// Updates a row of n junctions of an interpolated mesh (see topologies::interpolated) from the 3x3 rows around it
+    /// along y and z, scanning x in increasing order:\n
+    /// t[x] = sum((2 - |dy|) * (2 - |dz|) * rows[(dz + 1) * 3 + dy + 1][x]) for dy, dz in [-1, 1]\n
+    /// out[x] = weight * (t[x - 1] + 2 * t[x] + t[x + 1]) + center * rows[4][x] - out[x]\n
+    /// where t[-1] is replaced by 16 * xn and t[n] by 16 * xp (the weighted means of the x- and x+ neighbours)
+    /// @param out (z - 1) timestep values of the row, overwritten with the (z + 1) timestep values
+    /// @param rows z timestep values of the 9 rows, the row itself being rows[4] (either rows of the mesh or boundary
+    /// outputs)
+    /// @param scratch n + 2 values of temporary storage
+    /// @param n number of junctions in the row, must be at least 1
+    /// @param xn weighted mean of the x- neighbours of the first junction
+    /// @param xp weighted mean of the x+ neighbours of the last junction
+    /// @param weight weight of the neighbours' sum
+    /// @param center weight of the junction's own z timestep value
+    typedef void (*interpolated_row_kernel)(float *out, const float *const *rows, float *scratch, int n, float xn,
+                                            float xp, float weight, float center);
+
+    /// Converts half precision values to single precision
+    /// @param out n converted values
+    /// @param in values to convert
+    /// @param stride distance between consecutive values to convert
+    /// @param n number of values
+    typedef void (*float16_load_kernel)(float *out, const float16 *in, int stride, int n);
+
+    /// Converts single precision values to half precision, rounding to nearest even
+    /// @param out n converted values
+    /// @param in values to convert
+    /// @param n number of values
+    typedef void (*float16_store_kernel)(float16 *out, const float *in, int n);
+
+    /// Applies an affine update to scattered junctions:\n
+    /// buffer[index[j]] = a[j] * buffer[index[j]] + b[j]
+    /// @param buffer junction values
+    /// @param index linearized junction coordinates, must be unique
+    /// @param a multiplicative coefficient of each junction
+    /// @param b additive coefficient of each junction
+    /// @param n number of junctions
+    typedef void (*scatter_kernel)(float *buffer, const int *index, const float *a, const float *b, int n);
+
+    /// Weighted values of scattered junctions:\n
+    /// out[j] = w[j] * buffer[index[j]]
+    /// @param buffer junction values
+    /// @param index linearized junction coordinates
+    /// @param w weight of each junction
+    /// @param out n weighted values
+    /// @param n number of junctions
+    typedef void (*gather_kernel)(const float *buffer, const int *index, const float *w, float *out, int n);
+
+    /// Largest magnitude of consecutive values:\n
+    /// max(|values[j]|), 0 when n is 0
+    /// @param values values to scan
+    /// @param n number of values
+    typedef float (*peak_kernel)(const float *values, int n);
+
+    /// Set of kernels compiled for a specific instruction set
+    struct kernel_set {
+        isa instruction_set;
+        const char *name;
+        row_kernel update_row;
+        float16_row_kernel update_row_float16;
+        interpolated_row_kernel update_row_interpolated;
+        float16_load_kernel load_float16;
+        float16_store_kernel store_float16;
+        scatter_kernel scatter_affine;
+        gather_kernel gather_scaled;
+        peak_kernel peak_abs;
+    };
+
+    /// @return whether the running CPU (and OS) supports the instruction set and the kernels were compiled for it
+    [[nodiscard]] bool is_supported(isa instruction_set);
+
+    /// @return the kernels currently in use, by default the widest supported instruction set, which can be
+    /// overridden by setting the DWM_KERNEL environment variable to one of "scalar", "sse", "avx2" or "avx512"
+    [[nodiscard]] const kernel_set &active();
+
+    /// Changes the kernels in use, meshes pick up the change at their next update
+    /// @return false if the instruction set is not supported, in which case the active kernels are left unchanged
+    bool set_active(isa instruction_set);
+
+    // Per instruction set implementations, only defined when the instruction set is available for the target
+
+    void update_row_scalar(float *out, const float *c, const float *yp, const float *yn, const float *zp,
+                           const float *zn, int n, float xn, float xp);
+    void update_row_sse(float *out, const float *c, const float *yp, const float *yn, const float *zp,
+                        const float *zn, int n, float xn, float xp);
+    void update_row_avx2(float *out, const float *c, const float *yp, const float *yn, const float *zp,
+                         const float *zn, int n, float xn, float xp);
+    void update_row_avx512(float *out, const float *c, const float *yp, const float *yn, const float *zp,
+                           const float *zn, int n, float xn, float xp);
+
+    void update_row_float16_scalar(float16 *out, const float16 *c, const float16 *yp, const float16 *yn,
+                                   const float16 *zp, const float16 *zn, int n, float xn, float xp);
+    void update_row_float16_avx2(float16 *out, const float16 *c, const float16 *yp, const float16 *yn,
+                                 const float16 *zp, const float16 *zn, int n, float xn, float xp);
+    void update_row_float16_avx512(float16 *out, const float16 *c, const float16 *yp, const float16 *yn,
+                                   const float16 *zp, const float16 *zn, int n, float xn, float xp);
+
+    void update_row_interpolated_scalar(float *out, const float *const *rows, float *scratch, int n, float xn,
+                                        float xp, float weight, float center);
+    void update_row_interpolated_sse(float *out, const float *const *rows, float *scratch, int n, float xn, float xp,
+                                     float weight, float center);
+    void update_row_interpolated_avx2(float *out, const float *const *rows, float *scratch, int n, float xn, float xp,
+                                      float weight, float center);
+    void update_row_interpolated_avx512(float *out, const float *const *rows, float *scratch, int n, float xn,
+                                        float xp, float weight, float center);
+
+    void load_float16_scalar(float *out, const float16 *in, int stride, int n);
+    void load_float16_avx2(float *out, const float16 *in, int stride, int n);
+    void load_float16_avx512(float *out, const float16 *in, int stride, int n);
+
+    void store_float16_scalar(float16 *out, const float *in, int n);
+    void store_float16_avx2(float16 *out, const float *in, int n);
+    void store_float16_avx512(float16 *out, const float *in, int n);
+
+    void scatter_affine_scalar(float *buffer, const int *index, const float *a, const float *b, int n);
+    void scatter_affine_avx2(float *buffer, const int *index, const float *a, const float *b, int n);
+    void scatter_affine_avx512(float *buffer, const int *index, const float *a, const float *b, int n);
+
+    void gather_scaled_scalar(const float *buffer, const int *index, const float *w, float *out, int n);
+    void gather_scaled_avx2(const float *buffer, const int *index, const float *w, float *out, int n);
+    void gather_scaled_avx512(const float *buffer, const int *index, const float *w, float *out, int n);
+
+    float peak_abs_scalar(const float *values, int n);
+    float peak_abs_avx2(const float *values, int n);
+    float peak_abs_avx512(const float *values, int n);
+
+} // namespace dwm::kernels
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define DWM_KERNELS_X86_64
+#endif
+
+#endif
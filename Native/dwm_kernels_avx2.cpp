@@ -0,0 +1,182 @@
+// Compiled with AVX2, FMA and F16C enabled, only called after checking CPU support at runtime
+#include <algorithm>
+#include <cmath>
+#include "dwm_kernels.h"
+
+#ifdef DWM_KERNELS_X86_64
+#include <immintrin.h>
+
+namespace dwm::kernels {
+
+    void update_row_avx2(float *out, const float *c, const float *yp, const float *yn, const float *zp,
+                         const float *zn, const int n, const float xn, const float xp) {
+        if (n < 2) {
+            update_row_scalar(out, c, yp, yn, zp, zn, n, xn, xp);
+            return;
+        }
+        out[0] = (c[1] + xn + yp[0] + yn[0] + zp[0] + zn[0]) / 3.0f - out[0];
+
+        const __m256 third = _mm256_set1_ps(1.0f / 3.0f);
+        int x = 1;
+        for (; x + 8 <= n - 1; x += 8) {
+            __m256 sum = _mm256_add_ps(_mm256_loadu_ps(c + x + 1), _mm256_loadu_ps(c + x - 1));
+            sum = _mm256_add_ps(sum, _mm256_add_ps(_mm256_loadu_ps(yp + x), _mm256_loadu_ps(yn + x)));
+            sum = _mm256_add_ps(sum, _mm256_add_ps(_mm256_loadu_ps(zp + x), _mm256_loadu_ps(zn + x)));
+            _mm256_storeu_ps(out + x, _mm256_fmsub_ps(sum, third, _mm256_loadu_ps(out + x)));
+        }
+        for (; x < n - 1; x++)
+            out[x] = (c[x + 1] + c[x - 1] + yp[x] + yn[x] + zp[x] + zn[x]) / 3.0f - out[x];
+
+        out[n - 1] = (xp + c[n - 2] + yp[n - 1] + yn[n - 1] + zp[n - 1] + zn[n - 1]) / 3.0f - out[n - 1];
+    }
+
+    void update_row_interpolated_avx2(float *out, const float *const *rows, float *scratch, const int n,
+                                      const float xn, const float xp, const float weight, const float center) {
+        const float *r0 = rows[0], *r1 = rows[1], *r2 = rows[2], *r3 = rows[3], *c = rows[4];
+        const float *r5 = rows[5], *r6 = rows[6], *r7 = rows[7], *r8 = rows[8];
+        float *t = scratch + 1;
+
+        // Weighted sums across y and z first, then across x from the stored sums
+        const __m256 two = _mm256_set1_ps(2.0f), four = _mm256_set1_ps(4.0f);
+        int x = 0;
+        for (; x + 8 <= n; x += 8) {
+            const __m256 corners = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(r0 + x), _mm256_loadu_ps(r2 + x)),
+                                                 _mm256_add_ps(_mm256_loadu_ps(r6 + x), _mm256_loadu_ps(r8 + x)));
+            const __m256 edges = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(r1 + x), _mm256_loadu_ps(r3 + x)),
+                                               _mm256_add_ps(_mm256_loadu_ps(r5 + x), _mm256_loadu_ps(r7 + x)));
+            _mm256_storeu_ps(t + x,
+                             _mm256_fmadd_ps(four, _mm256_loadu_ps(c + x), _mm256_fmadd_ps(two, edges, corners)));
+        }
+        for (; x < n; x++)
+            t[x] = (r0[x] + r2[x] + r6[x] + r8[x]) + 2.0f * (r1[x] + r3[x] + r5[x] + r7[x]) + 4.0f * c[x];
+        scratch[0] = 16.0f * xn;
+        t[n] = 16.0f * xp;
+
+        const __m256 w = _mm256_set1_ps(weight), k = _mm256_set1_ps(center);
+        for (x = 0; x + 8 <= n; x += 8) {
+            const __m256 sum = _mm256_fmadd_ps(two, _mm256_loadu_ps(t + x),
+                                               _mm256_add_ps(_mm256_loadu_ps(t + x - 1), _mm256_loadu_ps(t + x + 1)));
+            const __m256 own = _mm256_fmsub_ps(k, _mm256_loadu_ps(c + x), _mm256_loadu_ps(out + x));
+            _mm256_storeu_ps(out + x, _mm256_fmadd_ps(w, sum, own));
+        }
+        for (; x < n; x++)
+            out[x] = weight * (t[x - 1] + t[x + 1] + 2.0f * t[x]) + center * c[x] - out[x];
+    }
+
+    namespace {
+
+        // Converts 8 half precision values to single precision
+        __m256 load8(const float16 *values) {
+            return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(values)));
+        }
+
+        // Updates 8 junctions from their half precision neighbours, multiplying last (see float16_row_kernel)
+        __m128i update_float16(const __m256 x_neighbours, const float16 *yp, const float16 *yn, const float16 *zp,
+                               const float16 *zn, const float16 *out) {
+            __m256 sum = _mm256_add_ps(x_neighbours, _mm256_add_ps(load8(yp), load8(yn)));
+            sum = _mm256_add_ps(sum, _mm256_add_ps(load8(zp), load8(zn)));
+            const __m256 next = _mm256_mul_ps(_mm256_fnmadd_ps(_mm256_set1_ps(3.0f), load8(out), sum),
+                                              _mm256_set1_ps(1.0f / 3.0f));
+            return _mm256_cvtps_ph(next, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        }
+
+    } // namespace
+
+    void update_row_float16_avx2(float16 *out, const float16 *c, const float16 *yp, const float16 *yn,
+                                 const float16 *zp, const float16 *zn, const int n, const float xn, const float xp) {
+        if (n < 9) {
+            update_row_float16_scalar(out, c, yp, yn, zp, zn, n, xn, xp);
+            return;
+        }
+        // The whole row is updated 8 junctions at a time, half precision values having no masked loads: the first and
+        // last 8 junctions shift in the x- and x+ boundary outputs as neighbours, and the interior ends with a vector
+        // overlapping the previous one. The vectors overlapping others are computed before any store, so that they
+        // read the same (z - 1) timestep values and store the same results
+        const __m256i shift_up = _mm256_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6);
+        const __m256i shift_down = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 7);
+        const __m256 first_left = _mm256_blend_ps(_mm256_permutevar8x32_ps(load8(c), shift_up),
+                                                  _mm256_set1_ps(xn), 0x01);
+        const __m256 last_right = _mm256_blend_ps(_mm256_permutevar8x32_ps(load8(c + n - 8), shift_down),
+                                                  _mm256_set1_ps(xp), 0x80);
+        const __m128i first = update_float16(_mm256_add_ps(first_left, load8(c + 1)), yp, yn, zp, zn, out);
+        const __m128i last = update_float16(_mm256_add_ps(load8(c + n - 9), last_right), yp + n - 8, yn + n - 8,
+                                            zp + n - 8, zn + n - 8, out + n - 8);
+        __m128i interior_end = _mm_setzero_si128();
+        if (n > 16) {
+            const int x = n - 16;
+            interior_end = update_float16(_mm256_add_ps(load8(c + x + 1), load8(c + x - 1)), yp + x, yn + x, zp + x,
+                                          zn + x, out + x);
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out), first);
+        for (int x = 8; x + 8 <= n - 8; x += 8) {
+            const __m256 x_neighbours = _mm256_add_ps(load8(c + x + 1), load8(c + x - 1));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x),
+                             update_float16(x_neighbours, yp + x, yn + x, zp + x, zn + x, out + x));
+        }
+        if (n > 16)
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + n - 16), interior_end);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + n - 8), last);
+    }
+
+    void load_float16_avx2(float *out, const float16 *in, const int stride, const int n) {
+        int j = 0;
+        if (stride == 1) {
+            for (; j + 8 <= n; j += 8)
+                _mm256_storeu_ps(out + j, load8(in + j));
+        }
+        for (; j < n; j++)
+            out[j] = _cvtsh_ss(in[j * stride].bits);
+    }
+
+    void store_float16_avx2(float16 *out, const float *in, const int n) {
+        int j = 0;
+        for (; j + 8 <= n; j += 8)
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + j),
+                             _mm256_cvtps_ph(_mm256_loadu_ps(in + j), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+        for (; j < n; j++)
+            out[j].bits = _cvtss_sh(in[j], _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    }
+
+    void scatter_affine_avx2(float *buffer, const int *index, const float *a, const float *b, const int n) {
+        // AVX2 can gather but not scatter, the results are stored one by one
+        int j = 0;
+        alignas(32) float values[8];
+        for (; j + 8 <= n; j += 8) {
+            const __m256i i = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(index + j));
+            const __m256 v = _mm256_i32gather_ps(buffer, i, 4);
+            _mm256_store_ps(values, _mm256_fmadd_ps(_mm256_loadu_ps(a + j), v, _mm256_loadu_ps(b + j)));
+            for (int k = 0; k < 8; k++)
+                buffer[index[j + k]] = values[k];
+        }
+        for (; j < n; j++)
+            buffer[index[j]] = a[j] * buffer[index[j]] + b[j];
+    }
+
+    void gather_scaled_avx2(const float *buffer, const int *index, const float *w, float *out, const int n) {
+        int j = 0;
+        for (; j + 8 <= n; j += 8) {
+            const __m256i i = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(index + j));
+            _mm256_storeu_ps(out + j, _mm256_mul_ps(_mm256_loadu_ps(w + j), _mm256_i32gather_ps(buffer, i, 4)));
+        }
+        for (; j < n; j++)
+            out[j] = w[j] * buffer[index[j]];
+    }
+
+    float peak_abs_avx2(const float *values, const int n) {
+        const __m256 magnitude = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+        __m256 peak = _mm256_setzero_ps();
+        int j = 0;
+        for (; j + 8 <= n; j += 8)
+            peak = _mm256_max_ps(peak, _mm256_and_ps(_mm256_loadu_ps(values + j), magnitude));
+        const __m128 folded = _mm_max_ps(_mm256_castps256_ps128(peak), _mm256_extractf128_ps(peak, 1));
+        const __m128 quarter = _mm_max_ps(folded, _mm_movehl_ps(folded, folded));
+        float value = _mm_cvtss_f32(_mm_max_ss(quarter, _mm_movehdup_ps(quarter)));
+        for (; j < n; j++)
+            value = std::max(value, std::fabs(values[j]));
+        return value;
+    }
+
+} // namespace dwm::kernels
+
+#endif
@@ -0,0 +1,191 @@
+// Compiled with AVX-512F enabled, only called after checking CPU support at runtime
+#include "dwm_kernels.h"
+
+#ifdef DWM_KERNELS_X86_64
+#include <immintrin.h>
+
+namespace dwm::kernels {
+
+    void update_row_avx512(float *out, const float *c, const float *yp, const float *yn, const float *zp,
+                           const float *zn, const int n, const float xn, const float xp) {
+        if (n < 2) {
+            update_row_scalar(out, c, yp, yn, zp, zn, n, xn, xp);
+            return;
+        }
+        out[0] = (c[1] + xn + yp[0] + yn[0] + zp[0] + zn[0]) / 3.0f - out[0];
+
+        // The remainder of the interior is handled with a masked iteration instead of a scalar loop
+        const __m512 third = _mm512_set1_ps(1.0f / 3.0f);
+        for (int x = 1; x < n - 1; x += 16) {
+            const int remaining = n - 1 - x;
+            const __mmask16 m = remaining >= 16 ? static_cast<__mmask16>(0xffff)
+                                                : static_cast<__mmask16>((1u << remaining) - 1u);
+            __m512 sum = _mm512_add_ps(_mm512_maskz_loadu_ps(m, c + x + 1), _mm512_maskz_loadu_ps(m, c + x - 1));
+            sum = _mm512_add_ps(sum, _mm512_add_ps(_mm512_maskz_loadu_ps(m, yp + x), _mm512_maskz_loadu_ps(m, yn + x)));
+            sum = _mm512_add_ps(sum, _mm512_add_ps(_mm512_maskz_loadu_ps(m, zp + x), _mm512_maskz_loadu_ps(m, zn + x)));
+            _mm512_mask_storeu_ps(out + x, m, _mm512_fmsub_ps(sum, third, _mm512_maskz_loadu_ps(m, out + x)));
+        }
+
+        out[n - 1] = (xp + c[n - 2] + yp[n - 1] + yn[n - 1] + zp[n - 1] + zn[n - 1]) / 3.0f - out[n - 1];
+    }
+
+    void update_row_interpolated_avx512(float *out, const float *const *rows, float *scratch, const int n,
+                                        const float xn, const float xp, const float weight, const float center) {
+        const float *r0 = rows[0], *r1 = rows[1], *r2 = rows[2], *r3 = rows[3], *c = rows[4];
+        const float *r5 = rows[5], *r6 = rows[6], *r7 = rows[7], *r8 = rows[8];
+        float *t = scratch + 1;
+        const auto mask = [n](const int x) {
+            const int remaining = n - x;
+            return remaining >= 16 ? static_cast<__mmask16>(0xffff) : static_cast<__mmask16>((1u << remaining) - 1u);
+        };
+
+        // Weighted sums across y and z first, then across x from the stored sums, both with masked remainders
+        const __m512 two = _mm512_set1_ps(2.0f), four = _mm512_set1_ps(4.0f);
+        for (int x = 0; x < n; x += 16) {
+            const __mmask16 m = mask(x);
+            const __m512 corners =
+                    _mm512_add_ps(_mm512_add_ps(_mm512_maskz_loadu_ps(m, r0 + x), _mm512_maskz_loadu_ps(m, r2 + x)),
+                                  _mm512_add_ps(_mm512_maskz_loadu_ps(m, r6 + x), _mm512_maskz_loadu_ps(m, r8 + x)));
+            const __m512 edges =
+                    _mm512_add_ps(_mm512_add_ps(_mm512_maskz_loadu_ps(m, r1 + x), _mm512_maskz_loadu_ps(m, r3 + x)),
+                                  _mm512_add_ps(_mm512_maskz_loadu_ps(m, r5 + x), _mm512_maskz_loadu_ps(m, r7 + x)));
+            _mm512_mask_storeu_ps(t + x, m, _mm512_fmadd_ps(four, _mm512_maskz_loadu_ps(m, c + x),
+                                                            _mm512_fmadd_ps(two, edges, corners)));
+        }
+        scratch[0] = 16.0f * xn;
+        t[n] = 16.0f * xp;
+
+        const __m512 w = _mm512_set1_ps(weight), k = _mm512_set1_ps(center);
+        for (int x = 0; x < n; x += 16) {
+            const __mmask16 m = mask(x);
+            const __m512 sum = _mm512_fmadd_ps(
+                    two, _mm512_maskz_loadu_ps(m, t + x),
+                    _mm512_add_ps(_mm512_maskz_loadu_ps(m, t + x - 1), _mm512_maskz_loadu_ps(m, t + x + 1)));
+            _mm512_mask_storeu_ps(out + x, m,
+                                  _mm512_fmadd_ps(w, sum, _mm512_fmsub_ps(k, _mm512_maskz_loadu_ps(m, c + x),
+                                                                          _mm512_maskz_loadu_ps(m, out + x))));
+        }
+    }
+
+    namespace {
+
+        // Converts 16 half precision values to single precision, zero-masked with all lanes enabled as the unmasked
+        // conversions trip uninitialized warnings on some compilers
+        __m512 load16(const float16 *values) {
+            return _mm512_maskz_cvtph_ps(0xffff, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values)));
+        }
+
+        // Updates 16 junctions from their half precision neighbours, multiplying last (see float16_row_kernel)
+        __m256i update_float16(const __m512 x_neighbours, const float16 *yp, const float16 *yn, const float16 *zp,
+                               const float16 *zn, const float16 *out) {
+            __m512 sum = _mm512_add_ps(x_neighbours, _mm512_add_ps(load16(yp), load16(yn)));
+            sum = _mm512_add_ps(sum, _mm512_add_ps(load16(zp), load16(zn)));
+            const __m512 next = _mm512_mul_ps(_mm512_fnmadd_ps(_mm512_set1_ps(3.0f), load16(out), sum),
+                                              _mm512_set1_ps(1.0f / 3.0f));
+            return _mm512_maskz_cvtps_ph(0xffff, next, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        }
+
+    } // namespace
+
+    void update_row_float16_avx512(float16 *out, const float16 *c, const float16 *yp, const float16 *yn,
+                                   const float16 *zp, const float16 *zn, const int n, const float xn,
+                                   const float xp) {
+        if (n < 17) {
+            update_row_float16_avx2(out, c, yp, yn, zp, zn, n, xn, xp);
+            return;
+        }
+        // Same vectors as the AVX2 kernel, 16 junctions wide, as 16-bit masked loads need AVX-512BW. The permutations
+        // are zero-masked with all lanes enabled, like the conversions
+        const __m512i shift_up = _mm512_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14);
+        const __m512i shift_down = _mm512_setr_epi32(1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 15);
+        const __m512 first_left = _mm512_mask_blend_ps(0x0001, _mm512_maskz_permutexvar_ps(0xffff, shift_up, load16(c)),
+                                                       _mm512_set1_ps(xn));
+        const __m512 last_right =
+                _mm512_mask_blend_ps(0x8000, _mm512_maskz_permutexvar_ps(0xffff, shift_down, load16(c + n - 16)),
+                                     _mm512_set1_ps(xp));
+        const __m256i first = update_float16(_mm512_add_ps(first_left, load16(c + 1)), yp, yn, zp, zn, out);
+        const __m256i last = update_float16(_mm512_add_ps(load16(c + n - 17), last_right), yp + n - 16, yn + n - 16,
+                                            zp + n - 16, zn + n - 16, out + n - 16);
+        __m256i interior_end = _mm256_setzero_si256();
+        if (n > 32) {
+            const int x = n - 32;
+            interior_end = update_float16(_mm512_add_ps(load16(c + x + 1), load16(c + x - 1)), yp + x, yn + x,
+                                          zp + x, zn + x, out + x);
+        }
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), first);
+        for (int x = 16; x + 16 <= n - 16; x += 16) {
+            const __m512 x_neighbours = _mm512_add_ps(load16(c + x + 1), load16(c + x - 1));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + x),
+                                update_float16(x_neighbours, yp + x, yn + x, zp + x, zn + x, out + x));
+        }
+        if (n > 32)
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + n - 32), interior_end);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + n - 16), last);
+    }
+
+    void load_float16_avx512(float *out, const float16 *in, const int stride, const int n) {
+        int j = 0;
+        if (stride == 1) {
+            for (; j + 16 <= n; j += 16)
+                _mm512_storeu_ps(out + j, load16(in + j));
+        }
+        for (; j < n; j++)
+            out[j] = _cvtsh_ss(in[j * stride].bits);
+    }
+
+    void store_float16_avx512(float16 *out, const float *in, const int n) {
+        int j = 0;
+        for (; j + 16 <= n; j += 16)
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + j),
+                                _mm512_maskz_cvtps_ph(0xffff, _mm512_loadu_ps(in + j),
+                                                      _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+        for (; j < n; j++)
+            out[j].bits = _cvtss_sh(in[j], _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    }
+
+    void scatter_affine_avx512(float *buffer, const int *index, const float *a, const float *b, const int n) {
+        for (int j = 0; j < n; j += 16) {
+            const int remaining = n - j;
+            const __mmask16 m = remaining >= 16 ? static_cast<__mmask16>(0xffff)
+                                                : static_cast<__mmask16>((1u << remaining) - 1u);
+            const __m512i i = _mm512_maskz_loadu_epi32(m, index + j);
+            const __m512 v = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), m, i, buffer, 4);
+            const __m512 r = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, a + j), v, _mm512_maskz_loadu_ps(m, b + j));
+            _mm512_mask_i32scatter_ps(buffer, m, i, r, 4);
+        }
+    }
+
+    void gather_scaled_avx512(const float *buffer, const int *index, const float *w, float *out, const int n) {
+        for (int j = 0; j < n; j += 16) {
+            const int remaining = n - j;
+            const __mmask16 m = remaining >= 16 ? static_cast<__mmask16>(0xffff)
+                                                : static_cast<__mmask16>((1u << remaining) - 1u);
+            const __m512i i = _mm512_maskz_loadu_epi32(m, index + j);
+            const __m512 v = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), m, i, buffer, 4);
+            _mm512_mask_storeu_ps(out + j, m, _mm512_mul_ps(_mm512_maskz_loadu_ps(m, w + j), v));
+        }
+    }
+
+    float peak_abs_avx512(const float *values, const int n) {
+        const __m512i magnitude = _mm512_set1_epi32(0x7fffffff);
+        __m512 peak = _mm512_setzero_ps();
+        for (int j = 0; j < n; j += 16) {
+            const int remaining = n - j;
+            const __mmask16 m = remaining >= 16 ? static_cast<__mmask16>(0xffff)
+                                                : static_cast<__mmask16>((1u << remaining) - 1u);
+            const __m512i v = _mm512_maskz_loadu_epi32(m, values + j);
+            peak = _mm512_mask_max_ps(peak, m, peak, _mm512_castsi512_ps(_mm512_maskz_and_epi32(m, v, magnitude)));
+        }
+        // Reduced through memory, the 512 to 256 bits casts trip uninitialized warnings on some compilers
+        alignas(64) float lanes[16];
+        _mm512_store_ps(lanes, peak);
+        float value = 0.0f;
+        for (const float lane : lanes)
+            value = lane > value ? lane : value;
+        return value;
+    }
+
+} // namespace dwm::kernels
+
+#endif
@@ -0,0 +1,66 @@
+// Compiled with the x86-64 baseline flags (SSE2)
+#include "dwm_kernels.h"
+
+#ifdef DWM_KERNELS_X86_64
+#include <immintrin.h>
+
+namespace dwm::kernels {
+
+    void update_row_sse(float *out, const float *c, const float *yp, const float *yn, const float *zp,
+                        const float *zn, const int n, const float xn, const float xp) {
+        if (n < 2) {
+            update_row_scalar(out, c, yp, yn, zp, zn, n, xn, xp);
+            return;
+        }
+        out[0] = (c[1] + xn + yp[0] + yn[0] + zp[0] + zn[0]) / 3.0f - out[0];
+
+        const __m128 third = _mm_set1_ps(1.0f / 3.0f);
+        int x = 1;
+        for (; x + 4 <= n - 1; x += 4) {
+            __m128 sum = _mm_add_ps(_mm_loadu_ps(c + x + 1), _mm_loadu_ps(c + x - 1));
+            sum = _mm_add_ps(sum, _mm_add_ps(_mm_loadu_ps(yp + x), _mm_loadu_ps(yn + x)));
+            sum = _mm_add_ps(sum, _mm_add_ps(_mm_loadu_ps(zp + x), _mm_loadu_ps(zn + x)));
+            _mm_storeu_ps(out + x, _mm_sub_ps(_mm_mul_ps(sum, third), _mm_loadu_ps(out + x)));
+        }
+        for (; x < n - 1; x++)
+            out[x] = (c[x + 1] + c[x - 1] + yp[x] + yn[x] + zp[x] + zn[x]) / 3.0f - out[x];
+
+        out[n - 1] = (xp + c[n - 2] + yp[n - 1] + yn[n - 1] + zp[n - 1] + zn[n - 1]) / 3.0f - out[n - 1];
+    }
+
+    void update_row_interpolated_sse(float *out, const float *const *rows, float *scratch, const int n,
+                                     const float xn, const float xp, const float weight, const float center) {
+        const float *r0 = rows[0], *r1 = rows[1], *r2 = rows[2], *r3 = rows[3], *c = rows[4];
+        const float *r5 = rows[5], *r6 = rows[6], *r7 = rows[7], *r8 = rows[8];
+        float *t = scratch + 1;
+
+        // Weighted sums across y and z first, then across x from the stored sums
+        const __m128 two = _mm_set1_ps(2.0f), four = _mm_set1_ps(4.0f);
+        int x = 0;
+        for (; x + 4 <= n; x += 4) {
+            const __m128 corners = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(r0 + x), _mm_loadu_ps(r2 + x)),
+                                              _mm_add_ps(_mm_loadu_ps(r6 + x), _mm_loadu_ps(r8 + x)));
+            const __m128 edges = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(r1 + x), _mm_loadu_ps(r3 + x)),
+                                            _mm_add_ps(_mm_loadu_ps(r5 + x), _mm_loadu_ps(r7 + x)));
+            _mm_storeu_ps(t + x, _mm_add_ps(_mm_add_ps(corners, _mm_mul_ps(two, edges)),
+                                            _mm_mul_ps(four, _mm_loadu_ps(c + x))));
+        }
+        for (; x < n; x++)
+            t[x] = (r0[x] + r2[x] + r6[x] + r8[x]) + 2.0f * (r1[x] + r3[x] + r5[x] + r7[x]) + 4.0f * c[x];
+        scratch[0] = 16.0f * xn;
+        t[n] = 16.0f * xp;
+
+        const __m128 w = _mm_set1_ps(weight), k = _mm_set1_ps(center);
+        for (x = 0; x + 4 <= n; x += 4) {
+            const __m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(t + x - 1), _mm_loadu_ps(t + x + 1)),
+                                          _mm_mul_ps(two, _mm_loadu_ps(t + x)));
+            _mm_storeu_ps(out + x, _mm_sub_ps(_mm_add_ps(_mm_mul_ps(w, sum), _mm_mul_ps(k, _mm_loadu_ps(c + x))),
+                                              _mm_loadu_ps(out + x)));
+        }
+        for (; x < n; x++)
+            out[x] = weight * (t[x - 1] + t[x + 1] + 2.0f * t[x]) + center * c[x] - out[x];
+    }
+
+} // namespace dwm::kernels
+
+#endif
@@ -0,0 +1,471 @@
+#ifndef DWM_NESTED_H
+#define DWM_NESTED_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "dwm.h"
+#include "dwm_occupancy.h"
+#include "dwm_workers.h"
+
+namespace dwm {
+
+    /// Fine mesh following the listener inside a coarse mesh covering the whole space, so that the listener's
+    /// surroundings are simulated at a high sample rate while the rest of the space only costs a mesh running several
+    /// times slower\n
+    /// The fine mesh runs ratio times faster than the coarse one, its junctions being ratio times closer, and its
+    /// origin is kept on a coarse junction. The coupling is one way: every source is simulated by the coarse mesh,
+    /// which carries the whole space's response at its own bandwidth, and the faces of the fine mesh are portals (see
+    /// mesh_3d::add_portal) reading the coarse field just outside them, sampled at each coarse step and linearly
+    /// interpolated for the fine steps in between. The sources inside the fine mesh are additionally simulated by it,
+    /// with their full bandwidth. Feeding the fine field back into the coarse mesh would let waves bounce between both
+    /// discretizations, which grows without bound\n
+    /// Blocks are at the fine rate. The coarse mesh's sources are averaged over each coarse step and scaled down by the
+    /// ratio, a source's field being inversely proportional to the junction density, and the receivers outside the fine
+    /// mesh linearly interpolated between coarse steps. The fine mesh is moved by whole coarse junctions when the point
+    /// it follows (see follow) drifts away from its center, at the start of a block falling on a coarse step: the
+    /// junctions still inside it keep their values and the others are interpolated from the coarse mesh, without
+    /// resetting anything
+    /// @param coarse_mesh mesh_3d type covering the whole space, which defines its dimensions and boundary filters
+    /// @param fine_mesh mesh_3d type following the listener, at an integer multiple of the coarse mesh's sample rate
+    template<typename coarse_mesh, typename fine_mesh>
+    class nested_mesh final {
+    public:
+        /// Fine steps per coarse step, and fine junctions per coarse junction along each axis
+        static constexpr int ratio = fine_mesh::step_rate() / coarse_mesh::step_rate();
+
+        /// Builds a new instance, the fine mesh being centered in the coarse one
+        /// @param max_workers maximum number of workers the update can be split into (see worker_pool)
+        /// @param pages pages backing the meshes' junctions, see arena
+        explicit nested_mesh(const int max_workers = 1, const page_mode pages = page_mode::transparent_huge) :
+            coarse(std::make_unique<coarse_mesh>(max_workers, pages)),
+            fine(std::make_unique<fine_mesh>(max_workers, pages)) {
+            static_assert(fine_mesh::step_rate() % coarse_mesh::step_rate() == 0 &&
+                          "the fine mesh must run at an integer multiple of the coarse mesh's sample rate");
+            static_assert(max_origin[0] >= 1 && max_origin[1] >= 1 && max_origin[2] >= 1 &&
+                          "the fine mesh must fit inside the coarse mesh, one coarse junction away from its faces");
+            for (int side = 0; side < 6; side++) {
+                interface &f = faces[side];
+                const size_t size = static_cast<size_t>(face_size(side)[0]) * face_size(side)[1];
+                for (std::vector<float> *values: {&f.ghost_previous, &f.ghost_next, &f.face_previous, &f.face_next,
+                                                  &f.ghost_residual, &f.face_residual, &f.incoming})
+                    values->assign(size, 0.0f);
+                fine->add_portal(static_cast<mesh_side>(side), 0, 0, face_size(side)[0], face_size(side)[1],
+                                 f.incoming.data());
+            }
+            patch.reserve(static_cast<size_t>((std::max({fine_size[0], fine_size[1], fine_size[2]}) - 1) / ratio + 2) *
+                          ((std::max({fine_size[0], fine_size[1], fine_size[2]}) - 1) / ratio + 2));
+            const auto coarse_size = coarse_mesh::junction_dimensions();
+            for (int k = 0; k < 3; k++) {
+                origin[k] = std::clamp((coarse_size[k] - fine_size[k] / ratio) / 2, 1, max_origin[k]);
+                target[k] = origin[k];
+            }
+        }
+
+        // No copy constructor
+        nested_mesh(const nested_mesh &other) = delete;
+        // No copy assignment operator
+        nested_mesh &operator=(const nested_mesh &other) = delete;
+        // No move constructor
+        nested_mesh(nested_mesh &&other) noexcept = delete;
+        // No move assignment operator
+        nested_mesh &operator=(nested_mesh &&other) noexcept = delete;
+
+        /// @return the coarse mesh
+        [[nodiscard]] coarse_mesh &coarse_part() { return *coarse; }
+
+        /// @return the fine mesh
+        [[nodiscard]] fine_mesh &fine_part() { return *fine; }
+
+        /// @return the number of junctions of both meshes, solid ones included
+        [[nodiscard]] static constexpr int junction_count() {
+            return coarse_mesh::junction_count() + fine_mesh::junction_count();
+        }
+
+        /// @return the number of junctions per meter of the fine mesh, which blocks are sampled from near the
+        /// listener
+        [[nodiscard]] static constexpr float junction_density() { return fine_mesh::junction_density(); }
+
+        /// @return the number of air junctions of both meshes
+        [[nodiscard]] int air_junction_count() const {
+            return coarse->air_junction_count() + fine->air_junction_count();
+        }
+
+        /// @return the number of junction updates computed by both meshes since they were built
+        [[nodiscard]] uint64_t junction_updates() const {
+            return coarse->junction_updates() + fine->junction_updates();
+        }
+
+        /// @return the pages actually backing the coarse mesh's junctions
+        [[nodiscard]] page_mode pages() const { return coarse->pages(); }
+
+        /// @return world coordinates of the fine mesh's (0, 0, 0) corner
+        [[nodiscard]] std::array<float, 3> fine_origin() const {
+            return {static_cast<float>(origin[0]) / coarse_density, static_cast<float>(origin[1]) / coarse_density,
+                    static_cast<float>(origin[2]) / coarse_density};
+        }
+
+        /// Sets the point the fine mesh is centered on, from the next block starting on a coarse step. The mesh is
+        /// only moved once the point is more than a quarter of its size away from its center, so that a listener
+        /// moving back and forth does not move it at every block
+        /// @param x world x coordinate, usually the listener's
+        /// @param y world y coordinate
+        /// @param z world z coordinate
+        void follow(const float x, const float y, const float z) {
+            const float point[3] = {x, y, z};
+            for (int k = 0; k < 3; k++) {
+                const float center = (static_cast<float>(origin[k]) + static_cast<float>(fine_size[k] - 1) /
+                                      (2.0f * ratio)) / coarse_density;
+                if (std::abs(point[k] - center) * fine_mesh::junction_density() > static_cast<float>(fine_size[k]) / 4)
+                    target[k] = std::clamp(static_cast<int>(std::lround(point[k] * coarse_density -
+                                                                         static_cast<float>(fine_size[k] - 1) /
+                                                                         (2.0f * ratio))),
+                                           1, max_origin[k]);
+                else
+                    target[k] = origin[k];
+            }
+        }
+
+        /// Marks the junctions of both meshes lying in the solid voxels of an occupancy grid (see
+        /// mesh_3d::set_occupancy), the grid is kept to mark the fine mesh again whenever it moves
+        /// @param grid occupancy grid in world coordinates
+        void set_occupancy(const occupancy_grid &grid) {
+            occupancy = grid;
+            coarse->set_occupancy(occupancy);
+            fine->set_occupancy(occupancy, fine_origin());
+        }
+
+        /// Marks all the junctions of both meshes as air again
+        void clear_occupancy() {
+            occupancy = occupancy_grid();
+            coarse->clear_occupancy();
+            fine->clear_occupancy();
+        }
+
+        /// Sets the peak value below which regions of both meshes fall asleep (see mesh_3d::set_sleep_threshold)
+        void set_sleep_threshold(const float threshold) {
+            coarse->set_sleep_threshold(threshold);
+            fine->set_sleep_threshold(threshold);
+        }
+
+        /// @return the fraction of the tiles of both meshes currently updated, weighted by the junction updates they
+        /// stand for
+        [[nodiscard]] float awake_fraction() const {
+            constexpr float coarse_weight = static_cast<float>(coarse_mesh::junction_count());
+            constexpr float fine_weight = static_cast<float>(fine_mesh::junction_count()) * ratio;
+            return (coarse->awake_fraction() * coarse_weight + fine->awake_fraction() * fine_weight) /
+                   (coarse_weight + fine_weight);
+        }
+
+        /// Resets both meshes to the initial state, the fine mesh being moved to the point it follows at once
+        void reset() {
+            coarse->reset();
+            fine->reset();
+            phase = 0;
+            for (interface &f: faces) {
+                for (std::vector<float> *values: {&f.ghost_previous, &f.ghost_next, &f.face_previous, &f.face_next,
+                                                  &f.ghost_residual, &f.face_residual, &f.incoming})
+                    std::fill(values->begin(), values->end(), 0.0f);
+            }
+            std::fill(coarse_values.begin(), coarse_values.end(), 0.0f);
+            if (origin != target) {
+                origin = target;
+                if (!occupancy.empty())
+                    fine->set_occupancy(occupancy, fine_origin());
+            }
+        }
+
+        /// @copydoc mesh_3d::reserve_block
+        void reserve_block(const int sources, const int receivers) {
+            coarse->reserve_block(sources, 0);
+            fine->reserve_block(sources, receivers);
+            fine_sources.reserve(sources);
+            coarse_sources.reserve(sources);
+            fine_receivers.reserve(receivers);
+            coarse_receivers.reserve(receivers);
+            coarse_values.reserve(2 * static_cast<size_t>(receivers));
+        }
+
+        /// Same as mesh_3d::update_block, with the same boundary parameters for both meshes (the fine mesh's faces
+        /// being portals, only the coarse mesh's boundaries are filtered). Receivers are read from the fine mesh when
+        /// inside it, from the coarse mesh otherwise
+        /// @param steps number of sample steps of the block, at the fine mesh's rate
+        template<typename params_t>
+        void update_block(const params_t &xp_params, const params_t &xn_params, const params_t &yp_params,
+                          const params_t &yn_params, const params_t &zp_params, const params_t &zn_params,
+                          const int steps, const block_source *sources, const int source_count,
+                          const block_receiver *receivers, const int receiver_count, worker_pool *workers = nullptr) {
+            if (steps <= 0)
+                return;
+            if (phase == 0 && origin != target)
+                move();
+
+            // Every source is simulated by the coarse mesh, with its samples averaged over the fine steps around each
+            // coarse step (truncated at the block's edges) and scaled by coarse_gain, and also by the fine mesh when
+            // inside it
+            const int first_coarse_step = (ratio - phase) % ratio; // Fine step the block's first coarse step falls on
+            const int coarse_steps = std::max(0, (steps - first_coarse_step + ratio - 1) / ratio);
+            fine_sources.clear();
+            coarse_sources.clear();
+            coarse_samples.resize(static_cast<size_t>(coarse_steps) * source_count);
+            const std::array<float, 3> o = fine_origin();
+            for (int s = 0; s < source_count; s++) {
+                block_source local = sources[s];
+                float *samples = coarse_samples.data() + static_cast<size_t>(s) * coarse_steps;
+                for (int k = 0; k < coarse_steps; k++) {
+                    const int center = first_coarse_step + k * ratio;
+                    const int first = std::max(0, center - ratio / 2);
+                    const int last = std::min(steps, center - ratio / 2 + ratio);
+                    float sum = 0.0f;
+                    for (int n = first; n < last; n++)
+                        sum += local.samples[n];
+                    samples[k] = sum / static_cast<float>(last - first) * coarse_gain;
+                }
+                local.samples = samples;
+                coarse_sources.push_back(local);
+                if (inside_fine(sources[s].x, sources[s].y, sources[s].z)) {
+                    local = sources[s];
+                    to_fine(o, local.x, local.y, local.z);
+                    to_fine(o, local.start_x, local.start_y, local.start_z);
+                    fine_sources.push_back(local);
+                }
+            }
+            fine_receivers.clear();
+            coarse_receivers.clear();
+            if (coarse_values.size() != 2 * static_cast<size_t>(receiver_count))
+                coarse_values.assign(2 * static_cast<size_t>(receiver_count), 0.0f);
+            for (int r = 0; r < receiver_count; r++) {
+                block_receiver local = receivers[r];
+                if (inside_fine(local.x, local.y, local.z)) {
+                    to_fine(o, local.x, local.y, local.z);
+                    to_fine(o, local.start_x, local.start_y, local.start_z);
+                    fine_receivers.push_back(local);
+                } else {
+                    coarse_receivers.push_back(r);
+                }
+            }
+
+            fine->begin_block(steps, fine_sources.data(), static_cast<int>(fine_sources.size()),
+                              fine_receivers.data(), static_cast<int>(fine_receivers.size()));
+            coarse->begin_block(coarse_steps, coarse_sources.data(), static_cast<int>(coarse_sources.size()),
+                                nullptr, 0);
+            for (int n = 0; n < steps; n++) {
+                if (phase == 0) {
+                    coarse->step_block(xp_params, xn_params, yp_params, yn_params, zp_params, zn_params, workers);
+                    sample_interface();
+                    for (const int r: coarse_receivers) {
+                        const block_receiver &rec = receivers[r];
+                        const float t = static_cast<float>(std::min(steps, n + ratio)) / static_cast<float>(steps);
+                        const float x = rec.moving ? std::lerp(rec.start_x, rec.x, t) : rec.x;
+                        const float y = rec.moving ? std::lerp(rec.start_y, rec.y, t) : rec.y;
+                        const float z = rec.moving ? std::lerp(rec.start_z, rec.z, t) : rec.z;
+                        coarse_values[2 * r] = coarse_values[2 * r + 1];
+                        coarse_values[2 * r + 1] = coarse->read_value(x, y, z);
+                    }
+                }
+
+                couple_faces();
+                fine->step_block(xp_params, xn_params, yp_params, yn_params, zp_params, zn_params, workers);
+                const float u = static_cast<float>(phase + 1) / ratio;
+                for (const int r: coarse_receivers)
+                    receivers[r].samples[n * receivers[r].stride] =
+                            std::lerp(coarse_values[2 * r], coarse_values[2 * r + 1], u);
+
+                phase = (phase + 1) % ratio;
+            }
+        }
+
+    private:
+        static constexpr float coarse_density = coarse_mesh::junction_density();
+        // Gain of the coarse mesh's sources, which match the fine mesh's level once scaled by the densities' ratio
+        static constexpr float coarse_gain = coarse_density / fine_mesh::junction_density();
+        static constexpr std::array<int, 3> fine_size = fine_mesh::junction_dimensions();
+        // Largest origin keeping the coarse junctions read around the fine mesh inside the coarse mesh
+        static constexpr std::array<int, 3> max_origin = {
+                coarse_mesh::junction_dimensions()[0] - 1 - (fine_size[0] + ratio - 1) / ratio,
+                coarse_mesh::junction_dimensions()[1] - 1 - (fine_size[1] + ratio - 1) / ratio,
+                coarse_mesh::junction_dimensions()[2] - 1 - (fine_size[2] + ratio - 1) / ratio};
+
+        std::unique_ptr<coarse_mesh> coarse;
+        std::unique_ptr<fine_mesh> fine;
+        std::array<int, 3> origin; // Coarse junction the fine mesh's (0, 0, 0) junction lies on
+        std::array<int, 3> target; // Origin the fine mesh is moved to at the next block starting on a coarse step
+        int phase = 0; // Fine steps since the last coarse step
+        occupancy_grid occupancy; // Kept to mark the fine mesh again when it moves
+
+        // Coupling of a face of the fine mesh, each vector holding one value per junction of the face in the portal's
+        // layout: the coarse field is imposed on the ghosts beyond the face, while the residual, where the fine field
+        // differs from the coarse one (e.g. the bandwidth the coarse mesh lacks), leaves through a first order
+        // absorbing condition instead of being reflected back by the imposed values
+        struct interface {
+            std::vector<float> ghost_previous, ghost_next; // Coarse field one fine junction beyond the face
+            std::vector<float> face_previous, face_next; // Coarse field on the face
+            std::vector<float> ghost_residual, face_residual; // Residuals of the previous fine step
+            std::vector<float> incoming; // Portal values of the current fine step
+        };
+        std::array<interface, 6> faces;
+        std::vector<float> patch; // Coarse junctions around a face, see sample_face
+
+        // Per block routing, see update_block
+        std::vector<block_source> fine_sources, coarse_sources;
+        std::vector<float> coarse_samples; // Averaged samples of the sources, source-major
+        std::vector<block_receiver> fine_receivers;
+        std::vector<int> coarse_receivers; // Indices of the receivers read from the coarse mesh
+        std::vector<float> coarse_values; // Last two coarse values of each receiver, kept across blocks
+
+        // Linear interpolation without the exactness guarantees of std::lerp, whose branches slow down the loops over
+        // the faces' junctions
+        [[nodiscard]] static float blend(const float a, const float b, const float t) { return a + (b - a) * t; }
+
+        // Dimensions (u, v) of a face of the fine mesh, see mesh_side
+        [[nodiscard]] static constexpr std::array<int, 2> face_size(const int side) {
+            return side < 2 ? std::array<int, 2>{fine_size[1], fine_size[2]}
+                            : side < 4 ? std::array<int, 2>{fine_size[0], fine_size[2]}
+                                       : std::array<int, 2>{fine_size[0], fine_size[1]};
+        }
+
+        // Whether a world coordinate lies within half a fine junction of the fine mesh's junctions
+        [[nodiscard]] bool inside_fine(const float x, const float y, const float z) const {
+            const float point[3] = {x, y, z};
+            for (int k = 0; k < 3; k++) {
+                const float local = point[k] * fine_mesh::junction_density() - static_cast<float>(origin[k] * ratio);
+                if (local < -0.5f || local > static_cast<float>(fine_size[k]) - 0.5f)
+                    return false;
+            }
+            return true;
+        }
+
+        // Converts world coordinates to the fine mesh's coordinates
+        static void to_fine(const std::array<float, 3> &o, float &x, float &y, float &z) {
+            x -= o[0];
+            y -= o[1];
+            z -= o[2];
+        }
+
+        // Calls function(side, j, x, y, z) for the j-th junction of each face of the fine mesh, in the portals' layout,
+        // lying layer junctions beyond the face (0 being the face itself)
+        template<typename function>
+        static void for_each_face_junction(const int layer, function &&f) {
+            for (int side = 0; side < 6; side++) {
+                const int axis = side / 2, u_axis = axis == 0 ? 1 : 0, v_axis = axis == 2 ? 1 : 2;
+                const int beyond = side % 2 == 0 ? fine_size[axis] - 1 + layer : -layer;
+                const auto [u_size, v_size] = face_size(side);
+                for (int v = 0; v < v_size; v++) {
+                    for (int u = 0; u < u_size; u++) {
+                        int junction[3];
+                        junction[axis] = beyond;
+                        junction[u_axis] = u;
+                        junction[v_axis] = v;
+                        f(side, v * u_size + u, junction[0], junction[1], junction[2]);
+                    }
+                }
+            }
+        }
+
+        // Samples the coarse field on and beyond the faces of the fine mesh at the coarse mesh's current step, the
+        // previous samples being kept to interpolate the fine steps in between
+        void sample_interface() {
+            for (interface &f: faces) {
+                f.ghost_previous.swap(f.ghost_next);
+                f.face_previous.swap(f.face_next);
+            }
+            for (int side = 0; side < 6; side++) {
+                sample_face(side, 1, faces[side].ghost_next);
+                sample_face(side, 0, faces[side].face_next);
+            }
+        }
+
+        // Samples the coarse field at the junctions of a face of the fine mesh, layer junctions beyond it: the fine
+        // junctions lying at fixed fractions of the coarse spacing, the coarse junctions around the face are gathered
+        // once, interpolated along the face's normal, then upsampled along the face
+        void sample_face(const int side, const int layer, std::vector<float> &values) {
+            const int axis = side / 2, u_axis = axis == 0 ? 1 : 0, v_axis = axis == 2 ? 1 : 2;
+            const auto [u_size, v_size] = face_size(side);
+            // Coarse junctions spanned by the face along u and v, plus the one closing the last interval
+            const int patch_u = (u_size - 1) / ratio + 2, patch_v = (v_size - 1) / ratio + 2;
+            // Position of the layer along the normal, in fine junctions from the coarse mesh's origin
+            const int normal = origin[axis] * ratio + (side % 2 == 0 ? fine_size[axis] - 1 + layer : -layer);
+            const int n_0 = normal / ratio;
+            const float n_f = static_cast<float>(normal % ratio) / ratio;
+            patch.resize(static_cast<size_t>(patch_u) * patch_v);
+            for (int v = 0; v < patch_v; v++) {
+                for (int u = 0; u < patch_u; u++) {
+                    int junction[3];
+                    junction[axis] = n_0;
+                    junction[u_axis] = origin[u_axis] + u;
+                    junction[v_axis] = origin[v_axis] + v;
+                    float value = coarse->junction_value(junction[0], junction[1], junction[2]);
+                    if (n_f > 0.0f) {
+                        junction[axis] = n_0 + 1;
+                        value = blend(value, coarse->junction_value(junction[0], junction[1], junction[2]), n_f);
+                    }
+                    patch[static_cast<size_t>(v) * patch_u + u] = value;
+                }
+            }
+            for (int v = 0; v < v_size; v++) {
+                const float *row = patch.data() + static_cast<size_t>(v / ratio) * patch_u;
+                const float v_f = static_cast<float>(v % ratio) / ratio;
+                for (int u = 0; u < u_size; u++) {
+                    const int u_0 = u / ratio;
+                    const float u_f = static_cast<float>(u % ratio) / ratio;
+                    values[static_cast<size_t>(v) * u_size + u] =
+                            blend(blend(row[u_0], row[u_0 + 1], u_f),
+                                  blend(row[patch_u + u_0], row[patch_u + u_0 + 1], u_f), v_f);
+                }
+            }
+        }
+
+        // Computes the portal values of the current fine step: the coarse field interpolated at the fine step, plus
+        // the residual carried outwards by Mur's first order absorbing condition
+        void couple_faces() {
+            // Distance travelled in a step, in junctions
+            constexpr float courant =
+                    343.0f * fine_mesh::junction_density() / static_cast<float>(fine_mesh::step_rate());
+            constexpr float mur = (courant - 1.0f) / (courant + 1.0f);
+            const float t = static_cast<float>(phase) / ratio;
+            for_each_face_junction(0, [&](const int side, const int j, const int x, const int y, const int z) {
+                interface &f = faces[side];
+                const float face_residual =
+                        fine->junction_value(x, y, z) - blend(f.face_previous[j], f.face_next[j], t);
+                const float ghost_residual = f.face_residual[j] + mur * (face_residual - f.ghost_residual[j]);
+                f.face_residual[j] = face_residual;
+                f.ghost_residual[j] = ghost_residual;
+                f.incoming[j] = blend(f.ghost_previous[j], f.ghost_next[j], t) + ghost_residual;
+            });
+        }
+
+        // Moves the fine mesh to the target origin, between two blocks and on a coarse step: the fine mesh is then
+        // at the coarse mesh's time step, and its previous step is interpolated between the coarse mesh's two
+        void move() {
+            const std::array<int, 3> offset = {(target[0] - origin[0]) * ratio, (target[1] - origin[1]) * ratio,
+                                               (target[2] - origin[2]) * ratio};
+            origin = target;
+            const std::array<float, 3> o = fine_origin();
+            constexpr float spacing = 1.0f / fine_mesh::junction_density();
+            constexpr float previous_weight = 1.0f / ratio;
+            const auto fill = [&](const int x, const int y, const int z, const bool previous) {
+                const float w_x = o[0] + static_cast<float>(x) * spacing, w_y = o[1] + static_cast<float>(y) * spacing,
+                            w_z = o[2] + static_cast<float>(z) * spacing;
+                const float current = coarse->read_value(w_x, w_y, w_z);
+                return previous ? std::lerp(current, coarse->read_previous_value(w_x, w_y, w_z), previous_weight)
+                                : current;
+            };
+            fine->shift(offset[0], offset[1], offset[2], fill);
+            if (!occupancy.empty())
+                fine->set_occupancy(occupancy, o);
+            // The coarse field around the fine mesh's new faces, as of the coarse step the fine mesh is at, the
+            // residuals of the old faces being meaningless there
+            sample_interface();
+            for (interface &f: faces) {
+                std::fill(f.ghost_residual.begin(), f.ghost_residual.end(), 0.0f);
+                std::fill(f.face_residual.begin(), f.face_residual.end(), 0.0f);
+            }
+        }
+    };
+
+} // namespace dwm
+
+#endif
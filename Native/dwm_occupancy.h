@@ -0,0 +1,176 @@
+#ifndef DWM_OCCUPANCY_H
+#define DWM_OCCUPANCY_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace dwm {
+
+    /// Voxelized occupancy of a space, marking the solid voxels (walls, furniture, space outside the level) which
+    /// meshes leave out of their simulation (see mesh_3d::set_occupancy)\n
+    /// Stored on disk as a compact binary file: the "DWMO" magic, a 32-bit version, the number of voxels along x, y
+    /// and z (32-bit), the voxels' size and the world coordinates of the grid's (0, 0, 0) corner (32-bit floats), then
+    /// the lengths (32-bit) of the alternating runs of air and solid voxels in x->y->z order, starting with air. All
+    /// values are in the host's byte order, little endian on all the supported platforms
+    class occupancy_grid final {
+    public:
+        /// Builds an empty grid, in which everything is air
+        occupancy_grid() = default;
+
+        /// Builds a grid in which all the voxels are air
+        /// @param size_x number of voxels along the x axis
+        /// @param size_y number of voxels along the y axis
+        /// @param size_z number of voxels along the z axis
+        /// @param voxel_size size in meters of the voxels' edges
+        /// @param origin world coordinates of the grid's (0, 0, 0) corner
+        occupancy_grid(const int size_x, const int size_y, const int size_z, const float voxel_size,
+                       const std::array<float, 3> &origin = {}) :
+            size{std::max(0, size_x), std::max(0, size_y), std::max(0, size_z)}, voxel(voxel_size), origin(origin),
+            voxels(static_cast<size_t>(size[0]) * size[1] * size[2]) {}
+
+        /// @return the number of voxels along the x, y and z axes
+        [[nodiscard]] std::array<int, 3> dimensions() const { return size; }
+
+        /// @return the size in meters of the voxels' edges
+        [[nodiscard]] float voxel_size() const { return voxel; }
+
+        /// @return the world coordinates of the grid's (0, 0, 0) corner
+        [[nodiscard]] std::array<float, 3> grid_origin() const { return origin; }
+
+        /// @return whether the grid has no voxel
+        [[nodiscard]] bool empty() const { return voxels.empty(); }
+
+        /// @return whether a voxel is solid
+        [[nodiscard]] bool solid(const int x, const int y, const int z) const { return voxels[index(x, y, z)] != 0; }
+
+        /// Marks a voxel as solid or air
+        void set_solid(const int x, const int y, const int z, const bool solid) { voxels[index(x, y, z)] = solid; }
+
+        /// @return whether the voxel containing a world coordinate is solid, coordinates outside the grid are air
+        [[nodiscard]] bool solid_at(const float x, const float y, const float z) const {
+            if (voxels.empty() || !(voxel > 0.0f))
+                return false;
+            const int v_x = static_cast<int>(std::floor((x - origin[0]) / voxel));
+            const int v_y = static_cast<int>(std::floor((y - origin[1]) / voxel));
+            const int v_z = static_cast<int>(std::floor((z - origin[2]) / voxel));
+            if (v_x < 0 || v_y < 0 || v_z < 0 || v_x >= size[0] || v_y >= size[1] || v_z >= size[2])
+                return false;
+            return solid(v_x, v_y, v_z);
+        }
+
+        /// @return 64-bit FNV-1a hash of the grid's dimensions, placement and voxels, identifying the grid in what is
+        /// derived from it (e.g. the keys of ir::cache)
+        [[nodiscard]] uint64_t fingerprint() const {
+            uint64_t hash = 14695981039346656037ull;
+            const auto add = [&hash](const void *data, const size_t bytes) {
+                for (size_t i = 0; i < bytes; i++)
+                    hash = (hash ^ static_cast<const unsigned char *>(data)[i]) * 1099511628211ull;
+            };
+            add(size.data(), sizeof(size));
+            add(&voxel, sizeof(voxel));
+            add(origin.data(), sizeof(origin));
+            add(voxels.data(), voxels.size());
+            return hash;
+        }
+
+        /// Loads a grid from a file
+        /// @param path path of the file
+        /// @return whether the file was read, the grid is left unchanged when it is missing or malformed
+        bool load(const char *path) {
+            FILE *file = std::fopen(path, "rb");
+            if (file == nullptr)
+                return false;
+            occupancy_grid loaded;
+            const bool valid = loaded.read(file);
+            std::fclose(file);
+            if (valid)
+                *this = std::move(loaded);
+            return valid;
+        }
+
+        /// Saves the grid to a file
+        /// @param path path of the file, overwritten
+        /// @return whether the file was entirely written
+        bool save(const char *path) const {
+            FILE *file = std::fopen(path, "wb");
+            if (file == nullptr)
+                return false;
+            const bool valid = write(file);
+            return std::fclose(file) == 0 && valid;
+        }
+
+    private:
+        static constexpr char magic[4] = {'D', 'W', 'M', 'O'};
+        static constexpr uint32_t version = 1;
+
+        std::array<int, 3> size{};
+        float voxel = 0.0f;
+        std::array<float, 3> origin{};
+        std::vector<uint8_t> voxels; // Whether each voxel is solid, linearized in x->y->z order
+
+        [[nodiscard]] size_t index(const int x, const int y, const int z) const {
+            return (static_cast<size_t>(z) * size[1] + y) * size[0] + x;
+        }
+
+        bool read(FILE *file) {
+            char file_magic[4];
+            uint32_t file_version;
+            int32_t file_size[3];
+            if (std::fread(file_magic, sizeof(file_magic), 1, file) != 1 ||
+                std::memcmp(file_magic, magic, sizeof(magic)) != 0 ||
+                std::fread(&file_version, sizeof(file_version), 1, file) != 1 || file_version != version ||
+                std::fread(file_size, sizeof(file_size), 1, file) != 1 ||
+                std::fread(&voxel, sizeof(voxel), 1, file) != 1 ||
+                std::fread(origin.data(), sizeof(float), 3, file) != 3 || !(voxel > 0.0f))
+                return false;
+            for (int k = 0; k < 3; k++) {
+                if (file_size[k] < 0)
+                    return false;
+                size[k] = file_size[k];
+            }
+            voxels.assign(static_cast<size_t>(size[0]) * size[1] * size[2], 0);
+
+            // The runs must cover the grid exactly
+            size_t filled = 0;
+            bool solid_run = false;
+            uint32_t run;
+            while (filled < voxels.size()) {
+                if (std::fread(&run, sizeof(run), 1, file) != 1 || run > voxels.size() - filled)
+                    return false;
+                std::fill_n(voxels.begin() + static_cast<std::ptrdiff_t>(filled), run, solid_run);
+                filled += run;
+                solid_run = !solid_run;
+            }
+            return true;
+        }
+
+        bool write(FILE *file) const {
+            const int32_t file_size[3] = {size[0], size[1], size[2]};
+            bool valid = std::fwrite(magic, sizeof(magic), 1, file) == 1 &&
+                         std::fwrite(&version, sizeof(version), 1, file) == 1 &&
+                         std::fwrite(file_size, sizeof(file_size), 1, file) == 1 &&
+                         std::fwrite(&voxel, sizeof(voxel), 1, file) == 1 &&
+                         std::fwrite(origin.data(), sizeof(float), 3, file) == 3;
+            bool solid_run = false;
+            for (size_t first = 0; valid && first < voxels.size();) {
+                size_t last = first;
+                while (last < voxels.size() && (voxels[last] != 0) == solid_run)
+                    last++;
+                const auto run = static_cast<uint32_t>(last - first);
+                valid = std::fwrite(&run, sizeof(run), 1, file) == 1;
+                first = last;
+                solid_run = !solid_run;
+            }
+            return valid;
+        }
+    };
+
+} // namespace dwm
+
+#endif
@@ -0,0 +1,183 @@
+#ifndef DWM_PIPELINE_H
+#define DWM_PIPELINE_H
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "dwm_ring.h"
+#include "dwm_workers.h"
+
+namespace dwm {
+
+    /// Renders audio blocks on a dedicated real time thread, a fixed number of blocks behind the audio callback\n
+    /// Each call to process posts a request describing the current block and returns the block posted lookahead calls
+    /// earlier, so that the simulation has lookahead blocks worth of time to render it instead of the callback's own
+    /// deadline. Requests and rendered samples go through SPSC rings, the audio thread never blocks nor allocates: a
+    /// block which is not ready in time is a deadline miss, concealed by fading out the previous block, and its
+    /// samples are dropped when they eventually arrive so that the latency does not grow
+    template<typename request>
+    class block_pipeline final {
+    public:
+        /// Renders the block described by a request, called on the pipeline's thread in posting order
+        /// @param context opaque pointer passed at construction
+        /// @param r request as posted
+        /// @param out rendered interleaved samples, frames * channels as posted
+        /// @param frames number of frames to render
+        /// @param channels number of interleaved channels
+        typedef void (*render_job)(void *context, const request &r, float *out, int frames, int channels);
+
+        /// Spawns the pipeline's thread
+        /// @param job rendering function
+        /// @param context opaque pointer passed to the job
+        /// @param lookahead number of blocks the output is delayed by, at least 1
+        /// @param max_frames maximum number of frames per block
+        /// @param max_channels maximum number of channels per block
+        block_pipeline(const render_job job, void *context, const int lookahead, const int max_frames,
+                       const int max_channels) :
+            job(job), context(context), lookahead_blocks(std::max(1, lookahead)),
+            max_samples(static_cast<size_t>(max_frames) * max_channels), requests(lookahead_blocks + 2),
+            block_sizes(requests.capacity()), output(2 * requests.capacity() * max_samples), rendered(max_samples),
+            last(max_samples) {
+            thread = std::thread([this] {
+                configure_realtime_thread(0, false);
+                render_loop();
+            });
+        }
+
+        ~block_pipeline() {
+            stop.store(true, std::memory_order_seq_cst);
+            posted.fetch_add(1, std::memory_order_seq_cst);
+            posted.notify_one();
+            thread.join();
+        }
+        // No copy constructor
+        block_pipeline(const block_pipeline &other) = delete;
+        // No copy assignment operator
+        block_pipeline &operator=(const block_pipeline &other) = delete;
+        // No move constructor
+        block_pipeline(block_pipeline &&other) noexcept = delete;
+        // No move assignment operator
+        block_pipeline &operator=(block_pipeline &&other) noexcept = delete;
+
+        /// @return number of blocks the output is delayed by
+        [[nodiscard]] int lookahead() const { return lookahead_blocks; }
+
+        /// @return number of blocks which were not rendered in time, can be called from any thread
+        [[nodiscard]] unsigned int deadline_misses() const { return misses.load(std::memory_order_relaxed); }
+
+        /// Posts a block and outputs the one posted lookahead calls earlier, silence until the pipeline is primed\n
+        /// Must always be called from the same thread
+        /// @param r request describing the block, copied
+        /// @param out interleaved output samples
+        /// @param frames number of frames, at most max_frames
+        /// @param channels number of interleaved channels, at most max_channels
+        void process(const request &r, float *out, const int frames, const int channels) {
+            const size_t samples = static_cast<size_t>(frames) * channels;
+            if (!requests.push({r, frames, channels})) {
+                // The thread is stalled since more than lookahead blocks, the block is lost and nothing waits for it
+                conceal(out, samples);
+                return;
+            }
+            block_sizes[posted_count++ & (block_sizes.size() - 1)] = samples;
+            posted.fetch_add(1, std::memory_order_release);
+            posted.notify_one();
+
+            if (posted_count - consumed_count <= static_cast<uint64_t>(lookahead_blocks)) {
+                std::fill_n(out, samples, 0.0f);
+                return;
+            }
+
+            // Blocks which missed their deadline are dropped as they arrive, then the oldest pending one is due
+            const size_t late = std::min(dropped, output.read_available());
+            output.discard(late);
+            dropped -= late;
+            const size_t due = block_sizes[consumed_count++ & (block_sizes.size() - 1)];
+            if (dropped > 0 || output.read_available() < due) {
+                dropped += due;
+                conceal(out, samples);
+                return;
+            }
+            output.pop(last.data(), due);
+            last_samples = due;
+            last_channels = channels;
+            std::copy_n(last.data(), std::min(due, samples), out);
+            std::fill(out + std::min(due, samples), out + samples, 0.0f);
+
+            // Fade in after a miss, since the concealment ended in silence
+            if (faded) {
+                faded = false;
+                ramp(out, samples, channels, 0.0f, 1.0f);
+            }
+        }
+
+    private:
+        struct entry {
+            request r;
+            int frames, channels;
+        };
+
+        const render_job job;
+        void *const context;
+        const int lookahead_blocks;
+        const size_t max_samples;
+
+        spsc_ring<entry> requests; // Written by process, read by the thread
+        std::vector<size_t> block_sizes; // Number of samples of each posted block, only accessed by process
+        spsc_ring<float> output; // Written by the thread, read by process
+        std::vector<float> rendered; // Block being rendered, only accessed by the thread
+        std::vector<float> last; // Last block output by process
+        size_t last_samples = 0;
+        int last_channels = 1;
+        bool faded = false; // Whether the last block was faded out since it was output
+        uint64_t posted_count = 0, consumed_count = 0; // Blocks posted and blocks due so far
+        size_t dropped = 0; // Samples of missed blocks still to be dropped from the output
+
+        std::thread thread;
+        alignas(64) std::atomic<unsigned int> posted{0}; // Incremented for each request, also used as futex word
+        std::atomic<bool> stop{false};
+        std::atomic<unsigned int> misses{0};
+
+        // Outputs the last block faded out the first time, silence afterwards
+        void conceal(float *out, const size_t samples) {
+            misses.fetch_add(1, std::memory_order_relaxed);
+            std::fill_n(out, samples, 0.0f);
+            if (faded)
+                return;
+            faded = true;
+            const size_t n = std::min(samples, last_samples);
+            std::copy_n(last.data(), n, out);
+            ramp(out, n, last_channels, 1.0f, 0.0f);
+        }
+
+        // Applies a linear gain ramp across interleaved samples
+        static void ramp(float *samples, const size_t count, const int channels, const float from, const float to) {
+            const size_t frames = count / channels;
+            for (size_t f = 0; f < frames; f++) {
+                const float gain = from + (to - from) * (static_cast<float>(f) + 1.0f) / static_cast<float>(frames);
+                for (int c = 0; c < channels; c++)
+                    samples[f * channels + c] *= gain;
+            }
+        }
+
+        void render_loop() {
+            entry e;
+            while (true) {
+                // Render everything posted, then sleep until the next request
+                const unsigned int seen = posted.load(std::memory_order_acquire);
+                if (stop.load(std::memory_order_acquire))
+                    return;
+                while (requests.pop(&e, 1) == 1) {
+                    const size_t samples = static_cast<size_t>(e.frames) * e.channels;
+                    job(context, e.r, rendered.data(), e.frames, e.channels);
+                    // Room is always available, as blocks leave the ring at the pace they are posted
+                    output.push(rendered.data(), samples);
+                }
+                posted.wait(seen, std::memory_order_acquire);
+            }
+        }
+    };
+
+} // namespace dwm
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef DWM_RESAMPLER_H
+#define DWM_RESAMPLER_H
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <numeric>
+#include <vector>
+
+namespace dwm {
+
+    /// Streaming polyphase resampler between two integer sample rates\n
+    /// The rates ratio is reduced to up / down, each input sample is conceptually upsampled by up, low pass filtered
+    /// by a Kaiser windowed sinc and decimated by down, but only the filter phases which produce an output are
+    /// evaluated. Output samples are queued until pulled, all the state is allocated at construction
+    class resampler final {
+    public:
+        /// Builds a new instance
+        /// @param input_rate sample rate of the pushed samples
+        /// @param output_rate sample rate of the pulled samples
+        /// @param max_block maximum number of samples pushed or pulled at once
+        /// @param taps filter length in samples at the lower of the two rates, trades quality for speed
+        explicit resampler(const int input_rate, const int output_rate, const int max_block, const int taps = 32) {
+            const int g = std::gcd(input_rate, output_rate);
+            up = output_rate / g;
+            down = input_rate / g;
+            phase_taps = up == down ? 1 : std::max(1, (taps * std::max(up, down) + up - 1) / up);
+
+            // Prototype low pass at input_rate * up, cut slightly below the lower Nyquist frequency
+            const int length = phase_taps * up;
+            const double cutoff = 0.5 * 0.9 / std::max(up, down);
+            const double center = 0.5 * (length - 1);
+            constexpr double beta = 8.0, pi = std::numbers::pi;
+            std::vector<double> prototype(length);
+            double sum = 0.0;
+            for (int m = 0; m < length; m++) {
+                const double t = m - center;
+                const double sinc = t == 0.0 ? 1.0 : std::sin(2.0 * pi * cutoff * t) / (2.0 * pi * cutoff * t);
+                const double r = length > 1 ? (m - center) / center : 0.0;
+                const double window = bessel_i0(beta * std::sqrt(std::max(0.0, 1.0 - r * r))) / bessel_i0(beta);
+                prototype[m] = sinc * window;
+                sum += prototype[m];
+            }
+
+            // Split in phases, each stored reversed to be convolved with the history in chronological order, with a
+            // total gain of up so that each phase has roughly unity gain
+            coefficients.resize(static_cast<size_t>(up) * phase_taps);
+            for (int phase = 0; phase < up; phase++) {
+                for (int j = 0; j < phase_taps; j++)
+                    coefficients[phase * phase_taps + (phase_taps - 1 - j)] =
+                            static_cast<float>(prototype[phase + j * up] * up / sum);
+            }
+
+            history.resize(2 * static_cast<size_t>(phase_taps));
+            // Room for a whole pushed block plus a pulled block worth of leftovers
+            const int outputs_per_input = (up + down - 1) / down;
+            queue.resize(static_cast<size_t>(max_block) * (outputs_per_input + 1) + outputs_per_input + 1);
+            reset();
+        }
+
+        /// Clears the filter history and the queued output
+        void reset() {
+            std::fill(history.begin(), history.end(), 0.0f);
+            history_position = 0;
+            phase = 0;
+            queue_read = 0;
+            queue_size = 0;
+        }
+
+        /// @return number of output samples ready to be pulled
+        [[nodiscard]] int available() const { return queue_size; }
+
+        /// @return group delay of the filter, in output samples
+        [[nodiscard]] double latency() const { return 0.5 * (phase_taps * up - 1) / down; }
+
+        /// @return number of input samples which must be pushed before output_count samples can be pulled
+        [[nodiscard]] int required_input(const int output_count) const {
+            int missing = output_count - queue_size, inputs = 0;
+            for (int a = phase; missing > 0; inputs++) {
+                if (a < up) {
+                    const int produced = (up - 1 - a) / down + 1;
+                    missing -= produced;
+                    a += produced * down;
+                }
+                a -= up;
+            }
+            return inputs;
+        }
+
+        /// Filters input samples, queueing the resulting output samples
+        /// @param input input samples
+        /// @param count number of input samples
+        /// @param stride distance between consecutive input samples
+        void push(const float *input, const int count, const int stride = 1) {
+            for (int n = 0; n < count; n++) {
+                // History is stored twice so that the last phase_taps samples are always contiguous
+                const float x = input[n * stride];
+                history[history_position] = x;
+                history[history_position + phase_taps] = x;
+                history_position = history_position + 1 == phase_taps ? 0 : history_position + 1;
+
+                const float *window = history.data() + history_position;
+                for (; phase < up; phase += down) {
+                    const float *h = coefficients.data() + static_cast<size_t>(phase) * phase_taps;
+                    float y = 0.0f;
+                    for (int j = 0; j < phase_taps; j++)
+                        y += h[j] * window[j];
+                    const int size = static_cast<int>(queue.size());
+                    if (queue_size < size) {
+                        queue[(queue_read + queue_size) % size] = y;
+                        queue_size++;
+                    }
+                }
+                phase -= up;
+            }
+        }
+
+        /// Dequeues output samples
+        /// @param output output samples
+        /// @param count maximum number of output samples
+        /// @param stride distance between consecutive output samples
+        /// @return number of output samples written
+        int pull(float *output, const int count, const int stride = 1) {
+            const int pulled = std::min(count, queue_size);
+            const int size = static_cast<int>(queue.size());
+            for (int n = 0; n < pulled; n++) {
+                output[n * stride] = queue[queue_read];
+                queue_read = queue_read + 1 == size ? 0 : queue_read + 1;
+            }
+            queue_size -= pulled;
+            return pulled;
+        }
+
+    private:
+        int up, down; // Reduced output_rate / input_rate ratio
+        int phase_taps; // Filter taps per phase
+        std::vector<float> coefficients; // Reversed filter taps of each phase, phase-major
+        std::vector<float> history; // Last phase_taps input samples, stored twice
+        int history_position = 0;
+        int phase = 0; // Phase of the next output sample, in [0, up + down)
+        std::vector<float> queue; // Output samples ring buffer
+        int queue_read = 0, queue_size = 0;
+
+        // Modified Bessel function of the first kind of order 0, used by the Kaiser window
+        static double bessel_i0(const double x) {
+            double sum = 1.0, term = 1.0;
+            for (int k = 1; k < 32; k++) {
+                term *= (x / (2.0 * k)) * (x / (2.0 * k));
+                sum += term;
+            }
+            return sum;
+        }
+    };
+
+} // namespace dwm
+
+#endif
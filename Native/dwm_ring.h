@@ -0,0 +1,117 @@
+#ifndef DWM_RING_H
+#define DWM_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dwm {
+
+    /// Wait-free single producer single consumer ring buffer, allocated at construction\n
+    /// One thread may push while another one pops, the read and write counters are monotonic so that they double as
+    /// timestamps: the n-th item ever pushed is the n-th item ever popped
+    template<typename T>
+    class spsc_ring final {
+    public:
+        /// Builds a new instance
+        /// @param capacity minimum number of items the ring can hold, rounded up to a power of two
+        explicit spsc_ring(const size_t capacity) : items(std::bit_ceil(capacity)), mask(items.size() - 1) {}
+
+        // No copy constructor
+        spsc_ring(const spsc_ring &other) = delete;
+        // No copy assignment operator
+        spsc_ring &operator=(const spsc_ring &other) = delete;
+        // No move constructor
+        spsc_ring(spsc_ring &&other) noexcept = delete;
+        // No move assignment operator
+        spsc_ring &operator=(spsc_ring &&other) noexcept = delete;
+
+        /// @return number of items the ring can hold
+        [[nodiscard]] size_t capacity() const { return items.size(); }
+
+        /// @return number of items ever pushed, can be called from any thread
+        [[nodiscard]] uint64_t written() const { return write_count.load(std::memory_order_acquire); }
+
+        /// @return number of items ever popped, can be called from any thread
+        [[nodiscard]] uint64_t read() const { return read_count.load(std::memory_order_acquire); }
+
+        /// @return number of items which can be popped, consumer side
+        [[nodiscard]] size_t read_available() const {
+            return static_cast<size_t>(write_count.load(std::memory_order_acquire) -
+                                       read_count.load(std::memory_order_relaxed));
+        }
+
+        /// @return number of items which can be pushed, producer side
+        [[nodiscard]] size_t write_available() const {
+            return items.size() - static_cast<size_t>(write_count.load(std::memory_order_relaxed) -
+                                                      read_count.load(std::memory_order_acquire));
+        }
+
+        /// Pushes as many items as there is room for, producer side
+        /// @param source items to push
+        /// @param count number of items to push
+        /// @param stride distance between consecutive items in source
+        /// @return number of items pushed, the remaining ones are dropped
+        size_t push(const T *source, const size_t count, const size_t stride = 1) {
+            const uint64_t w = write_count.load(std::memory_order_relaxed);
+            const size_t n = std::min(count, write_available());
+            for (size_t i = 0; i < n; i++)
+                items[(w + i) & mask] = source[i * stride];
+            write_count.store(w + n, std::memory_order_release);
+            return n;
+        }
+
+        /// Pushes a single item, producer side
+        /// @return whether the item was pushed
+        bool push(const T &item) { return push(&item, 1) == 1; }
+
+        /// Pops as many items as available, consumer side
+        /// @param destination popped items
+        /// @param count maximum number of items to pop
+        /// @return number of items popped
+        size_t pop(T *destination, const size_t count) {
+            const uint64_t r = read_count.load(std::memory_order_relaxed);
+            const size_t n = std::min(count, read_available());
+            for (size_t i = 0; i < n; i++)
+                destination[i] = items[(r + i) & mask];
+            read_count.store(r + n, std::memory_order_release);
+            return n;
+        }
+
+        /// Reads the oldest item without popping it, consumer side
+        /// @return whether an item was available
+        bool peek(T &item) const {
+            if (read_available() == 0)
+                return false;
+            item = items[read_count.load(std::memory_order_relaxed) & mask];
+            return true;
+        }
+
+        /// Drops the oldest items, consumer side
+        /// @param count maximum number of items to drop
+        void discard(const size_t count = 1) {
+            const uint64_t r = read_count.load(std::memory_order_relaxed);
+            read_count.store(r + std::min(count, read_available()), std::memory_order_release);
+        }
+
+        /// Drops items until the given number of items has ever been popped, consumer side
+        /// @param count value of written() at which to resume reading
+        void discard_until(const uint64_t count) {
+            const uint64_t r = read_count.load(std::memory_order_relaxed);
+            if (count > r)
+                discard(static_cast<size_t>(count - r));
+        }
+
+    private:
+        std::vector<T> items;
+        size_t mask;
+        alignas(64) std::atomic<uint64_t> write_count{0}; // Owned by the producer
+        alignas(64) std::atomic<uint64_t> read_count{0}; // Owned by the consumer
+    };
+
+} // namespace dwm
+
+#endif
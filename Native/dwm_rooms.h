@@ -0,0 +1,438 @@
+#ifndef DWM_ROOMS_H
+#define DWM_ROOMS_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "dwm.h"
+#include "dwm_workers.h"
+
+namespace dwm {
+
+    /// Set of meshes (rooms) placed side by side and coupled through portals, so that the simulation's cost scales
+    /// with the rooms' volume instead of the volume of their bounding box\n
+    /// All the rooms run at the same sample rate and thus share a single lattice of junctions, which their origins
+    /// are snapped to. Rooms whose faces are one junction apart can be coupled over any rectangle of those faces: at
+    /// each time step the facing junctions exchange their values (see mesh_3d::add_portal), so that waves cross the
+    /// opening as if both rooms were a single mesh, while the rest of each face keeps its room's boundary filter\n
+    /// Sources and receivers are routed to the room containing them, or the nearest one when outside all of them. Their
+    /// stencils do not span several rooms, so within half a junction of a portal they are snapped to the nearest face
+    /// @param meshes mesh_3d type of each room, which defines its dimensions and boundary filters
+    template<typename... meshes>
+    class room_network final {
+        typedef std::tuple_element_t<0, std::tuple<meshes...>> first_mesh;
+
+    public:
+        /// Number of rooms
+        static constexpr int room_count = sizeof...(meshes);
+
+        /// Builds a new instance, without any portal
+        /// @param origins world coordinates of each room's (0, 0, 0) corner, snapped to the junctions' lattice
+        /// @param max_workers maximum number of workers the update can be split into (see worker_pool)
+        /// @param pages pages backing the rooms' junctions, see arena
+        explicit room_network(const std::array<std::array<float, 3>, room_count> &origins, const int max_workers = 1,
+                              const page_mode pages = page_mode::transparent_huge) :
+            rooms(room<meshes>(max_workers, pages)...) {
+            static_assert(((meshes::junction_density() == first_mesh::junction_density()) && ...) &&
+                          "all the rooms must run at the same sample rate");
+            for (int r = 0; r < room_count; r++) {
+                for (int k = 0; k < 3; k++)
+                    lattice_origins[r][k] = static_cast<int>(std::lround(origins[r][k] * density));
+            }
+            [this]<size_t... r>(std::index_sequence<r...>) {
+                ((lattice_sizes[r] = std::tuple_element_t<r, std::tuple<meshes...>>::junction_dimensions()), ...);
+            }(std::index_sequence_for<meshes...>{});
+        }
+
+        // No copy constructor
+        room_network(const room_network &other) = delete;
+        // No copy assignment operator
+        room_network &operator=(const room_network &other) = delete;
+        // No move constructor
+        room_network(room_network &&other) noexcept = delete;
+        // No move assignment operator
+        room_network &operator=(room_network &&other) noexcept = delete;
+
+        /// @return the number of junctions updated at each sample step, summed over all the rooms
+        [[nodiscard]] static constexpr int junction_count() { return (meshes::junction_count() + ...); }
+
+        /// @return the mesh of a room
+        template<int r>
+        [[nodiscard]] std::tuple_element_t<r, std::tuple<meshes...>> &mesh() {
+            return *std::get<r>(rooms).mesh;
+        }
+
+        /// @return world coordinates of a room's junctions bounds (x-, y-, z-, x+, y+, z+), the + bounds being one
+        /// junction past the room's last junctions, where the junctions of the room next to it start
+        [[nodiscard]] std::array<float, 6> bounds(const int r) const {
+            std::array<float, 6> b;
+            for (int k = 0; k < 3; k++) {
+                b[k] = static_cast<float>(lattice_origins[r][k]) / density;
+                b[k + 3] = static_cast<float>(lattice_origins[r][k] + lattice_sizes[r][k]) / density;
+            }
+            return b;
+        }
+
+        /// Couples two rooms over the junctions of their facing faces lying inside an opening
+        /// @param a index of the first room
+        /// @param b index of the second room
+        /// @param opening_min world coordinates of the opening's lower corner
+        /// @param opening_max world coordinates of the opening's upper corner
+        /// @return whether the rooms are one junction apart and their faces overlap inside the opening
+        bool add_portal(const int a, const int b, const std::array<float, 3> &opening_min,
+                        const std::array<float, 3> &opening_max) {
+            std::array<int, 3> lo, hi;
+            for (int k = 0; k < 3; k++) {
+                lo[k] = static_cast<int>(std::ceil(opening_min[k] * density));
+                hi[k] = static_cast<int>(std::floor(opening_max[k] * density)) + 1;
+            }
+            return couple(a, b, lo, hi);
+        }
+
+        /// Couples two rooms over the whole overlap of their facing faces
+        /// @param a index of the first room
+        /// @param b index of the second room
+        /// @return whether the rooms are one junction apart and their faces overlap
+        bool add_portal(const int a, const int b) {
+            constexpr int unbounded = std::numeric_limits<int>::max();
+            return couple(a, b, {-unbounded, -unbounded, -unbounded}, {unbounded, unbounded, unbounded});
+        }
+
+        /// Couples every pair of rooms over the whole overlap of their facing faces
+        /// @return number of portals added
+        int add_portals() {
+            int count = 0;
+            for (int a = 0; a < room_count; a++) {
+                for (int b = a + 1; b < room_count; b++)
+                    count += add_portal(a, b) ? 1 : 0;
+            }
+            return count;
+        }
+
+        /// Sets the parameters of a room's boundary filters, rigid walls (default constructed parameters) until then
+        template<int r, typename xp_params_t, typename xn_params_t, typename yp_params_t, typename yn_params_t,
+                 typename zp_params_t, typename zn_params_t>
+        void set_boundaries(const xp_params_t &xp_params, const xn_params_t &xn_params, const yp_params_t &yp_params,
+                            const yn_params_t &yn_params, const zp_params_t &zp_params,
+                            const zn_params_t &zn_params) {
+            std::get<r>(rooms).set_boundaries(xp_params, xn_params, yp_params, yn_params, zp_params, zn_params);
+        }
+
+        /// Sets the parameters of every room's boundary filters
+        template<typename params_t>
+        void set_boundaries(const params_t &xp_params, const params_t &xn_params, const params_t &yp_params,
+                            const params_t &yn_params, const params_t &zp_params, const params_t &zn_params) {
+            std::apply([&](auto &...r) { (r.set_boundaries(xp_params, xn_params, yp_params, yn_params, zp_params,
+                                                           zn_params), ...); },
+                       rooms);
+        }
+
+        /// Marks the junctions of every room lying in the solid voxels of an occupancy grid (see
+        /// mesh_3d::set_occupancy)
+        /// @param grid occupancy grid in world coordinates
+        void set_occupancy(const occupancy_grid &grid) {
+            for (int r = 0; r < room_count; r++) {
+                const std::array<float, 6> b = bounds(r);
+                visit(r, [&](auto &rm) { rm.mesh->set_occupancy(grid, {b[0], b[1], b[2]}); });
+            }
+        }
+
+        /// Marks all the junctions of every room as air again
+        void clear_occupancy() {
+            std::apply([](auto &...r) { (r.mesh->clear_occupancy(), ...); }, rooms);
+        }
+
+        /// @return the number of air junctions updated at each sample step, summed over all the rooms
+        [[nodiscard]] int air_junction_count() const {
+            return std::apply([](const auto &...r) { return (r.mesh->air_junction_count() + ...); }, rooms);
+        }
+
+        /// @return the number of junction updates computed since the rooms were built, summed over all the rooms
+        [[nodiscard]] uint64_t junction_updates() const {
+            return std::apply([](const auto &...r) { return (r.mesh->junction_updates() + ...); }, rooms);
+        }
+
+        /// Sets the peak value below which regions of every room fall asleep (see mesh_3d::set_sleep_threshold), a
+        /// sleeping room wakes up when the energy of a neighbour reaches their portal
+        void set_sleep_threshold(const float threshold) {
+            std::apply([threshold](auto &...r) { (r.mesh->set_sleep_threshold(threshold), ...); }, rooms);
+        }
+
+        /// @return the fraction of the tiles of all the rooms currently updated, weighted by the rooms' junctions
+        [[nodiscard]] float awake_fraction() const {
+            return std::apply(
+                    [](const auto &...r) {
+                        return ((r.mesh->awake_fraction() * static_cast<float>(r.mesh->junction_count())) + ...);
+                    },
+                    rooms) / static_cast<float>(junction_count());
+        }
+
+        /// Resets all the rooms to the initial state
+        void reset() {
+            std::apply([](auto &...r) { (r.mesh->reset(), ...); }, rooms);
+        }
+
+        /// @copydoc mesh_3d::reserve_block
+        void reserve_block(const int sources, const int receivers) {
+            std::apply(
+                    [&](auto &...r) {
+                        ((r.mesh->reserve_block(sources, receivers), r.sources.reserve(sources),
+                          r.receivers.reserve(receivers)),
+                         ...);
+                    },
+                    rooms);
+        }
+
+        /// Same as mesh_3d::update_block, with the same boundary parameters for every room
+        template<typename params_t>
+        void update_block(const params_t &xp_params, const params_t &xn_params, const params_t &yp_params,
+                          const params_t &yn_params, const params_t &zp_params, const params_t &zn_params,
+                          const int steps, const block_source *sources, const int source_count,
+                          const block_receiver *receivers, const int receiver_count, worker_pool *workers = nullptr) {
+            set_boundaries(xp_params, xn_params, yp_params, yn_params, zp_params, zn_params);
+            update_block(steps, sources, source_count, receivers, receiver_count, workers);
+        }
+
+        /// Same as mesh_3d::update_block, with the boundary parameters set for each room\n
+        /// Coupled rooms are advanced in lockstep, one time step at a time, the others are updated independently
+        /// (with temporal blocking). When more than one worker is available, whole rooms are dealt to the workers
+        /// instead of splitting each room's update across all of them
+        /// @param steps number of sample steps of the block
+        /// @param sources sources injected at each step, in order, in world coordinates
+        /// @param source_count number of sources
+        /// @param receivers points sampled at each step, in world coordinates
+        /// @param receiver_count number of receivers
+        /// @param workers optional pool the rooms are updated with
+        void update_block(const int steps, const block_source *sources, const int source_count,
+                          const block_receiver *receivers, const int receiver_count, worker_pool *workers = nullptr) {
+            // Route the sources and receivers to their room, in its own coordinates
+            std::apply([](auto &...r) { ((r.sources.clear(), r.receivers.clear()), ...); }, rooms);
+            for (int s = 0; s < source_count; s++) {
+                block_source local = sources[s];
+                const int r = locate(local.x, local.y, local.z);
+                to_local(r, local.x, local.y, local.z);
+                to_local(r, local.start_x, local.start_y, local.start_z);
+                visit(r, [&](auto &rm) { rm.sources.push_back(local); });
+            }
+            for (int i = 0; i < receiver_count; i++) {
+                block_receiver local = receivers[i];
+                const int r = locate(local.x, local.y, local.z);
+                to_local(r, local.x, local.y, local.z);
+                to_local(r, local.start_x, local.start_y, local.start_z);
+                visit(r, [&](auto &rm) { rm.receivers.push_back(local); });
+            }
+
+            const bool parallel = workers != nullptr && workers->worker_count() > 1 && room_count > 1;
+            update_job job{this, steps, parallel ? nullptr : workers};
+            if (links.empty()) {
+                if (parallel)
+                    workers->run(update_rooms, &job, room_count);
+                else
+                    update_rooms(&job, 0, 1);
+                return;
+            }
+
+            std::apply(
+                    [&](auto &...r) {
+                        (r.mesh->begin_block(steps, r.sources.data(), static_cast<int>(r.sources.size()),
+                                             r.receivers.data(), static_cast<int>(r.receivers.size())),
+                         ...);
+                    },
+                    rooms);
+            for (int n = 0; n < steps; n++) {
+                // Once every room sleeps the rest of the block is silent, the receivers are already zeroed
+                if (std::apply([](const auto &...r) { return (r.mesh->asleep() && ...); }, rooms))
+                    break;
+                // Each room reads the values its neighbours had before the step
+                for (const auto &l: links) {
+                    visit(l->a, [&](auto &rm) {
+                        rm.mesh->read_face(l->side_a, l->u_a, l->v_a, l->u_size, l->v_size, l->from_a.data());
+                    });
+                    visit(l->b, [&](auto &rm) {
+                        rm.mesh->read_face(l->side_b, l->u_b, l->v_b, l->u_size, l->v_size, l->from_b.data());
+                    });
+                }
+                if (parallel)
+                    workers->run(step_rooms, &job, room_count);
+                else
+                    step_rooms(&job, 0, 1);
+            }
+        }
+
+    private:
+        // Junctions per meter, shared by all the rooms
+        static constexpr float density = first_mesh::junction_density();
+
+        // A room's mesh, boundary parameters and per block state
+        template<typename mesh_t>
+        struct room {
+            std::unique_ptr<mesh_t> mesh;
+            typename mesh_t::xp_filter_params xp_params{};
+            typename mesh_t::xn_filter_params xn_params{};
+            typename mesh_t::yp_filter_params yp_params{};
+            typename mesh_t::yn_filter_params yn_params{};
+            typename mesh_t::zp_filter_params zp_params{};
+            typename mesh_t::zn_filter_params zn_params{};
+            std::vector<block_source> sources; // Sources of the block inside the room, in room coordinates
+            std::vector<block_receiver> receivers; // Receivers of the block inside the room, in room coordinates
+
+            room(const int max_workers, const page_mode pages) :
+                mesh(std::make_unique<mesh_t>(max_workers, pages)) {}
+
+            template<typename xp_params_t, typename xn_params_t, typename yp_params_t, typename yn_params_t,
+                     typename zp_params_t, typename zn_params_t>
+            void set_boundaries(const xp_params_t &xp, const xn_params_t &xn, const yp_params_t &yp,
+                                const yn_params_t &yn, const zp_params_t &zp, const zn_params_t &zn) {
+                xp_params = xp;
+                xn_params = xn;
+                yp_params = yp;
+                yn_params = yn;
+                zp_params = zp;
+                zn_params = zn;
+            }
+
+            void step(worker_pool *workers) {
+                mesh->step_block(xp_params, xn_params, yp_params, yn_params, zp_params, zn_params, workers);
+            }
+        };
+
+        // Pair of facing rectangles of two rooms' faces, with the values read from each side before each step
+        struct link {
+            int a, b;
+            mesh_side side_a, side_b;
+            int u_a, v_a, u_b, v_b, u_size, v_size;
+            std::vector<float> from_a, from_b;
+        };
+
+        // Arguments of an update shared by all the workers
+        struct update_job {
+            room_network *network;
+            int steps;
+            worker_pool *workers; // Pool each room's update is split across, when rooms are not dealt to workers
+        };
+
+        std::tuple<room<meshes>...> rooms;
+        std::array<std::array<int, 3>, room_count> lattice_origins; // Lattice coordinates of each room's first junction
+        std::array<std::array<int, 3>, room_count> lattice_sizes; // Number of junctions of each room along each axis
+        std::vector<std::unique_ptr<link>> links; // Stable addresses, as the meshes' portals point to their values
+
+        // Calls f with the r-th room
+        template<typename function>
+        void visit(const int r, function &&f) {
+            [&]<size_t... i>(std::index_sequence<i...>) {
+                ((static_cast<int>(i) == r ? (f(std::get<i>(rooms)), 0) : 0), ...);
+            }(std::index_sequence_for<meshes...>{});
+        }
+
+        // Index of the room containing a point, or of the nearest one
+        // Rooms are split half way between their junctions, as a point beyond a room's last junctions is clamped to
+        // them, so that points between two coupled rooms are snapped to the nearest junctions
+        [[nodiscard]] int locate(const float x, const float y, const float z) const {
+            const float point[3] = {x * density, y * density, z * density};
+            int nearest = 0;
+            float nearest_distance = std::numeric_limits<float>::infinity();
+            for (int r = 0; r < room_count; r++) {
+                bool inside = true;
+                float distance = 0.0f;
+                for (int k = 0; k < 3; k++) {
+                    const float lo = static_cast<float>(lattice_origins[r][k]) - 0.5f;
+                    const float hi = lo + static_cast<float>(lattice_sizes[r][k]);
+                    const float outside = std::max(lo - point[k], point[k] - hi);
+                    inside = inside && point[k] >= lo && point[k] < hi;
+                    distance += outside > 0.0f ? outside * outside : 0.0f;
+                }
+                if (inside)
+                    return r;
+                if (distance < nearest_distance) {
+                    nearest = r;
+                    nearest_distance = distance;
+                }
+            }
+            return nearest;
+        }
+
+        // Converts world coordinates to a room's coordinates
+        void to_local(const int r, float &x, float &y, float &z) const {
+            x -= static_cast<float>(lattice_origins[r][0]) / density;
+            y -= static_cast<float>(lattice_origins[r][1]) / density;
+            z -= static_cast<float>(lattice_origins[r][2]) / density;
+        }
+
+        // Couples two rooms over the junctions of the lattice in [lo, hi) along each axis
+        bool couple(const int a, const int b, const std::array<int, 3> &lo, const std::array<int, 3> &hi) {
+            if (a < 0 || b < 0 || a >= room_count || b >= room_count || a == b)
+                return false;
+            const auto &o_a = lattice_origins[a], &o_b = lattice_origins[b];
+            const auto &s_a = lattice_sizes[a], &s_b = lattice_sizes[b];
+            for (int k = 0; k < 3; k++) {
+                // Room a must end one junction before room b along k, or the opposite
+                const bool a_first = o_a[k] + s_a[k] == o_b[k];
+                if (!a_first && o_b[k] + s_b[k] != o_a[k])
+                    continue;
+
+                // Axes of the faces' (u, v) coordinates, see mesh_side
+                const int u_axis = k == 0 ? 1 : 0, v_axis = k == 2 ? 1 : 2;
+                int begin[3], end[3];
+                for (const int j: {u_axis, v_axis}) {
+                    begin[j] = std::max({o_a[j], o_b[j], lo[j]});
+                    end[j] = std::min({o_a[j] + s_a[j], o_b[j] + s_b[j], hi[j]});
+                    if (end[j] <= begin[j])
+                        return false;
+                }
+
+                auto l = std::make_unique<link>();
+                l->a = a;
+                l->b = b;
+                // Sides are ordered xp, xn, yp, yn, zp, zn
+                l->side_a = static_cast<mesh_side>(2 * k + (a_first ? 0 : 1));
+                l->side_b = static_cast<mesh_side>(2 * k + (a_first ? 1 : 0));
+                l->u_a = begin[u_axis] - o_a[u_axis];
+                l->v_a = begin[v_axis] - o_a[v_axis];
+                l->u_b = begin[u_axis] - o_b[u_axis];
+                l->v_b = begin[v_axis] - o_b[v_axis];
+                l->u_size = end[u_axis] - begin[u_axis];
+                l->v_size = end[v_axis] - begin[v_axis];
+                l->from_a.resize(static_cast<size_t>(l->u_size) * l->v_size);
+                l->from_b.resize(l->from_a.size());
+                visit(a, [&](auto &rm) {
+                    rm.mesh->add_portal(l->side_a, l->u_a, l->v_a, l->u_size, l->v_size, l->from_b.data());
+                });
+                visit(b, [&](auto &rm) {
+                    rm.mesh->add_portal(l->side_b, l->u_b, l->v_b, l->u_size, l->v_size, l->from_a.data());
+                });
+                links.push_back(std::move(l));
+                return true;
+            }
+            return false;
+        }
+
+        // Updates the whole block of the rooms assigned to a worker, for rooms which are not coupled
+        static void update_rooms(void *context, const int worker, const int worker_count) {
+            const auto *job = static_cast<const update_job *>(context);
+            for (int r = worker; r < room_count; r += worker_count) {
+                job->network->visit(r, [&](auto &rm) {
+                    rm.mesh->update_block(rm.xp_params, rm.xn_params, rm.yp_params, rm.yn_params, rm.zp_params,
+                                          rm.zn_params, job->steps, rm.sources.data(),
+                                          static_cast<int>(rm.sources.size()), rm.receivers.data(),
+                                          static_cast<int>(rm.receivers.size()), job->workers);
+                });
+            }
+        }
+
+        // Advances the rooms assigned to a worker by one step of the block
+        static void step_rooms(void *context, const int worker, const int worker_count) {
+            const auto *job = static_cast<const update_job *>(context);
+            for (int r = worker; r < room_count; r += worker_count)
+                job->network->visit(r, [&](auto &rm) { rm.step(job->workers); });
+        }
+    };
+
+} // namespace dwm
+
+#endif
@@ -0,0 +1,220 @@
+#ifndef DWM_STATS_H
+#define DWM_STATS_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace dwm {
+
+    /// Statistics of the rendered blocks, recorded by the rendering threads and readable from any thread\n
+    /// Every value is a relaxed atomic, so that neither recording nor reading ever blocks: a snapshot taken while a
+    /// block is being recorded may mix that block with the previous ones
+    class render_statistics final {
+    public:
+        /// Values of a snapshot, in order
+        enum value {
+            blocks, // Blocks rendered
+            overruns, // Blocks which took longer to render than their duration
+            last_block_ms, // Rendering time of the last block
+            mean_block_ms, // Mean rendering time of the blocks
+            peak_block_ms, // Longest rendering time of a block
+            last_budget, // Rendering time of the last block, in percent of its duration
+            peak_budget, // Highest rendering time of a block, in percent of its duration
+            active_sources, // Sources injected in the mesh by the last block
+            sleeping_tiles, // Percentage of the mesh's tiles asleep at the end of the last block
+            junction_updates_per_second, // Junction updates computed per second spent rendering
+            value_count
+        };
+
+        /// Bins of the histogram of the rendering time, in percent of the blocks' duration: histogram_bin_width
+        /// percent wide from 0, the last bin also counting the blocks beyond it
+        static constexpr int histogram_bins = 40;
+        static constexpr float histogram_bin_width = 5.0f;
+
+        render_statistics() = default;
+        // No copy constructor
+        render_statistics(const render_statistics &other) = delete;
+        // No copy assignment operator
+        render_statistics &operator=(const render_statistics &other) = delete;
+
+        /// Records a rendered block, lock and wait free
+        /// @param seconds time spent rendering the block
+        /// @param duration duration of the block's samples, in seconds
+        /// @param sources number of sources injected in the mesh
+        /// @param awake_fraction fraction of the mesh's tiles updated at the end of the block
+        /// @param junction_updates number of junction updates computed for the block
+        void record_block(const double seconds, const double duration, const int sources, const float awake_fraction,
+                          const uint64_t junction_updates) {
+            const auto ns = static_cast<uint64_t>(seconds * 1e9);
+            const float budget = duration > 0.0 ? static_cast<float>(100.0 * seconds / duration) : 0.0f;
+            block_count.fetch_add(1, std::memory_order_relaxed);
+            if (budget > 100.0f)
+                overrun_count.fetch_add(1, std::memory_order_relaxed);
+            total_ns.fetch_add(ns, std::memory_order_relaxed);
+            last_ns.store(ns, std::memory_order_relaxed);
+            raise(peak_ns, ns);
+            raise(interval_peak_ns, ns);
+            last_percent.store(budget, std::memory_order_relaxed);
+            raise(peak_percent, budget);
+            raise(interval_peak_percent, budget);
+            const int bin = std::min(static_cast<int>(budget / histogram_bin_width), histogram_bins - 1);
+            histogram_counts[bin].fetch_add(1, std::memory_order_relaxed);
+            source_count.store(sources, std::memory_order_relaxed);
+            asleep.store(100.0f * (1.0f - awake_fraction), std::memory_order_relaxed);
+            updates.fetch_add(junction_updates, std::memory_order_relaxed);
+        }
+
+        /// Copies the current values
+        /// @param values value_count values in the order of the value enumeration, fewer if count is lower
+        /// @param count maximum number of values to copy
+        /// @return number of values copied
+        int snapshot(float *values, const int count) const {
+            const uint64_t n = block_count.load(std::memory_order_relaxed);
+            const uint64_t total = total_ns.load(std::memory_order_relaxed);
+            const float all[value_count] = {
+                    static_cast<float>(n),
+                    static_cast<float>(overrun_count.load(std::memory_order_relaxed)),
+                    static_cast<float>(last_ns.load(std::memory_order_relaxed)) * 1e-6f,
+                    n > 0 ? static_cast<float>(static_cast<double>(total) * 1e-6 / static_cast<double>(n)) : 0.0f,
+                    static_cast<float>(peak_ns.load(std::memory_order_relaxed)) * 1e-6f,
+                    last_percent.load(std::memory_order_relaxed),
+                    peak_percent.load(std::memory_order_relaxed),
+                    static_cast<float>(source_count.load(std::memory_order_relaxed)),
+                    asleep.load(std::memory_order_relaxed),
+                    total > 0 ? static_cast<float>(static_cast<double>(updates.load(std::memory_order_relaxed)) *
+                                                   1e9 / static_cast<double>(total))
+                              : 0.0f};
+            const int copied = std::clamp(count, 0, static_cast<int>(value_count));
+            std::copy_n(all, copied, values);
+            return copied;
+        }
+
+        /// Copies the histogram of the rendering time, see histogram_bins
+        /// @param counts blocks counted by each bin, fewer bins if count is lower
+        /// @param count maximum number of bins to copy
+        /// @return number of bins copied
+        int histogram(float *counts, const int count) const {
+            const int copied = std::clamp(count, 0, histogram_bins);
+            for (int b = 0; b < copied; b++)
+                counts[b] = static_cast<float>(histogram_counts[b].load(std::memory_order_relaxed));
+            return copied;
+        }
+
+        /// Takes the longest rendering time of a block since the previous call, see statistics_trace
+        /// @return longest rendering time in milliseconds and in percent of the block's duration
+        std::pair<float, float> take_interval_peak() {
+            return {static_cast<float>(interval_peak_ns.exchange(0, std::memory_order_relaxed)) * 1e-6f,
+                    interval_peak_percent.exchange(0.0f, std::memory_order_relaxed)};
+        }
+
+        /// @return total rendering time and junction updates recorded so far, see statistics_trace
+        [[nodiscard]] std::pair<uint64_t, uint64_t> totals() const {
+            return {total_ns.load(std::memory_order_relaxed), updates.load(std::memory_order_relaxed)};
+        }
+
+        /// Clears all the values, blocks recorded concurrently may be partially kept
+        void reset() {
+            for (auto *v: {&block_count, &overrun_count, &total_ns, &last_ns, &peak_ns, &interval_peak_ns, &updates})
+                v->store(0, std::memory_order_relaxed);
+            for (auto *v: {&last_percent, &peak_percent, &interval_peak_percent, &asleep})
+                v->store(0.0f, std::memory_order_relaxed);
+            source_count.store(0, std::memory_order_relaxed);
+            for (auto &bin: histogram_counts)
+                bin.store(0, std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<uint64_t> block_count{0}, overrun_count{0};
+        std::atomic<uint64_t> total_ns{0}, last_ns{0}, peak_ns{0}, interval_peak_ns{0};
+        std::atomic<float> last_percent{0.0f}, peak_percent{0.0f}, interval_peak_percent{0.0f};
+        std::atomic<int> source_count{0};
+        std::atomic<float> asleep{0.0f};
+        std::atomic<uint64_t> updates{0};
+        std::atomic<uint64_t> histogram_counts[histogram_bins] = {};
+
+        // Raises an atomic maximum to a value
+        template<typename T>
+        static void raise(std::atomic<T> &maximum, const T value) {
+            T current = maximum.load(std::memory_order_relaxed);
+            while (value > current && !maximum.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+            }
+        }
+    };
+
+    /// Periodically appends the statistics of a render_statistics to a CSV file, from a thread of its own so that the
+    /// rendering threads never touch the file: each line covers the blocks rendered since the previous one
+    class statistics_trace final {
+    public:
+        /// Opens the file and spawns the trace's thread
+        /// @param stats statistics to trace, must outlive the trace
+        /// @param file file to append to, truncated, closed by the trace
+        /// @param interval time between two lines
+        statistics_trace(render_statistics &stats, FILE *file, const std::chrono::milliseconds interval) :
+            stats(stats), file(file), interval(interval) {
+            std::fputs("time_s,blocks,overruns,mean_block_ms,peak_block_ms,peak_budget_percent,active_sources,"
+                       "sleeping_tiles_percent,junction_updates_per_second\n",
+                       file);
+            thread = std::thread([this] { trace_loop(); });
+        }
+
+        ~statistics_trace() {
+            {
+                const std::lock_guard lock(mutex);
+                stop = true;
+            }
+            wake.notify_one();
+            thread.join();
+            std::fclose(file);
+        }
+        // No copy constructor
+        statistics_trace(const statistics_trace &other) = delete;
+        // No copy assignment operator
+        statistics_trace &operator=(const statistics_trace &other) = delete;
+
+    private:
+        render_statistics &stats;
+        FILE *file;
+        std::chrono::milliseconds interval;
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable wake;
+        bool stop = false;
+
+        void trace_loop() {
+            const auto start = std::chrono::steady_clock::now();
+            float last[render_statistics::value_count];
+            stats.snapshot(last, render_statistics::value_count);
+            auto [last_ns, last_updates] = stats.totals();
+            stats.take_interval_peak();
+            std::unique_lock lock(mutex);
+            while (!wake.wait_for(lock, interval, [this] { return stop; })) {
+                float now[render_statistics::value_count];
+                stats.snapshot(now, render_statistics::value_count);
+                const auto [ns, updates] = stats.totals();
+                const auto [peak_ms, peak_budget] = stats.take_interval_peak();
+                const float blocks = now[render_statistics::blocks] - last[render_statistics::blocks];
+                const double seconds = static_cast<double>(ns - last_ns) * 1e-9;
+                std::fprintf(file, "%.3f,%.0f,%.0f,%.4f,%.4f,%.2f,%.0f,%.2f,%.0f\n",
+                             std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), blocks,
+                             now[render_statistics::overruns] - last[render_statistics::overruns],
+                             blocks > 0.0f ? seconds * 1e3 / blocks : 0.0, peak_ms, peak_budget,
+                             now[render_statistics::active_sources], now[render_statistics::sleeping_tiles],
+                             seconds > 0.0 ? static_cast<double>(updates - last_updates) / seconds : 0.0);
+                std::fflush(file);
+                std::copy_n(now, static_cast<int>(render_statistics::value_count), last);
+                last_ns = ns;
+                last_updates = updates;
+            }
+        }
+    };
+
+} // namespace dwm
+
+#endif
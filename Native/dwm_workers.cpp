@@ -0,0 +1,139 @@
+#include <algorithm>
+#include "dwm_workers.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace dwm {
+
+    namespace {
+
+        // Number of polls before a waiting thread yields or sleeps, a few microseconds on current CPUs
+        constexpr int spin_iterations = 4096;
+
+        void cpu_relax() {
+#if defined(__x86_64__) || defined(_M_X64)
+            _mm_pause();
+#endif
+        }
+
+    } // namespace
+
+    void configure_realtime_thread(const int core, const bool pin) {
+#ifdef _WIN32
+        if (pin) {
+            const DWORD_PTR mask = static_cast<DWORD_PTR>(1) << (core % (8 * sizeof(DWORD_PTR)));
+            SetThreadAffinityMask(GetCurrentThread(), mask);
+        }
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+#elif defined(__linux__)
+        if (pin) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(core % CPU_SETSIZE, &set);
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        }
+        sched_param param{};
+        param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+        pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+#else
+        (void) core;
+        (void) pin;
+#endif
+    }
+
+    worker_pool::worker_pool(const int max_workers, const bool pin) :
+        slots(std::max(1, max_workers > 0 ? max_workers : static_cast<int>(std::thread::hardware_concurrency()))) {
+        const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+        threads.reserve(slots.size() - 1);
+        for (int worker = 1; worker < static_cast<int>(slots.size()); worker++) {
+            threads.emplace_back([this, worker, cores, pin] {
+                // Worker 0 is usually scheduled on the first cores, so the others are pinned starting from the last
+                configure_realtime_thread(static_cast<int>(cores - 1 - (worker - 1) % cores), pin);
+                worker_loop(worker);
+            });
+        }
+    }
+
+    worker_pool::~worker_pool() {
+        stop.store(true, std::memory_order_seq_cst);
+        for (int worker = 1; worker < max_workers(); worker++) {
+            slots[worker].generation.fetch_add(1, std::memory_order_seq_cst);
+            slots[worker].generation.notify_one();
+        }
+        for (auto &thread: threads)
+            thread.join();
+    }
+
+    void worker_pool::set_worker_count(const int count) {
+        active_count.store(std::clamp(count, 1, max_workers()), std::memory_order_relaxed);
+    }
+
+    void worker_pool::run(const job j, void *context, const int max_count) {
+        const int count = std::clamp(std::min(worker_count(), max_count), 1, max_workers());
+        if (count == 1) {
+            j(context, 0, 1);
+            return;
+        }
+
+        current_job = j;
+        current_context = context;
+        current_count = count;
+        remaining.store(count - 1, std::memory_order_relaxed);
+
+        // Start the workers, waking up only the ones that went to sleep
+        for (int worker = 1; worker < count; worker++) {
+            slot &s = slots[worker];
+            s.generation.fetch_add(1, std::memory_order_seq_cst);
+            if (s.sleeping.load(std::memory_order_seq_cst))
+                s.generation.notify_one();
+        }
+
+        j(context, 0, count);
+
+        // Barrier: the other workers are expected to finish at about the same time, so spin first
+        for (int spin = 0; remaining.load(std::memory_order_acquire) != 0; spin++) {
+            if (spin < spin_iterations)
+                cpu_relax();
+            else
+                std::this_thread::yield();
+        }
+    }
+
+    void worker_pool::worker_loop(const int worker) {
+        slot &s = slots[worker];
+        unsigned seen = 0;
+        while (true) {
+            // Wait for the next run, spinning first since runs are usually issued back to back (once per sample)
+            unsigned generation = s.generation.load(std::memory_order_acquire);
+            for (int spin = 0; generation == seen; spin++) {
+                if (spin < spin_iterations) {
+                    cpu_relax();
+                } else {
+                    s.sleeping.store(true, std::memory_order_seq_cst);
+                    s.generation.wait(seen, std::memory_order_seq_cst);
+                    s.sleeping.store(false, std::memory_order_relaxed);
+                }
+                generation = s.generation.load(std::memory_order_acquire);
+            }
+            seen = generation;
+
+            if (stop.load(std::memory_order_acquire))
+                return;
+
+            current_job(current_context, worker, current_count);
+            remaining.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+} // namespace dwm
@@ -0,0 +1,82 @@
+#ifndef DWM_WORKERS_H
+#define DWM_WORKERS_H
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace dwm {
+
+    /// Raises the calling thread's priority to real time, failures are ignored since it is only a hint
+    /// @param core core to pin the thread to
+    /// @param pin whether to pin the thread, otherwise core is ignored
+    void configure_realtime_thread(int core, bool pin);
+
+    /// Pool of pre-spawned worker threads, used to split a single mesh update across cores\n
+    /// Dispatching work never allocates nor locks: idle workers spin for a short while and then sleep on a futex
+    /// (std::atomic::wait), the dispatching thread takes part in the work as worker 0 and spins until all the
+    /// other workers are done, which acts as the barrier between consecutive time steps
+    class worker_pool final {
+    public:
+        /// Work executed by each participating worker
+        /// @param context opaque pointer passed to run
+        /// @param worker index of the worker, in the [0, worker_count) range, 0 being the dispatching thread
+        /// @param worker_count number of workers participating in the run
+        typedef void (*job)(void *context, int worker, int worker_count);
+
+        /// Spawns the workers, which are pinned to their own core when possible
+        /// @param max_workers maximum number of workers including the dispatching thread, 0 to use one per hardware
+        /// thread
+        /// @param pin whether to pin each spawned worker to a core
+        explicit worker_pool(int max_workers = 0, bool pin = true);
+        ~worker_pool();
+        // No copy constructor
+        worker_pool(const worker_pool &other) = delete;
+        // No copy assignment operator
+        worker_pool &operator=(const worker_pool &other) = delete;
+        // No move constructor
+        worker_pool(worker_pool &&other) noexcept = delete;
+        // No move assignment operator
+        worker_pool &operator=(worker_pool &&other) noexcept = delete;
+
+        /// @return the maximum number of workers, including the dispatching thread
+        [[nodiscard]] int max_workers() const { return static_cast<int>(slots.size()); }
+
+        /// @return the number of workers currently used by run
+        [[nodiscard]] int worker_count() const { return active_count.load(std::memory_order_relaxed); }
+
+        /// Changes the number of workers used by the next runs, can be called from any thread
+        /// @param count number of workers, clamped in the [1, max_workers] range
+        void set_worker_count(int count);
+
+        /// Runs the job on min(worker_count, max_count) workers and returns once all of them are done\n
+        /// Must always be called from the same thread
+        /// @param j job to execute
+        /// @param context opaque pointer passed to the job
+        /// @param max_count maximum number of workers the job can be split into
+        void run(job j, void *context, int max_count);
+
+    private:
+        // Per worker wake up state, padded to avoid false sharing between workers
+        struct alignas(64) slot {
+            std::atomic<unsigned> generation{0}; // Incremented to start the worker, also used as futex word
+            std::atomic<bool> sleeping{false}; // Whether the worker is (or is about to be) blocked on the futex
+        };
+
+        std::vector<slot> slots; // Slot 0 belongs to the dispatching thread and is never used
+        std::vector<std::thread> threads;
+        std::atomic<int> active_count{1};
+        alignas(64) std::atomic<int> remaining{0}; // Workers that did not finish the current run yet
+        std::atomic<bool> stop{false};
+
+        // Current run, written before starting the workers and only read by the participating ones
+        job current_job = nullptr;
+        void *current_context = nullptr;
+        int current_count = 0;
+
+        void worker_loop(int worker);
+    };
+
+} // namespace dwm
+
+#endif
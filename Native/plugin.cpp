@@ -1,46 +1,504 @@
 // ReSharper disable CppParameterMayBeConstPtrOrRef
 // ReSharper disable CppDFAConstantFunctionResult
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <numbers>
+#include <string>
+#include <thread>
+#include <utility>
+#include <variant>
+#include <vector>
 #include "AudioPluginUtil.h"
-#include "dwm.h"
 #include "plugin_config.h"
+#include "dwm_convolution.h"
+#include "dwm_hybrid.h"
+#include "dwm_ir_cache.h"
+#include "dwm_nested.h"
+#include "dwm_occupancy.h"
+#include "dwm_pipeline.h"
+#include "dwm_ring.h"
+#include "dwm_rooms.h"
+#include "dwm_stats.h"
+#include "simulation.h"
+#if DWM_HYBRID_RENDERER
+#include "binauraliser.h"
+#endif
 
-struct dwm_source_data_t {
+// Samples buffered per source, enough for a few blocks of any usual DSP buffer size
+static constexpr size_t dwm_source_ring_capacity = 8192;
+// Position updates buffered per source, one is pushed per frame
+static constexpr size_t dwm_position_ring_capacity = 64;
+// Source slots are allocated in chunks as sources are acquired, up to DWM_MAX_SOURCE_COUNT
+static constexpr int dwm_source_chunk_size = 16;
+static constexpr int dwm_source_max_chunks = (DWM_MAX_SOURCE_COUNT + dwm_source_chunk_size - 1) / dwm_source_chunk_size;
+#if DWM_AMBISONIC_ORDER > 0
+// Channels rendered by the mesh, the ambisonic channels of the listener's field
+static constexpr int dwm_mesh_channels = dwm::ambisonics::channel_count(DWM_AMBISONIC_ORDER);
+#else
+// Channels rendered by the mesh, the listener's ears
+static constexpr int dwm_mesh_channels = 2;
+#endif
+// DSP tick id before the first tick is claimed
+static constexpr uint64_t dwm_no_tick = ~uint64_t{0};
+// Blocks of the simulation's maximum size a DSP tick is rendered in at most, so that its output is allocated upfront:
+// samples of longer ticks beyond them are left silent
+static constexpr int dwm_max_tick_blocks = 8;
+#if DWM_HYBRID_RENDERER
+// Samples of the binauraliser's impulse response searched for its latency, when the simulation is created
+static constexpr int dwm_binaural_calibration_samples = 16384;
+#endif
+
+// Mesh sample rate of each quality tier, by increasing rate
+#define DWM_TIER_RATE(rate, width, height, depth) rate
+static constexpr int dwm_tier_rates[] = {DWM_QUALITY_TIERS(DWM_TIER_RATE)};
+static constexpr int dwm_tier_count = sizeof(dwm_tier_rates) / sizeof(dwm_tier_rates[0]);
+// Mesh size of each quality tier, in meters (the rooms' bounding box is simulated instead with DWM_ROOMS)
+#define DWM_TIER_SIZE(rate, width, height, depth) {width, height, depth}
+static constexpr float dwm_tier_sizes[][3] = {DWM_QUALITY_TIERS(DWM_TIER_SIZE)};
+
+// Tier simulated at DWM_SAMPLE_RATE with a DWM_MESH_WIDTH x DWM_MESH_HEIGHT x DWM_MESH_DEPTH mesh, selected when the
+// plugin is loaded
+static constexpr int DefaultTier() {
+    for (int tier = 0; tier < dwm_tier_count; tier++)
+        if (dwm_tier_rates[tier] == DWM_SAMPLE_RATE && dwm_tier_sizes[tier][0] == DWM_MESH_WIDTH &&
+            dwm_tier_sizes[tier][1] == DWM_MESH_HEIGHT && dwm_tier_sizes[tier][2] == DWM_MESH_DEPTH)
+            return tier;
+    return 0;
+}
+
+#ifdef DWM_ROOMS
+// Origin and size of each room, in meters
+#define DWM_ROOM_BOUNDS(x, y, z, width, height, depth) {x, y, z, width, height, depth}
+static constexpr float dwm_rooms[][6] = {DWM_ROOMS(DWM_ROOM_BOUNDS)};
+static constexpr int dwm_room_count = sizeof(dwm_rooms) / sizeof(dwm_rooms[0]);
+
+// Extent of the rooms' bounding box along an axis, from the world origin
+static constexpr float RoomsExtent(const int axis) {
+    float extent = 0.0f;
+    for (const auto &room: dwm_rooms)
+        extent = std::max(extent, room[axis] + room[3 + axis]);
+    return extent;
+}
+#else
+// The single room is the mesh of the quality tier
+static constexpr int dwm_room_count = 1;
+#endif
+
+// Source position, valid from the time-th sample written by the source onwards
+struct dwm_source_position_t {
     float p_x = 0.0f, p_y = 0.0f, p_z = 0.0f;
-    float buffer[DWM_BUFFER_SIZE] = {};
+    uint64_t time = 0;
+};
+
+// Each source is written by Unity's audio and main threads and read by the mesh callback, through one SPSC ring per
+// producer so that no side ever blocks or observes torn data
+struct dwm_source_data_t {
+    dwm::spsc_ring<float> samples{dwm_source_ring_capacity}; // Written by OnAudioFilterRead
+    dwm::spsc_ring<dwm_source_position_t> positions{dwm_position_ring_capacity}; // Written by LateUpdate
+    std::atomic<unsigned int> underruns{0}; // Blocks the mesh callback could not entirely fill
+    std::atomic<unsigned int> overruns{0}; // Writes dropped, entirely or partially, because a ring was full
+    std::atomic<bool> active{false}; // Whether the slot is currently acquired
+    std::atomic<unsigned int> generation{0}; // Incremented each time the slot is acquired
+    std::atomic<int> writers{0}; // Writes in progress into the rings, see WriteAcquiredSource
+    std::atomic<bool> baked{false}; // Whether to render the source with the baked impulse responses
+    uint64_t acquired_samples = 0, acquired_positions = 0; // Rings' write counts when last acquired
+    dwm_source_position_t position; // Position of the last consumed sample, only accessed by the mesh callback
+};
+
+struct dwm_source_chunk_t {
+    dwm_source_data_t slots[dwm_source_chunk_size];
 };
 
-static dwm_source_data_t dwm_source_data[DWM_MAX_SOURCE_COUNT] = {};
+// Source slots registry: chunks are only ever added, under dwm_sources_mutex, and published to the audio thread
+// through dwm_source_chunk_count, while changes to the set of acquired slots bump dwm_source_registry_version
+static std::mutex dwm_sources_mutex;
+static std::unique_ptr<dwm_source_chunk_t> dwm_source_chunk_storage[dwm_source_max_chunks];
+static std::atomic<dwm_source_chunk_t *> dwm_source_chunks[dwm_source_max_chunks];
+static std::atomic<int> dwm_source_chunk_count = 0;
+static std::atomic<unsigned int> dwm_source_registry_version = 0;
+static std::vector<int> dwm_free_sources;
+
+// The simulation's per source state grows along with the registry, see AddSourceChunk
+namespace DWM_Mesh_Simulation {
+    struct data_t;
+    struct simulation_t;
+    struct shared_t;
+    void AddSourceChunk(simulation_t *sim, int chunk);
+    void AddSourceChunks(const shared_t *shared, int chunk);
+    unsigned int DeadlineMisses(const shared_t *shared);
+    bool SwitchTier(int tier);
+    bool StartBake(const char *path, float listener_spacing, float source_spacing, int yaw_count, int length);
+} // namespace DWM_Mesh_Simulation
+// Effect instances, in creation order, and the simulation they share: it is created with the first instance and
+// deleted with the last one, under dwm_simulation_mutex, and published under dwm_sources_mutex
+static std::vector<DWM_Mesh_Simulation::data_t *> dwm_effects;
+static DWM_Mesh_Simulation::shared_t *dwm_simulation = nullptr;
+static int dwm_simulation_references = 0;
+static std::mutex dwm_simulation_mutex;
+
+// Slot of a source, nullptr if the index was never handed out
+static dwm_source_data_t *GetSourceData(const int index) {
+    if (index < 0 || index / dwm_source_chunk_size >= dwm_source_chunk_count.load(std::memory_order_acquire))
+        return nullptr;
+    return &dwm_source_chunks[index / dwm_source_chunk_size]
+                    .load(std::memory_order_acquire)
+                    ->slots[index % dwm_source_chunk_size];
+}
+
+// Handle of an acquisition of a source slot, the slot's index in the low 32 bits and the generation it was acquired
+// at in the high ones, so that the writes of a released acquisition never reach the slot's next owner
+static constexpr unsigned int dwm_handle_generation_mask = 0x7fffffff;
+
+static int64_t SourceHandle(const int index, const unsigned int generation) {
+    return static_cast<int64_t>(generation & dwm_handle_generation_mask) << 32 | index;
+}
+
+// Slot of an acquisition, nullptr if the handle was never handed out or the slot was released since
+static dwm_source_data_t *GetAcquiredSource(const int64_t handle) {
+    dwm_source_data_t *src_data = handle >= 0 ? GetSourceData(static_cast<int>(handle & 0xffffffff)) : nullptr;
+    if (src_data == nullptr || !src_data->active.load(std::memory_order_acquire) ||
+        (src_data->generation.load(std::memory_order_acquire) & dwm_handle_generation_mask) != handle >> 32)
+        return nullptr;
+    return src_data;
+}
+
+// Writes into the rings of an acquisition's slot unless it was released: ReleaseSource waits for the writes in
+// progress, so that none of them lands in the rings once the slot is handed out again
+template<typename write_t>
+static void WriteAcquiredSource(const int64_t handle, write_t &&write) {
+    dwm_source_data_t *src_data = handle >= 0 ? GetSourceData(static_cast<int>(handle & 0xffffffff)) : nullptr;
+    if (src_data == nullptr)
+        return;
+    src_data->writers.fetch_add(1, std::memory_order_seq_cst);
+    if (src_data->active.load(std::memory_order_seq_cst) &&
+        (src_data->generation.load(std::memory_order_acquire) & dwm_handle_generation_mask) == handle >> 32)
+        write(*src_data);
+    src_data->writers.fetch_sub(1, std::memory_order_release);
+}
+
+// Worker threads the simulations' mesh updates are split across, each simulation spawning and joining its own pool so
+// that its renders never wait on another thread's
+static std::mutex dwm_workers_mutex;
+static std::vector<dwm::worker_pool *> dwm_worker_pools;
+static std::atomic<int> dwm_worker_count = 1;
+
+// Blocks the simulation renders ahead on its own thread, 0 to render inline in the audio callback, picked up when it
+// is created
+static std::atomic<int> dwm_lookahead_blocks = DWM_LOOKAHEAD_BLOCKS;
+
+// Peak value below which the regions of the meshes fall asleep, picked up by the simulation at its next block
+static std::atomic<float> dwm_sleep_threshold = DWM_SLEEP_THRESHOLD;
+
+// Solid voxels left out of the mesh of the simulation created afterwards, empty when everything is air
+static dwm::occupancy_grid dwm_occupancy;
+static std::mutex dwm_occupancy_mutex;
+
+// Statistics of the blocks rendered by the simulation, read without locks, and their optional trace file
+static dwm::render_statistics dwm_statistics;
+static std::unique_ptr<dwm::statistics_trace> dwm_trace;
+static std::mutex dwm_trace_mutex;
+static constexpr std::chrono::milliseconds dwm_trace_interval{100};
+
+// Impulse responses rendering the baked sources of the simulation created afterwards, and the bake running in the
+// background if any
+static std::shared_ptr<const dwm::ir::cache> dwm_responses;
+static std::unique_ptr<dwm::ir::background_bake> dwm_bake;
+static std::mutex dwm_responses_mutex;
+// Change of a baked source's interpolation weights above which its responses are blended again
+static constexpr float dwm_response_tolerance = 0.05f;
+
+// Quality tier of the simulation playing, published by the tick swapping it in, which the next simulation created is
+// built for and bakes are run at
+static std::atomic<int> dwm_quality_tier = DefaultTier();
+// Milliseconds a switch of quality tier waits for the audio thread to swap the new simulation in
+static constexpr int dwm_swap_timeout = 1000;
+// Serializes the switches of quality tier, which build and swap in simulations without holding dwm_simulation_mutex
+static std::mutex dwm_switch_mutex;
+
+// Extent of a quality tier's mesh along an axis, from the world origin
+static float TierExtent(const int tier, const int axis) {
+#ifdef DWM_ROOMS
+    (void) tier;
+    return RoomsExtent(axis);
+#else
+    return dwm_tier_sizes[tier][axis];
+#endif
+}
 
 extern "C" {
-int UNITY_AUDIODSP_EXPORT_API GetSampleRate() { return DWM_SAMPLE_RATE; }
+int UNITY_AUDIODSP_EXPORT_API GetSampleRate() { return dwm_tier_rates[dwm_quality_tier]; }
 int UNITY_AUDIODSP_EXPORT_API GetBufferSize() { return DWM_BUFFER_SIZE; }
-int UNITY_AUDIODSP_EXPORT_API GetMaxSourceCount() { return DWM_MAX_SOURCE_COUNT; }
-float UNITY_AUDIODSP_EXPORT_API GetMeshWidth() { return DWM_MESH_WIDTH; }
-float UNITY_AUDIODSP_EXPORT_API GetMeshHeight() { return DWM_MESH_HEIGHT; }
-float UNITY_AUDIODSP_EXPORT_API GetMeshDepth() { return DWM_MESH_DEPTH; }
+int UNITY_AUDIODSP_EXPORT_API GetMaxSourceCount() { return dwm_source_max_chunks * dwm_source_chunk_size; }
+float UNITY_AUDIODSP_EXPORT_API GetMeshWidth() { return TierExtent(dwm_quality_tier, 0); }
+float UNITY_AUDIODSP_EXPORT_API GetMeshHeight() { return TierExtent(dwm_quality_tier, 1); }
+float UNITY_AUDIODSP_EXPORT_API GetMeshDepth() { return TierExtent(dwm_quality_tier, 2); }
+int UNITY_AUDIODSP_EXPORT_API GetRoomCount() { return dwm_room_count; }
+void UNITY_AUDIODSP_EXPORT_API GetRoomBounds(const int index, float *bounds) {
+    if (index < 0 || index >= dwm_room_count)
+        return;
+#ifdef DWM_ROOMS
+    std::copy_n(dwm_rooms[index], 6, bounds);
+#else
+    const int tier = dwm_quality_tier;
+    bounds[0] = bounds[1] = bounds[2] = 0.0f;
+    for (int axis = 0; axis < 3; axis++)
+        bounds[3 + axis] = TierExtent(tier, axis);
+#endif
+}
 float UNITY_AUDIODSP_EXPORT_API GetEarsDistance() { return DWM_EARS_DISTANCE; }
-void UNITY_AUDIODSP_EXPORT_API WriteSource(const int index, const float p_x, const float p_y, const float p_z,
-                                           float *buffer, const int num_channels) {
-    dwm_source_data_t *src_data = &dwm_source_data[std::clamp(index, 0, DWM_MAX_SOURCE_COUNT - 1)];
-    src_data->p_x = p_x;
-    src_data->p_y = p_y;
-    src_data->p_z = p_z;
-    for (unsigned int n = 0; n < DWM_BUFFER_SIZE; n++)
-        src_data->buffer[n] = buffer[n * num_channels];
+int UNITY_AUDIODSP_EXPORT_API GetAmbisonicOrder() { return DWM_AMBISONIC_ORDER; }
+int UNITY_AUDIODSP_EXPORT_API GetMaxWorkerCount() { return static_cast<int>(std::thread::hardware_concurrency()); }
+void UNITY_AUDIODSP_EXPORT_API SetWorkerCount(const int count) {
+    dwm_worker_count = std::max(1, count);
+    const std::lock_guard lock(dwm_workers_mutex);
+    for (auto *workers: dwm_worker_pools)
+        workers->set_worker_count(dwm_worker_count);
+}
+int UNITY_AUDIODSP_EXPORT_API LoadOccupancy(const char *path) {
+    dwm::occupancy_grid grid;
+    if (path == nullptr || !grid.load(path))
+        return 0;
+    const std::lock_guard lock(dwm_occupancy_mutex);
+    dwm_occupancy = std::move(grid);
+    return 1;
+}
+void UNITY_AUDIODSP_EXPORT_API ClearOccupancy() {
+    const std::lock_guard lock(dwm_occupancy_mutex);
+    dwm_occupancy = dwm::occupancy_grid();
+}
+int UNITY_AUDIODSP_EXPORT_API GetLookaheadBlocks() { return dwm_lookahead_blocks; }
+void UNITY_AUDIODSP_EXPORT_API SetLookaheadBlocks(const int blocks) { dwm_lookahead_blocks = std::max(0, blocks); }
+float UNITY_AUDIODSP_EXPORT_API GetSleepThreshold() { return dwm_sleep_threshold; }
+void UNITY_AUDIODSP_EXPORT_API SetSleepThreshold(const float threshold) {
+    dwm_sleep_threshold = std::max(0.0f, threshold);
+}
+int UNITY_AUDIODSP_EXPORT_API GetQualityTierCount() { return dwm_tier_count; }
+int UNITY_AUDIODSP_EXPORT_API GetQualityTierRate(const int tier) {
+    return tier >= 0 && tier < dwm_tier_count ? dwm_tier_rates[tier] : 0;
+}
+void UNITY_AUDIODSP_EXPORT_API GetQualityTierSize(const int tier, float *size) {
+    if (tier >= 0 && tier < dwm_tier_count)
+        for (int axis = 0; axis < 3; axis++)
+            size[axis] = TierExtent(tier, axis);
+}
+int UNITY_AUDIODSP_EXPORT_API GetQualityTier() { return dwm_quality_tier; }
+int UNITY_AUDIODSP_EXPORT_API SetQualityTier(const int tier) { return DWM_Mesh_Simulation::SwitchTier(tier) ? 1 : 0; }
+unsigned int UNITY_AUDIODSP_EXPORT_API GetDeadlineMisses() {
+    const std::lock_guard lock(dwm_sources_mutex);
+    return dwm_simulation != nullptr ? DWM_Mesh_Simulation::DeadlineMisses(dwm_simulation) : 0;
+}
+int UNITY_AUDIODSP_EXPORT_API GetStatistics(float *values, const int count) {
+    return dwm_statistics.snapshot(values, count);
+}
+int UNITY_AUDIODSP_EXPORT_API GetBudgetHistogram(float *counts, const int count) {
+    return dwm_statistics.histogram(counts, count);
+}
+void UNITY_AUDIODSP_EXPORT_API ResetStatistics() { dwm_statistics.reset(); }
+int UNITY_AUDIODSP_EXPORT_API SetTraceFile(const char *path) {
+    const std::lock_guard lock(dwm_trace_mutex);
+    dwm_trace.reset();
+    if (path == nullptr || path[0] == 0)
+        return 1;
+    FILE *file = std::fopen(path, "w");
+    if (file == nullptr)
+        return 0;
+    dwm_trace = std::make_unique<dwm::statistics_trace>(dwm_statistics, file, dwm_trace_interval);
+    return 1;
+}
+int UNITY_AUDIODSP_EXPORT_API BakeImpulseResponses(const char *path, const float listener_spacing,
+                                                    const float source_spacing, const int yaw_count,
+                                                    const int length) {
+    return DWM_Mesh_Simulation::StartBake(path, listener_spacing, source_spacing, yaw_count, length) ? 1 : 0;
+}
+float UNITY_AUDIODSP_EXPORT_API GetBakeProgress() {
+    const std::lock_guard lock(dwm_responses_mutex);
+    return dwm_bake != nullptr ? dwm_bake->progress() : -1.0f;
+}
+int UNITY_AUDIODSP_EXPORT_API GetBakeError(char *message, const int capacity) {
+    std::string error;
+    {
+        const std::lock_guard lock(dwm_responses_mutex);
+        if (dwm_bake != nullptr)
+            error = dwm_bake->error();
+    }
+    if (message == nullptr || capacity < 1)
+        return static_cast<int>(error.size());
+    const size_t length = std::min(error.size(), static_cast<size_t>(capacity) - 1);
+    std::copy_n(error.data(), length, message);
+    message[length] = 0;
+    return static_cast<int>(error.size());
+}
+void UNITY_AUDIODSP_EXPORT_API CancelBake() {
+    const std::lock_guard lock(dwm_responses_mutex);
+    dwm_bake.reset();
+}
+int UNITY_AUDIODSP_EXPORT_API LoadImpulseResponses(const char *path) {
+    auto responses = std::make_shared<dwm::ir::cache>();
+    if (path == nullptr || !responses->load(path))
+        return 0;
+    const std::lock_guard lock(dwm_responses_mutex);
+    dwm_responses = std::move(responses);
+    return 1;
+}
+void UNITY_AUDIODSP_EXPORT_API ClearImpulseResponses() {
+    const std::lock_guard lock(dwm_responses_mutex);
+    dwm_responses.reset();
+}
+int64_t UNITY_AUDIODSP_EXPORT_API AcquireSource() {
+    const std::lock_guard lock(dwm_sources_mutex);
+    if (dwm_free_sources.empty()) {
+        const int chunk = dwm_source_chunk_count.load(std::memory_order_relaxed);
+        if (chunk == dwm_source_max_chunks)
+            return -1;
+        dwm_source_chunk_storage[chunk] = std::make_unique<dwm_source_chunk_t>();
+        if (dwm_simulation != nullptr)
+            DWM_Mesh_Simulation::AddSourceChunks(dwm_simulation, chunk);
+        dwm_source_chunks[chunk].store(dwm_source_chunk_storage[chunk].get(), std::memory_order_release);
+        dwm_source_chunk_count.store(chunk + 1, std::memory_order_release);
+        for (int i = dwm_source_chunk_size - 1; i >= 0; i--)
+            dwm_free_sources.push_back(chunk * dwm_source_chunk_size + i);
+    }
+    const int index = dwm_free_sources.back();
+    dwm_free_sources.pop_back();
+
+    // Whatever the previous owner left in the rings is skipped by the mesh callback
+    dwm_source_chunk_t &chunk = *dwm_source_chunk_storage[index / dwm_source_chunk_size];
+    dwm_source_data_t &src_data = chunk.slots[index % dwm_source_chunk_size];
+    src_data.underruns.store(0, std::memory_order_relaxed);
+    src_data.overruns.store(0, std::memory_order_relaxed);
+    src_data.baked.store(false, std::memory_order_relaxed);
+    src_data.acquired_samples = src_data.samples.written();
+    src_data.acquired_positions = src_data.positions.written();
+    src_data.generation.fetch_add(1, std::memory_order_release);
+    src_data.active.store(true, std::memory_order_release);
+    dwm_source_registry_version.fetch_add(1, std::memory_order_release);
+    return SourceHandle(index, src_data.generation.load(std::memory_order_relaxed));
+}
+void UNITY_AUDIODSP_EXPORT_API ReleaseSource(const int64_t handle) {
+    const std::lock_guard lock(dwm_sources_mutex);
+    dwm_source_data_t *src_data = GetAcquiredSource(handle);
+    if (src_data == nullptr)
+        return;
+    // The writes which saw the slot still acquired are waited for, the later ones are dropped
+    src_data->active.store(false, std::memory_order_seq_cst);
+    while (src_data->writers.load(std::memory_order_seq_cst) > 0)
+        std::this_thread::yield();
+    dwm_free_sources.push_back(static_cast<int>(handle & 0xffffffff));
+    dwm_source_registry_version.fetch_add(1, std::memory_order_release);
+}
+void UNITY_AUDIODSP_EXPORT_API WriteSource(const int64_t handle, const float *buffer, const int num_channels,
+                                           const int num_samples) {
+    WriteAcquiredSource(handle, [&](dwm_source_data_t &src_data) {
+        const size_t count = std::max(0, num_samples);
+        if (src_data.samples.push(buffer, count, std::max(1, num_channels)) < count)
+            src_data.overruns.fetch_add(1, std::memory_order_relaxed);
+    });
+}
+void UNITY_AUDIODSP_EXPORT_API WriteSourcePosition(const int64_t handle, const float p_x, const float p_y,
+                                                   const float p_z) {
+    WriteAcquiredSource(handle, [&](dwm_source_data_t &src_data) {
+        if (!src_data.positions.push({p_x, p_y, p_z, src_data.samples.written()}))
+            src_data.overruns.fetch_add(1, std::memory_order_relaxed);
+    });
+}
+void UNITY_AUDIODSP_EXPORT_API SetSourceBaked(const int64_t handle, const int baked) {
+    dwm_source_data_t *src_data = GetAcquiredSource(handle);
+    if (src_data != nullptr)
+        src_data->baked.store(baked != 0, std::memory_order_relaxed);
+}
+unsigned int UNITY_AUDIODSP_EXPORT_API GetSourceUnderruns(const int64_t handle) {
+    const dwm_source_data_t *src_data = GetAcquiredSource(handle);
+    return src_data != nullptr ? src_data->underruns.load(std::memory_order_relaxed) : 0;
+}
+unsigned int UNITY_AUDIODSP_EXPORT_API GetSourceOverruns(const int64_t handle) {
+    const dwm_source_data_t *src_data = GetAcquiredSource(handle);
+    return src_data != nullptr ? src_data->overruns.load(std::memory_order_relaxed) : 0;
 }
 }
 
 namespace DWM_Mesh_Simulation {
 
-    typedef dwm::filters::admittance_lowpass_parameters boundary_parameters;
-    typedef dwm::filters::admittance_lowpass filter;
-    typedef dwm::mesh_3d<DWM_MESH_WIDTH, DWM_MESH_HEIGHT, DWM_MESH_DEPTH, DWM_SAMPLE_RATE, //
-                         filter, boundary_parameters, //
-                         filter, boundary_parameters, //
-                         filter, boundary_parameters, filter, boundary_parameters, filter, //
-                         boundary_parameters, filter, boundary_parameters> //
-            mesh_admittance_lowpass;
+    typedef dwm::simulation::boundary_parameters boundary_parameters;
+#if DWM_FLOAT16_STORAGE
+    typedef dwm::float16 mesh_storage;
+#else
+    typedef float mesh_storage;
+#endif
+#if DWM_INTERPOLATED_MESH
+    typedef dwm::topologies::interpolated mesh_topology;
+#else
+    typedef dwm::topologies::rectilinear mesh_topology;
+#endif
+    template<int sample_rate, float width, float height, float depth>
+    using mesh_admittance_lowpass =
+            dwm::simulation::mesh_admittance_lowpass<width, height, depth, sample_rate, mesh_storage, mesh_topology>;
+#ifdef DWM_ROOMS
+#define DWM_ROOM_MESH(x, y, z, width, height, depth)                                                                   \
+    dwm::simulation::mesh_admittance_lowpass<static_cast<float>(width), static_cast<float>(height),                    \
+                                             static_cast<float>(depth), sample_rate, mesh_storage, mesh_topology>
+    // The rooms are shared by all the quality tiers, whose size is left unused
+    template<int sample_rate, float width, float height, float depth>
+    using simulated_mesh = dwm::room_network<DWM_ROOMS(DWM_ROOM_MESH)>;
+
+    // Builds the rooms at their configured origins, coupled wherever they touch
+    template<int sample_rate, float width, float height, float depth>
+    simulated_mesh<sample_rate, width, height, depth> *NewMesh(const int max_workers) {
+        std::array<std::array<float, 3>, dwm_room_count> origins;
+        for (int r = 0; r < dwm_room_count; r++)
+            origins[r] = {dwm_rooms[r][0], dwm_rooms[r][1], dwm_rooms[r][2]};
+        auto *mesh = new simulated_mesh<sample_rate, width, height, depth>(origins, max_workers,
+                                                                           dwm::page_mode::DWM_PAGE_MODE);
+        mesh->add_portals();
+        return mesh;
+    }
+#elif DWM_NESTED_MESH
+    // The space is covered by a mesh DWM_NESTED_RATIO times slower, the listener's surroundings by a cube at the full
+    // rate
+    template<int sample_rate, float width, float height, float depth>
+    using simulated_mesh = dwm::nested_mesh<
+            mesh_admittance_lowpass<sample_rate / DWM_NESTED_RATIO, width, height, depth>,
+            mesh_admittance_lowpass<sample_rate, DWM_NESTED_SIZE, DWM_NESTED_SIZE, DWM_NESTED_SIZE>>;
+
+    template<int sample_rate, float width, float height, float depth>
+    simulated_mesh<sample_rate, width, height, depth> *NewMesh(const int max_workers) {
+        return new simulated_mesh<sample_rate, width, height, depth>(max_workers, dwm::page_mode::DWM_PAGE_MODE);
+    }
+#else
+    template<int sample_rate, float width, float height, float depth>
+    using simulated_mesh = mesh_admittance_lowpass<sample_rate, width, height, depth>;
+
+    template<int sample_rate, float width, float height, float depth>
+    simulated_mesh<sample_rate, width, height, depth> *NewMesh(const int max_workers) {
+        return new simulated_mesh<sample_rate, width, height, depth>(max_workers, dwm::page_mode::DWM_PAGE_MODE);
+    }
+#endif
+
+    // Mesh of a quality tier: every tier's mesh is compiled for its own sample rate and size, so that switching
+    // between them at runtime keeps the update loops specialized for their mesh
+#define DWM_TIER_MESH(rate, width, height, depth) simulated_mesh<rate, width, height, depth> *
+    typedef std::variant<DWM_QUALITY_TIERS(DWM_TIER_MESH)> tier_mesh;
+    // Junction density of each quality tier, the same for all the meshes of a tier
+#define DWM_TIER_DENSITY(rate, width, height, depth)                                                                   \
+    mesh_admittance_lowpass<rate, width, height, depth>::junction_density()
+    static constexpr float dwm_tier_densities[] = {DWM_QUALITY_TIERS(DWM_TIER_DENSITY)};
+
+    // Builds the mesh of a quality tier
+    template<size_t tier = 0>
+    tier_mesh NewTierMesh(const int index, const int max_workers) {
+        if constexpr (tier + 1 < std::variant_size_v<tier_mesh>) {
+            if (index != static_cast<int>(tier))
+                return NewTierMesh<tier + 1>(index, max_workers);
+        }
+        return tier_mesh(std::in_place_index<tier>,
+                         NewMesh<dwm_tier_rates[tier], dwm_tier_sizes[tier][0], dwm_tier_sizes[tier][1],
+                                 dwm_tier_sizes[tier][2]>(max_workers));
+    }
 
     enum param_t {
         param_gain,
@@ -59,9 +517,126 @@ namespace DWM_Mesh_Simulation {
         param_num
     };
 
+    // Per source state of the simulation, for one chunk of source slots
+    struct source_chunk_t {
+        std::vector<dwm::simulation::source_resampler> resamplers;
+        std::vector<float> samples; // Samples consumed from each source, max_block per source
+        unsigned int generations[dwm_source_chunk_size] = {}; // Slots' generation the state belongs to
+        bool silent[dwm_source_chunk_size] = {}; // Whether the slot's last block was all zeros
+        bool placed[dwm_source_chunk_size] = {}; // Whether the slot's position was used by a previous block
+        dwm_source_position_t last_positions[dwm_source_chunk_size]; // Position at the end of the previous block
+#if DWM_AMBISONIC_ORDER == 0
+        std::vector<dwm::partitioned_convolver> convolvers; // Render the baked slots, empty without responses
+        dwm::ir::selection selections[dwm_source_chunk_size]; // Responses each slot's convolver was last given
+        bool convolving[dwm_source_chunk_size] = {}; // Whether the slot's last block was rendered by its convolver
+        int quiet_steps[dwm_source_chunk_size] = {}; // Mesh steps of silence the slot's convolver was fed since
+#endif
+#if DWM_HYBRID_RENDERER
+        std::vector<dwm::hybrid::direct_path> direct_paths;
+        int binaural_channels[dwm_source_chunk_size]; // Binauraliser's input rendering each slot, -1 if none
+#endif
+    };
+
+#if DWM_AMBISONIC_ORDER > 0
+    // The mesh is sampled around the listener's position, along its axes
+    typedef dwm::ambisonics::listener_frame listener_t;
+#else
+    // The mesh is sampled at the listener's ears
+    typedef dwm::simulation::ears listener_t;
+#endif
+
+    // Everything a block is rendered from besides the sources, captured by the audio callback
+    struct block_request_t {
+        float parameters[param_num]; // The gain is left to each instance's readout
+        listener_t listener;
+#if DWM_HYBRID_RENDERER
+        float listener_matrix[16]; // World to listener matrix, for the sources' directions
+#endif
+    };
+
+#if DWM_HYBRID_RENDERER
+    // High band of the sources' direct path, rendered by SAF's binauraliser above DWM_CROSSOVER_FREQUENCY while the
+    // mesh's output is low passed below it. The binauraliser processes fixed size frames, its inputs and outputs are
+    // therefore buffered for one frame, on top of its own latency
+    struct binaural_t {
+        void *binauraliser = nullptr;
+        int sample_rate = 0;
+        int frame_size = 0, frame_position = 0;
+        float gain = 1.0f; // Normalizes the binauraliser's response at the crossover frequency
+        dwm::hybrid::mesh_propagation propagation; // Direct path the high band follows to line up with the mesh's
+        float max_delay = 0.0f; // Longest direct path delay, in output samples
+        dwm::hybrid::mesh_low_band *low_band = nullptr; // Mesh's output, delayed by the binauraliser's latency
+        std::vector<float> direct; // Direct path of each input, max_block samples each, for the current block
+        std::vector<float> inputs, outputs; // Frame being filled, frame_size samples per channel
+        std::vector<const float *> input_channels;
+        std::vector<float *> output_channels;
+        int owners[DWM_BINAURAL_SOURCE_COUNT]; // Source slot rendered by each input, -1 if none
+    };
+#endif
+
+    // Simulation of the space at a quality tier, with everything depending on its mesh rate
+    struct simulation_t {
+        int tier;
+        int mesh_rate; // Sample rate of the tier's mesh
+        float source_gain; // Scales the sources to the level they have at the default tier
+        tier_mesh mesh;
+        dwm::simulation::rate_converter *converter;
+        dwm::worker_pool *workers;
+        int max_block; // Maximum number of samples rendered at once, longer callbacks are split
+        int sample_rate; // Output sample rate
+#if DWM_AMBISONIC_ORDER > 0
+        dwm::ambisonics::encoder *encoder; // Encodes the listener's field into the first output channels
+#endif
+        listener_t last_listener; // Listener at the end of the previous callback
+        bool has_last_listener;
+#if DWM_AMBISONIC_ORDER == 0
+        std::shared_ptr<const dwm::ir::cache> responses; // Rendering the baked sources, nullptr if none
+        uint64_t occupancy_fingerprint; // Of the occupancy the mesh was built with, part of the responses' key
+        std::vector<float> convolved; // Baked sources' ears at the mesh rate, for the current block
+        std::vector<float> blended; // Responses blended for a baked source
+#endif
+        std::atomic<source_chunk_t *> source_chunks[dwm_source_max_chunks]; // Published by AddSourceChunk
+        unsigned int registry_version; // Registry version active_sources was built from
+        int active_count;
+        int active_sources[dwm_source_max_chunks * dwm_source_chunk_size]; // Acquired slots, in index order
+        dwm::block_source sources[dwm_source_max_chunks * dwm_source_chunk_size]; // Sources injected in a block
+        dwm::block_pipeline<block_request_t> *pipeline; // Renders ahead of the callback, nullptr to render inline
+        shared_t *shared; // Shared simulation it was built for
+        std::atomic<bool> swapped_out; // Whether a tick swapped the next simulation in, its pipeline renders silence
+        std::atomic<bool> rendering; // Whether a render is consuming the sources
+        std::atomic<simulation_t *> predecessor; // Simulation swapped out for it, until it stopped rendering
+#if DWM_HYBRID_RENDERER
+        binaural_t binaural;
+#endif
+    };
+
+    // Simulation shared by all the effect instances: it is advanced once per DSP tick, by the first instance processed
+    // in the tick, with the boundary parameters of the first instance created, and the listener's channels it renders
+    // are read out by every instance. Switching to another quality tier builds a new simulation off the audio thread,
+    // which a tick swaps in after fading the current one out
+    struct shared_t {
+        int sample_rate; // Output sample rate
+        int buffer_size; // Unity's DSP buffer size
+        std::atomic<uint64_t> claimed_tick; // Last DSP tick claimed by an instance to advance the simulation
+        simulation_t *current; // Simulation the ticks advance, only accessed by the instance advancing the tick
+        std::atomic<simulation_t *> pending; // Simulation waiting to be swapped in, nullptr if none
+        std::atomic<simulation_t *> retired; // Simulation swapped out, waiting to be deleted off the audio thread
+        std::atomic<uint64_t> dropped_samples; // Samples of the sources no render consumed, during swaps
+        std::vector<simulation_t *> simulations; // Every simulation not deleted yet, under dwm_sources_mutex
+        bool switching; // Whether a switch of quality tier uses it, which then deletes it, under dwm_simulation_mutex
+        std::atomic<bool> released; // Whether the last instance was released
+        std::atomic<const data_t *> owner; // Instance the boundary parameters are taken from, the oldest one
+        std::atomic<bool> reading_owner; // Whether a tick is copying the owner's parameters
+        // Listener's channels of the last two ticks, interleaved and allocated upfront: a tick is rendered into one
+        // while the other is read out by the instances processed meanwhile, until it is published as ready
+        std::vector<float> output[2];
+        std::atomic<int> ready;
+    };
+
+    // Effect instance: its parameters and its readout of the shared simulation
     struct data_t {
         float parameters[param_num];
-        mesh_admittance_lowpass *mesh;
+        shared_t *shared;
     };
 
     int InternalRegisterEffectDefinition(UnityAudioEffectDefinition &definition) {
@@ -126,17 +701,727 @@ namespace DWM_Mesh_Simulation {
         return param_num;
     }
 
+    dwm::worker_pool *AcquireWorkers() {
+        const std::lock_guard lock(dwm_workers_mutex);
+        auto *workers = new dwm::worker_pool();
+        workers->set_worker_count(dwm_worker_count);
+        dwm_worker_pools.push_back(workers);
+        return workers;
+    }
+
+    void ReleaseWorkers(dwm::worker_pool *workers) {
+        const std::lock_guard lock(dwm_workers_mutex);
+        std::erase(dwm_worker_pools, workers);
+        delete workers;
+    }
+
+    // Allocates a simulation's state for a new chunk of source slots, called with dwm_sources_mutex held and before
+    // the chunk is published to the audio thread
+    void AddSourceChunk(simulation_t *sim, const int chunk) {
+        auto *c = new source_chunk_t();
+        c->resamplers.reserve(dwm_source_chunk_size);
+        for (int i = 0; i < dwm_source_chunk_size; i++)
+            c->resamplers.push_back(sim->converter->make_source_resampler());
+        c->samples.resize(static_cast<size_t>(dwm_source_chunk_size) * sim->max_block);
+#if DWM_AMBISONIC_ORDER == 0
+        if (sim->responses != nullptr) {
+            c->convolvers.reserve(dwm_source_chunk_size);
+            for (int i = 0; i < dwm_source_chunk_size; i++)
+                c->convolvers.emplace_back(2, sim->responses->settings().length, dwm::ir::convolution_partition);
+        }
+#endif
+#if DWM_HYBRID_RENDERER
+        c->direct_paths.reserve(dwm_source_chunk_size);
+        for (int i = 0; i < dwm_source_chunk_size; i++) {
+            c->direct_paths.emplace_back(DWM_CROSSOVER_FREQUENCY, sim->binaural.sample_rate,
+                                         sim->binaural.max_delay);
+            c->binaural_channels[i] = -1;
+        }
+#endif
+        sim->source_chunks[chunk].store(c, std::memory_order_release);
+    }
+
+    // Allocates the state of every simulation for a new chunk of source slots, called with dwm_sources_mutex held
+    void AddSourceChunks(const shared_t *shared, const int chunk) {
+        for (auto *sim: shared->simulations)
+            AddSourceChunk(sim, chunk);
+    }
+
+    // Blocks the simulations' pipelines did not render in time, 0 when rendering inline, called with dwm_sources_mutex
+    // held
+    unsigned int DeadlineMisses(const shared_t *shared) {
+        unsigned int misses = 0;
+        for (const auto *sim: shared->simulations)
+            misses += sim->pipeline != nullptr ? sim->pipeline->deadline_misses() : 0;
+        return misses;
+    }
+
+    // Key of the impulse responses baked from the plugin's mesh configuration at a quality tier, an occupancy and
+    // boundary parameters
+    uint64_t ResponsesKey(const int tier, const float *parameters, const uint64_t occupancy_fingerprint) {
+        dwm::ir::key_builder key;
+        key.add(dwm_tier_rates[tier]).add(DWM_INTERPOLATED_MESH).add(DWM_FLOAT16_STORAGE).add(DWM_EARS_DISTANCE);
+#if DWM_NESTED_MESH
+        key.add(DWM_NESTED_SIZE).add(DWM_NESTED_RATIO);
+#endif
+#ifdef DWM_ROOMS
+        key.add(dwm_rooms);
+#else
+        key.add(dwm_tier_sizes[tier]);
+#endif
+        key.add(occupancy_fingerprint);
+        // The gain is applied to each instance's readout
+        key.add_bytes(parameters + param_admittance_xp, sizeof(float) * (param_num - param_admittance_xp));
+        return key.key();
+    }
+
+    // Starts baking the impulse responses of a mesh of its own in the background, at the current quality tier, with the
+    // current occupancy and the boundary parameters of the first effect instance (the default ones if there is none)
+    bool StartBake(const char *path, const float listener_spacing, const float source_spacing, const int yaw_count,
+                   const int length) {
+#if DWM_AMBISONIC_ORDER > 0
+        // The responses are binaural, ambisonic output has no use for them
+        (void) path, (void) listener_spacing, (void) source_spacing, (void) yaw_count, (void) length;
+        return false;
+#else
+        if (path == nullptr || path[0] == 0 || !(listener_spacing > 0.0f) || !(source_spacing > 0.0f) ||
+            yaw_count < 1 || length < 1)
+            return false;
+        const int tier = dwm_quality_tier;
+        const float extent[3] = {TierExtent(tier, 0), TierExtent(tier, 1), TierExtent(tier, 2)};
+        const dwm::ir::bake_settings settings = {{extent[0], extent[1], extent[2], listener_spacing},
+                                                 {extent[0], extent[1], extent[2], source_spacing},
+                                                 yaw_count,
+                                                 length,
+                                                 dwm_tier_rates[tier],
+                                                 DWM_EARS_DISTANCE};
+
+        std::array<float, param_num> parameters{};
+        {
+            const std::lock_guard lock(dwm_sources_mutex);
+            if (!dwm_effects.empty())
+                std::copy_n(dwm_effects.front()->parameters, static_cast<int>(param_num), parameters.data());
+            else
+                AudioPluginUtil::InitParametersFromDefinitions(InternalRegisterEffectDefinition, parameters.data());
+        }
+        dwm::occupancy_grid occupancy;
+        {
+            const std::lock_guard lock(dwm_occupancy_mutex);
+            occupancy = dwm_occupancy;
+        }
+        const uint64_t key = ResponsesKey(tier, parameters.data(), occupancy.fingerprint());
+
+        const std::lock_guard lock(dwm_responses_mutex);
+        dwm_bake.reset();
+        dwm_bake = std::make_unique<dwm::ir::background_bake>(
+                [path = std::string(path), tier, settings, key, parameters, occupancy = std::move(occupancy)](
+                        std::atomic<float> &progress, const std::atomic<bool> &cancel, std::string &error) {
+                    return std::visit(
+                            [&](auto *tier_mesh) {
+                                const std::unique_ptr<std::remove_pointer_t<decltype(tier_mesh)>> mesh(tier_mesh);
+                                if (!occupancy.empty())
+                                    mesh->set_occupancy(occupancy);
+                                const auto p = [&parameters](const int admittance, const int cutoff) {
+                                    return boundary_parameters(parameters[admittance], parameters[cutoff]);
+                                };
+                                return dwm::ir::bake(*mesh, p(param_admittance_xp, param_cutoff_xp),
+                                                     p(param_admittance_xn, param_cutoff_xn),
+                                                     p(param_admittance_yp, param_cutoff_yp),
+                                                     p(param_admittance_yn, param_cutoff_yn),
+                                                     p(param_admittance_zp, param_cutoff_zp),
+                                                     p(param_admittance_zn, param_cutoff_zn), settings, key,
+                                                     path.c_str(), &progress, &cancel, &error);
+                            },
+                            NewTierMesh(tier, 1));
+                });
+        return true;
+#endif
+    }
+
+#if DWM_AMBISONIC_ORDER == 0
+    // Renders a baked source by convolving it with the responses interpolated at its position, into the block's
+    // convolved ears, instead of injecting it in the mesh
+    void ConvolveSource(simulation_t *sim, source_chunk_t &chunk, const int i, const float *samples,
+                        const unsigned int block, const int steps, const bool skip,
+                        const dwm_source_position_t &position, const dwm::simulation::ears &listener) {
+        dwm::partitioned_convolver &convolver = chunk.convolvers[i];
+        const float source[3] = {position.p_x, position.p_y, position.p_z};
+        const float center[3] = {0.5f * (listener.l_x + listener.r_x), 0.5f * (listener.l_y + listener.r_y),
+                                 0.5f * (listener.l_z + listener.r_z)};
+        const float yaw = std::atan2(listener.l_z - listener.r_z, listener.r_x - listener.l_x);
+        const dwm::ir::selection selection = sim->responses->select(source, center, yaw);
+        if (!chunk.convolving[i]) {
+            // Starts from silence, right away with the responses of the current placement
+            convolver.reset();
+            sim->responses->blend(selection, sim->blended.data());
+            convolver.set_responses(sim->blended.data(), false);
+            chunk.selections[i] = selection;
+            chunk.quiet_steps[i] = 0;
+            chunk.convolving[i] = true;
+        } else if (convolver.ready() && !selection.near(chunk.selections[i], dwm_response_tolerance)) {
+            sim->responses->blend(selection, sim->blended.data());
+            convolver.set_responses(sim->blended.data());
+            chunk.selections[i] = selection;
+        }
+
+        // Once the responses' tails have died out, silent blocks have nothing left to render
+        chunk.quiet_steps[i] = skip ? chunk.quiet_steps[i] + steps : 0;
+        if (chunk.quiet_steps[i] > convolver.length() + convolver.partition_size())
+            return;
+        convolver.process(chunk.resamplers[i].resample(samples, static_cast<int>(block), steps),
+                          sim->convolved.data(), steps, 2);
+    }
+#endif
+
+#if DWM_HYBRID_RENDERER
+    // Creates the simulation's binauraliser and measures its latency and gain at the crossover frequency, from
+    // its response to an impulse in front of the listener
+    void InitBinaural(simulation_t *sim, const int sample_rate) {
+        binaural_t &b = sim->binaural;
+        b.sample_rate = sample_rate;
+        binauraliser_create(&b.binauraliser);
+        binauraliser_setUseDefaultHRIRsflag(b.binauraliser, 1);
+        binauraliser_setNumSources(b.binauraliser, DWM_BINAURAL_SOURCE_COUNT);
+        for (int c = 0; c < DWM_BINAURAL_SOURCE_COUNT; c++) {
+            binauraliser_setSourceAzi_deg(b.binauraliser, c, 0.0f);
+            binauraliser_setSourceElev_deg(b.binauraliser, c, 0.0f);
+            b.owners[c] = -1;
+        }
+        binauraliser_init(b.binauraliser, sample_rate);
+        binauraliser_initCodec(b.binauraliser);
+
+        b.frame_size = binauraliser_getFrameSize();
+        b.inputs.assign(static_cast<size_t>(DWM_BINAURAL_SOURCE_COUNT) * b.frame_size, 0.0f);
+        b.outputs.assign(2 * static_cast<size_t>(b.frame_size), 0.0f);
+        for (int c = 0; c < DWM_BINAURAL_SOURCE_COUNT; c++)
+            b.input_channels.push_back(b.inputs.data() + static_cast<size_t>(c) * b.frame_size);
+        for (int ear = 0; ear < 2; ear++)
+            b.output_channels.push_back(b.outputs.data() + static_cast<size_t>(ear) * b.frame_size);
+        b.direct.assign(static_cast<size_t>(DWM_BINAURAL_SOURCE_COUNT) * sim->max_block, 0.0f);
+
+        const int frames = (dwm_binaural_calibration_samples + b.frame_size - 1) / b.frame_size;
+        std::vector<float> response(static_cast<size_t>(frames) * b.frame_size * 2);
+        for (int f = 0; f < frames; f++) {
+            b.inputs[0] = f == 0 ? 1.0f : 0.0f;
+            binauraliser_process(b.binauraliser, b.input_channels.data(), b.output_channels.data(),
+                                 DWM_BINAURAL_SOURCE_COUNT, 2, b.frame_size);
+            for (int ear = 0; ear < 2; ear++)
+                std::copy_n(b.output_channels[ear], b.frame_size,
+                            response.data() + static_cast<size_t>(ear * frames + f) * b.frame_size);
+        }
+        b.inputs[0] = 0.0f;
+        std::fill(b.outputs.begin(), b.outputs.end(), 0.0f);
+
+        const size_t length = static_cast<size_t>(frames) * b.frame_size;
+        size_t peak = 0;
+        float peak_value = 0.0f, magnitude = 0.0f;
+        for (size_t n = 0; n < length; n++) {
+            if (const float v = std::fabs(response[n]) + std::fabs(response[length + n]); v > peak_value) {
+                peak_value = v;
+                peak = n;
+            }
+        }
+        for (int ear = 0; ear < 2; ear++) {
+            std::complex<double> h = 0.0;
+            for (size_t n = 0; n < length; n++)
+                h += static_cast<double>(response[ear * length + n]) *
+                     std::polar(1.0, -2.0 * std::numbers::pi * DWM_CROSSOVER_FREQUENCY * static_cast<double>(n) /
+                                             sample_rate);
+            magnitude += static_cast<float>(std::abs(h)) / 2.0f;
+        }
+        // Without HRTFs the binauraliser is silent, and only the advertised latency is left to line up with
+        const int latency = peak_value > 0.0f ? static_cast<int>(peak) : binauraliser_getProcessingDelay();
+        b.gain = magnitude > 0.0f ? 1.0f / magnitude : 1.0f;
+
+        b.propagation = dwm::hybrid::mesh_propagation::of<mesh_topology>(
+                dwm_tier_densities[sim->tier], sim->mesh_rate, sample_rate, sim->converter->latency());
+        b.max_delay = b.propagation.delay(
+                std::hypot(TierExtent(sim->tier, 0), TierExtent(sim->tier, 1), TierExtent(sim->tier, 2)));
+        b.low_band = new dwm::hybrid::mesh_low_band(DWM_CROSSOVER_FREQUENCY, sample_rate, b.frame_size + latency);
+    }
+
+    // Frees the binauraliser inputs of the slots which were released
+    void ReleaseBinauralInputs(simulation_t *sim) {
+        binaural_t &b = sim->binaural;
+        for (int &owner: b.owners) {
+            if (owner < 0 || GetSourceData(owner)->active.load(std::memory_order_acquire))
+                continue;
+            sim->source_chunks[owner / dwm_source_chunk_size]
+                    .load(std::memory_order_relaxed)
+                    ->binaural_channels[owner % dwm_source_chunk_size] = -1;
+            owner = -1;
+        }
+    }
+
+    // Renders the high band of a source's direct path into its binauraliser input, taking a free one if needed
+    void RenderDirectPath(simulation_t *sim, source_chunk_t &chunk, const int index, const float *samples,
+                          const unsigned int block, const dwm_source_position_t &position,
+                          const float *listener_matrix) {
+        binaural_t &b = sim->binaural;
+        const int i = index % dwm_source_chunk_size;
+        int &channel = chunk.binaural_channels[i];
+        for (int c = 0; c < DWM_BINAURAL_SOURCE_COUNT && channel < 0; c++) {
+            if (b.owners[c] < 0) {
+                b.owners[c] = index;
+                channel = c;
+                chunk.direct_paths[i].reset();
+            }
+        }
+        if (channel < 0)
+            return; // Only the mesh's low band is left of the source
+
+        const auto direction = dwm::hybrid::source_direction::from_listener_matrix(listener_matrix, position.p_x,
+                                                                                  position.p_y, position.p_z);
+        binauraliser_setSourceAzi_deg(b.binauraliser, channel, direction.azimuth);
+        binauraliser_setSourceElev_deg(b.binauraliser, channel, direction.elevation);
+        chunk.direct_paths[i].render(samples, b.direct.data() + static_cast<size_t>(channel) * sim->max_block,
+                                     static_cast<int>(block), b.propagation.delay(direction.distance),
+                                     b.gain * b.propagation.gain(direction.distance));
+    }
+
+    // Replaces the mesh's output by its low band, and adds the binauraliser's output to it
+    void RenderBinaural(simulation_t *sim, float *out_buffer, const int block, const int out_channels) {
+        binaural_t &b = sim->binaural;
+        b.low_band->process(out_buffer, block, out_channels);
+        for (int n = 0; n < block;) {
+            const int count = std::min(block - n, b.frame_size - b.frame_position);
+            for (int c = 0; c < DWM_BINAURAL_SOURCE_COUNT; c++)
+                std::copy_n(b.direct.data() + static_cast<size_t>(c) * sim->max_block + n, count,
+                            b.inputs.data() + static_cast<size_t>(c) * b.frame_size + b.frame_position);
+            // The outputs are those of the previous frame
+            for (int k = 0; k < count; k++) {
+                for (int ear = 0; ear < 2; ear++)
+                    out_buffer[(n + k) * out_channels + ear] += b.outputs[ear * b.frame_size + b.frame_position + k];
+            }
+            n += count;
+            b.frame_position += count;
+            if (b.frame_position == b.frame_size) {
+                binauraliser_process(b.binauraliser, b.input_channels.data(), b.output_channels.data(),
+                                     DWM_BINAURAL_SOURCE_COUNT, 2, b.frame_size);
+                b.frame_position = 0;
+            }
+        }
+    }
+#endif
+
+    // Renders a block, splitting it in max_block long parts, called by the audio callback or the pipeline's thread
+    template<typename mesh_t>
+    void Render(simulation_t *sim, mesh_t &mesh, const block_request_t &request, float *out_buffer,
+                const unsigned int num_samples, const int out_channels) {
+        const auto start = std::chrono::steady_clock::now();
+        const uint64_t junction_updates = mesh.junction_updates();
+        int injected = 0; // Most sources injected in a part of the block
+        const float *parameters = request.parameters;
+        const listener_t &listener = request.listener;
+        const listener_t last_listener = sim->has_last_listener ? sim->last_listener : listener;
+
+        const auto p_xp = boundary_parameters(parameters[param_admittance_xp], parameters[param_cutoff_xp]);
+        const auto p_xn = boundary_parameters(parameters[param_admittance_xn], parameters[param_cutoff_xn]);
+        const auto p_yp = boundary_parameters(parameters[param_admittance_yp], parameters[param_cutoff_yp]);
+        const auto p_yn = boundary_parameters(parameters[param_admittance_yn], parameters[param_cutoff_yn]);
+        const auto p_zp = boundary_parameters(parameters[param_admittance_zp], parameters[param_cutoff_zp]);
+        const auto p_zn = boundary_parameters(parameters[param_admittance_zn], parameters[param_cutoff_zn]);
+
+        // Rebuild the list of acquired slots whenever a source is acquired or released
+        const unsigned int version = dwm_source_registry_version.load(std::memory_order_acquire);
+        if (version != sim->registry_version) {
+            sim->registry_version = version;
+            sim->active_count = 0;
+            const int slot_count = dwm_source_chunk_count.load(std::memory_order_acquire) * dwm_source_chunk_size;
+            for (int index = 0; index < slot_count; index++) {
+                if (GetSourceData(index)->active.load(std::memory_order_acquire) &&
+                    sim->source_chunks[index / dwm_source_chunk_size].load(std::memory_order_acquire) != nullptr)
+                    sim->active_sources[sim->active_count++] = index;
+            }
+#if DWM_HYBRID_RENDERER
+            ReleaseBinauralInputs(sim);
+#endif
+        }
+
+        // The samples the sources were fed while no simulation consumed them are dropped, so that their latency does
+        // not grow with each swap
+        if (const uint64_t dropped = sim->shared->dropped_samples.exchange(0, std::memory_order_relaxed); dropped > 0) {
+            for (int a = 0; a < sim->active_count; a++)
+                GetSourceData(sim->active_sources[a])->samples.discard(static_cast<size_t>(dropped));
+        }
+
+        mesh.set_sleep_threshold(dwm_sleep_threshold.load(std::memory_order_relaxed));
+#if DWM_AMBISONIC_ORDER == 0
+        // Baked sources are only convolved with responses baked from the current boundary parameters, and are
+        // simulated otherwise
+        const bool convolve =
+                sim->responses != nullptr &&
+                sim->responses->key() == ResponsesKey(sim->tier, parameters, sim->occupancy_fingerprint);
+#endif
+
+        for (unsigned int offset = 0; offset < num_samples;) {
+            const unsigned int block = std::min(num_samples - offset, static_cast<unsigned int>(sim->max_block));
+            const int steps = sim->converter->mesh_steps(block);
+            int source_count = 0;
+#if DWM_HYBRID_RENDERER
+            std::fill(sim->binaural.direct.begin(), sim->binaural.direct.end(), 0.0f);
+#endif
+
+            // The listener glides across the callback from its previous position
+            const listener_t block_start = listener_t::lerp(
+                    last_listener, listener, static_cast<float>(offset) / static_cast<float>(num_samples));
+            const listener_t block_end = listener_t::lerp(
+                    last_listener, listener, static_cast<float>(offset + block) / static_cast<float>(num_samples));
+#if DWM_AMBISONIC_ORDER == 0
+            bool convolved = false;
+            if (convolve)
+                std::fill_n(sim->convolved.begin(), 2 * steps, 0.0f);
+#endif
+            for (int a = 0; a < sim->active_count; a++) {
+                const int index = sim->active_sources[a];
+                dwm_source_data_t &src_data = *GetSourceData(index);
+                source_chunk_t &chunk = *sim->source_chunks[index / dwm_source_chunk_size].load(
+                        std::memory_order_relaxed);
+                const int i = index % dwm_source_chunk_size;
+                float *samples = chunk.samples.data() + static_cast<size_t>(i) * sim->max_block;
+
+                // Start from a clean state when the slot changed owner
+                const unsigned int generation = src_data.generation.load(std::memory_order_acquire);
+                if (generation != chunk.generations[i]) {
+                    chunk.generations[i] = generation;
+                    chunk.resamplers[i].reset();
+                    chunk.silent[i] = false;
+                    chunk.placed[i] = false;
+                    src_data.samples.discard_until(src_data.acquired_samples);
+                    src_data.positions.discard_until(src_data.acquired_positions);
+                    src_data.position = {};
+#if DWM_HYBRID_RENDERER
+                    chunk.direct_paths[i].reset();
+#endif
+                }
+
+                // Consume whatever is available, a source that has ever written is expected to keep up
+                const uint64_t start = src_data.samples.read();
+                const size_t read = src_data.samples.pop(samples, block);
+                if (read < block) {
+                    std::fill(samples + read, samples + block, 0.0f);
+                    if (src_data.samples.written() > src_data.acquired_samples)
+                        src_data.underruns.fetch_add(1, std::memory_order_relaxed);
+                }
+                // Scaled before anything renders them, the mesh, the baked responses and the direct path all being
+                // at the tier's level
+                std::transform(samples, samples + read, samples, [sim](const float v) { return v * sim->source_gain; });
+
+                // Latest position which became valid within the consumed samples
+                dwm_source_position_t position;
+                while (src_data.positions.peek(position) && position.time <= start + read) {
+                    src_data.position = position;
+                    src_data.positions.discard();
+                }
+
+                // The source glides from where the previous block left it, even if that block was skipped
+                const dwm_source_position_t from = chunk.last_positions[i], &to = src_data.position;
+                const bool moving =
+                        chunk.placed[i] && (from.p_x != to.p_x || from.p_y != to.p_y || from.p_z != to.p_z);
+                chunk.last_positions[i] = to;
+                chunk.placed[i] = true;
+#if DWM_HYBRID_RENDERER
+                // Rendered even when the mesh skips the source, the path's tail is still on its way
+                RenderDirectPath(sim, chunk, index, samples, block, to, request.listener_matrix);
+#endif
+
+                // A silent block following another one has nothing left to inject, not even the resampler's tail
+                const bool silent = std::all_of(samples, samples + block, [](const float v) { return v == 0.0f; });
+                const bool skip = silent && chunk.silent[i];
+                chunk.silent[i] = silent;
+#if DWM_AMBISONIC_ORDER == 0
+                if (convolve && src_data.baked.load(std::memory_order_relaxed)) {
+                    ConvolveSource(sim, chunk, i, samples, block, steps, skip, to, block_end);
+                    convolved = true;
+                    continue;
+                }
+                chunk.convolving[i] = false;
+#endif
+                if (skip)
+                    continue;
+                sim->sources[source_count++] = {to.p_x, to.p_y, to.p_z,
+                                                chunk.resamplers[i].resample(samples, static_cast<int>(block), steps),
+                                                moving, from.p_x, from.p_y, from.p_z};
+            }
+
+#if DWM_NESTED_MESH
+            // The fine region is moved towards where the listener ends the block
+#if DWM_AMBISONIC_ORDER > 0
+            mesh.follow(block_end.position[0], block_end.position[1], block_end.position[2]);
+#else
+            mesh.follow(0.5f * (block_end.l_x + block_end.r_x), 0.5f * (block_end.l_y + block_end.r_y),
+                              0.5f * (block_end.l_z + block_end.r_z));
+#endif
+#endif
+#if DWM_AMBISONIC_ORDER > 0
+            sim->converter->render_block(mesh, p_xp, p_xn, p_yp, p_yn, p_zp, p_zn, sim->sources,
+                                         source_count, *sim->encoder, block_end,
+                                         out_buffer + offset * out_channels, block, out_channels, sim->workers,
+                                         &block_start);
+#else
+            sim->converter->render_block(mesh, p_xp, p_xn, p_yp, p_yn, p_zp, p_zn, sim->sources,
+                                         source_count, block_end, out_buffer + offset * out_channels, block,
+                                         out_channels, sim->workers, &block_start,
+                                         convolved ? sim->convolved.data() : nullptr);
+#endif
+            injected = std::max(injected, source_count);
+#if DWM_HYBRID_RENDERER
+            RenderBinaural(sim, out_buffer + offset * out_channels, static_cast<int>(block), out_channels);
+#endif
+            offset += block;
+        }
+        sim->last_listener = listener;
+        sim->has_last_listener = true;
+
+        dwm_statistics.record_block(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(),
+                                    static_cast<double>(num_samples) / sim->sample_rate, injected,
+                                    mesh.awake_fraction(), mesh.junction_updates() - junction_updates);
+    }
+
+    // Renders a block unless another simulation is consuming the sources: the blocks the pipeline of a swapped out
+    // simulation was still handed are never heard, and the simulation swapped in leaves its blocks silent until the
+    // one it replaces is done with its last render. Only then is the latter handed over for deletion
+    void Render(simulation_t *sim, const block_request_t &request, float *out_buffer, const unsigned int num_samples,
+                const int out_channels) {
+        sim->rendering.store(true, std::memory_order_seq_cst);
+        bool idle = sim->swapped_out.load(std::memory_order_seq_cst);
+        if (simulation_t *predecessor = sim->predecessor.load(std::memory_order_acquire);
+            predecessor != nullptr && !idle) {
+            idle = predecessor->rendering.load(std::memory_order_seq_cst);
+            if (!idle) {
+                sim->shared->retired.store(predecessor, std::memory_order_release);
+                sim->predecessor.store(nullptr, std::memory_order_release);
+            }
+        }
+        if (idle) {
+            sim->rendering.store(false, std::memory_order_release);
+            sim->shared->dropped_samples.fetch_add(num_samples, std::memory_order_relaxed);
+            std::fill_n(out_buffer, static_cast<size_t>(num_samples) * out_channels, 0.0f);
+            return;
+        }
+        std::visit([&](auto *mesh) { Render(sim, *mesh, request, out_buffer, num_samples, out_channels); }, sim->mesh);
+        sim->rendering.store(false, std::memory_order_release);
+    }
+
+    void RenderPipelined(void *context, const block_request_t &request, float *out, const int frames,
+                         const int channels) {
+        Render(static_cast<simulation_t *>(context), request, out, static_cast<unsigned int>(frames), channels);
+    }
+
+    // Creates a simulation of the shared one at a quality tier, for its instances' output rate and DSP buffer size
+    simulation_t *NewSimulation(shared_t *shared, const int tier) {
+        const int sample_rate = shared->sample_rate, buffer_size = shared->buffer_size;
+        auto *sim = new simulation_t();
+        sim->shared = shared;
+        sim->tier = tier;
+        sim->mesh_rate = dwm_tier_rates[tier];
+        // A source's field is inversely proportional to the junction density, so that the sparser meshes of the
+        // cheaper tiers would play louder
+        sim->source_gain = dwm_tier_densities[tier] / dwm_tier_densities[DefaultTier()];
+        sim->workers = AcquireWorkers();
+        sim->mesh = NewTierMesh(tier, sim->workers->max_workers());
+        {
+            const std::lock_guard lock(dwm_occupancy_mutex);
+            if (!dwm_occupancy.empty())
+                std::visit([](auto *mesh) { mesh->set_occupancy(dwm_occupancy); }, sim->mesh);
+#if DWM_AMBISONIC_ORDER == 0
+            sim->occupancy_fingerprint = dwm_occupancy.fingerprint();
+#endif
+        }
+        sim->max_block = std::max(DWM_BUFFER_SIZE, buffer_size);
+        sim->sample_rate = sample_rate;
+        sim->converter = new dwm::simulation::rate_converter(sim->mesh_rate, sample_rate, sim->max_block,
+                                                             dwm_mesh_channels);
+#if DWM_AMBISONIC_ORDER > 0
+        // The field is sampled one junction apart, the closest points the mesh tells apart
+        sim->encoder = new dwm::ambisonics::encoder(DWM_AMBISONIC_ORDER, 1.0f / dwm_tier_densities[tier],
+                                                    sim->mesh_rate, sim->converter->max_mesh_steps());
+        const int receiver_count = sim->encoder->receiver_count();
+#else
+        const int receiver_count = 2;
+        {
+            const std::lock_guard lock(dwm_responses_mutex);
+            sim->responses = dwm_responses;
+        }
+        if (sim->responses != nullptr) {
+            sim->convolved.resize(2 * static_cast<size_t>(sim->converter->max_mesh_steps()));
+            sim->blended.resize(2 * static_cast<size_t>(sim->responses->settings().length));
+        }
+#endif
+        std::visit([&](auto *mesh) {
+            mesh->reserve_block(dwm_source_max_chunks * dwm_source_chunk_size, receiver_count);
+        }, sim->mesh);
+#if DWM_HYBRID_RENDERER
+        InitBinaural(sim, sample_rate);
+#endif
+        sim->registry_version = dwm_source_registry_version.load(std::memory_order_relaxed) - 1;
+        if (const int lookahead = dwm_lookahead_blocks.load(std::memory_order_relaxed); lookahead > 0)
+            sim->pipeline = new dwm::block_pipeline<block_request_t>(RenderPipelined, sim, lookahead,
+                                                                     sim->max_block, dwm_mesh_channels);
+        return sim;
+    }
+
+    void DeleteSimulation(simulation_t *sim) {
+        delete sim->pipeline;
+        for (auto &chunk: sim->source_chunks)
+            delete chunk.load(std::memory_order_relaxed);
+#if DWM_HYBRID_RENDERER
+        binauraliser_destroy(&sim->binaural.binauraliser);
+        delete sim->binaural.low_band;
+#endif
+#if DWM_AMBISONIC_ORDER > 0
+        delete sim->encoder;
+#endif
+        delete sim->converter;
+        std::visit([](auto *mesh) { delete mesh; }, sim->mesh);
+        ReleaseWorkers(sim->workers);
+        delete sim;
+    }
+
+    // Deletes a simulation which no tick advances anymore
+    void RemoveSimulation(shared_t *shared, simulation_t *sim) {
+        {
+            const std::lock_guard lock(dwm_sources_mutex);
+            std::erase(shared->simulations, sim);
+        }
+        DeleteSimulation(sim);
+    }
+
+    // Deletes the simulation a tick swapped out, if any
+    void ReclaimSimulation(shared_t *shared) {
+        if (simulation_t *retired = shared->retired.exchange(nullptr, std::memory_order_acq_rel); retired != nullptr)
+            RemoveSimulation(shared, retired);
+    }
+
+    // Deletes the shared simulation along with every simulation built for it
+    void DeleteShared(shared_t *shared) {
+        for (auto *sim: shared->simulations)
+            DeleteSimulation(sim);
+        delete shared;
+    }
+
+    // Attaches an instance to the simulation, creating it for the first instance
+    shared_t *AcquireSimulation(const UnityAudioEffectState *state, data_t *data) {
+        const std::lock_guard lock(dwm_simulation_mutex);
+        shared_t *shared = dwm_simulation;
+        if (dwm_simulation_references++ == 0) {
+            shared = new shared_t();
+            shared->sample_rate = static_cast<int>(state->samplerate);
+            shared->buffer_size = static_cast<int>(state->dspbuffersize);
+            shared->current = NewSimulation(shared, dwm_quality_tier);
+            shared->claimed_tick = dwm_no_tick;
+            shared->owner = data;
+            for (auto &output: shared->output)
+                output.resize(static_cast<size_t>(dwm_max_tick_blocks) * shared->current->max_block *
+                              dwm_mesh_channels);
+        }
+        const std::lock_guard sources_lock(dwm_sources_mutex);
+        if (dwm_simulation == nullptr) {
+            for (int chunk = 0; chunk < dwm_source_chunk_count.load(std::memory_order_relaxed); chunk++)
+                AddSourceChunk(shared->current, chunk);
+            shared->simulations.push_back(shared->current);
+            dwm_simulation = shared;
+        }
+        dwm_effects.push_back(data);
+        return shared;
+    }
+
+    // Detaches an instance from the simulation, deleting it with the last instance
+    void ReleaseSimulation(const data_t *data) {
+        const std::lock_guard lock(dwm_simulation_mutex);
+        shared_t *shared = dwm_simulation;
+        const data_t *owner = nullptr;
+        {
+            const std::lock_guard sources_lock(dwm_sources_mutex);
+            std::erase(dwm_effects, data);
+            if (--dwm_simulation_references == 0)
+                dwm_simulation = nullptr;
+            else
+                owner = dwm_effects.front();
+        }
+        if (owner == nullptr) {
+            shared->released = true;
+            if (!shared->switching)
+                DeleteShared(shared);
+            return;
+        }
+        // The next oldest instance's boundary parameters take over, the released instance being freed once no tick
+        // copies its parameters anymore
+        shared->owner.store(owner, std::memory_order_seq_cst);
+        while (shared->reading_owner.load(std::memory_order_seq_cst))
+            std::this_thread::yield();
+    }
+
+    // Switches the simulation to a quality tier: the tier's simulation is built on the calling thread, swapped in by
+    // the next tick, and the one it replaces is deleted back on the calling thread. Instances can be created and
+    // released meanwhile, the simulation being deleted by the switch if its last instance is released. The switch
+    // fails if no tick swapped the tier in within dwm_swap_timeout, the current tier going on
+    bool SwitchTier(const int tier) {
+        if (tier < 0 || tier >= dwm_tier_count)
+            return false;
+        const std::lock_guard switch_lock(dwm_switch_mutex);
+        shared_t *shared;
+        {
+            const std::lock_guard lock(dwm_simulation_mutex);
+            shared = dwm_simulation;
+            if (shared == nullptr) {
+                dwm_quality_tier = tier; // Picked up by the next simulation created
+                return true;
+            }
+            ReclaimSimulation(shared);
+            {
+                const std::lock_guard sources_lock(dwm_sources_mutex);
+                if (shared->simulations.back()->tier == tier)
+                    return true;
+            }
+            shared->switching = true;
+        }
+        simulation_t *next = NewSimulation(shared, tier);
+        {
+            const std::lock_guard sources_lock(dwm_sources_mutex);
+            for (int chunk = 0; chunk < dwm_source_chunk_count.load(std::memory_order_relaxed); chunk++) {
+                AddSourceChunk(next, chunk);
+                // The acquired sources go on from their current position instead of starting over, see Render
+                source_chunk_t *c = next->source_chunks[chunk].load(std::memory_order_relaxed);
+                for (int i = 0; i < dwm_source_chunk_size; i++)
+                    c->generations[i] =
+                            dwm_source_chunk_storage[chunk]->slots[i].generation.load(std::memory_order_relaxed);
+            }
+            shared->simulations.push_back(next);
+        }
+        shared->pending.store(next, std::memory_order_release);
+        for (int wait = 0; wait < dwm_swap_timeout && !shared->released.load(std::memory_order_acquire) &&
+                           (shared->pending.load(std::memory_order_acquire) != nullptr ||
+                            next->predecessor.load(std::memory_order_acquire) != nullptr);
+             wait++) {
+            ReclaimSimulation(shared);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        // Taken back unless a tick swapped it in meanwhile
+        simulation_t *expected = next;
+        const bool swapped = !shared->pending.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel);
+        if (!swapped)
+            RemoveSimulation(shared, next);
+        ReclaimSimulation(shared);
+
+        const std::lock_guard lock(dwm_simulation_mutex);
+        shared->switching = false;
+        if (shared->released)
+            DeleteShared(shared);
+        return swapped;
+    }
+
     UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK CreateCallback(UnityAudioEffectState *state) {
         auto *data = new data_t();
-        data->mesh = new mesh_admittance_lowpass();
         AudioPluginUtil::InitParametersFromDefinitions(InternalRegisterEffectDefinition, data->parameters);
+        data->shared = AcquireSimulation(state, data);
         state->effectdata = data;
         return UNITY_AUDIODSP_OK;
     }
 
     UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK ReleaseCallback(UnityAudioEffectState *state) {
-        const auto *data = state->GetEffectData<data_t>();
-        delete data->mesh;
+        auto *data = state->GetEffectData<data_t>();
+        ReleaseSimulation(data);
         delete data;
         return UNITY_AUDIODSP_OK;
     }
@@ -161,55 +1446,110 @@ namespace DWM_Mesh_Simulation {
         return UNITY_AUDIODSP_OK;
     }
 
-    int UNITY_AUDIODSP_CALLBACK GetFloatBufferCallback(UnityAudioEffectState *, const char *, float *buffer,
+    // Exposes the rendering statistics to the mixer's custom GUIs: "Statistics" holds the values of
+    // dwm::render_statistics::value, "BudgetHistogram" its histogram, the remaining samples are zeroed
+    int UNITY_AUDIODSP_CALLBACK GetFloatBufferCallback(UnityAudioEffectState *, const char *name, float *buffer,
                                                        const int num_samples) {
-        memset(buffer, 0, sizeof(float) * num_samples);
+        int copied = 0;
+        if (name != nullptr && std::strcmp(name, "Statistics") == 0)
+            copied = dwm_statistics.snapshot(buffer, num_samples);
+        else if (name != nullptr && std::strcmp(name, "BudgetHistogram") == 0)
+            copied = dwm_statistics.histogram(buffer, num_samples);
+        memset(buffer + copied, 0, sizeof(float) * (num_samples - copied));
         return UNITY_AUDIODSP_OK;
     }
 
-    UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK ProcessCallback(UnityAudioEffectState *state, float *,
-                                                                  float *out_buffer, const unsigned int num_samples,
-                                                                  const int, const int out_channels) {
-        const auto *data = state->GetEffectData<data_t>();
-        const float *m = state->spatializerdata->listenermatrix;
-
-        const float listen_x = -(m[0] * m[12] + m[1] * m[13] + m[2] * m[14]);
-        const float listen_y = -(m[4] * m[12] + m[5] * m[13] + m[6] * m[14]);
-        const float listen_z = -(m[8] * m[12] + m[9] * m[13] + m[10] * m[14]);
-
-        const float listen_right_x = m[0] * DWM_EARS_DISTANCE;
-        const float listen_right_y = m[4] * DWM_EARS_DISTANCE;
-        const float listen_right_z = m[8] * DWM_EARS_DISTANCE;
+    // Number of frames of a DSP tick the shared output holds
+    unsigned int TickFrames(const shared_t *shared, const unsigned int num_samples) {
+        return std::min(num_samples, static_cast<unsigned int>(shared->output[0].size() / dwm_mesh_channels));
+    }
 
-        const float listen_l_x = listen_x - listen_right_x;
-        const float listen_l_y = listen_y - listen_right_y;
-        const float listen_l_z = listen_z - listen_right_z;
+    // Renders the listener's channels of a new DSP tick into the shared output, and swaps in the simulation of the
+    // tier switched to if any
+    void AdvanceTick(shared_t *shared, const UnityAudioEffectState *state, const unsigned int num_samples) {
+        simulation_t *sim = shared->current;
+        block_request_t request;
+        // A released owner is only freed once no copy of its parameters is in progress, see ReleaseSimulation
+        shared->reading_owner.store(true, std::memory_order_seq_cst);
+        std::copy_n(shared->owner.load(std::memory_order_seq_cst)->parameters, static_cast<int>(param_num),
+                    request.parameters);
+        shared->reading_owner.store(false, std::memory_order_release);
+#if DWM_AMBISONIC_ORDER > 0
+        request.listener = listener_t::from_listener_matrix(state->spatializerdata->listenermatrix);
+#else
+        request.listener = listener_t::from_listener_matrix(state->spatializerdata->listenermatrix, DWM_EARS_DISTANCE);
+#endif
+#if DWM_HYBRID_RENDERER
+        std::copy_n(state->spatializerdata->listenermatrix, 16, request.listener_matrix);
+#endif
 
-        const float listen_r_x = listen_x + listen_right_x;
-        const float listen_r_y = listen_y + listen_right_y;
-        const float listen_r_z = listen_z + listen_right_z;
+        const int rendered = 1 - shared->ready.load(std::memory_order_relaxed);
+        float *output = shared->output[rendered].data();
+        const unsigned int frames = TickFrames(shared, num_samples);
+        if (sim->pipeline != nullptr) {
+            // Pipelined simulations only hand the blocks over and copy out the ones rendered lookahead blocks ago,
+            // the pipeline's thread being the only one rendering them
+            for (unsigned int offset = 0; offset < frames; offset += sim->max_block) {
+                const unsigned int block = std::min(frames - offset, static_cast<unsigned int>(sim->max_block));
+                sim->pipeline->process(request, output + static_cast<size_t>(offset) * dwm_mesh_channels,
+                                       static_cast<int>(block), dwm_mesh_channels);
+            }
+        } else
+            Render(sim, request, output, frames, dwm_mesh_channels);
 
-        const auto p_xp = boundary_parameters(data->parameters[param_admittance_xp], data->parameters[param_cutoff_xp]);
-        const auto p_xn = boundary_parameters(data->parameters[param_admittance_xn], data->parameters[param_cutoff_xn]);
-        const auto p_yp = boundary_parameters(data->parameters[param_admittance_yp], data->parameters[param_cutoff_yp]);
-        const auto p_yn = boundary_parameters(data->parameters[param_admittance_yn], data->parameters[param_cutoff_yn]);
-        const auto p_zp = boundary_parameters(data->parameters[param_admittance_zp], data->parameters[param_cutoff_zp]);
-        const auto p_zn = boundary_parameters(data->parameters[param_admittance_zn], data->parameters[param_cutoff_zn]);
+        // The simulation switched to starts from silence at the next tick, the current one fades out over this one.
+        // Only one swapped out simulation waits to be deleted at a time
+        simulation_t *next = nullptr;
+        if (sim->predecessor.load(std::memory_order_acquire) == nullptr &&
+            shared->retired.load(std::memory_order_acquire) == nullptr)
+            next = shared->pending.exchange(nullptr, std::memory_order_acq_rel);
+        if (next != nullptr) {
+            for (unsigned int n = 0; n < frames; n++) {
+                const float fade = 1.0f - static_cast<float>(n + 1) / static_cast<float>(frames);
+                for (int c = 0; c < dwm_mesh_channels; c++)
+                    output[n * dwm_mesh_channels + c] *= fade;
+            }
+            // The swapped out simulation is deleted once the next one saw it stop rendering, see Render
+            next->predecessor.store(sim, std::memory_order_relaxed);
+            sim->swapped_out.store(true, std::memory_order_seq_cst);
+            shared->current = next;
+            dwm_quality_tier.store(next->tier, std::memory_order_release);
+        }
+        shared->ready.store(rendered, std::memory_order_release);
+    }
 
+    // Copies the shared output of the last tick ready into an instance's output, at the instance's gain
+    void ReadOut(const shared_t *shared, const data_t *data, float *out_buffer, const unsigned int num_samples,
+                 const int out_channels) {
+        const float *output = shared->output[shared->ready.load(std::memory_order_acquire)].data();
         const float gain = powf(10.0f, data->parameters[param_gain] * 0.05f);
-        for (unsigned int n = 0; n < num_samples; n++) {
-            for (auto &[p_x, p_y, p_z, buffer]: dwm_source_data) {
-                data->mesh->write_value(p_x, p_y, p_z, buffer[n] * gain);
-                buffer[n] = 0;
-            }
-            data->mesh->update(p_xp, p_xn, p_yp, p_yn, p_zp, p_zn);
-            out_buffer[n * out_channels + 0] = data->mesh->read_value(listen_l_x, listen_l_y, listen_l_z);
-            out_buffer[n * out_channels + 1] = data->mesh->read_value(listen_r_x, listen_r_y, listen_r_z);
-            for (int i = 2; i < out_channels; i++) {
-                out_buffer[n * out_channels + i] = 0.0f;
-            }
+        const int copied = std::min(dwm_mesh_channels, out_channels);
+        const unsigned int frames = TickFrames(shared, num_samples);
+        for (unsigned int n = 0; n < frames; n++) {
+            const float *in = output + static_cast<size_t>(n) * dwm_mesh_channels;
+            float *out = out_buffer + static_cast<size_t>(n) * out_channels;
+            for (int c = 0; c < copied; c++)
+                out[c] = gain * in[c];
+            for (int c = copied; c < out_channels; c++)
+                out[c] = 0.0f;
         }
+        std::fill(out_buffer + static_cast<size_t>(frames) * out_channels,
+                  out_buffer + static_cast<size_t>(num_samples) * out_channels, 0.0f);
+    }
 
+    UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK ProcessCallback(UnityAudioEffectState *state, float *,
+                                                                  float *out_buffer, const unsigned int num_samples,
+                                                                  const int, const int out_channels) {
+        const auto *data = state->GetEffectData<data_t>();
+        shared_t *shared = data->shared;
+        // The first instance processed in the tick claims it without ever blocking, the instances processed meanwhile
+        // by other mixers read out the previous tick. The next tick only starts once all the mixers are done with
+        // this one, so the output being read out is never rendered into
+        const uint64_t tick = state->currdsptick;
+        uint64_t claimed = shared->claimed_tick.load(std::memory_order_acquire);
+        if (claimed != tick && shared->claimed_tick.compare_exchange_strong(claimed, tick, std::memory_order_acq_rel))
+            AdvanceTick(shared, state, num_samples);
+        ReadOut(shared, data, out_buffer, num_samples, out_channels);
         return UNITY_AUDIODSP_OK;
     }
 
@@ -0,0 +1,262 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <vector>
+#include "dwm.h"
+#include "dwm_ambisonics.h"
+#include "dwm_resampler.h"
+
+/// Block level rendering of a DWM mesh, shared between the Unity plugin and the headless benchmark
+namespace dwm::simulation {
+
+    typedef filters::admittance_lowpass_parameters boundary_parameters;
+    typedef filters::admittance_lowpass filter;
+
+    /// Mesh configuration used by the plugin, with admittance + low pass boundaries on every side
+    template<const float width, const float height, const float depth, const int sample_rate,
+             typename storage = float, topologies::mesh_topology topology = topologies::rectilinear>
+    using mesh_admittance_lowpass = mesh_3d<width, height, depth, sample_rate, filter, filter, filter, filter, filter,
+                                            filter, storage, topology>;
+
+    /// Listener's ears positions in world coordinates
+    struct ears final {
+        float l_x, l_y, l_z;
+        float r_x, r_y, r_z;
+
+        /// Computes the ears positions from a listener matrix (as provided by Unity's spatializer data)
+        /// @param m 4x4 world to listener matrix
+        /// @param ears_distance distance between the listener's position and each ear
+        [[nodiscard]] static ears from_listener_matrix(const float *m, const float ears_distance) {
+            const float listen_x = -(m[0] * m[12] + m[1] * m[13] + m[2] * m[14]);
+            const float listen_y = -(m[4] * m[12] + m[5] * m[13] + m[6] * m[14]);
+            const float listen_z = -(m[8] * m[12] + m[9] * m[13] + m[10] * m[14]);
+
+            const float listen_right_x = m[0] * ears_distance;
+            const float listen_right_y = m[4] * ears_distance;
+            const float listen_right_z = m[8] * ears_distance;
+
+            return {listen_x - listen_right_x, listen_y - listen_right_y, listen_z - listen_right_z,
+                    listen_x + listen_right_x, listen_y + listen_right_y, listen_z + listen_right_z};
+        }
+
+        /// @return ears positions linearly interpolated between a (t = 0) and b (t = 1)
+        [[nodiscard]] static ears lerp(const ears &a, const ears &b, const float t) {
+            return {std::lerp(a.l_x, b.l_x, t), std::lerp(a.l_y, b.l_y, t), std::lerp(a.l_z, b.l_z, t),
+                    std::lerp(a.r_x, b.r_x, t), std::lerp(a.r_y, b.r_y, t), std::lerp(a.r_z, b.r_z, t)};
+        }
+    };
+
+    /// Renders one block of audio: the sources are injected in the mesh, the mesh is updated and the ears are
+    /// sampled into the first two output channels, for each sample of the block
+    /// @param mesh the simulated mesh
+    /// @param sources sources injected in the mesh, already scaled by the desired gain
+    /// @param source_count number of sources
+    /// @param e listener's ears positions, reached at the end of the block
+    /// @param out_buffer interleaved output buffer
+    /// @param num_samples number of samples per channel to render
+    /// @param out_channels number of interleaved output channels, must be at least 2
+    /// @param workers optional pool each mesh update is split across
+    /// @param e_start optional ears positions at the start of the block, the ears then move linearly to e
+    template<typename mesh_t>
+    void render_block(mesh_t &mesh, const boundary_parameters &p_xp, const boundary_parameters &p_xn,
+                      const boundary_parameters &p_yp, const boundary_parameters &p_yn,
+                      const boundary_parameters &p_zp, const boundary_parameters &p_zn, const block_source *sources,
+                      const int source_count, const ears &e, float *out_buffer, const unsigned int num_samples,
+                      const int out_channels, worker_pool *workers = nullptr, const ears *e_start = nullptr) {
+        const ears &s = e_start != nullptr ? *e_start : e;
+        const bool moving = e_start != nullptr;
+        const block_receiver receivers[2] = {
+                {e.l_x, e.l_y, e.l_z, out_buffer + 0, out_channels, moving, s.l_x, s.l_y, s.l_z},
+                {e.r_x, e.r_y, e.r_z, out_buffer + 1, out_channels, moving, s.r_x, s.r_y, s.r_z}};
+        mesh.update_block(p_xp, p_xn, p_yp, p_yn, p_zp, p_zn, static_cast<int>(num_samples), sources, source_count,
+                          receivers, 2, workers);
+        for (unsigned int n = 0; n < num_samples; n++) {
+            for (int i = 2; i < out_channels; i++) {
+                out_buffer[n * out_channels + i] = 0.0f;
+            }
+        }
+    }
+
+    /// Renders one block of audio as render_block does, with the field around the listener encoded into ambisonic
+    /// channels instead of sampled at the ears
+    /// @param encoder encoder of the listener's field, whose channels are written into the first output channels
+    /// @param l listener's frame, reached at the end of the block
+    /// @param l_start optional listener's frame at the start of the block, the listener then moves linearly to l
+    template<typename mesh_t>
+    void render_block(mesh_t &mesh, const boundary_parameters &p_xp, const boundary_parameters &p_xn,
+                      const boundary_parameters &p_yp, const boundary_parameters &p_yn,
+                      const boundary_parameters &p_zp, const boundary_parameters &p_zn, const block_source *sources,
+                      const int source_count, ambisonics::encoder &encoder, const ambisonics::listener_frame &l,
+                      float *out_buffer, const unsigned int num_samples, const int out_channels,
+                      worker_pool *workers = nullptr, const ambisonics::listener_frame *l_start = nullptr) {
+        mesh.update_block(p_xp, p_xn, p_yp, p_yn, p_zp, p_zn, static_cast<int>(num_samples), sources, source_count,
+                          encoder.receivers(l, l_start), encoder.receiver_count(), workers);
+        encoder.encode(static_cast<int>(num_samples), out_buffer, out_channels);
+    }
+
+    /// Per source state of a rate_converter, owned by the caller so that sources can be added at any time without
+    /// touching the converter
+    class source_resampler final {
+    public:
+        /// Resamples a block of source samples to the mesh rate
+        /// @param input samples at the output rate
+        /// @param num_samples number of input samples, at most the converter's max_block
+        /// @param steps number of mesh steps of the block, as returned by rate_converter::mesh_steps
+        /// @return steps samples at the mesh rate, valid until the next call
+        const float *resample(const float *input, const int num_samples, const int steps) {
+            if (bypass)
+                return input;
+            r.push(input, num_samples);
+            const int pulled = r.pull(samples.data(), steps);
+            std::fill(samples.begin() + pulled, samples.begin() + steps, 0.0f);
+            return samples.data();
+        }
+
+        /// Forgets the previous blocks, for example when the source is reused for a different sound
+        void reset() { r.reset(); }
+
+    private:
+        friend class rate_converter;
+
+        bool bypass;
+        resampler r;
+        std::vector<float> samples; // Resampled block
+
+        source_resampler(const int mesh_rate, const int output_rate, const int max_block, const int max_steps) :
+            bypass(mesh_rate == output_rate), r(output_rate, mesh_rate, bypass ? 1 : std::max(max_block, max_steps)),
+            samples(bypass ? 0 : max_steps) {}
+    };
+
+    /// Runs a mesh at its own sample rate behind an output running at another one: source blocks are resampled to the
+    /// mesh rate and the ears (or ambisonic channels) back to the output rate, with all the state allocated at
+    /// construction\n
+    /// When both rates match blocks are rendered directly, without adding any latency
+    class rate_converter final {
+    public:
+        /// Builds a new instance
+        /// @param mesh_rate sample rate the mesh is simulated at
+        /// @param output_rate sample rate of the source and output blocks
+        /// @param max_block maximum number of samples per block at the output rate
+        /// @param channels number of channels rendered by the mesh, 2 for the ears or the encoder's channels
+        rate_converter(const int mesh_rate, const int output_rate, const int max_block, const int channels = 2) :
+            mesh_rate(mesh_rate), output_rate(output_rate), max_block(max_block), channels(channels),
+            max_steps(max_block * mesh_rate / output_rate + 2) {
+            if (mesh_rate == output_rate)
+                return;
+            channel_resamplers.reserve(channels);
+            for (int c = 0; c < channels; c++)
+                channel_resamplers.emplace_back(mesh_rate, output_rate, std::max(max_block, max_steps));
+            mesh_samples.resize(static_cast<size_t>(channels) * max_steps);
+            round_trip = channel_resamplers[0].latency() +
+                         resampler(output_rate, mesh_rate, 1).latency() * output_rate / mesh_rate;
+        }
+
+        /// @return new per source state for this converter
+        [[nodiscard]] source_resampler make_source_resampler() const {
+            return {mesh_rate, output_rate, max_block, max_steps};
+        }
+
+        /// @return number of mesh steps needed to render the next num_samples output samples
+        [[nodiscard]] int mesh_steps(const unsigned int num_samples) const {
+            if (channel_resamplers.empty())
+                return static_cast<int>(num_samples);
+            // All the channels are resampled in lockstep, so the first one tells how many mesh steps are needed
+            return std::min(channel_resamplers[0].required_input(static_cast<int>(num_samples)), max_steps);
+        }
+
+        /// @return maximum number of mesh steps per block
+        [[nodiscard]] int max_mesh_steps() const { return max_steps; }
+
+        /// @return delay added by resampling the sources to the mesh rate and the ears back, in output samples
+        [[nodiscard]] double latency() const { return round_trip; }
+
+        /// Same as dwm::simulation::render_block, with the output at the output rate
+        /// @param sources sources at the mesh rate, with mesh_steps(num_samples) samples each
+        /// @param num_samples number of output samples to render, at most max_block
+        /// @param added optional interleaved ears at the mesh rate, mesh_steps(num_samples) samples each, added to the
+        /// mesh's (e.g. the sources rendered with baked impulse responses)
+        template<typename mesh_t>
+        void render_block(mesh_t &mesh, const boundary_parameters &p_xp, const boundary_parameters &p_xn,
+                          const boundary_parameters &p_yp, const boundary_parameters &p_yn,
+                          const boundary_parameters &p_zp, const boundary_parameters &p_zn,
+                          const block_source *sources, const int source_count, const ears &e, float *out_buffer,
+                          const unsigned int num_samples, const int out_channels, worker_pool *workers = nullptr,
+                          const ears *e_start = nullptr, const float *added = nullptr) {
+            if (channel_resamplers.empty()) {
+                simulation::render_block(mesh, p_xp, p_xn, p_yp, p_yn, p_zp, p_zn, sources, source_count, e,
+                                         out_buffer, num_samples, out_channels, workers, e_start);
+                add_ears(added, static_cast<int>(num_samples), out_buffer, out_channels);
+                return;
+            }
+
+            const int steps = mesh_steps(num_samples);
+            if (steps > 0)
+                simulation::render_block(mesh, p_xp, p_xn, p_yp, p_yn, p_zp, p_zn, sources, source_count, e,
+                                         mesh_samples.data(), steps, channels, workers, e_start);
+            add_ears(added, steps, mesh_samples.data(), channels);
+            resample_channels(steps, out_buffer, num_samples, out_channels);
+        }
+
+        /// Same as dwm::simulation::render_block with an ambisonic encoder, with the output at the output rate
+        /// @param sources sources at the mesh rate, with mesh_steps(num_samples) samples each
+        /// @param num_samples number of output samples to render, at most max_block
+        template<typename mesh_t>
+        void render_block(mesh_t &mesh, const boundary_parameters &p_xp, const boundary_parameters &p_xn,
+                          const boundary_parameters &p_yp, const boundary_parameters &p_yn,
+                          const boundary_parameters &p_zp, const boundary_parameters &p_zn,
+                          const block_source *sources, const int source_count, ambisonics::encoder &encoder,
+                          const ambisonics::listener_frame &l, float *out_buffer, const unsigned int num_samples,
+                          const int out_channels, worker_pool *workers = nullptr,
+                          const ambisonics::listener_frame *l_start = nullptr) {
+            if (channel_resamplers.empty()) {
+                simulation::render_block(mesh, p_xp, p_xn, p_yp, p_yn, p_zp, p_zn, sources, source_count, encoder, l,
+                                         out_buffer, num_samples, out_channels, workers, l_start);
+                return;
+            }
+
+            const int steps = mesh_steps(num_samples);
+            if (steps > 0)
+                simulation::render_block(mesh, p_xp, p_xn, p_yp, p_yn, p_zp, p_zn, sources, source_count, encoder, l,
+                                         mesh_samples.data(), steps, channels, workers, l_start);
+            resample_channels(steps, out_buffer, num_samples, out_channels);
+        }
+
+    private:
+        int mesh_rate, output_rate, max_block, channels;
+        int max_steps; // Maximum number of mesh steps per block
+        double round_trip = 0.0; // Resamplers' latency, in output samples
+        std::vector<resampler> channel_resamplers; // Mesh rate to output rate, one per channel, empty when bypassed
+        std::vector<float> mesh_samples; // Interleaved channels at the mesh rate
+
+        // Adds interleaved ears to the first two channels of a block, if any
+        static void add_ears(const float *added, const int steps, float *buffer, const int buffer_channels) {
+            if (added == nullptr)
+                return;
+            for (int n = 0; n < steps; n++) {
+                buffer[n * buffer_channels] += added[2 * n];
+                buffer[n * buffer_channels + 1] += added[2 * n + 1];
+            }
+        }
+
+        // Resamples the channels of a block rendered at the mesh rate into the output, zeroing the other channels
+        void resample_channels(const int steps, float *out_buffer, const unsigned int num_samples,
+                               const int out_channels) {
+            const int samples = static_cast<int>(num_samples);
+            const int written = std::min(channels, out_channels);
+            for (int c = 0; c < written; c++) {
+                channel_resamplers[c].push(mesh_samples.data() + c, steps, channels);
+                const int pulled = channel_resamplers[c].pull(out_buffer + c, samples, out_channels);
+                for (int n = pulled; n < samples; n++)
+                    out_buffer[n * out_channels + c] = 0.0f;
+            }
+            for (int n = 0; n < samples; n++) {
+                for (int i = written; i < out_channels; i++) {
+                    out_buffer[n * out_channels + i] = 0.0f;
+                }
+            }
+        }
+    };
+
+} // namespace dwm::simulation
+
+#endif